@@ -606,6 +606,26 @@ static int ctl_shm_close(client_t *client)
 	return 0;
 }
 
+static int ctl_shm_set_event_filter(snd_ctl_t *ctl,
+				    const snd_ctl_shm_event_filter_t *wire)
+{
+	snd_ctl_event_filter_t *filter;
+	unsigned int iface;
+
+	if (!wire->active)
+		return snd_ctl_set_event_filter(ctl, NULL);
+	snd_ctl_event_filter_alloca(&filter);
+	snd_ctl_event_filter_clear(filter);
+	for (iface = 0; iface <= SND_CTL_ELEM_IFACE_LAST; iface++) {
+		if (wire->ifaces & (1U << iface))
+			snd_ctl_event_filter_add_interface(filter, iface);
+	}
+	snd_ctl_event_filter_set_numid_range(filter, wire->numid_min,
+					     wire->numid_max);
+	snd_ctl_event_filter_set_mask(filter, wire->mask);
+	return snd_ctl_set_event_filter(ctl, filter);
+}
+
 static int ctl_shm_cmd(client_t *client)
 {
 	snd_ctl_shm_ctrl_t *ctrl = client->transport.shm.ctrl;
@@ -702,6 +722,9 @@ static int ctl_shm_cmd(client_t *client)
 	case SND_CTL_IOCTL_READ:
 		ctrl->result = snd_ctl_read(ctl, &ctrl->u.read);
 		break;
+	case SND_CTL_IOCTL_EVENT_FILTER:
+		ctrl->result = ctl_shm_set_event_filter(ctl, &ctrl->u.event_filter);
+		break;
 	case SND_CTL_IOCTL_CLOSE:
 		client->ops->close(client);
 		break;
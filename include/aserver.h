@@ -111,6 +111,16 @@ typedef struct {
 #define SND_CTL_IOCTL_CLOSE		_IO ('U', 0xf2)
 #define SND_CTL_IOCTL_POLL_DESCRIPTOR	_IO ('U', 0xf3)
 #define SND_CTL_IOCTL_ASYNC		_IO ('U', 0xf4)
+#define SND_CTL_IOCTL_EVENT_FILTER	_IO ('U', 0xf5)
+
+/* event filter on the wire, independent of snd_ctl_event_filter_t */
+typedef struct {
+	int active;
+	unsigned int ifaces;		/* bitmap of interfaces, 0 = any */
+	unsigned int numid_min;
+	unsigned int numid_max;
+	unsigned int mask;
+} snd_ctl_shm_event_filter_t;
 
 typedef struct {
 	int result;
@@ -136,6 +146,7 @@ typedef struct {
 		int rawmidi_prefer_subdevice;
 		unsigned int power_state;
 		snd_ctl_event_t read;
+		snd_ctl_shm_event_filter_t event_filter;
 	} u;
 	char data[0];
 } snd_ctl_shm_ctrl_t;
@@ -68,6 +68,18 @@ typedef struct _snd_ctl_elem_value snd_ctl_elem_value_t;
 /** CTL event container */
 typedef struct _snd_ctl_event snd_ctl_event_t;
 
+/** CTL event filter container */
+typedef struct _snd_ctl_event_filter snd_ctl_event_filter_t;
+
+/** CTL compiled ASCII element assignment */
+typedef struct _snd_ctl_ascii_cset snd_ctl_ascii_cset_t;
+
+/** CTL shared memory mirror publisher */
+typedef struct _snd_ctl_mirror snd_ctl_mirror_t;
+
+/** Precomputed dB conversion table for a TLV volume range */
+typedef struct _snd_tlv_dB_table snd_tlv_dB_table_t;
+
 /** CTL element type */
 typedef enum _snd_ctl_elem_type {
 	/** Invalid type */
@@ -198,7 +210,9 @@ typedef enum _snd_ctl_type {
 	/** INET client CTL (not yet implemented) */
 	SND_CTL_TYPE_INET,
 	/** External control plugin */
-	SND_CTL_TYPE_EXT
+	SND_CTL_TYPE_EXT,
+	/** Shared memory mirror of another CTL */
+	SND_CTL_TYPE_MIRROR
 } snd_ctl_type_t;
 
 /** Non blocking mode (flag for open mode) \hideinitializer */
@@ -273,10 +287,16 @@ int snd_ctl_set_power_state(snd_ctl_t *ctl, unsigned int state);
 int snd_ctl_get_power_state(snd_ctl_t *ctl, unsigned int *state);
 
 int snd_ctl_read(snd_ctl_t *ctl, snd_ctl_event_t *event);
+int snd_ctl_set_event_filter(snd_ctl_t *ctl, const snd_ctl_event_filter_t *filter);
 int snd_ctl_wait(snd_ctl_t *ctl, int timeout);
 const char *snd_ctl_name(snd_ctl_t *ctl);
 snd_ctl_type_t snd_ctl_type(snd_ctl_t *ctl);
 
+int snd_ctl_mirror_publish(snd_ctl_mirror_t **mirror, snd_ctl_t *ctl,
+			   const char *file);
+int snd_ctl_mirror_update(snd_ctl_mirror_t *mirror);
+int snd_ctl_mirror_free(snd_ctl_mirror_t *mirror);
+
 const char *snd_ctl_elem_type_name(snd_ctl_elem_type_t type);
 const char *snd_ctl_elem_iface_name(snd_ctl_elem_iface_t iface);
 const char *snd_ctl_event_type_name(snd_ctl_event_type_t type);
@@ -299,6 +319,11 @@ int snd_ctl_ascii_value_parse(snd_ctl_t *handle,
 			      snd_ctl_elem_value_t *dst,
 			      snd_ctl_elem_info_t *info,
 			      const char *value);
+int snd_ctl_ascii_cset_compile(snd_ctl_ascii_cset_t **cset,
+			       snd_ctl_t *handle, const char *str);
+int snd_ctl_ascii_cset_write(snd_ctl_t *handle,
+			     const snd_ctl_ascii_cset_t *cset);
+void snd_ctl_ascii_cset_free(snd_ctl_ascii_cset_t *cset);
 
 size_t snd_ctl_elem_id_sizeof(void);
 /** \hideinitializer
@@ -353,6 +378,21 @@ void snd_ctl_event_clear(snd_ctl_event_t *obj);
 void snd_ctl_event_copy(snd_ctl_event_t *dst, const snd_ctl_event_t *src);
 snd_ctl_event_type_t snd_ctl_event_get_type(const snd_ctl_event_t *obj);
 
+size_t snd_ctl_event_filter_sizeof(void);
+/** \hideinitializer
+ * \brief allocate an invalid #snd_ctl_event_filter_t using standard alloca
+ * \param ptr returned pointer
+ */
+#define snd_ctl_event_filter_alloca(ptr) __snd_alloca(ptr, snd_ctl_event_filter)
+int snd_ctl_event_filter_malloc(snd_ctl_event_filter_t **ptr);
+void snd_ctl_event_filter_free(snd_ctl_event_filter_t *obj);
+void snd_ctl_event_filter_clear(snd_ctl_event_filter_t *obj);
+void snd_ctl_event_filter_copy(snd_ctl_event_filter_t *dst, const snd_ctl_event_filter_t *src);
+void snd_ctl_event_filter_add_interface(snd_ctl_event_filter_t *obj, snd_ctl_elem_iface_t iface);
+void snd_ctl_event_filter_set_numid_range(snd_ctl_event_filter_t *obj, unsigned int min, unsigned int max);
+void snd_ctl_event_filter_set_mask(snd_ctl_event_filter_t *obj, unsigned int mask);
+int snd_ctl_event_filter_match(const snd_ctl_event_filter_t *obj, const snd_ctl_event_t *event);
+
 size_t snd_ctl_elem_list_sizeof(void);
 /** \hideinitializer
  * \brief allocate an invalid #snd_ctl_elem_list_t using standard alloca
@@ -507,6 +547,17 @@ int snd_ctl_convert_to_dB(snd_ctl_t *ctl, const snd_ctl_elem_id_t *id,
 			  long volume, long *db_gain);
 int snd_ctl_convert_from_dB(snd_ctl_t *ctl, const snd_ctl_elem_id_t *id,
 			    long db_gain, long *value, int xdir);
+int snd_tlv_dB_table_new(snd_tlv_dB_table_t **table, unsigned int *tlv,
+			 long rangemin, long rangemax);
+void snd_tlv_dB_table_free(snd_tlv_dB_table_t *table);
+void snd_tlv_dB_table_get_range(const snd_tlv_dB_table_t *table,
+				long *rangemin, long *rangemax);
+int snd_tlv_dB_table_to_dB(const snd_tlv_dB_table_t *table,
+			   long volume, long *db_gain);
+int snd_tlv_dB_table_from_dB(const snd_tlv_dB_table_t *table,
+			     long db_gain, long *value, int xdir);
+int snd_ctl_get_dB_table(snd_ctl_t *ctl, const snd_ctl_elem_id_t *id,
+			 snd_tlv_dB_table_t **table);
 
 /**
  *  \defgroup HControl High level Control Interface
@@ -567,6 +618,7 @@ snd_hctl_elem_t *snd_hctl_find_elem(snd_hctl_t *hctl, const snd_ctl_elem_id_t *i
 void snd_hctl_set_callback(snd_hctl_t *hctl, snd_hctl_callback_t callback);
 void snd_hctl_set_callback_private(snd_hctl_t *hctl, void *data);
 void *snd_hctl_get_callback_private(snd_hctl_t *hctl);
+int snd_hctl_set_prefetch(snd_hctl_t *hctl, int enable);
 int snd_hctl_load(snd_hctl_t *hctl);
 int snd_hctl_free(snd_hctl_t *hctl);
 int snd_hctl_handle_events(snd_hctl_t *hctl);
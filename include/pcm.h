@@ -389,6 +389,8 @@ typedef long snd_pcm_sframes_t;
 #define SND_PCM_NO_AUTO_FORMAT		0x00040000
 /** Disable soft volume control */
 #define SND_PCM_NO_SOFTVOL		0x00080000
+/** The PCM is used by a single thread only, no locking is done (flag for open mode) */
+#define SND_PCM_SINGLE_THREAD		0x00100000
 
 /** PCM handle */
 typedef struct _snd_pcm snd_pcm_t;
@@ -474,6 +476,29 @@ typedef struct _snd_pcm_channel_area {
 	unsigned int step;
 } snd_pcm_channel_area_t;
 
+/** PCM position and timestamps filled by #snd_pcm_status_batch() */
+typedef struct _snd_pcm_batch_status {
+	/** zero or a negative error code, the other fields are valid only if zero */
+	int err;
+	/** PCM state */
+	snd_pcm_state_t state;
+	/** frames ready to be read or written */
+	snd_pcm_sframes_t avail;
+	/** total I/O latency in frames */
+	snd_pcm_sframes_t delay;
+	/** hardware position (0 ... boundary - 1) */
+	snd_pcm_uframes_t hw_ptr;
+	/** application position (0 ... boundary - 1) */
+	snd_pcm_uframes_t appl_ptr;
+	/** timestamp of the last position update */
+	snd_htimestamp_t tstamp;
+	/** audio timestamp of the last position update, zero if not known */
+	snd_htimestamp_t audio_tstamp;
+} snd_pcm_batch_status_t;
+
+/** Sync the positions with the hardware in #snd_pcm_status_batch() \hideinitializer */
+#define SND_PCM_STATUS_BATCH_HWSYNC	0x00000001
+
 /** PCM synchronization ID */
 typedef union _snd_pcm_sync_id {
 	/** 8-bit ID */
@@ -529,6 +554,8 @@ int snd_pcm_htimestamp(snd_pcm_t *pcm, snd_pcm_uframes_t *avail, snd_htimestamp_
 snd_pcm_sframes_t snd_pcm_avail(snd_pcm_t *pcm);
 snd_pcm_sframes_t snd_pcm_avail_update(snd_pcm_t *pcm);
 int snd_pcm_avail_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *availp, snd_pcm_sframes_t *delayp);
+int snd_pcm_status_batch(snd_pcm_t *const *pcms, snd_pcm_batch_status_t *status,
+			 unsigned int count, unsigned int flags);
 snd_pcm_sframes_t snd_pcm_rewindable(snd_pcm_t *pcm);
 snd_pcm_sframes_t snd_pcm_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t frames);
 snd_pcm_sframes_t snd_pcm_forwardable(snd_pcm_t *pcm);
@@ -1313,6 +1340,54 @@ int snd_spcm_init_get_params(snd_pcm_t *pcm,
 
 /** \} */
 
+/**
+ * \defgroup PCM_Uring Batched Transfers
+ * \ingroup PCM
+ * See the \ref pcm page for more details.
+ * \{
+ */
+
+/** PCM transfer ring container */
+typedef struct _snd_pcm_uring snd_pcm_uring_t;
+
+/** PCM transfer ring request type */
+typedef enum _snd_pcm_uring_op {
+	/** Interleaved write, the result is the count of written frames */
+	SND_PCM_URING_WRITEI = 0,
+	/** Interleaved read, the result is the count of read frames */
+	SND_PCM_URING_READI,
+	/** Wait for the PCM, the result is the (demangled) poll revents */
+	SND_PCM_URING_POLL,
+	SND_PCM_URING_LAST = SND_PCM_URING_POLL
+} snd_pcm_uring_op_t;
+
+/** PCM transfer ring completion */
+typedef struct _snd_pcm_uring_event {
+	snd_pcm_t *pcm;			/**< PCM handle of the request */
+	snd_pcm_uring_op_t op;		/**< request type */
+	snd_pcm_sframes_t result;	/**< frames, revents or a negative error code */
+	void *private_data;		/**< pointer passed with the request */
+} snd_pcm_uring_event_t;
+
+/** Don't use io_uring, always emulate the ring (flag for #snd_pcm_uring_open) */
+#define SND_PCM_URING_EMULATE		0x00000001
+
+int snd_pcm_uring_open(snd_pcm_uring_t **ringp, unsigned int entries, int mode);
+int snd_pcm_uring_close(snd_pcm_uring_t *ring);
+int snd_pcm_uring_native(snd_pcm_uring_t *ring);
+int snd_pcm_uring_writei(snd_pcm_uring_t *ring, snd_pcm_t *pcm,
+			 const void *buffer, snd_pcm_uframes_t size,
+			 void *private_data);
+int snd_pcm_uring_readi(snd_pcm_uring_t *ring, snd_pcm_t *pcm,
+			void *buffer, snd_pcm_uframes_t size,
+			void *private_data);
+int snd_pcm_uring_poll(snd_pcm_uring_t *ring, snd_pcm_t *pcm,
+		       void *private_data);
+int snd_pcm_uring_submit(snd_pcm_uring_t *ring, snd_pcm_uring_event_t *events,
+			 unsigned int space, int timeout);
+
+/** \} */
+
 /**
  * \defgroup PCM_Deprecated Deprecated Functions
  * \ingroup PCM
@@ -67,6 +67,36 @@ typedef enum _snd_rawmidi_stream {
 /** RawMidi handle */
 typedef struct _snd_rawmidi snd_rawmidi_t;
 
+/** RawMidi input read mode */
+typedef enum _snd_rawmidi_read_mode {
+	/** Plain bytes, read with snd_rawmidi_read() */
+	SND_RAWMIDI_READ_STANDARD = 0,
+	/** Timestamped bytes, read with snd_rawmidi_tread() */
+	SND_RAWMIDI_READ_TSTAMP = 1,
+} snd_rawmidi_read_mode_t;
+
+/** RawMidi input timestamp clock */
+typedef enum _snd_rawmidi_clock {
+	/** Default clock (monotonic) */
+	SND_RAWMIDI_CLOCK_NONE = 0,
+	/** Realtime clock */
+	SND_RAWMIDI_CLOCK_REALTIME = 1 << 3,
+	/** Monotonic clock */
+	SND_RAWMIDI_CLOCK_MONOTONIC = 2 << 3,
+	/** Raw monotonic clock */
+	SND_RAWMIDI_CLOCK_MONOTONIC_RAW = 3 << 3,
+} snd_rawmidi_clock_t;
+
+/** Complete MIDI message returned by snd_rawmidi_read_messages() */
+typedef struct _snd_rawmidi_message {
+	/** time when the first byte of the message was received */
+	struct timespec tstamp;
+	/** message bytes including the status byte */
+	unsigned char *data;
+	/** number of bytes in data */
+	size_t length;
+} snd_rawmidi_message_t;
+
 /** RawMidi type */
 typedef enum _snd_rawmidi_type {
 	/** Kernel level RawMidi */
@@ -126,6 +156,10 @@ int snd_rawmidi_params_set_avail_min(snd_rawmidi_t *rmidi, snd_rawmidi_params_t
 size_t snd_rawmidi_params_get_avail_min(const snd_rawmidi_params_t *params);
 int snd_rawmidi_params_set_no_active_sensing(snd_rawmidi_t *rmidi, snd_rawmidi_params_t *params, int val);
 int snd_rawmidi_params_get_no_active_sensing(const snd_rawmidi_params_t *params);
+int snd_rawmidi_params_set_read_mode(snd_rawmidi_t *rawmidi, snd_rawmidi_params_t *params, snd_rawmidi_read_mode_t val);
+snd_rawmidi_read_mode_t snd_rawmidi_params_get_read_mode(const snd_rawmidi_params_t *params);
+int snd_rawmidi_params_set_clock_type(snd_rawmidi_t *rawmidi, snd_rawmidi_params_t *params, snd_rawmidi_clock_t val);
+snd_rawmidi_clock_t snd_rawmidi_params_get_clock_type(const snd_rawmidi_params_t *params);
 int snd_rawmidi_params(snd_rawmidi_t *rmidi, snd_rawmidi_params_t * params);
 int snd_rawmidi_params_current(snd_rawmidi_t *rmidi, snd_rawmidi_params_t *params);
 size_t snd_rawmidi_status_sizeof(void);
@@ -145,6 +179,9 @@ int snd_rawmidi_drain(snd_rawmidi_t *rmidi);
 int snd_rawmidi_drop(snd_rawmidi_t *rmidi);
 ssize_t snd_rawmidi_write(snd_rawmidi_t *rmidi, const void *buffer, size_t size);
 ssize_t snd_rawmidi_read(snd_rawmidi_t *rmidi, void *buffer, size_t size);
+ssize_t snd_rawmidi_tread(snd_rawmidi_t *rmidi, struct timespec *tstamp, void *buffer, size_t size);
+ssize_t snd_rawmidi_read_messages(snd_rawmidi_t *rmidi, snd_rawmidi_message_t *msgs, size_t count,
+				  unsigned char *buffer, size_t size);
 const char *snd_rawmidi_name(snd_rawmidi_t *rmidi);
 snd_rawmidi_type_t snd_rawmidi_type(snd_rawmidi_t *rmidi);
 snd_rawmidi_stream_t snd_rawmidi_stream(snd_rawmidi_t *rawmidi);
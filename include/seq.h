@@ -62,7 +62,8 @@ typedef struct _snd_seq snd_seq_t;
 typedef enum _snd_seq_type {
 	SND_SEQ_TYPE_HW,		/**< hardware */
 	SND_SEQ_TYPE_SHM,		/**< shared memory (NYI) */
-	SND_SEQ_TYPE_INET		/**< network (NYI) */
+	SND_SEQ_TYPE_INET,		/**< network (NYI) */
+	SND_SEQ_TYPE_LOOP		/**< in-process loopback */
 } snd_seq_type_t;
 
 /** special client (port) ids */
@@ -90,6 +91,9 @@ size_t snd_seq_get_output_buffer_size(snd_seq_t *handle);
 size_t snd_seq_get_input_buffer_size(snd_seq_t *handle);
 int snd_seq_set_output_buffer_size(snd_seq_t *handle, size_t size);
 int snd_seq_set_input_buffer_size(snd_seq_t *handle, size_t size);
+int snd_seq_set_output_buffer_max(snd_seq_t *handle, size_t size);
+int snd_seq_set_input_buffer_max(snd_seq_t *handle, size_t size);
+unsigned int snd_seq_get_buffer_allocs(snd_seq_t *handle);
 
 /** system information container */
 typedef struct _snd_seq_system_info snd_seq_system_info_t;
@@ -521,8 +525,19 @@ ssize_t snd_seq_event_length(snd_seq_event_t *ev);
 int snd_seq_event_output(snd_seq_t *handle, snd_seq_event_t *ev);
 int snd_seq_event_output_buffer(snd_seq_t *handle, snd_seq_event_t *ev);
 int snd_seq_event_output_direct(snd_seq_t *handle, snd_seq_event_t *ev);
+int snd_seq_event_output_array(snd_seq_t *handle, snd_seq_event_t *evs, unsigned int count);
+int snd_seq_set_output_mt(snd_seq_t *handle, int enable);
 int snd_seq_event_input(snd_seq_t *handle, snd_seq_event_t **ev);
+int snd_seq_event_input_array(snd_seq_t *handle, snd_seq_event_t **evs, unsigned int count);
 int snd_seq_event_input_pending(snd_seq_t *seq, int fetch_sequencer);
+
+/** Input event handler, see #snd_seq_set_input_handler() */
+typedef int (*snd_seq_event_handler_t)(snd_seq_t *seq, snd_seq_event_t *ev, void *private_data);
+
+int snd_seq_set_input_filter(snd_seq_t *seq, int event_type);
+int snd_seq_reset_input_filter(snd_seq_t *seq);
+int snd_seq_set_input_handler(snd_seq_t *seq, int event_type,
+			      snd_seq_event_handler_t handler, void *private_data);
 int snd_seq_drain_output(snd_seq_t *handle);
 int snd_seq_event_output_pending(snd_seq_t *seq);
 int snd_seq_extract_output(snd_seq_t *handle, snd_seq_event_t **ev);
@@ -360,6 +360,24 @@ int snd_seq_parse_address(snd_seq_t *seq, snd_seq_addr_t *addr, const char *str)
 int snd_seq_reset_pool_output(snd_seq_t *seq);
 int snd_seq_reset_pool_input(snd_seq_t *seq);
 
+/*
+ * feed a sorted event list to a queue
+ */
+/** Queue feeding scheduler */
+typedef struct _snd_seq_scheduler snd_seq_scheduler_t;
+
+int snd_seq_scheduler_new(snd_seq_scheduler_t **schedp, snd_seq_t *seq, int queue,
+			  unsigned int watermark);
+void snd_seq_scheduler_free(snd_seq_scheduler_t *sched);
+int snd_seq_scheduler_set_events(snd_seq_scheduler_t *sched, snd_seq_event_t *evs,
+				 unsigned int count);
+int snd_seq_scheduler_fill(snd_seq_scheduler_t *sched);
+unsigned int snd_seq_scheduler_pending(snd_seq_scheduler_t *sched);
+unsigned int snd_seq_scheduler_get_batches(snd_seq_scheduler_t *sched);
+unsigned int snd_seq_scheduler_get_late(snd_seq_scheduler_t *sched);
+snd_seq_tick_time_t snd_seq_scheduler_get_max_late_tick(snd_seq_scheduler_t *sched);
+const snd_seq_real_time_t *snd_seq_scheduler_get_max_late_time(snd_seq_scheduler_t *sched);
+
 /**
  * \brief set note event
  * \param ev event record
@@ -92,6 +92,7 @@ against the original design.
 #include <signal.h>
 #include <poll.h>
 #include <stdbool.h>
+#include <limits.h>
 #include "control_local.h"
 
 /**
@@ -171,6 +172,7 @@ int snd_ctl_new(snd_ctl_t **ctlp, snd_ctl_type_t type, const char *name)
 	if (name)
 		ctl->name = strdup(name);
 	INIT_LIST_HEAD(&ctl->async_handlers);
+	snd_ctl_event_filter_clear(&ctl->event_filter);
 	*ctlp = ctl;
 	return 0;
 }
@@ -1156,8 +1158,47 @@ int snd_ctl_get_power_state(snd_ctl_t *ctl, unsigned int *state)
  */
 int snd_ctl_read(snd_ctl_t *ctl, snd_ctl_event_t *event)
 {
+	int err;
+
 	assert(ctl && event);
-	return (ctl->ops->read)(ctl, event);
+	if (!ctl->event_filtered || ctl->ops->set_event_filter)
+		return (ctl->ops->read)(ctl, event);
+	do {
+		err = (ctl->ops->read)(ctl, event);
+	} while (err > 0 && !snd_ctl_event_filter_match(&ctl->event_filter, event));
+	return err;
+}
+
+/**
+ * \brief Set the filter for events returned by #snd_ctl_read()
+ * \param ctl CTL handle
+ * \param filter Event filter, NULL to receive all events
+ * \return 0 on success otherwise a negative error code
+ *
+ * Element events not matching the filter are dropped before
+ * #snd_ctl_read() returns, so they do not reach the HCTL and mixer
+ * callbacks.  The control plugins supporting it (ext, shm) apply the
+ * filter on their side to avoid the transfer of the filtered events.
+ * Note that the poll descriptors may still be woken up by the filtered
+ * events, the following read returns -EAGAIN in this case.
+ */
+int snd_ctl_set_event_filter(snd_ctl_t *ctl, const snd_ctl_event_filter_t *filter)
+{
+	snd_ctl_event_filter_t all;
+	int err;
+
+	assert(ctl);
+	snd_ctl_event_filter_clear(&all);
+	if (filter && !memcmp(filter, &all, sizeof(all)))
+		filter = NULL;
+	if (ctl->ops->set_event_filter) {
+		err = ctl->ops->set_event_filter(ctl, filter);
+		if (err < 0)
+			return err;
+	}
+	ctl->event_filtered = filter != NULL;
+	ctl->event_filter = filter ? *filter : all;
+	return 0;
 }
 
 /**
@@ -1246,7 +1287,7 @@ snd_ctl_t *snd_async_handler_get_ctl(snd_async_handler_t *handler)
 }
 
 static const char *const build_in_ctls[] = {
-	"hw", "shm", NULL
+	"hw", "shm", "mirror", NULL
 };
 
 static int snd_ctl_open_conf(snd_ctl_t **ctlp, const char *name,
@@ -2015,6 +2056,132 @@ snd_ctl_event_type_t snd_ctl_event_get_type(const snd_ctl_event_t *obj)
 	return obj->type;
 }
 
+/**
+ * \brief get size of #snd_ctl_event_filter_t
+ * \return size in bytes
+ */
+size_t snd_ctl_event_filter_sizeof()
+{
+	return sizeof(snd_ctl_event_filter_t);
+}
+
+/**
+ * \brief allocate a #snd_ctl_event_filter_t passing all events using standard malloc
+ * \param ptr returned pointer
+ * \return 0 on success otherwise negative error code
+ */
+int snd_ctl_event_filter_malloc(snd_ctl_event_filter_t **ptr)
+{
+	assert(ptr);
+	*ptr = malloc(sizeof(snd_ctl_event_filter_t));
+	if (!*ptr)
+		return -ENOMEM;
+	snd_ctl_event_filter_clear(*ptr);
+	return 0;
+}
+
+/**
+ * \brief frees a previously allocated #snd_ctl_event_filter_t
+ * \param obj pointer to object to free
+ */
+void snd_ctl_event_filter_free(snd_ctl_event_filter_t *obj)
+{
+	free(obj);
+}
+
+/**
+ * \brief clear given #snd_ctl_event_filter_t object to pass all events
+ * \param obj pointer to object to clear
+ */
+void snd_ctl_event_filter_clear(snd_ctl_event_filter_t *obj)
+{
+	assert(obj);
+	obj->ifaces = 0;
+	obj->numid_min = 0;
+	obj->numid_max = UINT_MAX;
+	obj->mask = ~0U;
+}
+
+/**
+ * \brief copy one #snd_ctl_event_filter_t to another
+ * \param dst pointer to destination
+ * \param src pointer to source
+ */
+void snd_ctl_event_filter_copy(snd_ctl_event_filter_t *dst, const snd_ctl_event_filter_t *src)
+{
+	assert(dst && src);
+	*dst = *src;
+}
+
+/**
+ * \brief Add an interface to the interfaces passed by a CTL event filter
+ * \param obj CTL event filter
+ * \param iface Element interface
+ *
+ * When no interface is added, events of all interfaces pass.
+ */
+void snd_ctl_event_filter_add_interface(snd_ctl_event_filter_t *obj, snd_ctl_elem_iface_t iface)
+{
+	assert(obj);
+	assert((unsigned int)iface <= SND_CTL_ELEM_IFACE_LAST);
+	obj->ifaces |= 1U << iface;
+}
+
+/**
+ * \brief Set the range of element numeric identifiers passed by a CTL event filter
+ * \param obj CTL event filter
+ * \param min First passed numid
+ * \param max Last passed numid
+ */
+void snd_ctl_event_filter_set_numid_range(snd_ctl_event_filter_t *obj, unsigned int min, unsigned int max)
+{
+	assert(obj);
+	obj->numid_min = min;
+	obj->numid_max = max;
+}
+
+/**
+ * \brief Set the event mask bits passed by a CTL event filter
+ * \param obj CTL event filter
+ * \param mask Bitmask of SND_CTL_EVENT_MASK_VALUE, _INFO, _ADD and _TLV
+ *
+ * An element event passes when it has any of the given bits set.
+ * Removal events (#SND_CTL_EVENT_MASK_REMOVE) always pass.
+ */
+void snd_ctl_event_filter_set_mask(snd_ctl_event_filter_t *obj, unsigned int mask)
+{
+	assert(obj);
+	obj->mask = mask;
+}
+
+/**
+ * \brief Check whether an event passes a CTL event filter
+ * \param obj CTL event filter
+ * \param event CTL event
+ * \return 1 if the event passes, 0 if it is filtered out
+ *
+ * Events other than element events and element removal events always
+ * pass, whatever the interfaces and numid range of the filter.
+ */
+int snd_ctl_event_filter_match(const snd_ctl_event_filter_t *obj, const snd_ctl_event_t *event)
+{
+	const struct snd_ctl_elem_id *id;
+
+	assert(obj && event);
+	if (event->type != SND_CTL_EVENT_ELEM)
+		return 1;
+	/* element lists stay consistent only when no removal is lost */
+	if (event->data.elem.mask == SND_CTL_EVENT_MASK_REMOVE)
+		return 1;
+	id = &event->data.elem.id;
+	if (obj->ifaces && (id->iface > SND_CTL_ELEM_IFACE_LAST ||
+			    !(obj->ifaces & (1U << id->iface))))
+		return 0;
+	if (id->numid < obj->numid_min || id->numid > obj->numid_max)
+		return 0;
+	return (event->data.elem.mask & obj->mask) != 0;
+}
+
 /**
  * \brief get size of #snd_ctl_elem_list_t
  * \return size in bytes
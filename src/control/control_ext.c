@@ -415,14 +415,29 @@ static int snd_ctl_ext_read(snd_ctl_t *handle, snd_ctl_event_t *event)
 {
 	snd_ctl_ext_t *ext = handle->private_data;
 
+	int err;
+
 	if (ext->callback->read_event) {
-		memset(event, 0, sizeof(*event));
-		return ext->callback->read_event(ext, &event->data.elem.id, &event->data.elem.mask);
+		/* drop the filtered events before they leave the plugin */
+		do {
+			memset(event, 0, sizeof(*event));
+			err = ext->callback->read_event(ext, &event->data.elem.id,
+							&event->data.elem.mask);
+		} while (err > 0 && handle->event_filtered &&
+			 !snd_ctl_event_filter_match(&handle->event_filter, event));
+		return err;
 	}
 
 	return -EINVAL;
 }
 
+static int snd_ctl_ext_set_event_filter(snd_ctl_t *handle ATTRIBUTE_UNUSED,
+					const snd_ctl_event_filter_t *filter ATTRIBUTE_UNUSED)
+{
+	/* the filter stored in the handle is applied in snd_ctl_ext_read() */
+	return 0;
+}
+
 static int snd_ctl_ext_poll_descriptors_count(snd_ctl_t *handle)
 {
 	snd_ctl_ext_t *ext = handle->private_data;
@@ -490,6 +505,7 @@ static const snd_ctl_ops_t snd_ctl_ext_ops = {
 	.set_power_state = snd_ctl_ext_set_power_state,
 	.get_power_state = snd_ctl_ext_get_power_state,
 	.read = snd_ctl_ext_read,
+	.set_event_filter = snd_ctl_ext_set_event_filter,
 	.poll_descriptors_count = snd_ctl_ext_poll_descriptors_count,
 	.poll_descriptors = snd_ctl_ext_poll_descriptors,
 	.poll_revents = snd_ctl_ext_poll_revents,
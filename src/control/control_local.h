@@ -22,6 +22,13 @@
 #include "local.h"
 #include <sound/tlv.h>
 
+struct _snd_ctl_event_filter {
+	unsigned int ifaces;		/* bitmap of interfaces, 0 = any */
+	unsigned int numid_min;
+	unsigned int numid_max;
+	unsigned int mask;		/* SND_CTL_EVENT_MASK_* bits */
+};
+
 typedef struct _snd_ctl_ops {
 	int (*close)(snd_ctl_t *handle);
 	int (*nonblock)(snd_ctl_t *handle, int nonblock);
@@ -50,6 +57,8 @@ typedef struct _snd_ctl_ops {
 	int (*set_power_state)(snd_ctl_t *handle, unsigned int state);
 	int (*get_power_state)(snd_ctl_t *handle, unsigned int *state);
 	int (*read)(snd_ctl_t *handle, snd_ctl_event_t *event);
+	/* optional, the implementation drops the filtered events itself */
+	int (*set_event_filter)(snd_ctl_t *handle, const snd_ctl_event_filter_t *filter);
 	int (*poll_descriptors_count)(snd_ctl_t *handle);
 	int (*poll_descriptors)(snd_ctl_t *handle, struct pollfd *pfds, unsigned int space);
 	int (*poll_revents)(snd_ctl_t *handle, struct pollfd *pfds, unsigned int nfds, unsigned short *revents);
@@ -65,6 +74,8 @@ struct _snd_ctl {
 	int nonblock;
 	int poll_fd;
 	struct list_head async_handlers;
+	int event_filtered;		/* event_filter is active */
+	snd_ctl_event_filter_t event_filter;
 };
 
 struct _snd_hctl_elem {
@@ -76,6 +87,10 @@ struct _snd_hctl_elem {
 	void *callback_private;
 	/* links */
 	snd_hctl_t *hctl;		/* associated handle */
+	/* data prefetched by snd_hctl_load(), NULL if not available */
+	const snd_ctl_elem_info_t *info;
+	const char *enum_names;		/* enumerated item names */
+	const unsigned int *tlv;
 };
 
 struct _snd_hctl {
@@ -87,6 +102,8 @@ struct _snd_hctl {
 	snd_hctl_compare_t compare;
 	snd_hctl_callback_t callback;
 	void *callback_private;
+	int prefetch;			/* prefetch infos and TLVs in load */
+	void *prefetch_buf;		/* contiguous storage of prefetched data */
 };
 
 
@@ -98,6 +115,7 @@ int _snd_ctl_poll_descriptor(snd_ctl_t *ctl);
 #define _snd_ctl_async_descriptor _snd_ctl_poll_descriptor
 int snd_ctl_hw_open(snd_ctl_t **handle, const char *name, int card, int mode);
 int snd_ctl_shm_open(snd_ctl_t **handlep, const char *name, const char *sockname, const char *sname, int mode);
+int snd_ctl_mirror_open(snd_ctl_t **handlep, const char *name, const char *file, int mode);
 int snd_ctl_async(snd_ctl_t *ctl, int sig, pid_t pid);
 
 #define CTLINABORT(x) ((x)->nonblock == 2)
@@ -0,0 +1,834 @@
+/**
+ * \file control/control_mirror.c
+ * \ingroup Control
+ * \brief Shared memory control value mirror
+ */
+/*
+ *  Control Interface - shared memory mirror of control elements
+ *
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "control_local.h"
+
+#ifndef PIC
+/* entry for static linking */
+const char *_snd_module_control_mirror = "";
+#endif
+
+#ifndef DOC_HIDDEN
+
+#define MIRROR_MAGIC		"ALSACTLM"
+#define MIRROR_VERSION		1
+/* max byte size of a mirrored TLV */
+#define MIRROR_TLV_MAX		4096
+/* byte size of one enumerated item name */
+#define MIRROR_ENUM_NAME	64
+/* max tries to read a value which is being updated */
+#define MIRROR_READ_RETRIES	1000
+#define MIRROR_ALIGN(x)		(((x) + 7) & ~7UL)
+
+/*
+ * Layout of the shared file: the header, the element array and a pool
+ * with the enumerated item names and TLVs.  Everything except the values
+ * is written once before the file is made visible; each value is guarded
+ * by its own sequence counter (odd while the publisher writes it).
+ */
+typedef struct {
+	char magic[8];
+	unsigned int version;
+	unsigned int count;		/* number of mirrored elements */
+	unsigned int elem_offset;	/* offset of the element array */
+	unsigned int elem_size;		/* size of one element record */
+	unsigned int size;		/* total size of the mapping */
+	unsigned int updates;		/* number of finished update passes */
+	snd_ctl_card_info_t card_info;
+} mirror_header_t;
+
+typedef struct {
+	unsigned int seq;		/* value sequence counter */
+	unsigned int changes;		/* incremented when the value changes */
+	unsigned int names_offset;	/* enumerated item names, 0 if none */
+	unsigned int tlv_offset;	/* TLV data, 0 if none */
+	unsigned int tlv_size;		/* TLV byte size */
+	int value_error;		/* error of the last value read */
+	snd_ctl_elem_info_t info;
+	snd_ctl_elem_value_t value;
+} mirror_elem_t;
+
+struct _snd_ctl_mirror {
+	snd_ctl_t *ctl;
+	void *map;
+	size_t size;
+	mirror_header_t *hdr;
+	mirror_elem_t *elems;
+};
+
+typedef struct {
+	void *map;
+	size_t size;
+	const mirror_header_t *hdr;
+	const mirror_elem_t *elems;
+	unsigned int *seen;		/* changes counter seen by events */
+	unsigned int last;		/* index of the last found element */
+	unsigned int event_pos;		/* next element to check for events */
+	int subscribed;
+} snd_ctl_mirror_reader_t;
+
+#endif /* DOC_HIDDEN */
+
+/*
+ * Publisher side
+ */
+
+/* append a blob to the temporary pool, returns the offset in the pool */
+static int pool_append(char **pool, size_t *pool_size, const void *data,
+		       size_t size)
+{
+	size_t offset = *pool_size;
+	char *p;
+
+	p = realloc(*pool, MIRROR_ALIGN(offset + size));
+	if (!p)
+		return -ENOMEM;
+	memcpy(p + offset, data, size);
+	*pool = p;
+	*pool_size = MIRROR_ALIGN(offset + size);
+	return offset;
+}
+
+static int mirror_collect_elem(snd_ctl_t *ctl, mirror_elem_t *e,
+			       char **pool, size_t *pool_size)
+{
+	unsigned int tlv[MIRROR_TLV_MAX / sizeof(unsigned int)];
+	unsigned int i;
+	int err;
+
+	err = snd_ctl_elem_info(ctl, &e->info);
+	if (err < 0)
+		return err;
+	e->names_offset = 0;
+	e->tlv_offset = 0;
+	if (e->info.type == SND_CTL_ELEM_TYPE_ENUMERATED &&
+	    e->info.value.enumerated.items > 0) {
+		snd_ctl_elem_info_t info = e->info;
+		for (i = 0; i < e->info.value.enumerated.items; i++) {
+			info.value.enumerated.item = i;
+			err = snd_ctl_elem_info(ctl, &info);
+			if (err < 0)
+				return err;
+			err = pool_append(pool, pool_size,
+					  info.value.enumerated.name,
+					  MIRROR_ENUM_NAME);
+			if (err < 0)
+				return err;
+			if (i == 0)
+				e->names_offset = err + 1;
+		}
+	}
+	if (snd_ctl_elem_info_is_tlv_readable(&e->info) &&
+	    snd_ctl_elem_tlv_read(ctl, &e->info.id, tlv, sizeof(tlv)) >= 0) {
+		e->tlv_size = tlv[SNDRV_CTL_TLVO_LEN] + 2 * sizeof(unsigned int);
+		if (e->tlv_size <= sizeof(tlv)) {
+			err = pool_append(pool, pool_size, tlv, e->tlv_size);
+			if (err < 0)
+				return err;
+			e->tlv_offset = err + 1;
+		}
+	}
+	return 0;
+}
+
+/* the pool offsets are stored biased by one during collection */
+static void mirror_fixup_offset(unsigned int *offset, size_t pool_offset)
+{
+	if (*offset)
+		*offset += pool_offset - 1;
+}
+
+static void mirror_write_value(mirror_elem_t *e, const snd_ctl_elem_value_t *value,
+			       int err)
+{
+	unsigned int seq = e->seq;
+
+	__atomic_store_n(&e->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	e->value = *value;
+	e->value_error = err;
+	__atomic_store_n(&e->changes, e->changes + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&e->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * \brief Read all mirrored control values and publish the changed ones
+ * \param mirror the mirror handle
+ * \return the number of changed elements, or a negative error code
+ *
+ * The publisher calls this function whenever it wants to refresh the
+ * snapshot, e.g. periodically or after receiving control events.
+ * Elements which cannot be read keep their last published value.
+ */
+int snd_ctl_mirror_update(snd_ctl_mirror_t *mirror)
+{
+	snd_ctl_elem_value_t value;
+	unsigned int i;
+	int err, changed = 0;
+
+	assert(mirror);
+	for (i = 0; i < mirror->hdr->count; i++) {
+		mirror_elem_t *e = &mirror->elems[i];
+		if (!snd_ctl_elem_info_is_readable(&e->info))
+			continue;
+		memset(&value, 0, sizeof(value));
+		value.id = e->info.id;
+		err = snd_ctl_elem_read(mirror->ctl, &value);
+		if (err < 0) {
+			if (e->value_error != err) {
+				value = e->value;
+				mirror_write_value(e, &value, err);
+			}
+			continue;
+		}
+		if (!e->value_error &&
+		    !memcmp(&e->value.value, &value.value, sizeof(value.value)))
+			continue;
+		mirror_write_value(e, &value, 0);
+		changed++;
+	}
+	__atomic_add_fetch(&mirror->hdr->updates, 1, __ATOMIC_RELEASE);
+	return changed;
+}
+
+/**
+ * \brief Publish a read-only shared memory snapshot of a control handle
+ * \param mirror the pointer to store the new mirror handle
+ * \param ctl the control handle to mirror
+ * \param file path of the shared file, typically located in /dev/shm
+ * \return 0 if successful, or a negative error code
+ *
+ * The element list, infos, enumerated item names and TLVs of \p ctl are
+ * copied into \p file together with the current values.  The file is
+ * created under a temporary name and renamed at the end, so readers never
+ * see a partially written file.  Other processes open the snapshot as a
+ * control handle of type \c mirror and read it without any syscalls;
+ * the values are refreshed with #snd_ctl_mirror_update().
+ *
+ * The set of elements is fixed at the publish time.  When elements are
+ * added or removed, publish the mirror again.
+ */
+int snd_ctl_mirror_publish(snd_ctl_mirror_t **mirror, snd_ctl_t *ctl,
+			   const char *file)
+{
+	snd_ctl_mirror_t *m;
+	snd_ctl_card_info_t card_info;
+	snd_ctl_elem_list_t list;
+	mirror_elem_t *elems = NULL;
+	char *pool = NULL, *tmpname = NULL;
+	size_t pool_size = 0, elem_offset, pool_offset, size;
+	unsigned int i, count;
+	void *map = MAP_FAILED;
+	int fd = -1, err;
+
+	assert(mirror && ctl && file);
+	*mirror = NULL;
+	err = snd_ctl_card_info(ctl, &card_info);
+	if (err < 0)
+		return err;
+
+	memset(&list, 0, sizeof(list));
+	err = snd_ctl_elem_list(ctl, &list);
+	if (err < 0)
+		return err;
+	count = list.count;
+	if (count > 0) {
+		err = snd_ctl_elem_list_alloc_space(&list, count);
+		if (err < 0)
+			return err;
+		err = snd_ctl_elem_list(ctl, &list);
+		if (err < 0)
+			goto _err;
+		count = list.used;
+	}
+	elems = calloc(count ? count : 1, sizeof(*elems));
+	if (!elems) {
+		err = -ENOMEM;
+		goto _err;
+	}
+	for (i = 0; i < count; i++) {
+		snd_ctl_elem_list_get_id(&list, i, &elems[i].info.id);
+		err = mirror_collect_elem(ctl, &elems[i], &pool, &pool_size);
+		if (err < 0)
+			goto _err;
+	}
+
+	elem_offset = MIRROR_ALIGN(sizeof(mirror_header_t));
+	pool_offset = elem_offset + MIRROR_ALIGN(count * sizeof(*elems));
+	size = pool_offset + pool_size;
+
+	tmpname = malloc(strlen(file) + 8);
+	if (!tmpname) {
+		err = -ENOMEM;
+		goto _err;
+	}
+	sprintf(tmpname, "%s.XXXXXX", file);
+	fd = mkstemp(tmpname);
+	if (fd < 0) {
+		err = -errno;
+		SYSERR("cannot create %s", tmpname);
+		free(tmpname);
+		tmpname = NULL;
+		goto _err;
+	}
+	if (ftruncate(fd, size) < 0 || fchmod(fd, 0644) < 0) {
+		err = -errno;
+		goto _err;
+	}
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		err = -errno;
+		goto _err;
+	}
+	for (i = 0; i < count; i++) {
+		mirror_fixup_offset(&elems[i].names_offset, pool_offset);
+		mirror_fixup_offset(&elems[i].tlv_offset, pool_offset);
+	}
+	memcpy((char *)map + elem_offset, elems, count * sizeof(*elems));
+	if (pool_size)
+		memcpy((char *)map + pool_offset, pool, pool_size);
+
+	m = calloc(1, sizeof(*m));
+	if (!m) {
+		err = -ENOMEM;
+		goto _err;
+	}
+	m->ctl = ctl;
+	m->map = map;
+	m->size = size;
+	m->hdr = map;
+	m->elems = (mirror_elem_t *)((char *)map + elem_offset);
+	m->hdr->version = MIRROR_VERSION;
+	m->hdr->count = count;
+	m->hdr->elem_offset = elem_offset;
+	m->hdr->elem_size = sizeof(mirror_elem_t);
+	m->hdr->size = size;
+	m->hdr->card_info = card_info;
+	snd_ctl_mirror_update(m);
+	/* the magic marks the file as complete */
+	memcpy(m->hdr->magic, MIRROR_MAGIC, sizeof(m->hdr->magic));
+	if (rename(tmpname, file) < 0) {
+		err = -errno;
+		SYSERR("cannot rename %s to %s", tmpname, file);
+		free(m);
+		goto _err;
+	}
+	close(fd);
+	free(tmpname);
+	free(pool);
+	free(elems);
+	snd_ctl_elem_list_free_space(&list);
+	*mirror = m;
+	return 0;
+
+ _err:
+	if (map != MAP_FAILED)
+		munmap(map, size);
+	if (fd >= 0)
+		close(fd);
+	if (tmpname) {
+		unlink(tmpname);
+		free(tmpname);
+	}
+	free(pool);
+	free(elems);
+	snd_ctl_elem_list_free_space(&list);
+	return err;
+}
+
+/**
+ * \brief Stop publishing a control mirror and free the handle
+ * \param mirror the mirror handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * The shared file is left in place with the last published values;
+ * the mirrored control handle is not closed.
+ */
+int snd_ctl_mirror_free(snd_ctl_mirror_t *mirror)
+{
+	assert(mirror);
+	munmap(mirror->map, mirror->size);
+	free(mirror);
+	return 0;
+}
+
+/*
+ * Reader side
+ */
+
+static const mirror_elem_t *mirror_find(snd_ctl_mirror_reader_t *mirror,
+					const snd_ctl_elem_id_t *id)
+{
+	unsigned int i, idx, count = mirror->hdr->count;
+
+	for (i = 0; i < count; i++) {
+		const snd_ctl_elem_id_t *eid;
+		/* start at the last hit, lists are usually walked in order */
+		idx = (mirror->last + i) % count;
+		eid = &mirror->elems[idx].info.id;
+		if (id->numid) {
+			if (eid->numid != id->numid)
+				continue;
+		} else if (eid->iface != id->iface ||
+			   eid->device != id->device ||
+			   eid->subdevice != id->subdevice ||
+			   eid->index != id->index ||
+			   strcmp((const char *)eid->name, (const char *)id->name))
+			continue;
+		mirror->last = idx;
+		return &mirror->elems[idx];
+	}
+	return NULL;
+}
+
+/* check that a blob of the pool lies inside the mapping */
+static int mirror_blob_valid(const snd_ctl_mirror_reader_t *mirror,
+			     unsigned int offset, size_t size)
+{
+	return offset < mirror->size && size <= mirror->size - offset;
+}
+
+/*
+ * copy the value under the sequence counter, retrying while it changes;
+ * a publisher which died in the middle of an update leaves the counter
+ * odd, so give up after a while
+ */
+static int mirror_read_value(const mirror_elem_t *e, snd_ctl_elem_value_t *value)
+{
+	unsigned int seq, tries;
+	int err = 0;
+
+	for (tries = 0; tries < MIRROR_READ_RETRIES; tries++) {
+		seq = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1) {
+			sched_yield();
+			continue;
+		}
+		value->value = e->value.value;
+		err = e->value_error;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&e->seq, __ATOMIC_RELAXED) == seq)
+			return err;
+	}
+	return -EBUSY;
+}
+
+static int snd_ctl_mirror_close(snd_ctl_t *ctl)
+{
+	snd_ctl_mirror_reader_t *mirror = ctl->private_data;
+
+	munmap(mirror->map, mirror->size);
+	free(mirror->seen);
+	free(mirror);
+	return 0;
+}
+
+static int snd_ctl_mirror_nonblock(snd_ctl_t *handle ATTRIBUTE_UNUSED,
+				   int nonblock ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static int snd_ctl_mirror_async(snd_ctl_t *ctl ATTRIBUTE_UNUSED,
+				int sig ATTRIBUTE_UNUSED,
+				pid_t pid ATTRIBUTE_UNUSED)
+{
+	return -ENOSYS;
+}
+
+static int snd_ctl_mirror_subscribe_events(snd_ctl_t *ctl, int subscribe)
+{
+	snd_ctl_mirror_reader_t *mirror = ctl->private_data;
+	unsigned int i;
+
+	if (subscribe < 0)
+		return mirror->subscribed;
+	if (subscribe && !mirror->subscribed) {
+		for (i = 0; i < mirror->hdr->count; i++)
+			mirror->seen[i] = __atomic_load_n(&mirror->elems[i].changes,
+							  __ATOMIC_ACQUIRE);
+	}
+	mirror->subscribed = !!subscribe;
+	return 0;
+}
+
+static int snd_ctl_mirror_card_info(snd_ctl_t *ctl, snd_ctl_card_info_t *info)
+{
+	snd_ctl_mirror_reader_t *mirror = ctl->private_data;
+
+	*info = mirror->hdr->card_info;
+	return 0;
+}
+
+static int snd_ctl_mirror_elem_list(snd_ctl_t *ctl, snd_ctl_elem_list_t *list)
+{
+	snd_ctl_mirror_reader_t *mirror = ctl->private_data;
+	unsigned int i, offset;
+
+	list->count = mirror->hdr->count;
+	list->used = 0;
+	offset = list->offset;
+	for (i = 0; i < list->space && offset < list->count; i++, offset++) {
+		list->pids[i] = mirror->elems[offset].info.id;
+		list->used++;
+	}
+	return 0;
+}
+
+static int snd_ctl_mirror_elem_info(snd_ctl_t *ctl, snd_ctl_elem_info_t *info)
+{
+	snd_ctl_mirror_reader_t *mirror = ctl->private_data;
+	const mirror_elem_t *e;
+	unsigned int item;
+
+	e = mirror_find(mirror, &info->id);
+	if (!e)
+		return -ENOENT;
+	item = info->value.enumerated.item;
+	*info = e->info;
+	if (e->info.type == SND_CTL_ELEM_TYPE_ENUMERATED) {
+		if (item >= e->info.value.enumerated.items)
+			return -EINVAL;
+		info->value.enumerated.item = item;
+		if (e->names_offset &&
+		    !mirror_blob_valid(mirror, e->names_offset,
+				       (size_t)e->info.value.enumerated.items *
+				       MIRROR_ENUM_NAME))
+			return -EINVAL;
+		if (e->names_offset)
+			memcpy(info->value.enumerated.name,
+			       (const char *)mirror->map + e->names_offset +
+			       item * MIRROR_ENUM_NAME, MIRROR_ENUM_NAME);
+	}
+	return 0;
+}
+
+static int snd_ctl_mirror_elem_read(snd_ctl_t *ctl, snd_ctl_elem_value_t *control)
+{
+	snd_ctl_mirror_reader_t *mirror = ctl->private_data;
+	const mirror_elem_t *e;
+
+	e = mirror_find(mirror, &control->id);
+	if (!e)
+		return -ENOENT;
+	if (!snd_ctl_elem_info_is_readable(&e->info))
+		return -EPERM;
+	control->id = e->info.id;
+	return mirror_read_value(e, control);
+}
+
+static int snd_ctl_mirror_elem_add(snd_ctl_t *ctl ATTRIBUTE_UNUSED,
+				   snd_ctl_elem_info_t *info ATTRIBUTE_UNUSED)
+{
+	return -EPERM;
+}
+
+static int snd_ctl_mirror_elem_remove(snd_ctl_t *ctl ATTRIBUTE_UNUSED,
+				      snd_ctl_elem_id_t *id ATTRIBUTE_UNUSED)
+{
+	return -EPERM;
+}
+
+static int snd_ctl_mirror_elem_write(snd_ctl_t *ctl ATTRIBUTE_UNUSED,
+				     snd_ctl_elem_value_t *control ATTRIBUTE_UNUSED)
+{
+	return -EPERM;
+}
+
+static int snd_ctl_mirror_elem_tlv(snd_ctl_t *ctl, int op_flag,
+				   unsigned int numid,
+				   unsigned int *tlv, unsigned int tlv_size)
+{
+	snd_ctl_mirror_reader_t *mirror = ctl->private_data;
+	snd_ctl_elem_id_t id = { .numid = numid };
+	const mirror_elem_t *e;
+
+	if (op_flag)
+		return -EPERM;
+	e = mirror_find(mirror, &id);
+	if (!e)
+		return -ENOENT;
+	if (!e->tlv_offset)
+		return -ENXIO;
+	if (e->tlv_size > MIRROR_TLV_MAX ||
+	    !mirror_blob_valid(mirror, e->tlv_offset, e->tlv_size))
+		return -EINVAL;
+	if (tlv_size < e->tlv_size)
+		return -ENOMEM;
+	memcpy(tlv, (const char *)mirror->map + e->tlv_offset, e->tlv_size);
+	return 0;
+}
+
+static int snd_ctl_mirror_next_device(snd_ctl_t *ctl ATTRIBUTE_UNUSED,
+				      int *device ATTRIBUTE_UNUSED)
+{
+	return -ENXIO;
+}
+
+static int snd_ctl_mirror_hwdep_info(snd_ctl_t *ctl ATTRIBUTE_UNUSED,
+				     snd_hwdep_info_t *info ATTRIBUTE_UNUSED)
+{
+	return -ENXIO;
+}
+
+static int snd_ctl_mirror_pcm_info(snd_ctl_t *ctl ATTRIBUTE_UNUSED,
+				   snd_pcm_info_t *info ATTRIBUTE_UNUSED)
+{
+	return -ENXIO;
+}
+
+static int snd_ctl_mirror_prefer_subdevice(snd_ctl_t *ctl ATTRIBUTE_UNUSED,
+					   int subdev ATTRIBUTE_UNUSED)
+{
+	return -ENXIO;
+}
+
+static int snd_ctl_mirror_rawmidi_info(snd_ctl_t *ctl ATTRIBUTE_UNUSED,
+				       snd_rawmidi_info_t *info ATTRIBUTE_UNUSED)
+{
+	return -ENXIO;
+}
+
+static int snd_ctl_mirror_set_power_state(snd_ctl_t *ctl ATTRIBUTE_UNUSED,
+					  unsigned int state ATTRIBUTE_UNUSED)
+{
+	return -EPERM;
+}
+
+static int snd_ctl_mirror_get_power_state(snd_ctl_t *ctl ATTRIBUTE_UNUSED,
+					  unsigned int *state ATTRIBUTE_UNUSED)
+{
+	return -ENXIO;
+}
+
+/*
+ * Events are synthesized from the per-element change counters; there is
+ * no file descriptor to wait on, so the reader polls snd_ctl_read()
+ * at its own pace and gets -EAGAIN when nothing changed.
+ */
+static int snd_ctl_mirror_read(snd_ctl_t *ctl, snd_ctl_event_t *event)
+{
+	snd_ctl_mirror_reader_t *mirror = ctl->private_data;
+	unsigned int i, idx, changes, count = mirror->hdr->count;
+
+	if (!mirror->subscribed)
+		return -EBADFD;
+	for (i = 0; i < count; i++) {
+		idx = (mirror->event_pos + i) % count;
+		changes = __atomic_load_n(&mirror->elems[idx].changes,
+					  __ATOMIC_ACQUIRE);
+		if (changes == mirror->seen[idx])
+			continue;
+		mirror->seen[idx] = changes;
+		mirror->event_pos = idx + 1;
+		memset(event, 0, sizeof(*event));
+		event->type = SND_CTL_EVENT_ELEM;
+		event->data.elem.mask = SND_CTL_EVENT_MASK_VALUE;
+		event->data.elem.id = mirror->elems[idx].info.id;
+		return 1;
+	}
+	return -EAGAIN;
+}
+
+static int snd_ctl_mirror_poll_descriptors_count(snd_ctl_t *ctl ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static const snd_ctl_ops_t snd_ctl_mirror_ops = {
+	.close = snd_ctl_mirror_close,
+	.nonblock = snd_ctl_mirror_nonblock,
+	.async = snd_ctl_mirror_async,
+	.subscribe_events = snd_ctl_mirror_subscribe_events,
+	.card_info = snd_ctl_mirror_card_info,
+	.element_list = snd_ctl_mirror_elem_list,
+	.element_info = snd_ctl_mirror_elem_info,
+	.element_add = snd_ctl_mirror_elem_add,
+	.element_replace = snd_ctl_mirror_elem_add,
+	.element_remove = snd_ctl_mirror_elem_remove,
+	.element_read = snd_ctl_mirror_elem_read,
+	.element_write = snd_ctl_mirror_elem_write,
+	.element_lock = snd_ctl_mirror_elem_remove,
+	.element_unlock = snd_ctl_mirror_elem_remove,
+	.element_tlv = snd_ctl_mirror_elem_tlv,
+	.hwdep_next_device = snd_ctl_mirror_next_device,
+	.hwdep_info = snd_ctl_mirror_hwdep_info,
+	.pcm_next_device = snd_ctl_mirror_next_device,
+	.pcm_info = snd_ctl_mirror_pcm_info,
+	.pcm_prefer_subdevice = snd_ctl_mirror_prefer_subdevice,
+	.rawmidi_next_device = snd_ctl_mirror_next_device,
+	.rawmidi_info = snd_ctl_mirror_rawmidi_info,
+	.rawmidi_prefer_subdevice = snd_ctl_mirror_prefer_subdevice,
+	.set_power_state = snd_ctl_mirror_set_power_state,
+	.get_power_state = snd_ctl_mirror_get_power_state,
+	.read = snd_ctl_mirror_read,
+	.poll_descriptors_count = snd_ctl_mirror_poll_descriptors_count,
+};
+
+/**
+ * \brief Open a published control mirror
+ * \param handlep Returned CTL handle
+ * \param name Name of CTL
+ * \param file path of the file given to #snd_ctl_mirror_publish()
+ * \param mode Control open mode
+ * \return 0 on success otherwise a negative error code
+ */
+int snd_ctl_mirror_open(snd_ctl_t **handlep, const char *name,
+			const char *file, int mode ATTRIBUTE_UNUSED)
+{
+	snd_ctl_mirror_reader_t *mirror;
+	const mirror_header_t *hdr;
+	snd_ctl_t *ctl;
+	struct stat st;
+	void *map;
+	int fd, err;
+
+	fd = open(file, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		err = -errno;
+		SYSERR("cannot open %s", file);
+		return err;
+	}
+	if (fstat(fd, &st) < 0) {
+		err = -errno;
+		close(fd);
+		return err;
+	}
+	if ((size_t)st.st_size < sizeof(mirror_header_t)) {
+		close(fd);
+		SNDERR("%s is not a control mirror", file);
+		return -EINVAL;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	err = -errno;
+	close(fd);
+	if (map == MAP_FAILED)
+		return err;
+	hdr = map;
+	if (memcmp(hdr->magic, MIRROR_MAGIC, sizeof(hdr->magic)) ||
+	    hdr->version != MIRROR_VERSION ||
+	    hdr->elem_size != sizeof(mirror_elem_t) ||
+	    hdr->size != (size_t)st.st_size ||
+	    hdr->elem_offset + (size_t)hdr->count * hdr->elem_size > hdr->size) {
+		SNDERR("%s is not a compatible control mirror", file);
+		err = -EINVAL;
+		goto _err;
+	}
+	mirror = calloc(1, sizeof(*mirror));
+	if (!mirror) {
+		err = -ENOMEM;
+		goto _err;
+	}
+	mirror->seen = calloc(hdr->count ? hdr->count : 1, sizeof(unsigned int));
+	if (!mirror->seen) {
+		free(mirror);
+		err = -ENOMEM;
+		goto _err;
+	}
+	mirror->map = map;
+	mirror->size = st.st_size;
+	mirror->hdr = hdr;
+	mirror->elems = (const mirror_elem_t *)((const char *)map + hdr->elem_offset);
+
+	err = snd_ctl_new(&ctl, SND_CTL_TYPE_MIRROR, name);
+	if (err < 0) {
+		free(mirror->seen);
+		free(mirror);
+		goto _err;
+	}
+	ctl->ops = &snd_ctl_mirror_ops;
+	ctl->private_data = mirror;
+	ctl->poll_fd = -1;
+	*handlep = ctl;
+	return 0;
+
+ _err:
+	munmap(map, st.st_size);
+	return err;
+}
+
+/**
+ * \brief Creates a new mirror control handle
+ * \param handlep Returns created control handle
+ * \param name Name of control device
+ * \param root Root configuration node
+ * \param conf Configuration node with mirror definition
+ * \param mode Control mode
+ * \retval zero on success otherwise a negative error code
+ *
+ * The snapshot published by #snd_ctl_mirror_publish() is read from
+ * shared memory without syscalls; writes are refused with -EPERM.
+ * Value changes are reported through #snd_ctl_read() once events are
+ * subscribed, but there is no poll descriptor, so the reader has to
+ * poll at its own rate.
+ *
+ * \code
+ * ctl.name {
+ *	type mirror		# Shared memory mirror
+ *	file STR		# Path of the published file
+ * }
+ * \endcode
+ */
+int _snd_ctl_mirror_open(snd_ctl_t **handlep, char *name,
+			 snd_config_t *root ATTRIBUTE_UNUSED,
+			 snd_config_t *conf, int mode)
+{
+	snd_config_iterator_t i, next;
+	const char *file = NULL;
+	int err;
+
+	snd_config_for_each(i, next, conf) {
+		snd_config_t *n = snd_config_iterator_entry(i);
+		const char *id;
+		if (snd_config_get_id(n, &id) < 0)
+			continue;
+		if (_snd_conf_generic_id(id))
+			continue;
+		if (strcmp(id, "file") == 0) {
+			err = snd_config_get_string(n, &file);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				return -EINVAL;
+			}
+			continue;
+		}
+		SNDERR("Unknown field %s", id);
+		return -EINVAL;
+	}
+	if (!file) {
+		SNDERR("file is not defined");
+		return -EINVAL;
+	}
+	return snd_ctl_mirror_open(handlep, name, file, mode);
+}
+SND_DLSYM_BUILD_VERSION(_snd_ctl_mirror_open, SND_CONTROL_DLSYM_VERSION);
@@ -366,6 +366,21 @@ static int snd_ctl_shm_get_power_state(snd_ctl_t *ctl, unsigned int *state)
 	return err;
 }
 
+static int snd_ctl_shm_set_event_filter(snd_ctl_t *ctl, const snd_ctl_event_filter_t *filter)
+{
+	snd_ctl_shm_t *shm = ctl->private_data;
+	volatile snd_ctl_shm_ctrl_t *ctrl = shm->ctrl;
+	ctrl->u.event_filter.active = filter != NULL;
+	if (filter) {
+		ctrl->u.event_filter.ifaces = filter->ifaces;
+		ctrl->u.event_filter.numid_min = filter->numid_min;
+		ctrl->u.event_filter.numid_max = filter->numid_max;
+		ctrl->u.event_filter.mask = filter->mask;
+	}
+	ctrl->cmd = SND_CTL_IOCTL_EVENT_FILTER;
+	return snd_ctl_shm_action(ctl);
+}
+
 static int snd_ctl_shm_read(snd_ctl_t *ctl, snd_ctl_event_t *event)
 {
 	snd_ctl_shm_t *shm;
@@ -408,6 +423,7 @@ static const snd_ctl_ops_t snd_ctl_shm_ops = {
 	.set_power_state = snd_ctl_shm_set_power_state,
 	.get_power_state = snd_ctl_shm_get_power_state,
 	.read = snd_ctl_shm_read,
+	.set_event_filter = snd_ctl_shm_set_event_filter,
 };
 
 static int make_local_socket(const char *filename)
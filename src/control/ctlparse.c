@@ -390,3 +390,216 @@ int snd_ctl_ascii_value_parse(snd_ctl_t *handle,
 	}
 	return 0;
 }
+
+#ifndef DOC_HIDDEN
+/* how an item of the element is set by a compiled cset */
+#define CSET_ITEM_FIXED		0	/* value given in the string */
+#define CSET_ITEM_KEEP		1	/* not given, keeps the current value */
+#define CSET_ITEM_TOGGLE	2	/* boolean toggle */
+
+struct _snd_ctl_ascii_cset {
+	snd_ctl_elem_value_t value;	/* bound id (numid) and fixed values */
+	snd_ctl_elem_type_t type;
+	unsigned int count;
+	unsigned int need_read: 1;	/* some items depend on the current value */
+	unsigned char *mode;		/* CSET_ITEM_XXX of each item */
+};
+#endif
+
+static long long cset_get_item(const snd_ctl_elem_value_t *v,
+			       snd_ctl_elem_type_t type, unsigned int idx)
+{
+	switch (type) {
+	case SND_CTL_ELEM_TYPE_BOOLEAN:
+	case SND_CTL_ELEM_TYPE_INTEGER:
+		return v->value.integer.value[idx];
+	case SND_CTL_ELEM_TYPE_INTEGER64:
+		return v->value.integer64.value[idx];
+	case SND_CTL_ELEM_TYPE_ENUMERATED:
+		return v->value.enumerated.item[idx];
+	case SND_CTL_ELEM_TYPE_BYTES:
+		return v->value.bytes.data[idx];
+	default:
+		return 0;
+	}
+}
+
+static void cset_set_item(snd_ctl_elem_value_t *v, snd_ctl_elem_type_t type,
+			  unsigned int idx, long long val)
+{
+	switch (type) {
+	case SND_CTL_ELEM_TYPE_BOOLEAN:
+	case SND_CTL_ELEM_TYPE_INTEGER:
+		v->value.integer.value[idx] = val;
+		break;
+	case SND_CTL_ELEM_TYPE_INTEGER64:
+		v->value.integer64.value[idx] = val;
+		break;
+	case SND_CTL_ELEM_TYPE_ENUMERATED:
+		v->value.enumerated.item[idx] = val;
+		break;
+	case SND_CTL_ELEM_TYPE_BYTES:
+		v->value.bytes.data[idx] = val;
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * \brief compile an ASCII element assignment for repeated execution
+ * \param csetp pointer to store the compiled assignment
+ * \param handle CTL handle
+ * \param str element identifier followed by the value, e.g.
+ *        "name='Master Playback Volume' 50%,on"
+ * \return zero on success, otherwise a negative error code
+ *
+ * The identifier and the value are parsed only once, with the same
+ * syntax as #snd_ctl_ascii_elem_id_parse() and
+ * #snd_ctl_ascii_value_parse().  The element is bound by its numid and
+ * the enumerated item names are resolved here, so
+ * #snd_ctl_ascii_cset_write() issues a single write ioctl.  Only
+ * assignments which depend on the current value (toggle, or fewer
+ * values than the element count) read the element first.
+ *
+ * The result is bound to the card of \p handle.
+ */
+int snd_ctl_ascii_cset_compile(snd_ctl_ascii_cset_t **csetp,
+			       snd_ctl_t *handle, const char *str)
+{
+	snd_ctl_ascii_cset_t *cset;
+	snd_ctl_elem_id_t id = {0};
+	snd_ctl_elem_info_t info = {0};
+	snd_ctl_elem_value_t *ones;
+	const char *pos;
+	unsigned int idx;
+	long long a, b;
+	int err;
+
+	assert(csetp && handle && str);
+	*csetp = NULL;
+	err = __snd_ctl_ascii_elem_id_parse(&id, str, &pos);
+	if (err < 0)
+		return err;
+	while (*pos && isspace(*pos))
+		pos++;
+	if (!*pos)
+		return -EINVAL;
+	snd_ctl_elem_info_set_id(&info, &id);
+	err = snd_ctl_elem_info(handle, &info);
+	if (err < 0)
+		return err;
+
+	cset = calloc(1, sizeof(*cset));
+	ones = malloc(sizeof(*ones));
+	if (!cset || !ones) {
+		err = -ENOMEM;
+		goto _err;
+	}
+	cset->type = info.type;
+	cset->count = info.count;
+	cset->mode = calloc(cset->count ? cset->count : 1, 1);
+	if (!cset->mode) {
+		err = -ENOMEM;
+		goto _err;
+	}
+
+	/* Parse the value on top of two different "current" values: the
+	 * items which come out differently depend on the current value.
+	 */
+	memset(ones, 0xff, sizeof(*ones));
+	if (cset->type == SND_CTL_ELEM_TYPE_BOOLEAN) {
+		for (idx = 0; idx < cset->count; idx++)
+			cset_set_item(ones, cset->type, idx, 1);
+	}
+	err = snd_ctl_ascii_value_parse(handle, &cset->value, &info, pos);
+	if (err < 0)
+		goto _err;
+	err = snd_ctl_ascii_value_parse(handle, ones, &info, pos);
+	if (err < 0)
+		goto _err;
+	switch (cset->type) {
+	case SND_CTL_ELEM_TYPE_BOOLEAN:
+	case SND_CTL_ELEM_TYPE_INTEGER:
+	case SND_CTL_ELEM_TYPE_INTEGER64:
+	case SND_CTL_ELEM_TYPE_ENUMERATED:
+	case SND_CTL_ELEM_TYPE_BYTES:
+		break;
+	default:
+		/* not handled by the parser, the current value is written back */
+		cset->count = 0;
+		cset->need_read = 1;
+		break;
+	}
+	for (idx = 0; idx < cset->count; idx++) {
+		a = cset_get_item(&cset->value, cset->type, idx);
+		b = cset_get_item(ones, cset->type, idx);
+		if (a == b)
+			continue;
+		if (cset->type == SND_CTL_ELEM_TYPE_BOOLEAN && a == 1 && b == 0)
+			cset->mode[idx] = CSET_ITEM_TOGGLE;
+		else
+			cset->mode[idx] = CSET_ITEM_KEEP;
+		cset->need_read = 1;
+	}
+	free(ones);
+	*csetp = cset;
+	return 0;
+
+ _err:
+	free(ones);
+	snd_ctl_ascii_cset_free(cset);
+	return err;
+}
+
+/**
+ * \brief execute a compiled ASCII element assignment
+ * \param handle CTL handle of the card used for the compilation
+ * \param cset compiled assignment
+ * \return zero on success, otherwise a negative error code
+ */
+int snd_ctl_ascii_cset_write(snd_ctl_t *handle,
+			     const snd_ctl_ascii_cset_t *cset)
+{
+	snd_ctl_elem_value_t value;
+	unsigned int idx;
+	long long val;
+	int err;
+
+	assert(handle && cset);
+	if (!cset->need_read) {
+		value = cset->value;
+		return snd_ctl_elem_write(handle, &value);
+	}
+	memset(&value, 0, sizeof(value));
+	value.id = cset->value.id;
+	err = snd_ctl_elem_read(handle, &value);
+	if (err < 0)
+		return err;
+	for (idx = 0; idx < cset->count; idx++) {
+		switch (cset->mode[idx]) {
+		case CSET_ITEM_FIXED:
+			val = cset_get_item(&cset->value, cset->type, idx);
+			break;
+		case CSET_ITEM_TOGGLE:
+			val = cset_get_item(&value, cset->type, idx) > 0 ? 0 : 1;
+			break;
+		default:
+			continue;
+		}
+		cset_set_item(&value, cset->type, idx, val);
+	}
+	return snd_ctl_elem_write(handle, &value);
+}
+
+/**
+ * \brief free a compiled ASCII element assignment
+ * \param cset compiled assignment, may be NULL
+ */
+void snd_ctl_ascii_cset_free(snd_ctl_ascii_cset_t *cset)
+{
+	if (!cset)
+		return;
+	free(cset->mode);
+	free(cset);
+}
@@ -406,6 +406,8 @@ int snd_hctl_free(snd_hctl_t *hctl)
 	free(hctl->pelems);
 	hctl->pelems = 0;
 	hctl->alloc = 0;
+	free(hctl->prefetch_buf);
+	hctl->prefetch_buf = NULL;
 	INIT_LIST_HEAD(&hctl->elems);
 	return 0;
 }
@@ -557,10 +559,266 @@ snd_hctl_elem_t *snd_hctl_find_elem(snd_hctl_t *hctl, const snd_ctl_elem_id_t *i
 	return hctl->pelems[res];
 }
 
+/**
+ * \brief Enable or disable prefetching of element data in snd_hctl_load()
+ * \param hctl HCTL handle
+ * \param enable 1 to enable, 0 to disable
+ * \return 0 on success otherwise a negative error code
+ *
+ * Prefetching is disabled by default.  When enabled, #snd_hctl_load()
+ * reads the infos, enumerated item names and TLVs of all elements in one
+ * pass and stores them contiguously.  #snd_hctl_elem_info() and
+ * #snd_hctl_elem_tlv_read() are then served from memory until an INFO or
+ * TLV event for the element, handled by #snd_hctl_handle_events(), drops
+ * the prefetched data.  It must be called before #snd_hctl_load().
+ *
+ * For a hw control device on a machine with several CPUs, the elements
+ * are split between worker threads which issue their ioctls in parallel,
+ * so the load takes less wall time than querying the infos one by one.
+ * Otherwise the ioctls are issued one by one at load time, and this pays
+ * off only for applications querying most element infos or TLVs more
+ * than once.
+ *
+ * The kernel sends no event when an element is locked or unlocked, so
+ * the lock and owner state in a prefetched info is the one at load
+ * time; use #snd_ctl_elem_info() on #snd_hctl_ctl() for the current
+ * state.  The prefetched data of elements whose INFO or TLV events are
+ * dropped by the event filter of the CTL handle is not used.
+ */
+int snd_hctl_set_prefetch(snd_hctl_t *hctl, int enable)
+{
+	assert(hctl);
+	hctl->prefetch = !!enable;
+	return 0;
+}
+
+#ifndef DOC_HIDDEN
+/* byte size of an enumerated item name */
+#define PREFETCH_ENUM_NAME	64
+/* max byte size of a prefetched TLV */
+#define PREFETCH_TLV_MAX	4096
+/* max threads reading the element data */
+#define PREFETCH_THREADS	4
+/* min elements per prefetch thread */
+#define PREFETCH_CHUNK_MIN	32
+/* initial guess for the element count, saves the counting ioctl */
+#define LOAD_LIST_SPACE		256
+#endif
+
+/* the prefetched data is kept up to date only if its events are read */
+static int snd_hctl_elem_cached(snd_hctl_elem_t *elem, unsigned int mask)
+{
+	snd_ctl_t *ctl = elem->hctl->ctl;
+	snd_ctl_event_t event;
+
+	if (!ctl->event_filtered)
+		return 1;
+	memset(&event, 0, sizeof(event));
+	event.type = SND_CTL_EVENT_ELEM;
+	event.data.elem.mask = mask;
+	event.data.elem.id = elem->id;
+	return snd_ctl_event_filter_match(&ctl->event_filter, &event);
+}
+
+/* append a blob to the temporary pool and return its offset plus one */
+static size_t prefetch_append(char **pool, size_t *pool_size,
+			      const void *data, size_t size)
+{
+	size_t offset = *pool_size;
+	char *p;
+
+	p = realloc(*pool, offset + ((size + 7) & ~7UL));
+	if (!p)
+		return 0;
+	memcpy(p + offset, data, size);
+	*pool = p;
+	*pool_size = offset + ((size + 7) & ~7UL);
+	return offset + 1;
+}
+
+#ifndef DOC_HIDDEN
+/* a range of elements prefetched by one thread into its own pool */
+typedef struct {
+	snd_hctl_t *hctl;
+	unsigned int first, last;
+	snd_ctl_elem_info_t *infos;
+	size_t *names_off, *tlv_off;	/* offsets in the pool plus one */
+	char *pool;
+	size_t pool_size;
+#ifdef HAVE_LIBPTHREAD
+	pthread_t thread;
+	int started;
+#endif
+} prefetch_chunk_t;
+#endif
+
+static void *snd_hctl_prefetch_chunk(void *arg)
+{
+	prefetch_chunk_t *c = arg;
+	unsigned int tlv[PREFETCH_TLV_MAX / sizeof(unsigned int)];
+	snd_ctl_t *ctl = c->hctl->ctl;
+	snd_ctl_elem_info_t *infos = c->infos, info;
+	unsigned int idx, item;
+
+	for (idx = c->first; idx < c->last; idx++) {
+		snd_hctl_elem_t *elem = c->hctl->pelems[idx];
+		memset(&infos[idx], 0, sizeof(infos[idx]));
+		infos[idx].id = elem->id;
+		if (snd_ctl_elem_info(ctl, &infos[idx]) < 0) {
+			infos[idx].id.numid = 0;	/* not prefetched */
+			continue;
+		}
+		if (infos[idx].type == SND_CTL_ELEM_TYPE_ENUMERATED &&
+		    infos[idx].value.enumerated.items > 0) {
+			c->names_off[idx] = prefetch_append(&c->pool, &c->pool_size,
+					infos[idx].value.enumerated.name,
+					PREFETCH_ENUM_NAME);
+			info = infos[idx];
+			for (item = 1; item < infos[idx].value.enumerated.items; item++) {
+				info.value.enumerated.item = item;
+				if (snd_ctl_elem_info(ctl, &info) < 0 ||
+				    !prefetch_append(&c->pool, &c->pool_size,
+						     info.value.enumerated.name,
+						     PREFETCH_ENUM_NAME)) {
+					c->names_off[idx] = 0;
+					break;
+				}
+			}
+			if (!c->names_off[idx]) {
+				infos[idx].id.numid = 0;
+				continue;
+			}
+		}
+		if (snd_ctl_elem_info_is_tlv_readable(&infos[idx]) &&
+		    snd_ctl_elem_tlv_read(ctl, &elem->id, tlv, sizeof(tlv)) >= 0 &&
+		    tlv[SNDRV_CTL_TLVO_LEN] + 2 * sizeof(int) <= sizeof(tlv))
+			c->tlv_off[idx] = prefetch_append(&c->pool, &c->pool_size, tlv,
+					tlv[SNDRV_CTL_TLVO_LEN] + 2 * sizeof(int));
+	}
+	return NULL;
+}
+
+/*
+ * The ioctls of a hw control device may run concurrently, so the
+ * elements are split between up to PREFETCH_THREADS threads, one per
+ * online CPU.  The other control types are read serially.
+ */
+static unsigned int snd_hctl_prefetch_threads(snd_hctl_t *hctl)
+{
+#ifdef HAVE_LIBPTHREAD
+	long cpus;
+	unsigned int threads;
+
+	if (snd_ctl_type(hctl->ctl) != SND_CTL_TYPE_HW)
+		return 1;
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus <= 1)
+		return 1;
+	threads = cpus < PREFETCH_THREADS ? cpus : PREFETCH_THREADS;
+	if (threads > hctl->count / PREFETCH_CHUNK_MIN)
+		threads = hctl->count / PREFETCH_CHUNK_MIN;
+	return threads ? threads : 1;
+#else
+	return 1;
+#endif
+}
+
+/*
+ * Read the infos, enumerated item names and TLVs of all elements into a
+ * single buffer: the info array followed by a pool with the variable
+ * sized data.  Failures are not fatal, elements without prefetched data
+ * use the ioctls on demand.
+ */
+static void snd_hctl_prefetch(snd_hctl_t *hctl)
+{
+	snd_ctl_elem_info_t *infos;
+	size_t *names_off = NULL, *tlv_off = NULL;
+	size_t infos_size, pool_size = 0, base;
+	prefetch_chunk_t *chunks = NULL, *c;
+	unsigned int idx, i, threads;
+	char *buf;
+
+	if (!hctl->count)
+		return;
+	threads = snd_hctl_prefetch_threads(hctl);
+	infos_size = hctl->count * sizeof(*infos);
+	infos = malloc(infos_size);
+	names_off = calloc(hctl->count, sizeof(*names_off));
+	tlv_off = calloc(hctl->count, sizeof(*tlv_off));
+	chunks = calloc(threads, sizeof(*chunks));
+	if (!infos || !names_off || !tlv_off || !chunks)
+		goto _end;
+	for (i = 0; i < threads; i++) {
+		c = &chunks[i];
+		c->hctl = hctl;
+		c->first = (unsigned long long)hctl->count * i / threads;
+		c->last = (unsigned long long)hctl->count * (i + 1) / threads;
+		c->infos = infos;
+		c->names_off = names_off;
+		c->tlv_off = tlv_off;
+	}
+#ifdef HAVE_LIBPTHREAD
+	for (i = 1; i < threads; i++)
+		chunks[i].started = !pthread_create(&chunks[i].thread, NULL,
+						    snd_hctl_prefetch_chunk,
+						    &chunks[i]);
+#endif
+	snd_hctl_prefetch_chunk(&chunks[0]);
+	for (i = 1; i < threads; i++) {
+#ifdef HAVE_LIBPTHREAD
+		if (chunks[i].started) {
+			pthread_join(chunks[i].thread, NULL);
+			continue;
+		}
+#endif
+		snd_hctl_prefetch_chunk(&chunks[i]);
+	}
+
+	for (i = 0; i < threads; i++)
+		pool_size += chunks[i].pool_size;
+	buf = malloc(infos_size + pool_size);
+	if (!buf)
+		goto _end;
+	memcpy(buf, infos, infos_size);
+	base = infos_size;
+	for (i = 0; i < threads; i++) {
+		c = &chunks[i];
+		if (c->pool_size)
+			memcpy(buf + base, c->pool, c->pool_size);
+		for (idx = c->first; idx < c->last; idx++) {
+			snd_hctl_elem_t *elem = hctl->pelems[idx];
+			const snd_ctl_elem_info_t *info = (snd_ctl_elem_info_t *)buf + idx;
+			if (!info->id.numid)
+				continue;
+			elem->info = info;
+			if (names_off[idx])
+				elem->enum_names = buf + base + names_off[idx] - 1;
+			if (tlv_off[idx])
+				elem->tlv = (const unsigned int *)
+					(buf + base + tlv_off[idx] - 1);
+		}
+		base += c->pool_size;
+	}
+	free(hctl->prefetch_buf);
+	hctl->prefetch_buf = buf;
+ _end:
+	if (chunks) {
+		for (i = 0; i < threads; i++)
+			free(chunks[i].pool);
+		free(chunks);
+	}
+	free(infos);
+	free(names_off);
+	free(tlv_off);
+}
+
 /**
  * \brief Load an HCTL with all elements and sort them
  * \param hctl HCTL handle
  * \return 0 on success otherwise a negative error code
+ *
+ * See #snd_hctl_set_prefetch() for loading the element infos and TLVs
+ * at once.
  */
 int snd_hctl_load(snd_hctl_t *hctl)
 {
@@ -573,6 +831,10 @@ int snd_hctl_load(snd_hctl_t *hctl)
 	assert(hctl->count == 0);
 	assert(list_empty(&hctl->elems));
 	memset(&list, 0, sizeof(list));
+	/* try to get the whole list with one call */
+	err = snd_ctl_elem_list_alloc_space(&list, LOAD_LIST_SPACE);
+	if (err < 0)
+		goto _end;
 	if ((err = snd_ctl_elem_list(hctl->ctl, &list)) < 0)
 		goto _end;
 	while (list.count != list.used) {
@@ -606,6 +868,8 @@ int snd_hctl_load(snd_hctl_t *hctl)
 		list_add_tail(&elem->list, &hctl->elems);
 		hctl->count++;
 	}
+	if (hctl->prefetch)
+		snd_hctl_prefetch(hctl);
 	if (!hctl->compare)
 		hctl->compare = snd_hctl_compare_default;
 	snd_hctl_sort(hctl);
@@ -747,6 +1011,18 @@ static int snd_hctl_handle_event(snd_hctl_t *hctl, snd_ctl_event_t *event)
 		snd_hctl_elem_remove(hctl, (unsigned int) res);
 		return 0;
 	}
+	if (event->data.elem.mask & (SNDRV_CTL_EVENT_MASK_INFO |
+				     SNDRV_CTL_EVENT_MASK_TLV)) {
+		/* drop the prefetched data before the callbacks see the event */
+		elem = snd_hctl_find_elem(hctl, &event->data.elem.id);
+		if (elem) {
+			if (event->data.elem.mask & SNDRV_CTL_EVENT_MASK_INFO) {
+				elem->info = NULL;
+				elem->enum_names = NULL;
+			}
+			elem->tlv = NULL;
+		}
+	}
 	if (event->data.elem.mask & SNDRV_CTL_EVENT_MASK_ADD) {
 		elem = calloc(1, sizeof(snd_hctl_elem_t));
 		if (elem == NULL)
@@ -807,6 +1083,22 @@ int snd_hctl_elem_info(snd_hctl_elem_t *elem, snd_ctl_elem_info_t *info)
 	assert(elem);
 	assert(elem->hctl);
 	assert(info);
+	if (elem->info && snd_hctl_elem_cached(elem, SNDRV_CTL_EVENT_MASK_INFO)) {
+		unsigned int item = info->value.enumerated.item;
+		if (elem->info->type != SND_CTL_ELEM_TYPE_ENUMERATED) {
+			*info = *elem->info;
+			return 0;
+		}
+		/* out of range items are left to the driver */
+		if (item < elem->info->value.enumerated.items) {
+			*info = *elem->info;
+			info->value.enumerated.item = item;
+			memcpy(info->value.enumerated.name,
+			       elem->enum_names + item * PREFETCH_ENUM_NAME,
+			       PREFETCH_ENUM_NAME);
+			return 0;
+		}
+	}
 	info->id = elem->id;
 	return snd_ctl_elem_info(elem->hctl->ctl, info);
 }
@@ -855,6 +1147,13 @@ int snd_hctl_elem_tlv_read(snd_hctl_elem_t *elem, unsigned int *tlv, unsigned in
 	assert(elem);
 	assert(tlv);
 	assert(tlv_size >= 12);
+	if (elem->tlv && snd_hctl_elem_cached(elem, SNDRV_CTL_EVENT_MASK_TLV)) {
+		unsigned int size = elem->tlv[SNDRV_CTL_TLVO_LEN] + 2 * sizeof(int);
+		if (tlv_size < size)
+			return -ENOMEM;
+		memcpy(tlv, elem->tlv, size);
+		return 0;
+	}
 	return snd_ctl_elem_tlv_read(elem->hctl->ctl, &elem->id, tlv, tlv_size);
 }
 
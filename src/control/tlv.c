@@ -30,6 +30,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <limits.h>
 #ifndef HAVE_SOFT_FLOAT
 #include <math.h>
 #endif
@@ -403,6 +404,323 @@ int snd_tlv_convert_from_dB(unsigned int *tlv, long rangemin, long rangemax,
 	return -EINVAL;
 }
 
+#ifndef DOC_HIDDEN
+/* max number of raw volume steps kept in the value -> dB array */
+#define MAX_DB_TABLE_VALUES	65536
+/* marks a raw volume which has no dB representation */
+#define DB_TABLE_INVALID	LONG_MIN
+
+struct db_segment {
+	unsigned int type;
+	long rangemin, rangemax;	/* raw volume range of this item */
+	long dbmin, dbmax;		/* dB range (DB_RANGE items only) */
+	int min, max, step, mute;	/* dB parameters taken from the TLV */
+	double vmin, vmax;		/* linear gain at min/max (DB_LINEAR) */
+};
+
+struct _snd_tlv_dB_table {
+	long rangemin, rangemax;
+	unsigned int *tlv;		/* private copy of the dB TLV */
+	long *db;			/* value -> dB, NULL if range is too big */
+	unsigned int segments;		/* compiled items, 0 = use TLV path */
+	unsigned int is_range: 1;	/* items come from a DB_RANGE container */
+	struct db_segment *seg;
+};
+#endif
+
+/* precompute the parameters of a single (non-container) dB TLV */
+static int compile_dB_segment(unsigned int *tlv, long rangemin, long rangemax,
+			      struct db_segment *seg)
+{
+	seg->type = tlv[SNDRV_CTL_TLVO_TYPE];
+	seg->rangemin = rangemin;
+	seg->rangemax = rangemax;
+	switch (seg->type) {
+	case SND_CTL_TLVT_DB_SCALE:
+		seg->min = tlv[SNDRV_CTL_TLVO_DB_SCALE_MIN];
+		seg->step = tlv[SNDRV_CTL_TLVO_DB_SCALE_MUTE_AND_STEP] & 0xffff;
+		seg->mute = !!(tlv[SNDRV_CTL_TLVO_DB_SCALE_MUTE_AND_STEP] & 0x10000);
+		seg->max = seg->min + (int)(seg->step * (rangemax - rangemin));
+		return 0;
+	case SND_CTL_TLVT_DB_MINMAX:
+	case SND_CTL_TLVT_DB_MINMAX_MUTE:
+		seg->min = tlv[SNDRV_CTL_TLVO_DB_MINMAX_MIN];
+		seg->max = tlv[SNDRV_CTL_TLVO_DB_MINMAX_MAX];
+		seg->mute = seg->type == SND_CTL_TLVT_DB_MINMAX_MUTE;
+		return 0;
+#ifndef HAVE_SOFT_FLOAT
+	case SND_CTL_TLVT_DB_LINEAR:
+		seg->min = tlv[SNDRV_CTL_TLVO_DB_LINEAR_MIN];
+		seg->max = tlv[SNDRV_CTL_TLVO_DB_LINEAR_MAX];
+		seg->vmin = (seg->min <= SND_CTL_TLV_DB_GAIN_MUTE) ? 0.0 :
+			pow(10.0,  (double)seg->min / 2000.0);
+		seg->vmax = !seg->max ? 1.0 :
+			pow(10.0,  (double)seg->max / 2000.0);
+		return 0;
+#endif
+	}
+	return -EINVAL;
+}
+
+/* compile the items of a DB_RANGE container as walked by
+ * snd_tlv_convert_from_dB(); returns the number of items or an error
+ */
+static int compile_dB_range(snd_tlv_dB_table_t *table)
+{
+	unsigned int *tlv = table->tlv;
+	unsigned int pos, len, count;
+	int err;
+
+	len = int_index(tlv[SNDRV_CTL_TLVO_LEN]);
+	if (len < 6 || len > MAX_TLV_RANGE_SIZE)
+		return -EINVAL;
+	table->seg = calloc(len / 4, sizeof(*table->seg));
+	if (!table->seg)
+		return -ENOMEM;
+	pos = 2;
+	count = 0;
+	while (pos + 4 <= len) {
+		struct db_segment *seg = &table->seg[count];
+		long submin, submax;
+		submin = (int)tlv[pos];
+		submax = (int)tlv[pos + 1];
+		if (table->rangemax < submax)
+			submax = table->rangemax;
+		err = snd_tlv_get_dB_range(tlv + pos + 2, submin, submax,
+					   &seg->dbmin, &seg->dbmax);
+		if (err < 0)
+			return err;
+		err = compile_dB_segment(tlv + pos + 2, submin, submax, seg);
+		if (err < 0)
+			return err;
+		count++;
+		if (table->rangemax == submax)
+			break;
+		pos += int_index(tlv[pos + 3]) + 4;
+	}
+	return count;
+}
+
+static int segment_from_dB(const struct db_segment *seg, long db_gain,
+			   long *value, int xdir)
+{
+	long rangemin = seg->rangemin, rangemax = seg->rangemax;
+
+	switch (seg->type) {
+	case SND_CTL_TLVT_DB_SCALE:
+	case SND_CTL_TLVT_DB_MINMAX:
+	case SND_CTL_TLVT_DB_MINMAX_MUTE: {
+		int min = seg->min, max = seg->max;
+		if (db_gain <= min)
+			if (db_gain > SND_CTL_TLV_DB_GAIN_MUTE && xdir > 0 &&
+			    seg->mute)
+				*value = rangemin + 1;
+			else
+				*value = rangemin;
+		else if (db_gain >= max)
+			*value = rangemax;
+		else {
+			long v = (db_gain - min) * (rangemax - rangemin);
+			if (xdir > 0)
+				v += (max - min) - 1;
+			v = v / (max - min) + rangemin;
+			*value = v;
+		}
+		return 0;
+	}
+#ifndef HAVE_SOFT_FLOAT
+	case SND_CTL_TLVT_DB_LINEAR:
+		if (db_gain <= seg->min)
+			*value = rangemin;
+		else if (db_gain >= seg->max)
+			*value = rangemax;
+		else {
+			double v = pow(10.0, (double)db_gain / 2000.0);
+			v = (v - seg->vmin) * (rangemax - rangemin) /
+				(seg->vmax - seg->vmin);
+			if (xdir > 0)
+				v = ceil(v);
+			*value = (long)v + rangemin;
+		}
+		return 0;
+#endif
+	}
+	return -EINVAL;
+}
+
+/**
+ * \brief Build a precomputed dB conversion table
+ * \param table the pointer to store the newly allocated table
+ * \param tlv the TLV source returned by #snd_tlv_parse_dB_info()
+ * \param rangemin the minimum value of the raw volume
+ * \param rangemax the maximum value of the raw volume
+ * \return 0 if successful, or a negative error code
+ *
+ * The dB TLV is parsed once and the gain of each raw volume step in
+ * the given range is stored, so that #snd_tlv_dB_table_to_dB() becomes
+ * a plain array lookup.  The parameters used by the reverse conversion
+ * (including the power terms of linear scales) are precomputed for
+ * #snd_tlv_dB_table_from_dB().  The results are identical to
+ * #snd_tlv_convert_to_dB() and #snd_tlv_convert_from_dB().
+ *
+ * The table keeps a private copy of the TLV, so the source buffer can be
+ * released afterwards.  The table must be rebuilt when the range changes.
+ */
+int snd_tlv_dB_table_new(snd_tlv_dB_table_t **table, unsigned int *tlv,
+			 long rangemin, long rangemax)
+{
+	snd_tlv_dB_table_t *t;
+	unsigned int size;
+	int err;
+
+	assert(table && tlv);
+	*table = NULL;
+	if (rangemax < rangemin)
+		return -EINVAL;
+	size = int_index(tlv[SNDRV_CTL_TLVO_LEN]) + 2;
+	if (size > MAX_TLV_RANGE_SIZE)
+		return -EINVAL;
+	t = calloc(1, sizeof(*t));
+	if (!t)
+		return -ENOMEM;
+	t->rangemin = rangemin;
+	t->rangemax = rangemax;
+	t->tlv = malloc(size * sizeof(int));
+	if (!t->tlv) {
+		err = -ENOMEM;
+		goto _err;
+	}
+	memcpy(t->tlv, tlv, size * sizeof(int));
+
+	if (t->tlv[SNDRV_CTL_TLVO_TYPE] == SND_CTL_TLVT_DB_RANGE) {
+		t->is_range = 1;
+		err = compile_dB_range(t);
+		if (err == -ENOMEM)
+			goto _err;
+	} else {
+		t->seg = calloc(1, sizeof(*t->seg));
+		if (!t->seg) {
+			err = -ENOMEM;
+			goto _err;
+		}
+		err = compile_dB_segment(t->tlv, rangemin, rangemax, t->seg);
+		if (err == 0)
+			err = 1;
+	}
+	/* items which cannot be compiled fall back to the TLV functions */
+	t->segments = err > 0 ? err : 0;
+
+	if ((unsigned long)(rangemax - rangemin) < MAX_DB_TABLE_VALUES) {
+		long v, n = rangemax - rangemin + 1;
+		t->db = malloc(n * sizeof(long));
+		if (!t->db) {
+			err = -ENOMEM;
+			goto _err;
+		}
+		for (v = 0; v < n; v++) {
+			if (snd_tlv_convert_to_dB(t->tlv, rangemin, rangemax,
+						  rangemin + v, &t->db[v]) < 0)
+				t->db[v] = DB_TABLE_INVALID;
+		}
+	}
+	*table = t;
+	return 0;
+
+ _err:
+	snd_tlv_dB_table_free(t);
+	return err;
+}
+
+/**
+ * \brief Free a dB conversion table
+ * \param table the table created by #snd_tlv_dB_table_new()
+ */
+void snd_tlv_dB_table_free(snd_tlv_dB_table_t *table)
+{
+	if (!table)
+		return;
+	free(table->db);
+	free(table->seg);
+	free(table->tlv);
+	free(table);
+}
+
+/**
+ * \brief Get the raw volume range a dB conversion table was built for
+ * \param table the dB conversion table
+ * \param rangemin the pointer to store the minimum value of the raw volume
+ * \param rangemax the pointer to store the maximum value of the raw volume
+ */
+void snd_tlv_dB_table_get_range(const snd_tlv_dB_table_t *table,
+				long *rangemin, long *rangemax)
+{
+	assert(table);
+	*rangemin = table->rangemin;
+	*rangemax = table->rangemax;
+}
+
+/**
+ * \brief Convert the given raw volume value to a dB gain using a table
+ * \param table the dB conversion table
+ * \param volume the raw volume value to convert
+ * \param db_gain the dB gain (in 0.01dB unit)
+ * \return 0 if successful, or a negative error code
+ */
+int snd_tlv_dB_table_to_dB(const snd_tlv_dB_table_t *table,
+			   long volume, long *db_gain)
+{
+	assert(table);
+	if (table->db && volume >= table->rangemin &&
+	    volume <= table->rangemax) {
+		long db = table->db[volume - table->rangemin];
+		if (db == DB_TABLE_INVALID)
+			return -EINVAL;
+		*db_gain = db;
+		return 0;
+	}
+	return snd_tlv_convert_to_dB(table->tlv, table->rangemin,
+				     table->rangemax, volume, db_gain);
+}
+
+/**
+ * \brief Convert from dB gain to the corresponding raw value using a table
+ * \param table the dB conversion table
+ * \param db_gain the dB gain to convert (in 0.01dB unit)
+ * \param value the pointer to store the converted raw volume value
+ * \param xdir the direction for round-up. The value is round up
+ *        when this is positive.
+ * \return 0 if successful, or a negative error code
+ */
+int snd_tlv_dB_table_from_dB(const snd_tlv_dB_table_t *table,
+			     long db_gain, long *value, int xdir)
+{
+	const struct db_segment *seg;
+	long prev_submax;
+	unsigned int i;
+
+	assert(table);
+	if (!table->segments)
+		return snd_tlv_convert_from_dB(table->tlv, table->rangemin,
+					       table->rangemax, db_gain,
+					       value, xdir);
+	if (!table->is_range)
+		return segment_from_dB(table->seg, db_gain, value, xdir);
+
+	prev_submax = 0;
+	for (i = 0; i < table->segments; i++) {
+		seg = &table->seg[i];
+		if (db_gain >= seg->dbmin && db_gain <= seg->dbmax)
+			return segment_from_dB(seg, db_gain, value, xdir);
+		else if (db_gain < seg->dbmin) {
+			*value = xdir > 0 || i == 0 ? seg->rangemin : prev_submax;
+			return 0;
+		}
+		prev_submax = seg->rangemax;
+	}
+	*value = prev_submax;
+	return 0;
+}
+
 #ifndef DOC_HIDDEN
 #define TEMP_TLV_SIZE		4096
 struct tlv_info {
@@ -501,3 +819,26 @@ int snd_ctl_convert_from_dB(snd_ctl_t *ctl, const snd_ctl_elem_id_t *id,
 	return snd_tlv_convert_from_dB(info.tlv, info.minval, info.maxval,
 				       db_gain, value, xdir);
 }
+
+/**
+ * \brief Build a dB conversion table for the given control element
+ * \param ctl the control handler
+ * \param id the element id
+ * \param table the pointer to store the newly allocated table
+ * \return 0 if successful, or a negative error code
+ *
+ * The element info and TLV are read only once here.  Use this instead of
+ * #snd_ctl_convert_to_dB() and #snd_ctl_convert_from_dB() when converting
+ * repeatedly, and free the table with #snd_tlv_dB_table_free().
+ */
+int snd_ctl_get_dB_table(snd_ctl_t *ctl, const snd_ctl_elem_id_t *id,
+			 snd_tlv_dB_table_t **table)
+{
+	struct tlv_info info;
+	int err;
+
+	err = get_tlv_info(ctl, id, &info);
+	if (err < 0)
+		return err;
+	return snd_tlv_dB_table_new(table, info.tlv, info.minval, info.maxval);
+}
@@ -234,6 +234,10 @@ int snd_mixer_attach_hctl(snd_mixer_t *mixer, snd_hctl_t *hctl)
 		free(slave);
 		return err;
 	}
+	/* the parallel prefetch of a hw device shortens snd_mixer_load() */
+	if (snd_ctl_type(snd_hctl_ctl(hctl)) == SND_CTL_TYPE_HW &&
+	    sysconf(_SC_NPROCESSORS_ONLN) > 1)
+		snd_hctl_set_prefetch(hctl, 1);
 	snd_hctl_set_callback(hctl, hctl_event_handler);
 	snd_hctl_set_callback_private(hctl, mixer);
 	slave->hctl = hctl;
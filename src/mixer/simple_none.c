@@ -87,6 +87,7 @@ typedef struct _selem_none {
 		long vol[32];
 		unsigned int sw;
 		unsigned int *db_info;
+		snd_tlv_dB_table_t *db_table;
 	} str[2];
 } selem_none_t;
 
@@ -666,6 +667,8 @@ static void selem_free(snd_mixer_elem_t *elem)
 	/* free db range information */
 	free(simple->str[0].db_info);
 	free(simple->str[1].db_info);
+	snd_tlv_dB_table_free(simple->str[0].db_table);
+	snd_tlv_dB_table_free(simple->str[1].db_table);
 	free(simple);
 }
 
@@ -1085,11 +1088,36 @@ static int get_volume_ops(snd_mixer_elem_t *elem, int dir,
 
 static int init_db_range(snd_hctl_elem_t *ctl, struct selem_str *rec);
 
+/* get the dB conversion table matching the current volume range;
+ * the table is rebuilt when the range was changed in the meantime
+ */
+static snd_tlv_dB_table_t *get_db_table(struct selem_str *rec)
+{
+	long min, max;
+
+	if (rec->db_table) {
+		snd_tlv_dB_table_get_range(rec->db_table, &min, &max);
+		if (min == rec->min && max == rec->max)
+			return rec->db_table;
+		snd_tlv_dB_table_free(rec->db_table);
+		rec->db_table = NULL;
+	}
+	if (snd_tlv_dB_table_new(&rec->db_table, rec->db_info,
+				 rec->min, rec->max) < 0)
+		return NULL;
+	return rec->db_table;
+}
+
 static int convert_to_dB(snd_hctl_elem_t *ctl, struct selem_str *rec,
 			 long volume, long *db_gain)
 {
+	snd_tlv_dB_table_t *table;
+
 	if (init_db_range(ctl, rec) < 0)
 		return -EINVAL;
+	table = get_db_table(rec);
+	if (table)
+		return snd_tlv_dB_table_to_dB(table, volume, db_gain);
 	return snd_tlv_convert_to_dB(rec->db_info, rec->min, rec->max,
 				     volume, db_gain);
 }
@@ -1127,6 +1155,8 @@ static int init_db_range(snd_hctl_elem_t *ctl, struct selem_str *rec)
 	memcpy(rec->db_info, dbrec, db_size);
 	free(tlv);
 	rec->db_initialized = 1;
+	/* precompute the conversions; the TLV path is used on failure */
+	get_db_table(rec);
 	return 0;
 
  error:
@@ -1181,9 +1211,14 @@ static int get_dB_range_ops(snd_mixer_elem_t *elem, int dir,
 static int convert_from_dB(snd_hctl_elem_t *ctl, struct selem_str *rec,
 			   long db_gain, long *value, int xdir)
 {
+	snd_tlv_dB_table_t *table;
+
 	if (init_db_range(ctl, rec) < 0)
 		return -EINVAL;
 
+	table = get_db_table(rec);
+	if (table)
+		return snd_tlv_dB_table_from_dB(table, db_gain, value, xdir);
 	return snd_tlv_convert_from_dB(rec->db_info, rec->min, rec->max,
 				       db_gain, value, xdir);
 }
@@ -427,6 +427,13 @@ before any read/write begin+commit operations.
 The function #snd_pcm_avail_delay() combines #snd_pcm_avail() and
 #snd_pcm_delay() and returns both values in sync.
 </p>
+<p>
+Applications serving many streams can read the positions, avail, delay
+and timestamps of all of them with one #snd_pcm_status_batch() call.
+For directly opened hardware devices the values come from the status
+mapped by the kernel, without any system call, unless
+#SND_PCM_STATUS_BATCH_HWSYNC is passed.
+</p>
 
 \section pcm_action Managing the stream state
 
@@ -486,6 +493,23 @@ for hardware synchronized streams. When the #snd_pcm_link()
 function is called, all operations managing the stream state for these two
 streams are joined. The opposite function is #snd_pcm_unlink().
 
+\section pcm_uring Batched transfers
+
+A single thread serving many streams can queue the interleaved transfers
+(#snd_pcm_uring_writei(), #snd_pcm_uring_readi()) and the waits
+(#snd_pcm_uring_poll()) of all of them in a #snd_pcm_uring_t ring and
+submit them with one #snd_pcm_uring_submit() call, which also returns
+the finished requests. Where the kernel provides io_uring, the waits of
+PCMs with a single poll descriptor are passed to the kernel in one system
+call and complete asynchronously. The transfers, and all requests when
+io_uring is not available, are emulated: the transfers are done by
+#snd_pcm_writei() or #snd_pcm_readi() during the submit (so they block
+for blocking PCMs) and the waits by poll(). A wait
+completes only when the PCM is really ready, spurious wakeups are
+consumed by the ring. The buffers passed with the requests must stay
+valid and the PCMs must not be used otherwise until the requests
+complete.
+
 \section pcm_thread_safety Thread-safety
 
 When the library is configured with the proper option, some PCM functions
@@ -502,6 +526,16 @@ LIBASOUND_THREAD_SAFE=0 aplay foo.wav
 \endcode
 for making the debugging easier.
 
+An application which calls the functions of a PCM from a single thread
+only can pass #SND_PCM_SINGLE_THREAD to #snd_pcm_open(). The PCM and all
+the plugins opened below it then skip the locks, so the calls done during
+streaming (e.g. #snd_pcm_avail_update(), #snd_pcm_mmap_commit()) do not
+pay for the mutexes. The same is done when the definition of the PCM in
+the configuration contains <code>single_thread true</code>. Plugins
+which share their slave with other clients or with a thread of their
+own (share, multi, meter, dmix, dsnoop and dshare) keep the lock of the
+slave.
+
 \section pcm_dev_names PCM naming conventions
 
 The ALSA library uses a generic string representation for names of devices.
@@ -654,6 +688,9 @@ playback devices.
 #include <poll.h>
 #include <sys/mman.h>
 #include <limits.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "pcm_local.h"
 
 #ifndef DOC_HIDDEN
@@ -2506,6 +2543,16 @@ static int snd_pcm_open_conf(snd_pcm_t **pcmp, const char *name,
 		free(val);
 		return -EINVAL;
 	}
+	/* the definition may declare single-threaded use of this PCM */
+	if (snd_config_search(pcm_conf, "single_thread", &tmp) >= 0) {
+		err = snd_config_get_bool(tmp);
+		if (err < 0) {
+			SNDERR("Invalid value for single_thread");
+			return err;
+		}
+		if (err)
+			mode |= SND_PCM_SINGLE_THREAD;
+	}
 	err = snd_config_search(pcm_conf, "type", &conf);
 	if (err < 0) {
 		SNDERR("type is not defined");
@@ -2752,6 +2799,9 @@ int snd_pcm_new(snd_pcm_t **pcmp, snd_pcm_type_t type, const char *name,
 	if (mode & SND_PCM_ASYNC) {
 		/* async handler may lead to a deadlock; suppose no MT */
 		pcm->lock_enabled = 0;
+	} else if (mode & SND_PCM_SINGLE_THREAD) {
+		/* declared by the application or the configuration */
+		pcm->lock_enabled = 0;
 	} else {
 		/* set lock_enabled field depending on $LIBASOUND_THREAD_SAFE */
 		static int do_lock_enable = -1; /* uninitialized */
@@ -3008,6 +3058,424 @@ int snd_pcm_avail_delay(snd_pcm_t *pcm,
 	return err;
 }
 
+#ifndef DOC_HIDDEN
+static int pcm_status_batch1(snd_pcm_t *pcm, snd_pcm_batch_status_t *status,
+			     unsigned int flags)
+{
+	snd_pcm_uframes_t avail;
+	int err;
+
+	if (!(flags & SND_PCM_STATUS_BATCH_HWSYNC) &&
+	    pcm->type == SND_PCM_TYPE_HW) {
+		err = snd_pcm_hw_fast_status(pcm, status);
+		if (err != -ENOSYS)
+			return err;
+	}
+	if (flags & SND_PCM_STATUS_BATCH_HWSYNC) {
+		err = __snd_pcm_hwsync(pcm);
+		if (err < 0)
+			return err;
+	}
+	if (pcm->fast_ops->htimestamp) {
+		err = pcm->fast_ops->htimestamp(pcm->fast_op_arg, &avail,
+						&status->tstamp);
+		if (err < 0)
+			return err;
+		status->avail = avail;
+	} else {
+		status->avail = __snd_pcm_avail_update(pcm);
+		if (status->avail < 0)
+			return status->avail;
+	}
+	err = __snd_pcm_delay(pcm, &status->delay);
+	if (err < 0)
+		return err;
+	status->state = __snd_pcm_state(pcm);
+	status->hw_ptr = *pcm->hw.ptr;
+	status->appl_ptr = *pcm->appl.ptr;
+	return 0;
+}
+#endif
+
+/**
+ * \brief Read the positions and timestamps of several PCMs at once
+ * \param pcms array of \a count PCM handles
+ * \param status array of \a count records to fill
+ * \param count number of PCM handles
+ * \param flags #SND_PCM_STATUS_BATCH_HWSYNC or 0
+ * \return the number of records with an error set, 0 if all are valid
+ *
+ * Fills the state, avail, delay, positions and timestamps of each PCM,
+ * in sync like #snd_pcm_avail_delay() and #snd_pcm_htimestamp(), taking
+ * the lock of each PCM only once. An error of one PCM is stored in the
+ * err field of its record and does not stop the others.
+ *
+ * For the hw plugin the values are read from the status record mapped
+ * by the kernel, so no system call is made: the position is the one of
+ * the last period interrupt or hwsync and the delay does not include
+ * the delay reported by the driver. Pass #SND_PCM_STATUS_BATCH_HWSYNC
+ * to sync the position with the hardware first and query the delay as
+ * #snd_pcm_delay() does. The audio timestamp is known only for the hw
+ * plugin without #SND_PCM_STATUS_BATCH_HWSYNC, it is zero otherwise.
+ *
+ * The function is thread-safe when built with the proper option.
+ */
+int snd_pcm_status_batch(snd_pcm_t *const *pcms, snd_pcm_batch_status_t *status,
+			 unsigned int count, unsigned int flags)
+{
+	unsigned int i;
+	int failed = 0;
+
+	assert(pcms && (status || !count));
+	for (i = 0; i < count; i++) {
+		snd_pcm_t *pcm = pcms[i];
+
+		memset(&status[i], 0, sizeof(status[i]));
+		if (!pcm->setup) {
+			SNDMSG("PCM not set up");
+			status[i].err = -EIO;
+		} else {
+			snd_pcm_lock(pcm->fast_op_arg);
+			status[i].err = pcm_status_batch1(pcm, &status[i], flags);
+			snd_pcm_unlock(pcm->fast_op_arg);
+		}
+		if (status[i].err < 0)
+			failed++;
+	}
+	return failed;
+}
+
+#ifndef DOC_HIDDEN
+#ifdef __SSE2__
+/*
+ * Copies and fills bigger than this bypass the cache with non-temporal
+ * stores. The destination of such a transfer is usually a DMA buffer
+ * which is not read back by the CPU, so caching it only evicts the
+ * working set of the application.
+ */
+#define PCM_STREAM_THRESHOLD	(256 * 1024)
+
+static void pcm_stream_copy(char *dst, const char *src, size_t bytes)
+{
+	size_t head = -(uintptr_t)dst & 15;
+
+	memcpy(dst, src, head);
+	dst += head;
+	src += head;
+	bytes -= head;
+	while (bytes >= 64) {
+		__m128i a = _mm_loadu_si128((const __m128i *)src);
+		__m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+		__m128i c = _mm_loadu_si128((const __m128i *)(src + 32));
+		__m128i d = _mm_loadu_si128((const __m128i *)(src + 48));
+		_mm_stream_si128((__m128i *)dst, a);
+		_mm_stream_si128((__m128i *)(dst + 16), b);
+		_mm_stream_si128((__m128i *)(dst + 32), c);
+		_mm_stream_si128((__m128i *)(dst + 48), d);
+		src += 64;
+		dst += 64;
+		bytes -= 64;
+	}
+	_mm_sfence();
+	memcpy(dst, src, bytes);
+}
+
+/* dst is 8 byte aligned, returns the number of 64 bit words filled */
+static size_t pcm_stream_fill(uint64_t *dst, uint64_t silence, size_t dwords)
+{
+	__m128i val = _mm_set1_epi64x(silence);
+	size_t done = 0;
+
+	if ((uintptr_t)dst & 8) {
+		*dst = silence;
+		done++;
+	}
+	while (dwords - done >= 8) {
+		__m128i *d = (__m128i *)(dst + done);
+		_mm_stream_si128(d, val);
+		_mm_stream_si128(d + 1, val);
+		_mm_stream_si128(d + 2, val);
+		_mm_stream_si128(d + 3, val);
+		done += 8;
+	}
+	_mm_sfence();
+	return done;
+}
+#endif
+
+/*
+ * Transposes between interleaved and non-interleaved layouts.
+ * The channel count is a constant in each loop, and each buffer is
+ * walked only once instead of once per channel. The loops over the
+ * channels must be unrolled to keep the pointers and vectors in
+ * registers; the pragma is known from GCC 8, other compilers decide
+ * on their own.
+ */
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 8
+#define PCM_UNROLL	_Pragma("GCC unroll 8")
+#else
+#define PCM_UNROLL
+#endif
+
+#define PCM_INTERLEAVE_LOOP(type, chns) do {			\
+	const type *s[chns];					\
+	type *d = dst + i * chns;				\
+	PCM_UNROLL						\
+	for (c = 0; c < chns; c++)				\
+		s[c] = src[c];					\
+	for (; i < frames; i++, d += chns)			\
+		PCM_UNROLL					\
+		for (c = 0; c < chns; c++)			\
+			d[c] = s[c][i];				\
+} while (0)
+
+#define PCM_DEINTERLEAVE_LOOP(type, chns) do {			\
+	type *d[chns];						\
+	const type *s = src + i * chns;				\
+	PCM_UNROLL						\
+	for (c = 0; c < chns; c++)				\
+		d[c] = dst[c];					\
+	for (; i < frames; i++, s += chns)			\
+		PCM_UNROLL					\
+		for (c = 0; c < chns; c++)			\
+			d[c][i] = s[c];				\
+} while (0)
+
+#ifdef __SSE2__
+/*
+ * A round of unpacks of the first half of the vectors with the second
+ * half is a riffle shuffle of all the samples, which rotates the bits
+ * of each sample index left by one. A block of 2^c channels of 2^f
+ * samples is therefore interleaved by c rounds and deinterleaved by f
+ * rounds, where 2^f samples fill one vector.
+ */
+#define PCM_DEFINE_RIFFLE(bits)						\
+static inline void pcm_riffle_##bits(__m128i *v, unsigned int chns,	\
+				     unsigned int rounds)		\
+{									\
+	__m128i t[8];							\
+	unsigned int c, r;						\
+	PCM_UNROLL							\
+	for (r = 0; r < rounds; r++) {					\
+		PCM_UNROLL						\
+		for (c = 0; c < chns / 2; c++) {			\
+			t[2 * c] = _mm_unpacklo_epi##bits(v[c], v[c + chns / 2]); \
+			t[2 * c + 1] = _mm_unpackhi_epi##bits(v[c], v[c + chns / 2]); \
+		}							\
+		PCM_UNROLL						\
+		for (c = 0; c < chns; c++)				\
+			v[c] = t[c];					\
+	}								\
+}									\
+static inline snd_pcm_uframes_t						\
+pcm_interleave_sse_##bits(uint##bits##_t *dst,				\
+			  uint##bits##_t *const *src,			\
+			  unsigned int chns, unsigned int rounds,	\
+			  snd_pcm_uframes_t frames)			\
+{									\
+	const unsigned int lanes = 128 / bits;				\
+	snd_pcm_uframes_t i;						\
+	unsigned int c;							\
+	__m128i v[8];							\
+	for (i = 0; i + lanes <= frames; i += lanes) {			\
+		PCM_UNROLL						\
+		for (c = 0; c < chns; c++)				\
+			v[c] = _mm_loadu_si128((const __m128i *)(src[c] + i)); \
+		pcm_riffle_##bits(v, chns, rounds);			\
+		PCM_UNROLL						\
+		for (c = 0; c < chns; c++)				\
+			_mm_storeu_si128((__m128i *)(dst + i * chns) + c, v[c]); \
+	}								\
+	return i;							\
+}									\
+static inline snd_pcm_uframes_t						\
+pcm_deinterleave_sse_##bits(uint##bits##_t *const *dst,		\
+			    const uint##bits##_t *src,			\
+			    unsigned int chns,				\
+			    snd_pcm_uframes_t frames)			\
+{									\
+	const unsigned int lanes = 128 / bits;				\
+	unsigned int c, rounds = __builtin_ctz(lanes);			\
+	snd_pcm_uframes_t i;						\
+	__m128i v[8];							\
+	for (i = 0; i + lanes <= frames; i += lanes) {			\
+		PCM_UNROLL						\
+		for (c = 0; c < chns; c++)				\
+			v[c] = _mm_loadu_si128((const __m128i *)(src + i * chns) + c); \
+		pcm_riffle_##bits(v, chns, rounds);			\
+		PCM_UNROLL						\
+		for (c = 0; c < chns; c++)				\
+			_mm_storeu_si128((__m128i *)(dst[c] + i), v[c]); \
+	}								\
+	return i;							\
+}
+#define PCM_INTERLEAVE_SSE(bits, chns, rounds)				\
+	(i = pcm_interleave_sse_##bits(dst, src, chns, rounds, frames))
+#define PCM_DEINTERLEAVE_SSE(bits, chns)				\
+	(i = pcm_deinterleave_sse_##bits(dst, src, chns, frames))
+#else
+#define PCM_DEFINE_RIFFLE(bits)
+#define PCM_INTERLEAVE_SSE(bits, chns, rounds)		do { } while (0)
+#define PCM_DEINTERLEAVE_SSE(bits, chns)		do { } while (0)
+#endif
+
+#define PCM_DEFINE_TRANSPOSE(bits)					\
+PCM_DEFINE_RIFFLE(bits)							\
+static void pcm_interleave_##bits(uint##bits##_t *dst,			\
+				  uint##bits##_t *const *src,		\
+				  unsigned int chns,			\
+				  snd_pcm_uframes_t frames)		\
+{									\
+	snd_pcm_uframes_t i = 0;					\
+	unsigned int c;							\
+	switch (chns) {							\
+	case 2:								\
+		PCM_INTERLEAVE_SSE(bits, 2, 1);				\
+		PCM_INTERLEAVE_LOOP(uint##bits##_t, 2);			\
+		break;							\
+	case 4:								\
+		PCM_INTERLEAVE_SSE(bits, 4, 2);				\
+		PCM_INTERLEAVE_LOOP(uint##bits##_t, 4);			\
+		break;							\
+	case 6:								\
+		PCM_INTERLEAVE_LOOP(uint##bits##_t, 6);			\
+		break;							\
+	case 8:								\
+		PCM_INTERLEAVE_SSE(bits, 8, 3);				\
+		PCM_INTERLEAVE_LOOP(uint##bits##_t, 8);			\
+		break;							\
+	}								\
+}									\
+static void pcm_deinterleave_##bits(uint##bits##_t *const *dst,	\
+				    const uint##bits##_t *src,		\
+				    unsigned int chns,			\
+				    snd_pcm_uframes_t frames)		\
+{									\
+	snd_pcm_uframes_t i = 0;					\
+	unsigned int c;							\
+	switch (chns) {							\
+	case 2:								\
+		PCM_DEINTERLEAVE_SSE(bits, 2);				\
+		PCM_DEINTERLEAVE_LOOP(uint##bits##_t, 2);		\
+		break;							\
+	case 4:								\
+		PCM_DEINTERLEAVE_SSE(bits, 4);				\
+		PCM_DEINTERLEAVE_LOOP(uint##bits##_t, 4);		\
+		break;							\
+	case 6:								\
+		PCM_DEINTERLEAVE_LOOP(uint##bits##_t, 6);		\
+		break;							\
+	case 8:								\
+		PCM_DEINTERLEAVE_SSE(bits, 8);				\
+		PCM_DEINTERLEAVE_LOOP(uint##bits##_t, 8);		\
+		break;							\
+	}								\
+}
+
+PCM_DEFINE_TRANSPOSE(8)
+PCM_DEFINE_TRANSPOSE(16)
+PCM_DEFINE_TRANSPOSE(32)
+PCM_DEFINE_TRANSPOSE(64)
+
+/* number of channels sharing one interleaved buffer, 0 if none */
+static unsigned int pcm_interleaved_channels(const snd_pcm_channel_area_t *areas,
+					     unsigned int channels, int width)
+{
+	unsigned int n = 1;
+
+	if (!areas->addr || areas->first % 8)
+		return 0;
+	while (n < channels && n * width < areas->step &&
+	       areas[n].addr == areas->addr &&
+	       areas[n].step == areas->step &&
+	       areas[n].first == areas[n - 1].first + width)
+		n++;
+	return n * width == areas->step ? n : 0;
+}
+
+static int pcm_planar_channels(const snd_pcm_channel_area_t *areas,
+			       unsigned int channels, int width)
+{
+	unsigned int c;
+
+	for (c = 0; c < channels; c++)
+		if (!areas[c].addr || areas[c].first % 8 ||
+		    areas[c].step != (unsigned int)width)
+			return 0;
+	return 1;
+}
+
+/*
+ * Copy between one interleaved group of 2, 4, 6 or 8 channels and
+ * the same number of non-interleaved channels, return the number of
+ * channels copied or 0 if the areas do not have this layout.
+ */
+static unsigned int pcm_areas_transpose(const snd_pcm_channel_area_t *dst_areas,
+					snd_pcm_uframes_t dst_offset,
+					const snd_pcm_channel_area_t *src_areas,
+					snd_pcm_uframes_t src_offset,
+					unsigned int channels,
+					snd_pcm_uframes_t frames, int width)
+{
+	void *ptrs[8];
+	unsigned int c, chns;
+	int interleave;
+	char *ibuf;
+
+	if (width != 8 && width != 16 && width != 32 && width != 64)
+		return 0;
+	chns = pcm_interleaved_channels(src_areas, channels, width);
+	interleave = chns < 2;
+	if (interleave)
+		chns = pcm_interleaved_channels(dst_areas, channels, width);
+	if (chns < 2 || chns > 8 || chns % 2)
+		return 0;
+	/* measured slower than the per-channel copies */
+	if (chns == 6 && width == 32 && !interleave)
+		return 0;
+	if (interleave) {
+		if (!pcm_planar_channels(src_areas, chns, width))
+			return 0;
+		ibuf = snd_pcm_channel_area_addr(dst_areas, dst_offset);
+		for (c = 0; c < chns; c++)
+			ptrs[c] = snd_pcm_channel_area_addr(&src_areas[c], src_offset);
+	} else {
+		if (!pcm_planar_channels(dst_areas, chns, width))
+			return 0;
+		ibuf = snd_pcm_channel_area_addr(src_areas, src_offset);
+		for (c = 0; c < chns; c++)
+			ptrs[c] = snd_pcm_channel_area_addr(&dst_areas[c], dst_offset);
+	}
+	switch (width) {
+	case 8:
+		if (interleave)
+			pcm_interleave_8((uint8_t *)ibuf, (uint8_t **)ptrs, chns, frames);
+		else
+			pcm_deinterleave_8((uint8_t **)ptrs, (uint8_t *)ibuf, chns, frames);
+		break;
+	case 16:
+		if (interleave)
+			pcm_interleave_16((uint16_t *)ibuf, (uint16_t **)ptrs, chns, frames);
+		else
+			pcm_deinterleave_16((uint16_t **)ptrs, (uint16_t *)ibuf, chns, frames);
+		break;
+	case 32:
+		if (interleave)
+			pcm_interleave_32((uint32_t *)ibuf, (uint32_t **)ptrs, chns, frames);
+		else
+			pcm_deinterleave_32((uint32_t **)ptrs, (uint32_t *)ibuf, chns, frames);
+		break;
+	case 64:
+		if (interleave)
+			pcm_interleave_64((uint64_t *)ibuf, (uint64_t **)ptrs, chns, frames);
+		else
+			pcm_deinterleave_64((uint64_t **)ptrs, (uint64_t *)ibuf, chns, frames);
+		break;
+	}
+	return chns;
+}
+#endif /* DOC_HIDDEN */
+
 /**
  * \brief Silence an area
  * \param dst_area area specification
@@ -3039,6 +3507,13 @@ int snd_pcm_area_silence(const snd_pcm_channel_area_t *dst_area, snd_pcm_uframes
 		unsigned int dwords = samples * width / 64;
 		uint64_t *dstp = (uint64_t *)dst;
 		samples -= dwords * 64 / width;
+#ifdef __SSE2__
+		if (dwords * 8 >= PCM_STREAM_THRESHOLD) {
+			size_t done = pcm_stream_fill(dstp, silence, dwords);
+			dstp += done;
+			dwords -= done;
+		}
+#endif
 		while (dwords-- > 0)
 			*dstp++ = silence;
 		if (samples == 0)
@@ -3206,6 +3681,11 @@ int snd_pcm_area_copy(const snd_pcm_channel_area_t *dst_area, snd_pcm_uframes_t
 		samples -= bytes * 8 / width;
 		assert(src < dst || src >= dst + bytes);
 		assert(dst < src || dst >= src + bytes);
+#ifdef __SSE2__
+		if (bytes >= PCM_STREAM_THRESHOLD)
+			pcm_stream_copy(dst, src, bytes);
+		else
+#endif
 		memcpy(dst, src, bytes);
 		if (samples == 0)
 			return 0;
@@ -3321,11 +3801,23 @@ int snd_pcm_areas_copy(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_
 	while (channels > 0) {
 		unsigned int step = src_areas->step;
 		void *src_addr = src_areas->addr;
+		unsigned int transposed;
 		const snd_pcm_channel_area_t *src_start = src_areas;
 		void *dst_addr = dst_areas->addr;
 		const snd_pcm_channel_area_t *dst_start = dst_areas;
 		int channels1 = channels;
 		unsigned int chns = 0;
+		if (step != dst_areas->step) {
+			transposed = pcm_areas_transpose(dst_areas, dst_offset,
+							 src_areas, src_offset,
+							 channels, frames, width);
+			if (transposed) {
+				src_areas += transposed;
+				dst_areas += transposed;
+				channels -= transposed;
+				continue;
+			}
+		}
 		while (dst_areas->step == step) {
 			channels1--;
 			chns++;
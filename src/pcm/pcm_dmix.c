@@ -1084,7 +1084,7 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 		/* recursion is already checked in
 		   snd_pcm_direct_get_slave_ipc_offset() */
 		ret = snd_pcm_open_slave(&spcm, root, sconf, stream,
-					 mode | SND_PCM_NONBLOCK, NULL);
+					 snd_pcm_shared_slave_mode(mode) | SND_PCM_NONBLOCK, NULL);
 		if (ret < 0) {
 			SNDERR("unable to open slave");
 			goto _err;
@@ -1132,7 +1132,7 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 		} else {
 
 			ret = snd_pcm_open_slave(&spcm, root, sconf, stream,
-						 mode | SND_PCM_NONBLOCK |
+						 snd_pcm_shared_slave_mode(mode) | SND_PCM_NONBLOCK |
 						 SND_PCM_APPEND,
 						 NULL);
 			if (ret < 0) {
@@ -26,11 +26,17 @@
  *
  */
   
+#include "config.h"
 #include "bswap.h"
 #include <ctype.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "pcm_local.h"
 #include "pcm_plugin.h"
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #ifndef PIC
 /* entry for static linking */
@@ -45,15 +51,74 @@ const char *_snd_module_pcm_file = "";
 #define CHANNELS_KEY	'c'
 #define BWIDTH_KEY	'b'
 #define FORMAT_KEY	'f'
+#define SEGMENT_KEY	'n'	/* kept, replaced for each segment */
 
 /* maximum length of a value */
 #define VALUE_MAXLEN	64
 
 typedef enum _snd_pcm_file_format {
 	SND_PCM_FILE_FORMAT_RAW,
-	SND_PCM_FILE_FORMAT_WAV
+	SND_PCM_FILE_FORMAT_WAV,
+	SND_PCM_FILE_FORMAT_FLAC
 } snd_pcm_file_format_t;
 
+/* writes of the O_DIRECT staging buffer, a multiple of the block size */
+#define DIRECT_CHUNK	(256 * 1024)
+/* dropped from the page cache at once with the fadvise option */
+#define FADVISE_STEP	(1024 * 1024)
+/* the mapped input file is read ahead in steps of this size */
+#define INFILE_READAHEAD	(1024 * 1024)
+
+/*
+ * With the async option the data leaving the plugin buffer is put on
+ * a single producer, single consumer ring and written to the file by
+ * a thread, so a slow disk does not block the stream.  When the ring
+ * is full, the data is dropped and counted.
+ */
+typedef struct {
+#ifdef HAVE_LIBPTHREAD
+	pthread_t thread;
+#endif
+	char *ring;
+	size_t size;			/* power of two */
+	size_t head;			/* consumed bytes, written by the thread */
+	size_t tail;			/* produced bytes */
+	int wake_fd[2];
+	int sleeping;			/* the thread waits for wake_fd */
+	int stop;
+	int error;			/* first write error of the thread */
+	unsigned long overflows;	/* times data was dropped */
+	unsigned long long lost;	/* bytes dropped */
+	size_t max_fill;		/* ring high watermark */
+	char *direct_buf;		/* aligned staging for O_DIRECT */
+	size_t direct_used;
+	off_t pos;			/* file offset, -1 if not seekable */
+	off_t advised;			/* dropped from page cache up to here */
+} snd_pcm_file_writer_t;
+
+/* frames per FLAC block */
+#define FLAC_BLOCK		4096
+#define FLAC_HEADER_SIZE	(8 + 34)	/* marker, STREAMINFO */
+
+/* FLAC encoder state of the writer thread */
+typedef struct {
+	snd_pcm_format_t format;
+	unsigned int channels;
+	unsigned int rate;
+	unsigned int bits;		/* per sample */
+	unsigned int sample_bytes;	/* physical */
+	unsigned int frame_bytes;
+	char *in;			/* pending data of the block */
+	size_t in_bytes;
+	int32_t *x;			/* one channel of the block */
+	unsigned char *out;		/* the coded frame */
+	int header;			/* the stream header was written */
+	off_t offset;			/* of the header, -1 if not seekable */
+	uint32_t frame_no;
+	uint64_t total;			/* frames in the stream */
+	unsigned int min_frame, max_frame;
+} snd_pcm_file_flac_t;
+
 /* WAV format chunk */
 struct wav_fmt {
 	short fmt;
@@ -74,6 +139,12 @@ typedef struct {
 	FILE *pipe;
 	char *ifname;
 	int ifd;
+	char *ifmap;			/* mapped input file or NULL */
+	size_t ifmap_size;
+	off_t ifsize;			/* input file size when it was mapped */
+	size_t ifdata_end;		/* end of the sample data */
+	size_t ifpos;			/* read position */
+	size_t ifahead;			/* read ahead up to here */
 	int format;
 	snd_pcm_uframes_t appl_ptr;
 	snd_pcm_uframes_t file_ptr_bytes;
@@ -90,6 +161,16 @@ typedef struct {
 	struct wav_fmt wav_header;
 	size_t filelen;
 	char ifmmap_overwritten;
+	double async;			/* seconds buffered by the writer thread */
+	int direct;			/* O_DIRECT writes from the thread */
+	int fadvise;			/* drop written data from the page cache */
+	snd_pcm_file_writer_t *writer;
+	snd_pcm_file_flac_t *flac;
+	double segment_time;		/* segment limits, 0 = single file */
+	long segment_size;
+	size_t segment_bytes;		/* sample data per segment */
+	unsigned int segment;		/* number of the current segment */
+	char *segname;			/* its final name */
 } snd_pcm_file_t;
 
 #if __BYTE_ORDER == __LITTLE_ENDIAN
@@ -189,6 +270,14 @@ static int snd_pcm_file_replace_fname(snd_pcm_file_t *file, char **new_fname_p)
 					return err;
 				break;
 
+			case SEGMENT_KEY:
+				/* replaced when the segment is opened */
+				if (file->segment_time > 0 || file->segment_size > 0) {
+					*(new_index_ch++) = LEADING_KEY;
+					*(new_index_ch++) = SEGMENT_KEY;
+				}
+				break;
+
 			default:
 				/* non-key char, just copying */
 				*(new_index_ch++) = *(old_index_ch);
@@ -271,6 +360,121 @@ static int snd_pcm_file_open_output_file(snd_pcm_file_t *file)
 	return 0;
 }
 
+/* find the sample data of a WAV input file, return its offset or 0 */
+static off_t snd_pcm_file_infile_wav_data(snd_pcm_file_t *file, off_t *end)
+{
+	unsigned char hdr[12];
+	off_t pos = 12;
+	size_t len;
+
+	if (pread(file->ifd, hdr, 12, 0) != 12 ||
+	    memcmp(hdr, "RIFF", 4) || memcmp(hdr + 8, "WAVE", 4))
+		return 0;
+	while (pread(file->ifd, hdr, 8, pos) == 8) {
+		len = hdr[4] | (hdr[5] << 8) | (hdr[6] << 16) | ((size_t)hdr[7] << 24);
+		pos += 8;
+		if (!memcmp(hdr, "data", 4)) {
+			if (pos + (off_t)len < *end)
+				*end = pos + len;
+			return pos;
+		}
+		pos += (len + 1) & ~(size_t)1;
+	}
+	return 0;
+}
+
+/*
+ * Skip the header of a WAV input file and map a regular input file, so
+ * the samples are copied from the page cache to the stream directly.
+ * Other files are read with read() into the scratch buffer.
+ *
+ * The mapping covers the file size at open.  The size is checked before
+ * each copy and the file is read with read() from then on when it was
+ * truncated or grew, so appended data is seen and a truncated file ends
+ * the stream.  This costs a fstat() per transfer, and a truncation
+ * between the check and the copy still raises SIGBUS; files which are
+ * written while they are played are better given as pipes.
+ */
+static void snd_pcm_file_infile_setup(snd_pcm_file_t *file)
+{
+	struct stat st;
+	off_t start, end;
+	void *map;
+
+	if (fstat(file->ifd, &st) < 0 || !S_ISREG(st.st_mode))
+		return;
+	start = lseek(file->ifd, 0, SEEK_CUR);
+	if (start < 0)
+		return;
+	end = st.st_size;
+	if (start == 0) {
+		start = snd_pcm_file_infile_wav_data(file, &end);
+		lseek(file->ifd, start, SEEK_SET);
+	}
+	if (end <= start || (unsigned long long)end > SIZE_MAX)
+		return;
+	map = mmap(NULL, end, PROT_READ, MAP_PRIVATE, file->ifd, 0);
+	if (map == MAP_FAILED)
+		return;
+	madvise(map, end, MADV_SEQUENTIAL);
+	file->ifmap = map;
+	file->ifmap_size = end;
+	file->ifsize = st.st_size;
+	file->ifdata_end = end;
+	file->ifpos = start;
+	file->ifahead = start;
+}
+
+/* fall back to read() when the input file changed its size */
+static int snd_pcm_file_infile_changed(snd_pcm_file_t *file)
+{
+	struct stat st;
+
+	if (fstat(file->ifd, &st) == 0 && st.st_size == file->ifsize)
+		return 0;
+	munmap(file->ifmap, file->ifmap_size);
+	file->ifmap = NULL;
+	lseek(file->ifd, file->ifpos, SEEK_SET);
+	return 1;
+}
+
+/* copy from the mapped input file, return bytes red */
+static int snd_pcm_file_areas_map_infile(snd_pcm_t *pcm,
+					 const snd_pcm_channel_area_t *areas,
+					 snd_pcm_uframes_t offset,
+					 snd_pcm_uframes_t frames)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	snd_pcm_channel_area_t areas_if[pcm->channels];
+	size_t bytes, ahead;
+	long page;
+
+	bytes = snd_pcm_frames_to_bytes(pcm, frames);
+	if (bytes > file->ifdata_end - file->ifpos) {
+		frames = snd_pcm_bytes_to_frames(pcm, file->ifdata_end - file->ifpos);
+		bytes = snd_pcm_frames_to_bytes(pcm, frames);
+	}
+	if (!bytes)
+		return 0;
+
+	/* keep the pages of the next step coming */
+	if (file->ifpos + bytes + INFILE_READAHEAD > file->ifahead &&
+	    file->ifahead < file->ifdata_end) {
+		page = sysconf(_SC_PAGESIZE);
+		ahead = file->ifahead & ~(size_t)(page - 1);
+		file->ifahead = file->ifpos + bytes + 2 * INFILE_READAHEAD;
+		if (file->ifahead > file->ifdata_end)
+			file->ifahead = file->ifdata_end;
+		madvise(file->ifmap + ahead, file->ifahead - ahead, MADV_WILLNEED);
+	}
+
+	snd_pcm_areas_from_buf(pcm, areas_if, file->ifmap + file->ifpos);
+	snd_pcm_areas_copy(areas, offset, areas_if, 0, pcm->channels, frames, pcm->format);
+	file->ifpos += bytes;
+
+	return bytes;
+}
+
 /* fill areas with data from input file, return bytes red */
 static int snd_pcm_file_areas_read_infile(snd_pcm_t *pcm,
 					  const snd_pcm_channel_area_t *areas,
@@ -284,6 +488,9 @@ static int snd_pcm_file_areas_read_infile(snd_pcm_t *pcm,
 	if (file->ifd < 0)
 		return -EBADF;
 
+	if (file->ifmap && !snd_pcm_file_infile_changed(file))
+		return snd_pcm_file_areas_map_infile(pcm, areas, offset, frames);
+
 	if (file->rbuf == NULL)
 		return -ENOMEM;
 
@@ -320,10 +527,12 @@ static void setup_wav_header(snd_pcm_t *pcm, struct wav_fmt *fmt)
 	fmt->bits = TO_LE16(fmt->bits);
 }
 
-static int write_wav_header(snd_pcm_t *pcm)
+/* the header, with zero lengths fixed up at close */
+#define WAV_HEADER_SIZE	44
+
+static void make_wav_header(snd_pcm_t *pcm, char *buf)
 {
 	snd_pcm_file_t *file = pcm->private_data;
-	ssize_t res;
 
 	static const char header[] = {
 		'R', 'I', 'F', 'F',
@@ -336,19 +545,22 @@ static int write_wav_header(snd_pcm_t *pcm)
 		'd', 'a', 't', 'a',
 		0, 0, 0, 0
 	};
-	
-	setup_wav_header(pcm, &file->wav_header);
 
-	res = write(file->fd, header, sizeof(header));
-	if (res != sizeof(header))
-		goto write_error;
+	setup_wav_header(pcm, &file->wav_header);
+	memcpy(buf, header, sizeof(header));
+	memcpy(buf + sizeof(header), &file->wav_header, sizeof(file->wav_header));
+	memcpy(buf + sizeof(header) + sizeof(file->wav_header), header2, sizeof(header2));
+}
 
-	res = write(file->fd, &file->wav_header, sizeof(file->wav_header));
-	if (res != sizeof(file->wav_header))
-		goto write_error;
+static int write_wav_header(snd_pcm_t *pcm)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	char buf[WAV_HEADER_SIZE];
+	ssize_t res;
 
-	res = write(file->fd, header2, sizeof(header2));
-	if (res != sizeof(header2))
+	make_wav_header(pcm, buf);
+	res = write(file->fd, buf, sizeof(buf));
+	if (res != sizeof(buf))
 		goto write_error;
 
 	return 0;
@@ -397,6 +609,817 @@ static void fixup_wav_header(snd_pcm_t *pcm)
 }
 #endif /* DOC_HIDDEN */
 
+#ifdef HAVE_LIBPTHREAD
+/*
+ * A minimal FLAC encoder, run by the writer thread: fixed size blocks,
+ * each channel coded as a constant, with the best fixed predictor and
+ * a single Rice partition, or verbatim, whichever is the shortest.
+ */
+typedef struct {
+	unsigned char *buf;
+	size_t pos;
+	uint64_t acc;
+	unsigned int bits;
+} flac_bits_t;
+
+static void flac_put(flac_bits_t *b, uint32_t val, unsigned int n)
+{
+	if (n < 32)
+		val &= (1U << n) - 1;
+	b->acc = (b->acc << n) | val;
+	b->bits += n;
+	while (b->bits >= 8) {
+		b->bits -= 8;
+		b->buf[b->pos++] = b->acc >> b->bits;
+	}
+}
+
+static void flac_put_unary(flac_bits_t *b, uint32_t q)
+{
+	for (; q >= 31; q -= 31)
+		flac_put(b, 0, 31);
+	flac_put(b, 1, q + 1);
+}
+
+/* the frame number, coded like UTF-8 */
+static void flac_put_utf8(flac_bits_t *b, uint32_t v)
+{
+	int len, i;
+
+	if (v < 0x80) {
+		flac_put(b, v, 8);
+		return;
+	}
+	for (len = 2; len < 6 && v >= (1U << (5 * len + 1)); len++)
+		;
+	flac_put(b, ((0xff00 >> len) & 0xff) | (v >> (6 * (len - 1))), 8);
+	for (i = len - 2; i >= 0; i--)
+		flac_put(b, 0x80 | ((v >> (6 * i)) & 0x3f), 8);
+}
+
+static unsigned int flac_crc(const unsigned char *p, size_t len,
+			     unsigned int width, unsigned int poly)
+{
+	unsigned int top = 1U << (width - 1), crc = 0;
+	int i;
+
+	while (len--) {
+		crc ^= *p++ << (width - 8);
+		for (i = 0; i < 8; i++)
+			crc = crc & top ? (crc << 1) ^ poly : crc << 1;
+	}
+	return crc & ((1U << width) - 1);
+}
+
+static int32_t flac_residual(const int32_t *x, unsigned int i, unsigned int order)
+{
+	switch (order) {
+	case 0:
+		return x[i];
+	case 1:
+		return x[i] - x[i - 1];
+	case 2:
+		return x[i] - 2 * x[i - 1] + x[i - 2];
+	case 3:
+		return x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+	default:
+		return x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4];
+	}
+}
+
+static inline uint32_t flac_fold(int32_t r)
+{
+	return ((uint32_t)r << 1) ^ (uint32_t)(r >> 31);
+}
+
+/* bits of the residual of an order with Rice parameter k */
+static uint64_t flac_rice_bits(const int32_t *x, unsigned int n,
+			       unsigned int order, unsigned int k)
+{
+	uint64_t bits = (uint64_t)(n - order) * (k + 1);
+	unsigned int i;
+
+	for (i = order; i < n; i++)
+		bits += flac_fold(flac_residual(x, i, order)) >> k;
+	return bits;
+}
+
+static void flac_subframe(snd_pcm_file_flac_t *enc, flac_bits_t *b, unsigned int n)
+{
+	const int32_t *x = enc->x;
+	uint64_t best, bits, sum;
+	unsigned int i, order, k, c, best_order = 0, best_k = 0;
+	int verbatim = 1;
+
+	for (i = 1; i < n && x[i] == x[0]; i++)
+		;
+	if (i == n) {
+		flac_put(b, 0x00, 8);		/* constant */
+		flac_put(b, x[0], enc->bits);
+		return;
+	}
+	best = (uint64_t)n * enc->bits;
+	for (order = 0; order <= 4 && order < n; order++) {
+		sum = 0;
+		for (i = order; i < n; i++)
+			sum += flac_fold(flac_residual(x, i, order));
+		/* start from the parameter matching the mean */
+		for (k = 0; k < 14 && ((uint64_t)(n - order) << (k + 1)) < sum; k++)
+			;
+		for (c = k ? k - 1 : 0; c <= k + 1 && c <= 14; c++) {
+			bits = order * enc->bits + 10 + flac_rice_bits(x, n, order, c);
+			if (bits < best) {
+				best = bits;
+				best_order = order;
+				best_k = c;
+				verbatim = 0;
+			}
+		}
+	}
+	if (verbatim) {
+		flac_put(b, 0x01 << 1, 8);
+		for (i = 0; i < n; i++)
+			flac_put(b, x[i], enc->bits);
+		return;
+	}
+	flac_put(b, (0x08 | best_order) << 1, 8);
+	for (i = 0; i < best_order; i++)
+		flac_put(b, x[i], enc->bits);
+	flac_put(b, 0, 2);		/* Rice coding, 4 bit parameter */
+	flac_put(b, 0, 4);		/* one partition */
+	flac_put(b, best_k, 4);
+	for (i = best_order; i < n; i++) {
+		uint32_t u = flac_fold(flac_residual(x, i, best_order));
+		flac_put_unary(b, u >> best_k);
+		flac_put(b, u, best_k);
+	}
+}
+
+static int32_t flac_sample(snd_pcm_file_flac_t *enc, const unsigned char *p)
+{
+	int32_t v;
+
+	if (enc->format == SND_PCM_FORMAT_S16_LE)
+		return (int16_t)(p[0] | (p[1] << 8));
+	/* S24_LE and S24_3LE */
+	v = p[0] | (p[1] << 8) | (p[2] << 16);
+	return (v ^ 0x800000) - 0x800000;
+}
+
+static void flac_make_header(snd_pcm_file_flac_t *enc, unsigned char *buf)
+{
+	flac_bits_t b = { .buf = buf };
+
+	memcpy(buf, "fLaC", 4);
+	b.pos = 4;
+	flac_put(&b, 0x80, 8);		/* last metadata block, STREAMINFO */
+	flac_put(&b, 34, 24);
+	flac_put(&b, FLAC_BLOCK, 16);
+	flac_put(&b, FLAC_BLOCK, 16);
+	/* 0 for unknown, the header of a stream is written before its frames */
+	flac_put(&b, enc->min_frame == UINT_MAX ? 0 : enc->min_frame, 24);
+	flac_put(&b, enc->max_frame, 24);
+	flac_put(&b, enc->rate, 20);
+	flac_put(&b, enc->channels - 1, 3);
+	flac_put(&b, enc->bits - 1, 5);
+	flac_put(&b, enc->total >> 32, 4);
+	flac_put(&b, enc->total, 32);
+	memset(buf + b.pos, 0, 16);	/* no MD5 */
+}
+
+static snd_pcm_file_flac_t *flac_new(snd_pcm_t *slave)
+{
+	snd_pcm_file_flac_t *enc;
+	size_t out;
+
+	if ((slave->format != SND_PCM_FORMAT_S16_LE &&
+	     slave->format != SND_PCM_FORMAT_S24_LE &&
+	     slave->format != SND_PCM_FORMAT_S24_3LE) ||
+	    slave->channels > 8) {
+		SNDERR("FLAC output supports only S16_LE, S24_LE and S24_3LE with up to 8 channels");
+		return NULL;
+	}
+	enc = calloc(1, sizeof(*enc));
+	if (!enc)
+		return NULL;
+	enc->format = slave->format;
+	enc->channels = slave->channels;
+	enc->rate = slave->rate;
+	enc->bits = snd_pcm_format_width(slave->format);
+	enc->sample_bytes = snd_pcm_format_physical_width(slave->format) / 8;
+	enc->frame_bytes = enc->sample_bytes * enc->channels;
+	/* a coded frame is never longer than the verbatim one */
+	out = 32 + enc->channels * (FLAC_BLOCK * enc->bits / 8 + 8);
+	enc->in = malloc(FLAC_BLOCK * enc->frame_bytes);
+	enc->x = malloc(FLAC_BLOCK * sizeof(*enc->x));
+	enc->out = malloc(out);
+	if (!enc->in || !enc->x || !enc->out) {
+		free(enc->in);
+		free(enc->x);
+		free(enc->out);
+		free(enc);
+		return NULL;
+	}
+	enc->min_frame = UINT_MAX;
+	return enc;
+}
+
+static void flac_free(snd_pcm_file_flac_t *enc)
+{
+	if (!enc)
+		return;
+	free(enc->in);
+	free(enc->x);
+	free(enc->out);
+	free(enc);
+}
+
+/* start a new stream, for the next segment */
+static void flac_reset(snd_pcm_file_flac_t *enc)
+{
+	enc->in_bytes = 0;
+	enc->header = 0;
+	enc->frame_no = 0;
+	enc->total = 0;
+	enc->min_frame = UINT_MAX;
+	enc->max_frame = 0;
+}
+
+/* write the whole buffer, return 0 or a negative error code */
+static int writer_write_all(int fd, const char *buf, size_t len)
+{
+	ssize_t res;
+
+	while (len > 0) {
+		res = write(fd, buf, len);
+		if (res < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		buf += res;
+		len -= res;
+	}
+	return 0;
+}
+
+/* drop the data written one step ago, the last step may be still dirty */
+static void writer_advise(snd_pcm_file_t *file)
+{
+#ifdef POSIX_FADV_DONTNEED
+	snd_pcm_file_writer_t *w = file->writer;
+
+	if (!file->fadvise || w->pos < 0)
+		return;
+	if (w->pos - w->advised < 2 * FADVISE_STEP)
+		return;
+	posix_fadvise(file->fd, w->advised, FADVISE_STEP, POSIX_FADV_DONTNEED);
+	w->advised += FADVISE_STEP;
+#endif
+}
+
+/* output bytes to the file, staged in whole chunks for O_DIRECT */
+static int writer_output(snd_pcm_file_t *file, const char *buf, size_t len)
+{
+	snd_pcm_file_writer_t *w = file->writer;
+	size_t n;
+	int err;
+
+	if (!w->direct_buf) {
+		err = writer_write_all(file->fd, buf, len);
+		if (err < 0)
+			return err;
+		if (w->pos >= 0)
+			w->pos += len;
+		writer_advise(file);
+		return 0;
+	}
+	while (len > 0) {
+		n = DIRECT_CHUNK - w->direct_used;
+		if (n > len)
+			n = len;
+		memcpy(w->direct_buf + w->direct_used, buf, n);
+		w->direct_used += n;
+		buf += n;
+		len -= n;
+		if (w->direct_used == DIRECT_CHUNK) {
+			err = writer_write_all(file->fd, w->direct_buf, DIRECT_CHUNK);
+			if (err < 0)
+				return err;
+			w->direct_used = 0;
+			w->pos += DIRECT_CHUNK;
+			writer_advise(file);
+		}
+	}
+	return 0;
+}
+
+/* back to plain writes, the header updates are not aligned */
+static void writer_direct_off(snd_pcm_file_t *file)
+{
+#ifdef O_DIRECT
+	if (file->writer->direct_buf && file->fd >= 0)
+		fcntl(file->fd, F_SETFL, fcntl(file->fd, F_GETFL) & ~O_DIRECT);
+#endif
+}
+
+/* write the staged tail, which is not a whole block, without O_DIRECT */
+static int writer_flush_direct(snd_pcm_file_t *file)
+{
+	snd_pcm_file_writer_t *w = file->writer;
+	int err;
+
+	writer_direct_off(file);
+	err = writer_write_all(file->fd, w->direct_buf, w->direct_used);
+	if (err >= 0)
+		w->pos += w->direct_used;
+	w->direct_used = 0;
+	return err;
+}
+
+/* code the pending frames as one FLAC frame */
+static int flac_frame(snd_pcm_file_t *file)
+{
+	snd_pcm_file_flac_t *enc = file->flac;
+	flac_bits_t b = { .buf = enc->out };
+	unsigned int n = enc->in_bytes / enc->frame_bytes;
+	unsigned int ch, i;
+	const unsigned char *p;
+	int err;
+
+	if (!n)
+		return 0;
+	flac_put(&b, 0x3ffe, 14);	/* sync */
+	flac_put(&b, 0, 2);		/* fixed block size */
+	flac_put(&b, 7, 4);		/* 16 bit block size follows */
+	flac_put(&b, 0, 4);		/* rate from STREAMINFO */
+	flac_put(&b, enc->channels - 1, 4);
+	flac_put(&b, 0, 4);		/* sample size from STREAMINFO */
+	flac_put_utf8(&b, enc->frame_no);
+	flac_put(&b, n - 1, 16);
+	flac_put(&b, flac_crc(b.buf, b.pos, 8, 0x07), 8);
+	for (ch = 0; ch < enc->channels; ch++) {
+		p = (const unsigned char *)enc->in + ch * enc->sample_bytes;
+		for (i = 0; i < n; i++, p += enc->frame_bytes)
+			enc->x[i] = flac_sample(enc, p);
+		flac_subframe(enc, &b, n);
+	}
+	if (b.bits)
+		flac_put(&b, 0, 8 - b.bits);
+	flac_put(&b, flac_crc(b.buf, b.pos, 16, 0x8005), 16);
+
+	err = writer_output(file, (char *)b.buf, b.pos);
+	if (err < 0)
+		return err;
+	enc->in_bytes = 0;
+	enc->frame_no++;
+	enc->total += n;
+	if (b.pos < enc->min_frame)
+		enc->min_frame = b.pos;
+	if (b.pos > enc->max_frame)
+		enc->max_frame = b.pos;
+	return 0;
+}
+
+static int flac_write(snd_pcm_file_t *file, const char *buf, size_t len)
+{
+	snd_pcm_file_flac_t *enc = file->flac;
+	size_t block = FLAC_BLOCK * enc->frame_bytes, n;
+	int err;
+
+	while (len > 0) {
+		n = block - enc->in_bytes;
+		if (n > len)
+			n = len;
+		memcpy(enc->in + enc->in_bytes, buf, n);
+		enc->in_bytes += n;
+		buf += n;
+		len -= n;
+		if (enc->in_bytes == block) {
+			err = flac_frame(file);
+			if (err < 0)
+				return err;
+		}
+	}
+	return 0;
+}
+
+static int writer_header(snd_pcm_t *pcm)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	char header[WAV_HEADER_SIZE > FLAC_HEADER_SIZE ? WAV_HEADER_SIZE : FLAC_HEADER_SIZE];
+	int err;
+
+	if (file->format == SND_PCM_FILE_FORMAT_WAV &&
+	    !file->wav_header.fmt) {
+		make_wav_header(pcm, header);
+		err = writer_output(file, header, WAV_HEADER_SIZE);
+		if (err < 0) {
+			memset(&file->wav_header, 0, sizeof(struct wav_fmt));
+			return err;
+		}
+	} else if (file->flac && !file->flac->header) {
+		file->flac->offset = file->writer->pos < 0 ? -1 :
+			file->writer->pos + (off_t)file->writer->direct_used;
+		flac_make_header(file->flac, (unsigned char *)header);
+		err = writer_output(file, header, FLAC_HEADER_SIZE);
+		if (err < 0)
+			return err;
+		file->flac->header = 1;
+	}
+	return 0;
+}
+
+/* complete the file: pending data, then the lengths in the header */
+static int writer_finish(snd_pcm_t *pcm)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	snd_pcm_file_writer_t *w = file->writer;
+	unsigned char header[FLAC_HEADER_SIZE];
+	int err = 0;
+
+	if (file->flac)
+		err = flac_frame(file);
+	/* also turns O_DIRECT off for the header updates */
+	if (err >= 0 && w->direct_buf)
+		err = writer_flush_direct(file);
+	if (err < 0)
+		return err;
+	if (file->flac && file->flac->header && file->flac->offset >= 0) {
+		flac_make_header(file->flac, header);
+		if (pwrite(file->fd, header, sizeof(header), file->flac->offset) != sizeof(header))
+			return -errno;
+	}
+	return 0;
+}
+
+/* the name with %n replaced, or with the number before the extension */
+static char *writer_segment_name(snd_pcm_file_t *file, const char *suffix)
+{
+	const char *fname = file->final_fname;
+	const char *key = strstr(fname, "%n");
+	const char *base, *ext;
+	size_t len = strlen(fname) + strlen(suffix) + 16;
+	char *name = malloc(len);
+
+	if (!name)
+		return NULL;
+	if (key) {
+		snprintf(name, len, "%.*s%04u%s%s", (int)(key - fname),
+			 fname, file->segment, key + 2, suffix);
+		return name;
+	}
+	base = strrchr(fname, '/');
+	base = base ? base + 1 : fname;
+	ext = strrchr(base, '.');
+	if (!ext || ext == base)
+		ext = fname + strlen(fname);
+	snprintf(name, len, "%.*s.%04u%s%s", (int)(ext - fname), fname,
+		 file->segment, ext, suffix);
+	return name;
+}
+
+/* a segment is written under a temporary name, see writer_close_segment() */
+static int writer_open_segment(snd_pcm_t *pcm)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	snd_pcm_file_writer_t *w = file->writer;
+	char *part;
+	int fd;
+
+	for (;;) {
+		free(file->segname);
+		file->segname = writer_segment_name(file, "");
+		if (!file->segname)
+			return -ENOMEM;
+		/* without truncate, keep the existing segments */
+		if (file->trunc || access(file->segname, F_OK) < 0)
+			break;
+		file->segment++;
+	}
+	part = writer_segment_name(file, ".part");
+	if (!part)
+		return -ENOMEM;
+	fd = open(part, O_WRONLY|O_CREAT|O_TRUNC, file->perm);
+	if (fd < 0) {
+		SYSERR("open %s for writing failed", part);
+		free(part);
+		return -errno;
+	}
+	free(part);
+	file->fd = fd;
+	w->pos = 0;
+	w->advised = 0;
+#ifdef O_DIRECT
+	if (w->direct_buf)
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_DIRECT);
+#endif
+	return 0;
+}
+
+/* complete the segment and rename it to its final name at once */
+static int writer_close_segment(snd_pcm_t *pcm)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	char *part;
+	int err;
+
+	if (file->fd < 0)
+		return 0;
+	err = writer_finish(pcm);
+	if (err >= 0 && file->wav_header.fmt)
+		fixup_wav_header(pcm);
+	close(file->fd);
+	file->fd = -1;
+	part = writer_segment_name(file, ".part");
+	if (!part)
+		return -ENOMEM;
+	if (err >= 0 && rename(part, file->segname) < 0) {
+		err = -errno;
+		SYSERR("rename %s failed", part);
+	}
+	free(part);
+	file->segment++;
+	file->filelen = 0;
+	memset(&file->wav_header, 0, sizeof(struct wav_fmt));
+	if (file->flac)
+		flac_reset(file->flac);
+	return err;
+}
+
+static int writer_chunk(snd_pcm_t *pcm, const char *buf, size_t len)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	size_t n;
+	int err;
+
+	while (len > 0) {
+		if (file->fd < 0) {
+			err = writer_open_segment(pcm);
+			if (err < 0)
+				return err;
+		}
+		err = writer_header(pcm);
+		if (err < 0)
+			return err;
+		n = len;
+		if (file->segment_bytes && n > file->segment_bytes - file->filelen)
+			n = file->segment_bytes - file->filelen;
+		if (file->flac)
+			err = flac_write(file, buf, n);
+		else
+			err = writer_output(file, buf, n);
+		if (err < 0)
+			return err;
+		file->filelen += n;
+		buf += n;
+		len -= n;
+		if (file->segment_bytes && file->filelen >= file->segment_bytes) {
+			err = writer_close_segment(pcm);
+			if (err < 0)
+				return err;
+		}
+	}
+	return 0;
+}
+
+static void *writer_thread(void *arg)
+{
+	snd_pcm_t *pcm = arg;
+	snd_pcm_file_t *file = pcm->private_data;
+	snd_pcm_file_writer_t *w = file->writer;
+	struct pollfd pfd;
+	size_t head, tail, pos, n;
+	char dummy[16];
+	int err;
+
+	for (;;) {
+		head = w->head;
+		tail = __atomic_load_n(&w->tail, __ATOMIC_ACQUIRE);
+		if (head == tail) {
+			if (__atomic_load_n(&w->stop, __ATOMIC_ACQUIRE))
+				break;
+			__atomic_store_n(&w->sleeping, 1, __ATOMIC_SEQ_CST);
+			if (__atomic_load_n(&w->tail, __ATOMIC_SEQ_CST) != head ||
+			    __atomic_load_n(&w->stop, __ATOMIC_SEQ_CST)) {
+				__atomic_store_n(&w->sleeping, 0, __ATOMIC_RELAXED);
+				continue;
+			}
+			pfd.fd = w->wake_fd[0];
+			pfd.events = POLLIN;
+			if (poll(&pfd, 1, -1) > 0)
+				while (read(w->wake_fd[0], dummy, sizeof(dummy)) == sizeof(dummy))
+					;
+			continue;
+		}
+		pos = head & (w->size - 1);
+		n = tail - head;
+		if (n > w->size - pos)
+			n = w->size - pos;
+		/* after an error the data is only consumed */
+		if (!w->error) {
+			err = writer_chunk(pcm, w->ring + pos, n);
+			if (err < 0) {
+				SNDERR("%s write failed (%s), file data may be corrupt",
+				       file->fname, snd_strerror(err));
+				__atomic_store_n(&w->error, -EIO, __ATOMIC_RELEASE);
+			}
+		}
+		__atomic_store_n(&w->head, head + n, __ATOMIC_RELEASE);
+	}
+	if (!w->error) {
+		if (file->segment_bytes)
+			err = writer_close_segment(pcm);
+		else
+			err = writer_finish(pcm);
+		if (err < 0)
+			SNDERR("%s write failed (%s), file data may be corrupt",
+			       file->fname, snd_strerror(err));
+	}
+	/* also after an error, the header is still fixed up on close */
+	writer_direct_off(file);
+	return NULL;
+}
+
+static int snd_pcm_file_writer_start(snd_pcm_t *pcm)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	snd_pcm_t *slave = file->gen.slave;
+	snd_pcm_file_writer_t *w;
+	size_t bytes;
+	int err;
+
+	w = calloc(1, sizeof(*w));
+	if (!w)
+		return -ENOMEM;
+	w->wake_fd[0] = w->wake_fd[1] = -1;
+	/* called from hw_params, the setup is not copied to pcm yet */
+	bytes = snd_pcm_frames_to_bytes(slave, (snd_pcm_uframes_t)
+					((file->async > 0 ? file->async : 1.0) * slave->rate));
+	if (bytes < 2 * file->buffer_bytes)
+		bytes = 2 * file->buffer_bytes;
+	for (w->size = 4096; w->size < bytes; w->size *= 2)
+		;
+	w->ring = malloc(w->size);
+	if (!w->ring) {
+		err = -ENOMEM;
+		goto _err;
+	}
+	if (pipe(w->wake_fd) < 0) {
+		err = -errno;
+		goto _err;
+	}
+	fcntl(w->wake_fd[0], F_SETFL, O_NONBLOCK);
+	fcntl(w->wake_fd[1], F_SETFL, O_NONBLOCK);
+	if (file->flac &&
+	    (file->flac->format != slave->format ||
+	     file->flac->channels != slave->channels ||
+	     file->flac->rate != slave->rate)) {
+		/* a FLAC stream cannot change its parameters */
+		if (file->flac->header) {
+			SNDERR("%s: the FLAC stream parameters cannot change", file->fname);
+			err = -EINVAL;
+			goto _err;
+		}
+		flac_free(file->flac);
+		file->flac = NULL;
+	}
+	if (file->format == SND_PCM_FILE_FORMAT_FLAC && !file->flac) {
+		file->flac = flac_new(slave);
+		if (!file->flac) {
+			err = -EINVAL;
+			goto _err;
+		}
+	}
+	if (file->segment_bytes) {
+		/* each segment is opened by the thread */
+		w->pos = 0;
+#ifdef O_DIRECT
+		if (file->direct &&
+		    posix_memalign((void **)&w->direct_buf, 4096, DIRECT_CHUNK))
+			w->direct_buf = NULL;
+#endif
+	} else {
+		w->pos = file->pipe ? -1 : lseek(file->fd, 0, SEEK_CUR);
+	}
+	w->advised = w->pos;
+#ifdef O_DIRECT
+	/* only from a block boundary, a reopened stream may not start there */
+	if (!file->segment_bytes &&
+	    file->direct && w->pos >= 0 && (w->pos % 4096) == 0 &&
+	    posix_memalign((void **)&w->direct_buf, 4096, DIRECT_CHUNK) == 0) {
+		if (fcntl(file->fd, F_SETFL, fcntl(file->fd, F_GETFL) | O_DIRECT) < 0) {
+			free(w->direct_buf);
+			w->direct_buf = NULL;
+		}
+	}
+#endif
+	file->writer = w;
+	err = pthread_create(&w->thread, NULL, writer_thread, pcm);
+	if (err) {
+		file->writer = NULL;
+		err = -err;
+		goto _err;
+	}
+	return 0;
+
+ _err:
+#ifdef O_DIRECT
+	if (w->direct_buf && file->fd >= 0)
+		fcntl(file->fd, F_SETFL, fcntl(file->fd, F_GETFL) & ~O_DIRECT);
+#endif
+	if (w->wake_fd[0] >= 0) {
+		close(w->wake_fd[0]);
+		close(w->wake_fd[1]);
+	}
+	free(w->direct_buf);
+	free(w->ring);
+	free(w);
+	return err;
+}
+
+/* let the thread write all queued data and finish */
+static void snd_pcm_file_writer_stop(snd_pcm_t *pcm)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	snd_pcm_file_writer_t *w = file->writer;
+
+	if (!w)
+		return;
+	__atomic_store_n(&w->stop, 1, __ATOMIC_SEQ_CST);
+	if (write(w->wake_fd[1], "", 1) < 0 && errno != EAGAIN)
+		SYSERR("writer wakeup failed");
+	pthread_join(w->thread, NULL);
+	if (w->overflows)
+		SNDERR("%s: %llu bytes dropped in %lu writer overflows",
+		       file->fname ? file->fname : "file", w->lost, w->overflows);
+	close(w->wake_fd[0]);
+	close(w->wake_fd[1]);
+	free(w->direct_buf);
+	free(w->ring);
+	free(w);
+	file->writer = NULL;
+}
+
+static void writer_put(snd_pcm_file_writer_t *w, size_t *tail, const char *buf, size_t len)
+{
+	size_t pos = *tail & (w->size - 1);
+	size_t n = w->size - pos;
+
+	if (n > len)
+		n = len;
+	memcpy(w->ring + pos, buf, n);
+	memcpy(w->ring, buf + n, len - n);
+	*tail += len;
+}
+
+/* queue bytes from the plugin buffer for the thread, never blocks */
+static int snd_pcm_file_writer_queue(snd_pcm_t *pcm, size_t bytes)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	snd_pcm_file_writer_t *w = file->writer;
+	size_t head, tail, copy, n, c;
+	int err;
+
+	err = __atomic_load_n(&w->error, __ATOMIC_ACQUIRE);
+	if (err < 0) {
+		file->wbuf_used_bytes = 0;
+		file->file_ptr_bytes = 0;
+		return err;
+	}
+	head = __atomic_load_n(&w->head, __ATOMIC_ACQUIRE);
+	tail = w->tail;
+	copy = w->size - (tail - head);
+	if (copy < bytes) {
+		/* drop the newest data, keeping the file in whole frames */
+		copy -= copy % snd_pcm_frames_to_bytes(pcm, 1);
+		w->overflows++;
+		w->lost += bytes - copy;
+	} else {
+		copy = bytes;
+	}
+	file->wbuf_used_bytes -= bytes;
+	while (bytes > 0) {
+		n = file->wbuf_size_bytes - file->file_ptr_bytes;
+		if (n > bytes)
+			n = bytes;
+		c = n < copy ? n : copy;
+		writer_put(w, &tail, file->wbuf + file->file_ptr_bytes, c);
+		copy -= c;
+		bytes -= n;
+		file->file_ptr_bytes += n;
+		if (file->file_ptr_bytes == file->wbuf_size_bytes)
+			file->file_ptr_bytes = 0;
+	}
+	__atomic_store_n(&w->tail, tail, __ATOMIC_SEQ_CST);
+	if (tail - head > w->max_fill)
+		w->max_fill = tail - head;
+	if (__atomic_exchange_n(&w->sleeping, 0, __ATOMIC_SEQ_CST) &&
+	    write(w->wake_fd[1], "", 1) < 0 && errno != EAGAIN)
+		SYSERR("writer wakeup failed");
+	return 0;
+}
+#endif /* HAVE_LIBPTHREAD */
 
 
 /* return error code in case write failed */
@@ -406,6 +1429,10 @@ static int snd_pcm_file_write_bytes(snd_pcm_t *pcm, size_t bytes)
 	snd_pcm_sframes_t err = 0;
 	assert(bytes <= file->wbuf_used_bytes);
 
+#ifdef HAVE_LIBPTHREAD
+	if (file->writer)
+		return snd_pcm_file_writer_queue(pcm, bytes);
+#endif
 	if (file->format == SND_PCM_FILE_FORMAT_WAV &&
 	    !file->wav_header.fmt) {
 		err = write_wav_header(pcm);
@@ -488,10 +1515,16 @@ static int snd_pcm_file_close(snd_pcm_t *pcm)
 			close(file->fd);
 		}
 	}
+	if (file->ifmap)
+		munmap(file->ifmap, file->ifmap_size);
 	if (file->ifname) {
 		free((void *)file->ifname);
 		close(file->ifd);
 	}
+#ifdef HAVE_LIBPTHREAD
+	flac_free(file->flac);
+#endif
+	free(file->segname);
 	return snd_pcm_generic_close(pcm);
 }
 
@@ -723,6 +1756,9 @@ static int snd_pcm_file_mmap_begin(snd_pcm_t *pcm, const snd_pcm_channel_area_t
 static int snd_pcm_file_hw_free(snd_pcm_t *pcm)
 {
 	snd_pcm_file_t *file = pcm->private_data;
+#ifdef HAVE_LIBPTHREAD
+	snd_pcm_file_writer_stop(pcm);
+#endif
 	free(file->wbuf);
 	free(file->wbuf_areas);
 	free(file->final_fname);
@@ -737,6 +1773,7 @@ static int snd_pcm_file_hw_free(snd_pcm_t *pcm)
 static int snd_pcm_file_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 {
 	snd_pcm_file_t *file = pcm->private_data;
+	size_t bytes, frame_bytes;
 	unsigned int channel;
 	snd_pcm_t *slave = file->gen.slave;
 	int err = _snd_pcm_hw_params_internal(slave, params);
@@ -774,13 +1811,39 @@ static int snd_pcm_file_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 		a->first = slave->sample_bits * channel;
 		a->step = slave->frame_bits;
 	}
-	if (file->fd < 0) {
+	if (file->segment_time > 0 || file->segment_size > 0) {
+		/* the segments are opened by the writer thread */
+		err = snd_pcm_file_replace_fname(file, &file->final_fname);
+		if (err < 0) {
+			snd_pcm_file_hw_free(pcm);
+			return err;
+		}
+		frame_bytes = snd_pcm_frames_to_bytes(slave, 1);
+		bytes = file->segment_size > 0 ? (size_t)file->segment_size : SIZE_MAX;
+		if (file->segment_time > 0 &&
+		    file->segment_time * slave->rate * frame_bytes < bytes)
+			bytes = file->segment_time * slave->rate * frame_bytes;
+		/* whole frames, at least one */
+		bytes -= bytes % frame_bytes;
+		file->segment_bytes = bytes ? bytes : frame_bytes;
+	} else if (file->fd < 0) {
 		err = snd_pcm_file_open_output_file(file);
 		if (err < 0) {
 			SYSERR("failed opening output file %s", file->fname);
 			return err;
 		}
 	}
+#ifdef HAVE_LIBPTHREAD
+	if (file->async > 0 || file->segment_bytes ||
+	    file->format == SND_PCM_FILE_FORMAT_FLAC) {
+		err = snd_pcm_file_writer_start(pcm);
+		if (err < 0) {
+			SNDERR("cannot start the file writer thread");
+			snd_pcm_file_hw_free(pcm);
+			return err;
+		}
+	}
+#endif
 
 	/* pointer may have changed - e.g if plug is used. */
 	snd_pcm_unlink_hw_ptr(pcm, file->gen.slave);
@@ -802,6 +1865,12 @@ static void snd_pcm_file_dump(snd_pcm_t *pcm, snd_output_t *out)
 	if (file->final_fname)
 		snd_output_printf(out, "Final file PCM (file=%s)\n",
 				file->final_fname);
+	if (file->writer)
+		snd_output_printf(out, "Writer thread: ring %zu bytes, max fill %zu, "
+				  "%lu overflows, %llu bytes dropped%s\n",
+				  file->writer->size, file->writer->max_fill,
+				  file->writer->overflows, file->writer->lost,
+				  file->writer->direct_buf ? ", O_DIRECT" : "");
 
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
@@ -899,6 +1968,10 @@ int snd_pcm_file_open(snd_pcm_t **pcmp, const char *name,
 		format = SND_PCM_FILE_FORMAT_RAW;
 	else if (!strcmp(fmt, "wav"))
 		format = SND_PCM_FILE_FORMAT_WAV;
+#ifdef HAVE_LIBPTHREAD
+	else if (!strcmp(fmt, "flac"))
+		format = SND_PCM_FILE_FORMAT_FLAC;
+#endif
 	else {
 		SNDERR("file format %s is unknown", fmt);
 		return -EINVAL;
@@ -927,12 +2000,16 @@ int snd_pcm_file_open(snd_pcm_t **pcmp, const char *name,
 	}
 	file->fd = fd;
 	file->ifd = ifd;
+	if (ifd >= 0 && stream == SND_PCM_STREAM_CAPTURE)
+		snd_pcm_file_infile_setup(file);
 	file->format = format;
 	file->gen.slave = slave;
 	file->gen.close_slave = close_slave;
 
 	err = snd_pcm_new(&pcm, SND_PCM_TYPE_FILE, name, slave->stream, slave->mode);
 	if (err < 0) {
+		if (file->ifmap)
+			munmap(file->ifmap, file->ifmap_size);
 		free(file->fname);
 		free(file->ifname);
 		free(file);
@@ -956,6 +2033,21 @@ int snd_pcm_file_open(snd_pcm_t **pcmp, const char *name,
 	return 0;
 }
 
+#ifndef DOC_HIDDEN
+/* the writer thread options are applied before hw_params */
+static void snd_pcm_file_set_writer(snd_pcm_t *pcm, double async, int direct, int fadvise,
+				    double segment_time, long segment_size)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+
+	file->async = async;
+	file->direct = direct;
+	file->fadvise = fadvise;
+	file->segment_time = segment_time;
+	file->segment_size = segment_size;
+}
+#endif
+
 /*! \page pcm_plugins
 
 \section pcm_plugins_file Plugin: File
@@ -984,17 +2076,58 @@ pcm.name {
 				# %b	bits per sample (replaced with: 16)
 				# %f	sample format string
 				#			(replaced with: S16_LE)
+				# %n	segment number (replaced with: 0001)
 				# %%	replaced with %
 	or
 	file INT		# Output file descriptor number
-	infile STR		# Input filename - only raw format
+	infile STR		# Input filename - raw or WAV format
 	or
 	infile INT		# Input file descriptor number
-	[format STR]		# File format ("raw" or "wav")
+	[format STR]		# File format ("raw", "wav" or "flac")
 	[perm INT]		# Output file permission (octal, def. 0600)
+	[async REAL]		# Write the file from a thread, buffering
+				# this many seconds (def. 0 = write from
+				# the stream calls)
+	[direct BOOL]		# Write with O_DIRECT from the thread
+	[fadvise BOOL]		# Drop the written data from the page cache
+	[segment_time REAL]	# Start a new file after this many seconds
+	[segment_size INT]	# Start a new file after this many bytes
+				# of sample data, before compression
 }
 \endcode
 
+The sample data of a WAV input file must match the stream format, only
+its header is skipped.  A regular input file is mapped to memory and
+the samples are copied from there, other input files are read with
+read().
+
+With \c async, the data is queued on a ring and written by a separate
+thread, so a slow disk or network file system does not block the
+stream.  When the ring is full, the newest data is dropped instead; the
+number of these overflows is shown by #snd_pcm_dump() and reported when
+the stream is freed.  A write error of the thread fails the next stream
+write with \c -EIO.  The \c direct and \c fadvise options apply only to
+\c async writes to regular files; \c direct is used when the file
+system and the file position allow it.
+
+The \c flac format compresses the stream losslessly on the writer
+thread, which is used for it even without \c async (with a one second
+ring).  It supports the S16_LE, S24_LE and S24_3LE formats with up to
+8 channels.
+
+With \c segment_time or \c segment_size, the output is split into
+files of complete headers and whole frames, also written by the
+thread.  Each segment is written as \c NAME.part and renamed to \c NAME
+once it is complete, so a file under its final name is never partial.
+\c NAME is the file name with \c %n replaced by the segment number, or
+with the number inserted before the extension (\c rec.0001.flac).
+Existing segments are replaced, unless \c truncate is false, then their
+numbers are skipped.  Without segments, \c %n is removed from the name.
+The \c segment_size limit counts the sample data of the stream, so
+\c flac segments are smaller by the compression ratio.  FLAC output to
+a pipe cannot update its header, so the frame sizes and the length are
+left as unknown there.
+
 \subsection pcm_plugins_file_funcref Function reference
 
 <UL>
@@ -1029,6 +2162,9 @@ int _snd_pcm_file_open(snd_pcm_t **pcmp, const char *name,
 	const char *format = NULL;
 	long fd = -1, ifd = -1, trunc = 1;
 	long perm = 0600;
+	double async = 0, segment_time = 0;
+	long segment_size = 0;
+	int direct = 0, fadvise = 0;
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
 		const char *id;
@@ -1089,6 +2225,50 @@ int _snd_pcm_file_open(snd_pcm_t **pcmp, const char *name,
 			trunc = err;
 			continue;
 		}
+		if (strcmp(id, "async") == 0) {
+			err = snd_config_get_ireal(n, &async);
+			if (err < 0 || async < 0) {
+				SNDERR("Invalid value for %s", id);
+				return -EINVAL;
+			}
+#ifndef HAVE_LIBPTHREAD
+			if (async > 0) {
+				SNDERR("async file writes need thread support");
+				return -ENXIO;
+			}
+#endif
+			continue;
+		}
+		if (strcmp(id, "segment_time") == 0) {
+			err = snd_config_get_ireal(n, &segment_time);
+			if (err < 0 || segment_time < 0) {
+				SNDERR("Invalid value for %s", id);
+				return -EINVAL;
+			}
+			continue;
+		}
+		if (strcmp(id, "segment_size") == 0) {
+			err = snd_config_get_integer(n, &segment_size);
+			if (err < 0 || segment_size < 0) {
+				SNDERR("Invalid value for %s", id);
+				return -EINVAL;
+			}
+			continue;
+		}
+		if (strcmp(id, "direct") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return -EINVAL;
+			direct = err;
+			continue;
+		}
+		if (strcmp(id, "fadvise") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return -EINVAL;
+			fadvise = err;
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -1115,15 +2295,32 @@ int _snd_pcm_file_open(snd_pcm_t **pcmp, const char *name,
 		SNDERR("file is not defined");
 		return -EINVAL;
 	}
+	if (segment_time > 0 || segment_size > 0) {
+#ifdef HAVE_LIBPTHREAD
+		if (!fname || fname[0] == '|') {
+			snd_config_delete(sconf);
+			SNDERR("segments need an output file name");
+			return -EINVAL;
+		}
+#else
+		snd_config_delete(sconf);
+		SNDERR("file segments need thread support");
+		return -ENXIO;
+#endif
+	}
 	err = snd_pcm_open_slave(&spcm, root, sconf, stream, mode, conf);
 	snd_config_delete(sconf);
 	if (err < 0)
 		return err;
 	err = snd_pcm_file_open(pcmp, name, fname, fd, ifname, ifd,
 				trunc, format, perm, spcm, 1, stream);
-	if (err < 0)
+	if (err < 0) {
 		snd_pcm_close(spcm);
-	return err;
+		return err;
+	}
+	snd_pcm_file_set_writer(*pcmp, async, direct, fadvise,
+				segment_time, segment_size);
+	return 0;
 }
 #ifndef DOC_HIDDEN
 SND_DLSYM_BUILD_VERSION(_snd_pcm_file_open, SND_PCM_DLSYM_VERSION);
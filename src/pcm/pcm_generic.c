@@ -28,8 +28,12 @@
 
 #include <sys/ioctl.h>
 #include <limits.h>
+#include <fcntl.h>
 #include "pcm_local.h"
 #include "pcm_generic.h"
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
 
 #ifndef DOC_HIDDEN
 
@@ -346,4 +350,91 @@ int snd_pcm_generic_may_wait_for_avail_min(snd_pcm_t *pcm, snd_pcm_uframes_t ava
 	return snd_pcm_may_wait_for_avail_min(generic->slave, snd_pcm_mmap_avail(generic->slave));
 }
 
+/*
+ * Readiness notification
+ *
+ * Plugins which know exactly when the application can transfer (e.g. the
+ * ones driven by their own thread) export a notifier as their single poll
+ * descriptor instead of emulating the wakeups on the slave descriptors.
+ * The notifier is level triggered: it stays readable until it's cleared.
+ */
+
+int snd_pcm_generic_notify_open(snd_pcm_generic_notify_t *notify)
+{
+	int fds[2];
+
+	notify->ready = 0;
+#ifdef HAVE_SYS_EVENTFD_H
+	notify->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (notify->fd >= 0) {
+		notify->wfd = notify->fd;
+		return 0;
+	}
+#endif
+	if (pipe(fds) < 0) {
+		SYSERR("cannot create the notification pipe");
+		return -errno;
+	}
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	fcntl(fds[1], F_SETFL, O_NONBLOCK);
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+	notify->fd = fds[0];
+	notify->wfd = fds[1];
+	return 0;
+}
+
+void snd_pcm_generic_notify_close(snd_pcm_generic_notify_t *notify)
+{
+	if (notify->wfd != notify->fd)
+		close(notify->wfd);
+	close(notify->fd);
+	notify->fd = notify->wfd = -1;
+}
+
+void snd_pcm_generic_notify_wake(snd_pcm_generic_notify_t *notify)
+{
+	uint64_t val = 1;
+
+	/* the eventfd counter and the pipe only need one pending event */
+	if (notify->wfd == notify->fd)
+		write(notify->wfd, &val, sizeof(val));
+	else
+		write(notify->wfd, &val, 1);
+}
+
+void snd_pcm_generic_notify_clear(snd_pcm_generic_notify_t *notify)
+{
+	char buf[64];
+
+	while (read(notify->fd, buf, sizeof(buf)) > 0 &&
+	       notify->wfd != notify->fd)
+		;
+}
+
+void snd_pcm_generic_notify_set(snd_pcm_generic_notify_t *notify, int ready)
+{
+	if (ready == notify->ready)
+		return;
+	if (ready)
+		snd_pcm_generic_notify_wake(notify);
+	else
+		snd_pcm_generic_notify_clear(notify);
+	notify->ready = ready;
+}
+
+/* the notifier is polled for POLLIN, report the stream direction instead */
+int snd_pcm_generic_notify_revents(snd_pcm_t *pcm, struct pollfd *pfds, unsigned int nfds, unsigned short *revents)
+{
+	unsigned short events;
+
+	if (nfds != 1)
+		return -EINVAL;
+	events = pfds->revents & (POLLERR | POLLNVAL);
+	if (pfds->revents & POLLIN)
+		events |= pcm->stream == SND_PCM_STREAM_PLAYBACK ? POLLOUT : POLLIN;
+	*revents = events;
+	return 0;
+}
+
 #endif /* DOC_HIDDEN */
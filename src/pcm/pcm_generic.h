@@ -24,6 +24,13 @@ typedef struct {
 	int close_slave;
 } snd_pcm_generic_t;	
 
+/* readiness notification, an eventfd (or a pipe) which is readable when set */
+typedef struct {
+	int fd;			/* polled for POLLIN */
+	int wfd;		/* written to set, the same as fd for eventfd */
+	int ready;
+} snd_pcm_generic_notify_t;
+
 /* make local functions really local */
 #define snd_pcm_generic_close \
 	snd1_pcm_generic_close
@@ -111,6 +118,18 @@ typedef struct {
 	snd1_pcm_generic_set_chmap
 #define snd_pcm_generic_may_wait_for_avail_min \
 	snd1_pcm_generic_may_wait_for_avail_min
+#define snd_pcm_generic_notify_open \
+	snd1_pcm_generic_notify_open
+#define snd_pcm_generic_notify_close \
+	snd1_pcm_generic_notify_close
+#define snd_pcm_generic_notify_wake \
+	snd1_pcm_generic_notify_wake
+#define snd_pcm_generic_notify_clear \
+	snd1_pcm_generic_notify_clear
+#define snd_pcm_generic_notify_set \
+	snd1_pcm_generic_notify_set
+#define snd_pcm_generic_notify_revents \
+	snd1_pcm_generic_notify_revents
 
 int snd_pcm_generic_close(snd_pcm_t *pcm);
 int snd_pcm_generic_nonblock(snd_pcm_t *pcm, int nonblock);
@@ -161,4 +180,9 @@ snd_pcm_chmap_query_t **snd_pcm_generic_query_chmaps(snd_pcm_t *pcm);
 snd_pcm_chmap_t *snd_pcm_generic_get_chmap(snd_pcm_t *pcm);
 int snd_pcm_generic_set_chmap(snd_pcm_t *pcm, const snd_pcm_chmap_t *map);
 int snd_pcm_generic_may_wait_for_avail_min(snd_pcm_t *pcm, snd_pcm_uframes_t avail);
-
+int snd_pcm_generic_notify_open(snd_pcm_generic_notify_t *notify);
+void snd_pcm_generic_notify_close(snd_pcm_generic_notify_t *notify);
+void snd_pcm_generic_notify_wake(snd_pcm_generic_notify_t *notify);
+void snd_pcm_generic_notify_clear(snd_pcm_generic_notify_t *notify);
+void snd_pcm_generic_notify_set(snd_pcm_generic_notify_t *notify, int ready);
+int snd_pcm_generic_notify_revents(snd_pcm_t *pcm, struct pollfd *pfds, unsigned int nfds, unsigned short *revents);
@@ -97,6 +97,15 @@ typedef struct {
 	bool mmap_status_fallbacked;
 	bool mmap_control_fallbacked;
 	struct snd_pcm_sync_ptr *sync_ptr;
+	/* SYNC_PTR coalescing, used only for the fallbacked records */
+	unsigned int sync_ptr_window;	/* us, 0 = sync on every query */
+	unsigned long long sync_ptr_last; /* ns of the last SYNC_PTR */
+	unsigned long long sync_ptr_since; /* ns of the counter reset */
+	unsigned long sync_ptr_calls;
+	unsigned long sync_ptr_skipped;
+	unsigned long appl_deferred;
+	int appl_pending;		/* appl_ptr not pushed to the kernel yet */
+	int linked;
 
 	int period_event;
 	snd_timer_t *period_timer;
@@ -132,18 +141,61 @@ struct timespec snd_pcm_hw_fast_tstamp(snd_pcm_t *pcm)
 }
 #endif /* DOC_HIDDEN */
 
+static unsigned long long sync_ptr_now(void)
+{
+	snd_htimestamp_t ts;
+
+	gettimestamp(&ts, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 static int sync_ptr1(snd_pcm_hw_t *hw, unsigned int flags)
 {
 	int err;
+	/* a deferred appl_ptr is pushed instead of being read back */
+	if (hw->appl_pending)
+		flags &= ~SNDRV_PCM_SYNC_PTR_APPL;
 	hw->sync_ptr->flags = flags;
 	if (ioctl(hw->fd, SNDRV_PCM_IOCTL_SYNC_PTR, hw->sync_ptr) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_SYNC_PTR failed (%i)", err);
 		return err;
 	}
+	hw->appl_pending = 0;
+	hw->sync_ptr_calls++;
+	if (hw->sync_ptr_window)
+		hw->sync_ptr_last = sync_ptr_now();
 	return 0;
 }
 
+/*
+ * The status read by a SYNC_PTR less than sync_ptr_window ago is used
+ * instead of a new one by the position and state queries.
+ */
+static int sync_ptr_cached(snd_pcm_hw_t *hw)
+{
+	if (!hw->sync_ptr_window)
+		return 0;
+	if (sync_ptr_now() - hw->sync_ptr_last >= hw->sync_ptr_window * 1000ULL)
+		return 0;
+	hw->sync_ptr_skipped++;
+	return 1;
+}
+
+/* the state changed, the next query must sync */
+static void sync_ptr_invalidate(snd_pcm_hw_t *hw)
+{
+	hw->sync_ptr_last = 0;
+}
+
+static void sync_ptr_reset_counters(snd_pcm_hw_t *hw)
+{
+	hw->sync_ptr_calls = 0;
+	hw->sync_ptr_skipped = 0;
+	hw->appl_deferred = 0;
+	hw->sync_ptr_since = sync_ptr_now();
+}
+
 static int issue_avail_min(snd_pcm_hw_t *hw)
 {
 	if (!hw->mmap_control_fallbacked)
@@ -162,10 +214,20 @@ static int issue_applptr(snd_pcm_hw_t *hw)
 	return sync_ptr1(hw, SNDRV_PCM_SYNC_PTR_AVAIL_MIN);
 }
 
+/* push a deferred appl_ptr before the kernel acts on it */
+static int flush_applptr(snd_pcm_hw_t *hw)
+{
+	if (!hw->appl_pending)
+		return 0;
+	return issue_applptr(hw);
+}
+
 static int request_hwsync(snd_pcm_hw_t *hw)
 {
 	if (!hw->mmap_status_fallbacked)
 		return 0;
+	if (sync_ptr_cached(hw))
+		return 0;
 
 	/*
 	 * Query both of control/status data to avoid unexpected change of
@@ -205,6 +267,13 @@ static int query_status_data(snd_pcm_hw_t *hw)
 			 SNDRV_PCM_SYNC_PTR_AVAIL_MIN);
 }
 
+static int query_status_data_cached(snd_pcm_hw_t *hw)
+{
+	if (!hw->mmap_status_fallbacked || sync_ptr_cached(hw))
+		return 0;
+	return query_status_data(hw);
+}
+
 static int snd_pcm_hw_clear_timer_queue(snd_pcm_hw_t *hw)
 {
 	if (hw->period_timer_need_poll) {
@@ -389,6 +458,8 @@ static int snd_pcm_hw_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 	params->info &= ~0xf0000000;
 	if (pcm->tstamp_type != SND_PCM_TSTAMP_TYPE_GETTIMEOFDAY)
 		params->info |= SND_PCM_INFO_MONOTONIC;
+	hw->appl_pending = 0;
+	sync_ptr_reset_counters(hw);
 	return query_status_data(hw);
 }
 
@@ -485,6 +556,7 @@ static int snd_pcm_hw_hw_free(snd_pcm_t *pcm)
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int fd = hw->fd, err;
 	snd_pcm_hw_change_timer(pcm, 0);
+	hw->appl_pending = 0;
 	if (ioctl(fd, SNDRV_PCM_IOCTL_HW_FREE) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_HW_FREE failed (%i)", err);
@@ -577,6 +649,9 @@ static int snd_pcm_hw_status(snd_pcm_t *pcm, snd_pcm_status_t * status)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int fd = hw->fd, err;
+	err = flush_applptr(hw);
+	if (err < 0)
+		return err;
 	if (SNDRV_PROTOCOL_VERSION(2, 0, 13) > hw->version) {
 		if (ioctl(fd, SNDRV_PCM_IOCTL_STATUS, status) < 0) {
 			err = -errno;
@@ -600,7 +675,7 @@ static int snd_pcm_hw_status(snd_pcm_t *pcm, snd_pcm_status_t * status)
 static snd_pcm_state_t snd_pcm_hw_state(snd_pcm_t *pcm)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
-	int err = query_status_data(hw);
+	int err = query_status_data_cached(hw);
 	if (err < 0)
 		return err;
 	return (snd_pcm_state_t) hw->mmap_status->state;
@@ -610,6 +685,9 @@ static int snd_pcm_hw_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int fd = hw->fd, err;
+	err = flush_applptr(hw);
+	if (err < 0)
+		return err;
 	if (ioctl(fd, SNDRV_PCM_IOCTL_DELAY, delayp) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_DELAY failed (%i)", err);
@@ -654,6 +732,7 @@ static int snd_pcm_hw_prepare(snd_pcm_t *pcm)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int fd = hw->fd, err;
+	hw->appl_pending = 0;
 	if (ioctl(fd, SNDRV_PCM_IOCTL_PREPARE) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_PREPARE failed (%i)", err);
@@ -666,6 +745,7 @@ static int snd_pcm_hw_reset(snd_pcm_t *pcm)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int fd = hw->fd, err;
+	hw->appl_pending = 0;
 	if (ioctl(fd, SNDRV_PCM_IOCTL_RESET) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_RESET failed (%i)", err);
@@ -692,6 +772,7 @@ static int snd_pcm_hw_start(snd_pcm_t *pcm)
 #endif
 		return err;
 	}
+	sync_ptr_invalidate(hw);
 	return 0;
 }
 
@@ -699,12 +780,13 @@ static int snd_pcm_hw_drop(snd_pcm_t *pcm)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int err;
+	hw->appl_pending = 0;
 	if (ioctl(hw->fd, SNDRV_PCM_IOCTL_DROP) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_DROP failed (%i)", err);
 		return err;
-	} else {
 	}
+	sync_ptr_invalidate(hw);
 	return 0;
 }
 
@@ -712,11 +794,15 @@ static int snd_pcm_hw_drain(snd_pcm_t *pcm)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int err;
+	err = flush_applptr(hw);
+	if (err < 0)
+		return err;
 	if (ioctl(hw->fd, SNDRV_PCM_IOCTL_DRAIN) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_DRAIN failed (%i)", err);
 		return err;
 	}
+	sync_ptr_invalidate(hw);
 	return 0;
 }
 
@@ -729,6 +815,7 @@ static int snd_pcm_hw_pause(snd_pcm_t *pcm, int enable)
 		SYSMSG("SNDRV_PCM_IOCTL_PAUSE failed (%i)", err);
 		return err;
 	}
+	sync_ptr_invalidate(hw);
 	return 0;
 }
 
@@ -741,6 +828,9 @@ static snd_pcm_sframes_t snd_pcm_hw_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t fra
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int err;
+	err = flush_applptr(hw);
+	if (err < 0)
+		return err;
 	if (ioctl(hw->fd, SNDRV_PCM_IOCTL_REWIND, &frames) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_REWIND failed (%i)", err);
@@ -762,6 +852,9 @@ static snd_pcm_sframes_t snd_pcm_hw_forward(snd_pcm_t *pcm, snd_pcm_uframes_t fr
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int err;
 	if (SNDRV_PROTOCOL_VERSION(2, 0, 4) <= hw->version) {
+		err = flush_applptr(hw);
+		if (err < 0)
+			return err;
 		if (ioctl(hw->fd, SNDRV_PCM_IOCTL_FORWARD, &frames) < 0) {
 			err = -errno;
 			SYSMSG("SNDRV_PCM_IOCTL_FORWARD failed (%i)", err);
@@ -804,6 +897,7 @@ static int snd_pcm_hw_resume(snd_pcm_t *pcm)
 		SYSMSG("SNDRV_PCM_IOCTL_RESUME failed (%i)", err);
 		return err;
 	}
+	sync_ptr_invalidate(hw);
 	return 0;
 }
 
@@ -811,10 +905,21 @@ static int hw_link(snd_pcm_t *pcm1, snd_pcm_t *pcm2)
 {
 	snd_pcm_hw_t *hw1 = pcm1->private_data;
 	snd_pcm_hw_t *hw2 = pcm2->private_data;
+	int err;
+
+	/* a linked stream may be started without a flush of its appl_ptr */
+	err = flush_applptr(hw1);
+	if (err < 0)
+		return err;
+	err = flush_applptr(hw2);
+	if (err < 0)
+		return err;
 	if (ioctl(hw1->fd, SNDRV_PCM_IOCTL_LINK, hw2->fd) < 0) {
 		SYSMSG("SNDRV_PCM_IOCTL_LINK failed (%i)", -errno);
 		return -errno;
 	}
+	hw1->linked = 1;
+	hw2->linked = 1;
 	return 0;
 }
 
@@ -845,6 +950,7 @@ static int snd_pcm_hw_unlink(snd_pcm_t *pcm)
 		SYSMSG("SNDRV_PCM_IOCTL_UNLINK failed (%i)", -errno);
 		return -errno;
 	}
+	hw->linked = 0;
 	return 0;
 }
 
@@ -857,6 +963,9 @@ static snd_pcm_sframes_t snd_pcm_hw_writei(snd_pcm_t *pcm, const void *buffer, s
 	xferi.buf = (char*) buffer;
 	xferi.frames = size;
 	xferi.result = 0; /* make valgrind happy */
+	err = flush_applptr(hw);
+	if (err < 0)
+		return err;
 	if (ioctl(fd, SNDRV_PCM_IOCTL_WRITEI_FRAMES, &xferi) < 0)
 		err = -errno;
 	else
@@ -878,6 +987,9 @@ static snd_pcm_sframes_t snd_pcm_hw_writen(snd_pcm_t *pcm, void **bufs, snd_pcm_
 	memset(&xfern, 0, sizeof(xfern)); /* make valgrind happy */
 	xfern.bufs = bufs;
 	xfern.frames = size;
+	err = flush_applptr(hw);
+	if (err < 0)
+		return err;
 	if (ioctl(fd, SNDRV_PCM_IOCTL_WRITEN_FRAMES, &xfern) < 0)
 		err = -errno;
 	else
@@ -1002,7 +1114,14 @@ static int map_status_and_control_data(snd_pcm_t *pcm, bool force_fallback)
 
 	/* Any fallback mode needs to keep the buffer. */
 	if (hw->mmap_status_fallbacked || hw->mmap_control_fallbacked) {
+		if (!force_fallback)
+			SNDMSG("cannot mmap the PCM %s%s%s, using SYNC_PTR",
+			       hw->mmap_status_fallbacked ? "status" : "",
+			       hw->mmap_status_fallbacked &&
+			       hw->mmap_control_fallbacked ? " and " : "",
+			       hw->mmap_control_fallbacked ? "control" : "");
 		hw->sync_ptr = sync_ptr;
+		sync_ptr_reset_counters(hw);
 	} else {
 		free(sync_ptr);
 		hw->sync_ptr = NULL;
@@ -1102,7 +1221,19 @@ static snd_pcm_sframes_t snd_pcm_hw_mmap_commit(snd_pcm_t *pcm,
 	snd_pcm_hw_t *hw = pcm->private_data;
 
 	snd_pcm_mmap_appl_forward(pcm, size);
-	issue_applptr(hw);
+	/*
+	 * Until a playback stream is started the kernel does not use
+	 * appl_ptr, so a prefill is pushed with the next SYNC_PTR or at
+	 * the latest by start. A running stream needs it immediately,
+	 * the application may poll right after the commit.
+	 */
+	if (hw->sync_ptr_window && hw->mmap_control_fallbacked &&
+	    pcm->stream == SND_PCM_STREAM_PLAYBACK && !hw->linked &&
+	    FAST_PCM_STATE(hw) == SND_PCM_STATE_PREPARED) {
+		hw->appl_pending = 1;
+		hw->appl_deferred++;
+	} else
+		issue_applptr(hw);
 #ifdef DEBUG_MMAP
 	fprintf(stderr, "appl_forward: hw_ptr = %li, appl_ptr = %li, size = %li\n", *pcm->hw.ptr, *pcm->appl.ptr, size);
 #endif
@@ -1114,7 +1245,7 @@ static snd_pcm_sframes_t snd_pcm_hw_avail_update(snd_pcm_t *pcm)
 	snd_pcm_hw_t *hw = pcm->private_data;
 	snd_pcm_uframes_t avail;
 
-	query_status_data(hw);
+	query_status_data_cached(hw);
 	avail = snd_pcm_mmap_avail(pcm);
 	switch (FAST_PCM_STATE(hw)) {
 	case SNDRV_PCM_STATE_RUNNING:
@@ -1156,6 +1287,75 @@ static int snd_pcm_hw_htimestamp(snd_pcm_t *pcm, snd_pcm_uframes_t *avail,
 	return 0;
 }
 
+static inline int snd_pcm_hw_tstamp_equal(const snd_htimestamp_t *a,
+					   snd_htimestamp_t b)
+{
+	return a->tv_sec == b.tv_sec && a->tv_nsec == b.tv_nsec;
+}
+
+/*
+ * Fill the status from the mmapped status and control records without
+ * any ioctl, -ENOSYS if they are not mapped. Called with the PCM locked.
+ */
+int snd_pcm_hw_fast_status(snd_pcm_t *pcm, snd_pcm_batch_status_t *status)
+{
+	snd_pcm_hw_t *hw = pcm->private_data;
+	snd_pcm_uframes_t hw_ptr, appl_ptr;
+	snd_pcm_sframes_t avail;
+
+	if (pcm->type != SND_PCM_TYPE_HW ||
+	    hw->mmap_status_fallbacked || hw->mmap_control_fallbacked)
+		return -ENOSYS;
+	/*
+	 * The kernel updates the record at any time and it has no sequence
+	 * counter, so read it until the state, the position and the time
+	 * stamps are the same twice in a row.
+	 */
+	status->audio_tstamp.tv_sec = 0;
+	status->audio_tstamp.tv_nsec = 0;
+	for (;;) {
+		hw_ptr = hw->mmap_status->hw_ptr;
+		status->state = FAST_PCM_STATE(hw);
+		status->tstamp = snd_pcm_hw_fast_tstamp(pcm);
+		if (SNDRV_PROTOCOL_VERSION(2, 0, 12) <= hw->version) {
+			status->audio_tstamp.tv_sec = hw->mmap_status->audio_tstamp.tv_sec;
+			status->audio_tstamp.tv_nsec = hw->mmap_status->audio_tstamp.tv_nsec;
+		}
+		if (hw_ptr != hw->mmap_status->hw_ptr ||
+		    status->state != FAST_PCM_STATE(hw) ||
+		    !snd_pcm_hw_tstamp_equal(&status->tstamp, snd_pcm_hw_fast_tstamp(pcm)))
+			continue;
+		if (SNDRV_PROTOCOL_VERSION(2, 0, 12) > hw->version ||
+		    (status->audio_tstamp.tv_sec == hw->mmap_status->audio_tstamp.tv_sec &&
+		     status->audio_tstamp.tv_nsec == hw->mmap_status->audio_tstamp.tv_nsec))
+			break;
+	}
+	appl_ptr = hw->mmap_control->appl_ptr;
+	avail = __snd_pcm_avail(pcm, hw_ptr, appl_ptr);
+	switch (status->state) {
+	case SND_PCM_STATE_RUNNING:
+		if ((snd_pcm_uframes_t)avail >= pcm->stop_threshold) {
+			/* let avail_update stop the stream and report it */
+			avail = snd_pcm_hw_avail_update(pcm);
+			if (avail < 0)
+				return avail;
+		}
+		break;
+	case SND_PCM_STATE_XRUN:
+		return -EPIPE;
+	default:
+		break;
+	}
+	status->hw_ptr = hw_ptr;
+	status->appl_ptr = appl_ptr;
+	status->avail = avail;
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		status->delay = pcm->buffer_size - avail;
+	else
+		status->delay = avail;
+	return 0;
+}
+
 static void __fill_chmap_ctl_id(snd_ctl_elem_id_t *id, int dev, int subdev,
 				int stream)
 {
@@ -1432,6 +1632,19 @@ static void snd_pcm_hw_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "  appl_ptr     : %li\n", hw->mmap_control->appl_ptr);
 		snd_output_printf(out, "  hw_ptr       : %li\n", hw->mmap_status->hw_ptr);
 	}
+	if (hw->mmap_status_fallbacked || hw->mmap_control_fallbacked) {
+		double secs = (sync_ptr_now() - hw->sync_ptr_since) / 1e9;
+
+		snd_output_printf(out, "  status       : %s\n",
+				  hw->mmap_status_fallbacked ? "SYNC_PTR" : "mmap");
+		snd_output_printf(out, "  control      : %s\n",
+				  hw->mmap_control_fallbacked ? "SYNC_PTR" : "mmap");
+		snd_output_printf(out, "  sync_ptr     : %lu calls (%.1f/s), %lu skipped, %lu appl deferred, window %u us\n",
+				  hw->sync_ptr_calls,
+				  secs > 0 ? hw->sync_ptr_calls / secs : 0.0,
+				  hw->sync_ptr_skipped, hw->appl_deferred,
+				  hw->sync_ptr_window);
+	}
 }
 
 static const snd_pcm_ops_t snd_pcm_hw_ops = {
@@ -1758,6 +1971,7 @@ pcm.name {
 	[device INT]		# Device number (default 0)
 	[subdevice INT]		# Subdevice number (default -1: first available)
 	[sync_ptr_ioctl BOOL]	# Use SYNC_PTR ioctl rather than the direct mmap access for control structures
+	[sync_ptr_window INT]	# Reuse a SYNC_PTR result for this many us (default 0)
 	[nonblock BOOL]		# Force non-blocking open mode
 	[format STR]		# Restrict only to the given format
 	[channels INT]		# Restrict only to the given channels
@@ -1766,6 +1980,15 @@ pcm.name {
 }
 \endcode
 
+When the status and control records cannot be mmapped (for example with
+some 32-bit compat layers or emulators), or sync_ptr_ioctl is set, every
+position update costs a SYNC_PTR ioctl. The sync_ptr_window option
+(default defaults.pcm.sync_ptr_window) lets the position and state
+queries reuse the result of a SYNC_PTR issued less than the given time
+ago, and defers the appl_ptr updates of a playback stream that is not
+started yet to the next SYNC_PTR or to the start. The number of SYNC_PTR
+calls per second and the skipped ones are shown by snd_pcm_dump().
+
 \subsection pcm_plugins_hw_funcref Function reference
 
 <UL>
@@ -1795,6 +2018,7 @@ int _snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 	long card = -1, device = 0, subdevice = -1;
 	const char *str;
 	int err, sync_ptr_ioctl = 0;
+	long sync_ptr_window = 0;
 	int rate = 0, channels = 0;
 	snd_pcm_format_t format = SND_PCM_FORMAT_UNKNOWN;
 	snd_config_t *n;
@@ -1808,6 +2032,9 @@ int _snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 		if (err >= 0)
 			nonblock = err;
 	}
+	/* look for defaults.pcm.sync_ptr_window definition */
+	if (snd_config_search(root, "defaults.pcm.sync_ptr_window", &n) >= 0)
+		snd_config_get_integer(n, &sync_ptr_window);
 	snd_config_for_each(i, next, conf) {
 		const char *id;
 		n = snd_config_iterator_entry(i);
@@ -1856,6 +2083,14 @@ int _snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 			sync_ptr_ioctl = err;
 			continue;
 		}
+		if (strcmp(id, "sync_ptr_window") == 0) {
+			err = snd_config_get_integer(n, &sync_ptr_window);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				goto fail;
+			}
+			continue;
+		}
 		if (strcmp(id, "nonblock") == 0) {
 			err = snd_config_get_bool(n);
 			if (err < 0)
@@ -1929,6 +2164,8 @@ int _snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 					 SND_PCM_NO_SOFTVOL);
 
 	hw = (*pcmp)->private_data;
+	if (sync_ptr_window > 0)
+		hw->sync_ptr_window = sync_ptr_window;
 	if (format != SND_PCM_FORMAT_UNKNOWN)
 		hw->format = format;
 	if (channels > 0)
@@ -280,6 +280,8 @@ struct _snd_pcm {
 	snd1_pcm_open_named_slave
 #define snd_pcm_hw_open_fd \
 	snd1_pcm_hw_open_fd
+#define snd_pcm_hw_fast_status \
+	snd1_pcm_hw_fast_status
 #define snd_pcm_wait_nocheck \
 	snd1_pcm_wait_nocheck
 #define snd_pcm_rate_get_default_converter \
@@ -975,10 +977,21 @@ snd_pcm_open_slave(snd_pcm_t **pcmp, snd_config_t *root,
 					mode, parent_conf);
 }
 
-#define snd_pcm_conf_generic_id(id) _snd_conf_generic_id(id)
+/*
+ * The open mode for a slave which is also used by other clients or by a
+ * thread of the plugin, so it must keep its lock.
+ */
+static inline int snd_pcm_shared_slave_mode(int mode)
+{
+	return mode & ~SND_PCM_SINGLE_THREAD;
+}
+
+#define snd_pcm_conf_generic_id(id) \
+	(_snd_conf_generic_id(id) || strcmp(id, "single_thread") == 0)
 
 int snd_pcm_hw_open_fd(snd_pcm_t **pcmp, const char *name, int fd,
 		       int sync_ptr_ioctl);
+int snd_pcm_hw_fast_status(snd_pcm_t *pcm, snd_pcm_batch_status_t *status);
 int __snd_pcm_mmap_emul_open(snd_pcm_t **pcmp, const char *name,
 			     snd_pcm_t *slave, int close_slave);
 
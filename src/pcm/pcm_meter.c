@@ -798,7 +798,8 @@ int _snd_pcm_meter_open(snd_pcm_t **pcmp, const char *name,
 	err = snd_pcm_slave_conf(root, slave, &sconf, 0);
 	if (err < 0)
 		return err;
-	err = snd_pcm_open_slave(&spcm, root, sconf, stream, mode, conf);
+	err = snd_pcm_open_slave(&spcm, root, sconf, stream,
+				 snd_pcm_shared_slave_mode(mode), conf);
 	snd_config_delete(sconf);
 	if (err < 0)
 		return err;
@@ -33,6 +33,9 @@
 #include <math.h>
 #include "pcm_local.h"
 #include "pcm_generic.h"
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #ifndef PIC
 /* entry for static linking */
@@ -46,6 +49,8 @@ typedef struct {
 	unsigned int channels_count;
 	int close_slave;
 	snd_pcm_t *linked;
+	snd_pcm_uframes_t frames;	/* job argument */
+	snd_pcm_sframes_t result;	/* job result */
 } snd_pcm_multi_slave_t;
 
 typedef struct {
@@ -53,22 +58,264 @@ typedef struct {
 	unsigned int slave_channel;
 } snd_pcm_multi_channel_t;
 
+/* the operations the workers run on each slave */
+typedef enum {
+	MULTI_JOB_COMMIT,
+	MULTI_JOB_REWIND,
+	MULTI_JOB_FORWARD,
+	MULTI_JOB_AVAIL,
+	MULTI_JOB_HWSYNC,
+} snd_pcm_multi_job_t;
+
+typedef struct _snd_pcm_multi snd_pcm_multi_t;
+
 typedef struct {
+#ifdef HAVE_LIBPTHREAD
+	pthread_t thread;
+#endif
+	snd_pcm_multi_t *multi;
+	unsigned int idx;		/* first slave, the caller is 0 */
+} snd_pcm_multi_worker_t;
+
+struct _snd_pcm_multi {
 	snd_pcm_uframes_t appl_ptr, hw_ptr;
 	unsigned int slaves_count;
 	unsigned int master_slave;
 	snd_pcm_multi_slave_t *slaves;
 	unsigned int channels_count;
 	snd_pcm_multi_channel_t *channels;
-} snd_pcm_multi_t;
+	/*
+	 * With the threads option, the slave operations are shared between
+	 * the caller and threads - 1 persistent workers: the slave i is
+	 * handled by the thread i % threads.  The caller publishes a job
+	 * with a new generation and waits until every worker has run it.
+	 */
+	unsigned int threads;
+	snd_pcm_multi_worker_t *workers;
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_t mutex;
+	pthread_cond_t start_cond;
+	pthread_cond_t done_cond;
+#endif
+	unsigned int generation;
+	unsigned int pending;		/* workers still running the job */
+	int quit;
+	snd_pcm_multi_job_t job;
+	snd_pcm_uframes_t job_offset;
+	snd_pcm_sframes_t job_error;	/* first error, stops the others */
+};
 
 #endif
 
+static void snd_pcm_multi_run_slaves(snd_pcm_multi_t *multi, unsigned int idx)
+{
+	snd_pcm_sframes_t ok;
+	unsigned int i;
+
+	for (i = idx; i < multi->slaves_count; i += multi->threads) {
+		snd_pcm_multi_slave_t *slave = &multi->slaves[i];
+		if (__atomic_load_n(&multi->job_error, __ATOMIC_RELAXED) < 0)
+			break;
+		switch (multi->job) {
+		case MULTI_JOB_COMMIT:
+			slave->result = snd_pcm_mmap_commit(slave->pcm, multi->job_offset,
+							    slave->frames);
+			break;
+		case MULTI_JOB_REWIND:
+			slave->result = slave->frames ?
+				snd_pcm_rewind(slave->pcm, slave->frames) : 0;
+			break;
+		case MULTI_JOB_FORWARD:
+			slave->result = slave->frames ?
+				INTERNAL(snd_pcm_forward)(slave->pcm, slave->frames) : 0;
+			break;
+		case MULTI_JOB_AVAIL:
+			slave->result = snd_pcm_avail_update(slave->pcm);
+			break;
+		case MULTI_JOB_HWSYNC:
+			slave->result = snd_pcm_hwsync(slave->pcm);
+			break;
+		}
+		if (slave->result < 0) {
+			ok = 0;
+			__atomic_compare_exchange_n(&multi->job_error, &ok,
+						    slave->result, 0,
+						    __ATOMIC_RELAXED,
+						    __ATOMIC_RELAXED);
+			break;
+		}
+	}
+}
+
+#ifdef HAVE_LIBPTHREAD
+static void *snd_pcm_multi_worker(void *arg)
+{
+	snd_pcm_multi_worker_t *w = arg;
+	snd_pcm_multi_t *multi = w->multi;
+	unsigned int generation = 0;
+
+	pthread_mutex_lock(&multi->mutex);
+	for (;;) {
+		while (multi->generation == generation && !multi->quit)
+			pthread_cond_wait(&multi->start_cond, &multi->mutex);
+		if (multi->quit)
+			break;
+		generation = multi->generation;
+		pthread_mutex_unlock(&multi->mutex);
+		snd_pcm_multi_run_slaves(multi, w->idx);
+		pthread_mutex_lock(&multi->mutex);
+		if (--multi->pending == 0)
+			pthread_cond_signal(&multi->done_cond);
+	}
+	pthread_mutex_unlock(&multi->mutex);
+	return NULL;
+}
+#endif
+
+/*
+ * run the job on every slave, the results are in slaves[].result;
+ * returns the first error, the slaves not run yet are skipped then
+ */
+static snd_pcm_sframes_t snd_pcm_multi_run(snd_pcm_multi_t *multi,
+					   snd_pcm_multi_job_t job)
+{
+	multi->job = job;
+	multi->job_error = 0;
+#ifdef HAVE_LIBPTHREAD
+	if (multi->workers) {
+		pthread_mutex_lock(&multi->mutex);
+		multi->generation++;
+		multi->pending = multi->threads - 1;
+		pthread_cond_broadcast(&multi->start_cond);
+		pthread_mutex_unlock(&multi->mutex);
+		snd_pcm_multi_run_slaves(multi, 0);
+		pthread_mutex_lock(&multi->mutex);
+		while (multi->pending)
+			pthread_cond_wait(&multi->done_cond, &multi->mutex);
+		pthread_mutex_unlock(&multi->mutex);
+		return multi->job_error;
+	}
+#endif
+	snd_pcm_multi_run_slaves(multi, 0);
+	return multi->job_error;
+}
+
+static void snd_pcm_multi_stop_workers(snd_pcm_multi_t *multi)
+{
+#ifdef HAVE_LIBPTHREAD
+	unsigned int i;
+
+	if (!multi->workers)
+		return;
+	pthread_mutex_lock(&multi->mutex);
+	multi->quit = 1;
+	pthread_cond_broadcast(&multi->start_cond);
+	pthread_mutex_unlock(&multi->mutex);
+	for (i = 1; i < multi->threads; i++) {
+		if (multi->workers[i].multi)
+			pthread_join(multi->workers[i].thread, NULL);
+	}
+	pthread_cond_destroy(&multi->done_cond);
+	pthread_cond_destroy(&multi->start_cond);
+	pthread_mutex_destroy(&multi->mutex);
+	free(multi->workers);
+	multi->workers = NULL;
+#endif
+	multi->threads = 1;
+}
+
+static int snd_pcm_multi_start_workers(snd_pcm_multi_t *multi, unsigned int threads)
+{
+#ifdef HAVE_LIBPTHREAD
+	unsigned int i;
+	int err;
+#endif
+
+	multi->threads = 1;
+	if (threads > multi->slaves_count)
+		threads = multi->slaves_count;
+	if (threads <= 1)
+		return 0;
+#ifdef HAVE_LIBPTHREAD
+	multi->workers = calloc(threads, sizeof(*multi->workers));
+	if (!multi->workers)
+		return -ENOMEM;
+	pthread_mutex_init(&multi->mutex, NULL);
+	pthread_cond_init(&multi->start_cond, NULL);
+	pthread_cond_init(&multi->done_cond, NULL);
+	multi->threads = threads;
+	for (i = 1; i < threads; i++) {
+		multi->workers[i].idx = i;
+		multi->workers[i].multi = multi;
+		err = pthread_create(&multi->workers[i].thread, NULL,
+				     snd_pcm_multi_worker, &multi->workers[i]);
+		if (err) {
+			multi->workers[i].multi = NULL;
+			snd_pcm_multi_stop_workers(multi);
+			return -err;
+		}
+	}
+	return 0;
+#else
+	SNDERR("multi: threads need pthread support, running serially");
+	return 0;
+#endif
+}
+
+/*
+ * rewind or forward every slave in parallel, then move back the slaves
+ * which went further than the others
+ */
+static snd_pcm_sframes_t snd_pcm_multi_move_parallel(snd_pcm_t *pcm,
+						     snd_pcm_multi_job_t job,
+						     snd_pcm_multi_job_t undo,
+						     snd_pcm_uframes_t frames)
+{
+	snd_pcm_multi_t *multi = pcm->private_data;
+	snd_pcm_uframes_t moved = frames;
+	snd_pcm_sframes_t err;
+	unsigned int i;
+	int realign = 0;
+
+	for (i = 0; i < multi->slaves_count; ++i)
+		multi->slaves[i].frames = frames;
+	err = snd_pcm_multi_run(multi, job);
+	if (err < 0)
+		return err;
+	for (i = 0; i < multi->slaves_count; ++i) {
+		snd_pcm_sframes_t f = multi->slaves[i].result;
+		if ((snd_pcm_uframes_t)f < moved)
+			moved = f;
+	}
+	for (i = 0; i < multi->slaves_count; ++i) {
+		snd_pcm_multi_slave_t *slave = &multi->slaves[i];
+		slave->frames = slave->result - moved;
+		if (slave->frames)
+			realign = 1;
+	}
+	if (realign) {
+		err = snd_pcm_multi_run(multi, undo);
+		if (err < 0)
+			return err;
+		for (i = 0; i < multi->slaves_count; ++i) {
+			snd_pcm_multi_slave_t *slave = &multi->slaves[i];
+			if ((snd_pcm_uframes_t)slave->result != slave->frames)
+				return -EIO;
+		}
+	}
+	if (job == MULTI_JOB_REWIND)
+		snd_pcm_mmap_appl_backward(pcm, moved);
+	else
+		snd_pcm_mmap_appl_forward(pcm, moved);
+	return moved;
+}
+
 static int snd_pcm_multi_close(snd_pcm_t *pcm)
 {
 	snd_pcm_multi_t *multi = pcm->private_data;
 	unsigned int i;
 	int ret = 0;
+	snd_pcm_multi_stop_workers(multi);
 	for (i = 0; i < multi->slaves_count; ++i) {
 		snd_pcm_multi_slave_t *slave = &multi->slaves[i];
 		if (slave->close_slave) {
@@ -435,13 +682,11 @@ static void snd_pcm_multi_hwptr_update(snd_pcm_t *pcm)
 static int snd_pcm_multi_hwsync(snd_pcm_t *pcm)
 {
 	snd_pcm_multi_t *multi = pcm->private_data;
-	unsigned int i;
 	int err;
-	for (i = 0; i < multi->slaves_count; ++i) {
-		err = snd_pcm_hwsync(multi->slaves[i].pcm);
-		if (err < 0)
-			return err;
-	}
+	/* runs serially in the caller without workers */
+	err = snd_pcm_multi_run(multi, MULTI_JOB_HWSYNC);
+	if (err < 0)
+		return err;
 	snd_pcm_multi_hwptr_update(pcm);
 	return 0;
 }
@@ -466,11 +711,19 @@ static int snd_pcm_multi_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
 static snd_pcm_sframes_t snd_pcm_multi_avail_update(snd_pcm_t *pcm)
 {
 	snd_pcm_multi_t *multi = pcm->private_data;
-	snd_pcm_sframes_t ret = LONG_MAX;
+	snd_pcm_sframes_t ret = LONG_MAX, err;
 	unsigned int i;
+	if (multi->workers) {
+		err = snd_pcm_multi_run(multi, MULTI_JOB_AVAIL);
+		if (err < 0)
+			return err;
+	}
 	for (i = 0; i < multi->slaves_count; ++i) {
 		snd_pcm_sframes_t avail;
-		avail = snd_pcm_avail_update(multi->slaves[i].pcm);
+		if (multi->workers)
+			avail = multi->slaves[i].result;
+		else
+			avail = snd_pcm_avail_update(multi->slaves[i].pcm);
 		if (avail < 0)
 			return avail;
 		if (ret > avail)
@@ -647,6 +900,9 @@ static snd_pcm_sframes_t snd_pcm_multi_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t
 	snd_pcm_multi_t *multi = pcm->private_data;
 	unsigned int i;
 	snd_pcm_uframes_t pos[multi->slaves_count];
+	if (multi->workers)
+		return snd_pcm_multi_move_parallel(pcm, MULTI_JOB_REWIND,
+						   MULTI_JOB_FORWARD, frames);
 	memset(pos, 0, sizeof(pos));
 	for (i = 0; i < multi->slaves_count; ++i) {
 		snd_pcm_t *slave_i = multi->slaves[i].pcm;
@@ -669,6 +925,7 @@ static snd_pcm_sframes_t snd_pcm_multi_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t
 				return -EIO;
 		}
 	}
+	snd_pcm_mmap_appl_backward(pcm, frames);
 	return frames;
 }
 
@@ -677,6 +934,9 @@ static snd_pcm_sframes_t snd_pcm_multi_forward(snd_pcm_t *pcm, snd_pcm_uframes_t
 	snd_pcm_multi_t *multi = pcm->private_data;
 	unsigned int i;
 	snd_pcm_uframes_t pos[multi->slaves_count];
+	if (multi->workers)
+		return snd_pcm_multi_move_parallel(pcm, MULTI_JOB_FORWARD,
+						   MULTI_JOB_REWIND, frames);
 	memset(pos, 0, sizeof(pos));
 	for (i = 0; i < multi->slaves_count; ++i) {
 		snd_pcm_t *slave_i = multi->slaves[i].pcm;
@@ -699,6 +959,7 @@ static snd_pcm_sframes_t snd_pcm_multi_forward(snd_pcm_t *pcm, snd_pcm_uframes_t
 				return -EIO;
 		}
 	}
+	snd_pcm_mmap_appl_forward(pcm, frames);
 	return frames;
 }
 
@@ -774,9 +1035,20 @@ static snd_pcm_sframes_t snd_pcm_multi_mmap_commit(snd_pcm_t *pcm,
 	unsigned int i;
 	snd_pcm_sframes_t result;
 
+	if (multi->workers) {
+		multi->job_offset = offset;
+		for (i = 0; i < multi->slaves_count; ++i)
+			multi->slaves[i].frames = size;
+		result = snd_pcm_multi_run(multi, MULTI_JOB_COMMIT);
+		if (result < 0)
+			return result;
+	}
 	for (i = 0; i < multi->slaves_count; ++i) {
 		slave = multi->slaves[i].pcm;
-		result = snd_pcm_mmap_commit(slave, offset, size);
+		if (multi->workers)
+			result = multi->slaves[i].result;
+		else
+			result = snd_pcm_mmap_commit(slave, offset, size);
 		if (result < 0)
 			return result;
 		if ((snd_pcm_uframes_t)result != size)
@@ -984,6 +1256,8 @@ static void snd_pcm_multi_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "    %d: slave %d, channel %d\n", 
 			k, c->slave_idx, c->slave_channel);
 	}
+	if (multi->workers)
+		snd_output_printf(out, "  Threads: %u\n", multi->threads);
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -1117,6 +1391,7 @@ int snd_pcm_multi_open(snd_pcm_t **pcmp, const char *name,
 			continue;
 	}
 	multi->channels_count = channels_count;
+	multi->threads = 1;
 
 	err = snd_pcm_new(&pcm, SND_PCM_TYPE_MULTI, name, stream,
 			  multi->slaves[0].pcm->mode);
@@ -1166,9 +1441,18 @@ pcm.name {
 		}
 	}
 	[master INT]		# Define the master slave
+	[threads INT]		# Threads running the slave operations
 }
 \endcode
 
+With many slaves, e.g. several multi-channel cards aggregated to one
+device, the slaves can be driven in parallel: when \c threads is greater
+than one, the commits, rewinds, forwards and avail updates of the slaves
+are shared between the calling thread and <code>threads - 1</code>
+persistent worker threads, and the call returns when all of them are
+done.  The default 0 runs them one after the other in the calling thread,
+which is cheaper for a few slaves.
+
 For example, to bind two PCM streams with two-channel stereo (hw:0,0 and
 hw:0,1) as one 4-channel stereo PCM stream, define like this:
 \code
@@ -1245,6 +1529,7 @@ int _snd_pcm_multi_open(snd_pcm_t **pcmp, const char *name,
 	unsigned int *channels_schannel = NULL;
 	unsigned int slaves_count = 0;
 	long master_slave = 0;
+	long threads = 0;
 	unsigned int channels_count = 0;
 	snd_config_for_each(i, inext, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
@@ -1276,6 +1561,14 @@ int _snd_pcm_multi_open(snd_pcm_t **pcmp, const char *name,
 			}
 			continue;
 		}
+		if (strcmp(id, "threads") == 0) {
+			if (snd_config_get_integer(n, &threads) < 0 ||
+			    threads < 0) {
+				SNDERR("Invalid value for %s", id);
+				return -EINVAL;
+			}
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -1413,8 +1706,8 @@ int _snd_pcm_multi_open(snd_pcm_t **pcmp, const char *name,
 	
 	for (idx = 0; idx < slaves_count; ++idx) {
 		err = snd_pcm_open_slave(&slaves_pcm[idx], root,
-					 slaves_conf[idx], stream, mode,
-					 conf);
+					 slaves_conf[idx], stream,
+					 snd_pcm_shared_slave_mode(mode), conf);
 		if (err < 0)
 			goto _free;
 		snd_config_delete(slaves_conf[idx]);
@@ -1425,6 +1718,14 @@ int _snd_pcm_multi_open(snd_pcm_t **pcmp, const char *name,
 				 channels_count,
 				 channels_sidx, channels_schannel,
 				 1);
+	if (err >= 0) {
+		err = snd_pcm_multi_start_workers((*pcmp)->private_data, threads);
+		if (err < 0) {
+			/* the slaves are closed with the multi PCM */
+			snd_pcm_close(*pcmp);
+			memset(slaves_pcm, 0, slaves_count * sizeof(*slaves_pcm));
+		}
+	}
 _free:
 	if (err < 0) {
 		for (idx = 0; idx < slaves_count; ++idx) {
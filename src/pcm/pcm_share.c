@@ -33,10 +33,10 @@
 #include <string.h>
 #include <signal.h>
 #include <math.h>
-#include <sys/socket.h>
 #include <poll.h>
 #include <pthread.h>
 #include "pcm_local.h"
+#include "pcm_generic.h"
 
 #ifndef PIC
 /* entry for static linking */
@@ -88,7 +88,7 @@ typedef struct {
 	snd_pcm_uframes_t silence_frames;
 	snd_pcm_sw_params_t sw_params;
 	snd_pcm_uframes_t hw_ptr;
-	int poll[2];
+	snd_pcm_generic_notify_t wake;
 	int polling;
 	pthread_t thread;
 	pthread_mutex_t mutex;
@@ -109,9 +109,7 @@ typedef struct {
 	snd_pcm_state_t state;
 	snd_pcm_uframes_t hw_ptr;
 	snd_pcm_uframes_t appl_ptr;
-	int ready;
-	int client_socket;
-	int slave_socket;
+	snd_pcm_generic_notify_t notify;
 } snd_pcm_share_t;
 
 #endif /* DOC_HIDDEN */
@@ -212,7 +210,12 @@ static snd_pcm_uframes_t _snd_pcm_share_missing(snd_pcm_t *pcm)
 	case SND_PCM_STATE_DRAINING:
 		if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
 			break;
-		/* Fall through */
+		return INT_MAX;
+	case SND_PCM_STATE_PREPARED:
+		/* only the application moves the pointers until the start */
+		snd_pcm_generic_notify_set(&share->notify,
+					   snd_pcm_mmap_avail(pcm) >= pcm->avail_min);
+		return INT_MAX;
 	default:
 		return INT_MAX;
 	}
@@ -286,21 +289,7 @@ static snd_pcm_uframes_t _snd_pcm_share_missing(snd_pcm_t *pcm)
 	}
 
  update_poll:
-	if (ready != share->ready) {
-		char buf[1];
-		if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
-			if (ready)
-				read(share->slave_socket, buf, 1);
-			else
-				write(share->client_socket, buf, 1);
-		} else {
-			if (ready)
-				write(share->slave_socket, buf, 1);
-			else
-				read(share->client_socket, buf, 1);
-		}
-		share->ready = ready;
-	}
+	snd_pcm_generic_notify_set(&share->notify, ready);
 	if (!running)
 		return INT_MAX;
 	if (pcm->stream == SND_PCM_STREAM_PLAYBACK &&
@@ -357,7 +346,7 @@ static void *snd_pcm_share_thread(void *data)
 	struct pollfd pfd[2];
 	int err;
 
-	pfd[0].fd = slave->poll[0];
+	pfd[0].fd = slave->wake.fd;
 	pfd[0].events = POLLIN;
 	err = snd_pcm_poll_descriptors(spcm, &pfd[1], 1);
 	if (err != 1) {
@@ -365,12 +354,6 @@ static void *snd_pcm_share_thread(void *data)
 		return NULL;
 	}
 	Pthread_mutex_lock(&slave->mutex);
-	err = pipe(slave->poll);
-	if (err < 0) {
-		SYSERR("can't create a pipe");
-		Pthread_mutex_unlock(&slave->mutex);
-		return NULL;
-	}
 	while (slave->open_count > 0) {
 		snd_pcm_uframes_t missing;
 		// printf("begin min_missing\n");
@@ -403,10 +386,8 @@ static void *snd_pcm_share_thread(void *data)
 			Pthread_mutex_unlock(&slave->mutex);
 			err = poll(pfd, 2, -1);
 			Pthread_mutex_lock(&slave->mutex);
-			if (pfd[0].revents & POLLIN) {
-				char buf[1];
-				read(pfd[0].fd, buf, 1);
-			}
+			if (pfd[0].revents & POLLIN)
+				snd_pcm_generic_notify_clear(&slave->wake);
 		} else {
 			slave->polling = 0;
 			pthread_cond_wait(&slave->poll_cond, &slave->mutex);
@@ -443,15 +424,9 @@ static void _snd_pcm_share_update(snd_pcm_t *pcm)
 			avail_min += spcm->buffer_size;
 		if (avail_min < 0)
 			avail_min += spcm->boundary;
-		if ((snd_pcm_uframes_t)avail_min < spcm->avail_min) {
-			int err;
-			snd_pcm_sw_params_set_avail_min(spcm, &slave->sw_params, avail_min);
-			err = snd_pcm_sw_params(spcm, &slave->sw_params);
-			if (err < 0) {
-				SYSERR("snd_pcm_sw_params error");
-				return;
-			}
-		}
+		/* let the thread wake up earlier, it reprograms avail_min */
+		if ((snd_pcm_uframes_t)avail_min < spcm->avail_min)
+			snd_pcm_generic_notify_wake(&slave->wake);
 	}
 }
 
@@ -850,6 +825,8 @@ static snd_pcm_sframes_t _snd_pcm_share_mmap_commit(snd_pcm_t *pcm,
 			}
 		}
 		_snd_pcm_share_update(pcm);
+	} else if (share->state == SND_PCM_STATE_PREPARED) {
+		_snd_pcm_share_update(pcm);
 	}
 	return size;
 }
@@ -895,6 +872,7 @@ static int snd_pcm_share_prepare(snd_pcm_t *pcm)
 	share->hw_ptr = 0;
 	share->appl_ptr = 0;
 	share->state = SND_PCM_STATE_PREPARED;
+	_snd_pcm_share_update(pcm);
  _end:
 	Pthread_mutex_unlock(&slave->mutex);
 	return err;
@@ -1151,6 +1129,12 @@ static void _snd_pcm_share_stop(snd_pcm_t *pcm, snd_pcm_state_t state)
 	if (slave->running_count == 0) {
 		int err = snd_pcm_drop(slave->pcm);
 		assert(err >= 0);
+		/* other clients are still prepared and start the slave later */
+		if (slave->prepared_count > 0) {
+			err = snd_pcm_prepare(slave->pcm);
+			if (err < 0)
+				SYSMSG("snd_pcm_prepare error");
+		}
 	}
 }
 
@@ -1165,6 +1149,7 @@ static int snd_pcm_share_drain(snd_pcm_t *pcm)
 		err = -EBADFD;
 		goto _end;
 	case SND_PCM_STATE_PREPARED:
+		slave->prepared_count--;
 		share->state = SND_PCM_STATE_SETUP;
 		goto _end;
 	case SND_PCM_STATE_SETUP:
@@ -1235,6 +1220,8 @@ static int snd_pcm_share_drop(snd_pcm_t *pcm)
 		_snd_pcm_share_update(pcm);
 		break;
 	case SND_PCM_STATE_PREPARED:
+		slave->prepared_count--;
+		/* Fall through */
 	case SND_PCM_STATE_XRUN:
 		share->state = SND_PCM_STATE_SETUP;
 		break;
@@ -1259,23 +1246,25 @@ static int snd_pcm_share_close(snd_pcm_t *pcm)
 	Pthread_mutex_lock(&slave->mutex);
 	slave->open_count--;
 	if (slave->open_count == 0) {
+		/* the thread waits either on the condition or in poll() */
 		pthread_cond_signal(&slave->poll_cond);
+		snd_pcm_generic_notify_wake(&slave->wake);
 		Pthread_mutex_unlock(&slave->mutex);
 		err = pthread_join(slave->thread, 0);
 		assert(err == 0);
 		err = snd_pcm_close(slave->pcm);
+		snd_pcm_generic_notify_close(&slave->wake);
 		pthread_mutex_destroy(&slave->mutex);
 		pthread_cond_destroy(&slave->poll_cond);
+		list_del(&share->list);
 		list_del(&slave->list);
 		free(slave);
-		list_del(&share->list);
 	} else {
 		list_del(&share->list);
 		Pthread_mutex_unlock(&slave->mutex);
 	}
 	Pthread_mutex_unlock(&snd_pcm_share_slaves_mutex);
-	close(share->client_socket);
-	close(share->slave_socket);
+	snd_pcm_generic_notify_close(&share->notify);
 	free(share->slave_channels);
 	free(share);
 	return err;
@@ -1346,6 +1335,7 @@ static const snd_pcm_fast_ops_t snd_pcm_share_fast_ops = {
 	.avail_update = snd_pcm_share_avail_update,
 	.htimestamp = snd_pcm_share_htimestamp,
 	.mmap_commit = snd_pcm_share_mmap_commit,
+	.poll_revents = snd_pcm_generic_notify_revents,
 };
 
 /**
@@ -1381,7 +1371,6 @@ int snd_pcm_share_open(snd_pcm_t **pcmp, const char *name, const char *sname,
 	char slave_map[32] = { 0 };
 	unsigned int k;
 	snd_pcm_share_slave_t *slave = NULL;
-	int sd[2];
 
 	assert(pcmp);
 	assert(channels > 0 && sname && channels_map);
@@ -1417,34 +1406,8 @@ int snd_pcm_share_open(snd_pcm_t **pcmp, const char *name, const char *sname,
 		free(share);
 		return err;
 	}
-	err = socketpair(AF_LOCAL, SOCK_STREAM, 0, sd);
-	if (err < 0) {
-		snd_pcm_free(pcm);
-		free(share->slave_channels);
-		free(share);
-		return -errno;
-	}
-		
-	if (stream == SND_PCM_STREAM_PLAYBACK) {
-		int bufsize = 1;
-		err = setsockopt(sd[0], SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
-		if (err >= 0) {
-			struct pollfd pfd;
-			pfd.fd = sd[0];
-			pfd.events = POLLOUT;
-			while ((err = poll(&pfd, 1, 0)) == 1) {
-				char buf[1];
-				err = write(sd[0], buf, 1);
-				assert(err != 0);
-				if (err != 1)
-					break;
-			}
-		}
-	}
+	err = snd_pcm_generic_notify_open(&share->notify);
 	if (err < 0) {
-		err = -errno;
-		close(sd[0]);
-		close(sd[1]);
 		snd_pcm_free(pcm);
 		free(share->slave_channels);
 		free(share);
@@ -1461,11 +1424,11 @@ int snd_pcm_share_open(snd_pcm_t **pcmp, const char *name, const char *sname,
 	}
 	if (!slave) {
 		snd_pcm_t *spcm;
-		err = snd_pcm_open(&spcm, sname, stream, mode);
+		err = snd_pcm_open(&spcm, sname, stream,
+				   snd_pcm_shared_slave_mode(mode));
 		if (err < 0) {
 			Pthread_mutex_unlock(&snd_pcm_share_slaves_mutex);
-			close(sd[0]);
-			close(sd[1]);
+			snd_pcm_generic_notify_close(&share->notify);
 			snd_pcm_free(pcm);
 			free(share->slave_channels);
 			free(share);
@@ -1477,8 +1440,7 @@ int snd_pcm_share_open(snd_pcm_t **pcmp, const char *name, const char *sname,
 		if (!slave) {
 			Pthread_mutex_unlock(&snd_pcm_share_slaves_mutex);
 			snd_pcm_close(spcm);
-			close(sd[0]);
-			close(sd[1]);
+			snd_pcm_generic_notify_close(&share->notify);
 			snd_pcm_free(pcm);
 			free(share->slave_channels);
 			free(share);
@@ -1491,6 +1453,17 @@ int snd_pcm_share_open(snd_pcm_t **pcmp, const char *name, const char *sname,
 		slave->rate = srate;
 		slave->period_time = speriod_time;
 		slave->buffer_time = sbuffer_time;
+		err = snd_pcm_generic_notify_open(&slave->wake);
+		if (err < 0) {
+			Pthread_mutex_unlock(&snd_pcm_share_slaves_mutex);
+			snd_pcm_close(spcm);
+			free(slave);
+			snd_pcm_generic_notify_close(&share->notify);
+			snd_pcm_free(pcm);
+			free(share->slave_channels);
+			free(share);
+			return err;
+		}
 		pthread_mutex_init(&slave->mutex, NULL);
 		pthread_cond_init(&slave->poll_cond, NULL);
 		list_add_tail(&slave->list, &snd_pcm_share_slaves);
@@ -1507,8 +1480,7 @@ int snd_pcm_share_open(snd_pcm_t **pcmp, const char *name, const char *sname,
 				if (slave_map[sh->slave_channels[k]]) {
 					SNDERR("Slave channel %d is already in use", sh->slave_channels[k]);
 					Pthread_mutex_unlock(&slave->mutex);
-					close(sd[0]);
-					close(sd[1]);
+					snd_pcm_generic_notify_close(&share->notify);
 					snd_pcm_free(pcm);
 					free(share->slave_channels);
 					free(share);
@@ -1520,15 +1492,13 @@ int snd_pcm_share_open(snd_pcm_t **pcmp, const char *name, const char *sname,
 
 	share->slave = slave;
 	share->pcm = pcm;
-	share->client_socket = sd[0];
-	share->slave_socket = sd[1];
 	
 	pcm->mmap_rw = 1;
 	pcm->ops = &snd_pcm_share_ops;
 	pcm->fast_ops = &snd_pcm_share_fast_ops;
 	pcm->private_data = share;
-	pcm->poll_fd = share->client_socket;
-	pcm->poll_events = stream == SND_PCM_STREAM_PLAYBACK ? POLLOUT : POLLIN;
+	pcm->poll_fd = share->notify.fd;
+	pcm->poll_events = POLLIN;
 	pcm->tstamp_type = slave->pcm->tstamp_type;
 	snd_pcm_set_hw_ptr(pcm, &share->hw_ptr, -1, 0);
 	snd_pcm_set_appl_ptr(pcm, &share->appl_ptr, -1, 0);
@@ -0,0 +1,741 @@
+/**
+ * \file pcm/pcm_uring.c
+ * \ingroup PCM_Uring
+ * \brief PCM Batched Transfers
+ * \date 2026
+ *
+ * Queues the transfers and the waits of many PCMs and submits them at
+ * once, the waits by io_uring when the kernel provides it.
+ */
+/*
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <poll.h>
+#include "pcm_local.h"
+#ifdef HAVE_LINUX_IO_URING_H
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && \
+    defined(__NR_io_uring_register) && defined(IO_URING_OP_SUPPORTED)
+#define URING_NATIVE
+#endif
+#endif
+
+#ifndef DOC_HIDDEN
+
+#define URING_MAX_ENTRIES	4096
+#define URING_CANCEL_DATA	((uint64_t)-1)
+
+enum {
+	REQ_FREE,
+	REQ_QUEUED,		/* emulated transfer, done by the submit */
+	REQ_WAITING,		/* emulated wait, polled by the submit */
+	REQ_INFLIGHT,		/* wait passed to the kernel */
+	REQ_DONE,		/* completed, not returned yet */
+};
+
+struct uring_req {
+	int state;
+	snd_pcm_uring_op_t op;
+	snd_pcm_t *pcm;
+	void *buffer;
+	snd_pcm_uframes_t size;
+	void *private_data;
+	struct pollfd *pfds;
+	unsigned int nfds;
+	snd_pcm_sframes_t result;
+};
+
+struct _snd_pcm_uring {
+	int fd;				/* io_uring, -1 when emulated */
+	unsigned int entries;
+	unsigned int used;
+	struct uring_req *reqs;
+#ifdef URING_NATIVE
+	void *sq_ring;
+	size_t sq_ring_size;
+	void *cq_ring;
+	size_t cq_ring_size;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+	unsigned int sq_entries;
+	unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned int *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe *cqes;
+	unsigned int to_submit;
+	int closing;
+#endif
+};
+
+static int uring_count(snd_pcm_uring_t *ring, int state)
+{
+	unsigned int i;
+	int count = 0;
+
+	for (i = 0; i < ring->entries; i++)
+		if (ring->reqs[i].state == state)
+			count++;
+	return count;
+}
+
+#ifdef URING_NATIVE
+
+static void uring_unmap(snd_pcm_uring_t *ring)
+{
+	if (ring->sqes)
+		munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_ring && ring->cq_ring != ring->sq_ring)
+		munmap(ring->cq_ring, ring->cq_ring_size);
+	if (ring->sq_ring)
+		munmap(ring->sq_ring, ring->sq_ring_size);
+	ring->sqes = NULL;
+	ring->cq_ring = ring->sq_ring = NULL;
+}
+
+/* the polls and their cancels must be supported by the kernel */
+static int uring_probe(snd_pcm_uring_t *ring)
+{
+	static const unsigned char ops[] = {
+		IORING_OP_POLL_ADD, IORING_OP_ASYNC_CANCEL,
+	};
+	struct io_uring_probe *probe;
+	unsigned int i;
+	int err = 0;
+
+	probe = calloc(1, sizeof(*probe) + 256 * sizeof(probe->ops[0]));
+	if (!probe)
+		return -ENOMEM;
+	if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE,
+		    probe, 256) < 0) {
+		err = -errno;
+		goto out;
+	}
+	for (i = 0; i < sizeof(ops); i++) {
+		if (ops[i] > probe->last_op ||
+		    !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED)) {
+			err = -ENOSYS;
+			break;
+		}
+	}
+ out:
+	free(probe);
+	return err;
+}
+
+static int uring_setup(snd_pcm_uring_t *ring)
+{
+	struct io_uring_params p;
+	void *ptr;
+	int err;
+
+	memset(&p, 0, sizeof(p));
+	ring->fd = syscall(__NR_io_uring_setup, ring->entries, &p);
+	if (ring->fd < 0)
+		return -errno;
+	ring->sq_entries = p.sq_entries;
+	ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	ring->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_ring_size > ring->sq_ring_size)
+			ring->sq_ring_size = ring->cq_ring_size;
+		ring->cq_ring_size = ring->sq_ring_size;
+	}
+	ptr = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ptr == MAP_FAILED)
+		goto _err;
+	ring->sq_ring = ptr;
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_ring = ring->sq_ring;
+	} else {
+		ptr = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+			   MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		if (ptr == MAP_FAILED)
+			goto _err;
+		ring->cq_ring = ptr;
+	}
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ptr = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ptr == MAP_FAILED)
+		goto _err;
+	ring->sqes = ptr;
+	ring->sq_head = (unsigned int *)((char *)ring->sq_ring + p.sq_off.head);
+	ring->sq_tail = (unsigned int *)((char *)ring->sq_ring + p.sq_off.tail);
+	ring->sq_mask = (unsigned int *)((char *)ring->sq_ring + p.sq_off.ring_mask);
+	ring->sq_array = (unsigned int *)((char *)ring->sq_ring + p.sq_off.array);
+	ring->cq_head = (unsigned int *)((char *)ring->cq_ring + p.cq_off.head);
+	ring->cq_tail = (unsigned int *)((char *)ring->cq_ring + p.cq_off.tail);
+	ring->cq_mask = (unsigned int *)((char *)ring->cq_ring + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)((char *)ring->cq_ring + p.cq_off.cqes);
+	err = uring_probe(ring);
+	if (err < 0)
+		goto _close;
+	return 0;
+
+ _err:
+	err = -errno;
+ _close:
+	uring_unmap(ring);
+	close(ring->fd);
+	ring->fd = -1;
+	return err;
+}
+
+static int uring_enter(snd_pcm_uring_t *ring)
+{
+	int ret;
+
+	while (ring->to_submit > 0) {
+		ret = syscall(__NR_io_uring_enter, ring->fd, ring->to_submit,
+			      0, 0, NULL, 0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		ring->to_submit -= ret;
+	}
+	return 0;
+}
+
+/*
+ * Only the waits are passed to the kernel: io_uring transfers go through
+ * the readv()/writev() path of the device, which takes the
+ * non-interleaved buffers only.
+ */
+static int uring_native(snd_pcm_uring_t *ring, struct uring_req *req)
+{
+	return ring->fd >= 0 && req->op == SND_PCM_URING_POLL &&
+	       req->nfds == 1;
+}
+
+/* the outstanding requests never exceed the submission queue */
+static struct io_uring_sqe *uring_sqe(snd_pcm_uring_t *ring)
+{
+	unsigned int tail = *ring->sq_tail, idx;
+	struct io_uring_sqe *sqe;
+
+	idx = tail & *ring->sq_mask;
+	sqe = &ring->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	ring->sq_array[idx] = idx;
+	return sqe;
+}
+
+static void uring_sqe_commit(snd_pcm_uring_t *ring)
+{
+	__atomic_store_n(ring->sq_tail, *ring->sq_tail + 1, __ATOMIC_RELEASE);
+	ring->to_submit++;
+}
+
+static int uring_prep(snd_pcm_uring_t *ring, struct uring_req *req)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = uring_sqe(ring);
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = req->pfds[0].fd;
+	sqe->poll_events = req->pfds[0].events;
+	sqe->user_data = req - ring->reqs;
+	uring_sqe_commit(ring);
+	req->state = REQ_INFLIGHT;
+	return 0;
+}
+
+static void uring_complete(snd_pcm_uring_t *ring, struct uring_req *req,
+			   int res)
+{
+	unsigned short revents;
+	int err;
+
+	if (res < 0) {
+		req->result = res;
+		goto done;
+	}
+	req->pfds[0].revents = res;
+	err = snd_pcm_poll_descriptors_revents(req->pcm, req->pfds, 1,
+					       &revents);
+	if (err < 0) {
+		req->result = err;
+		goto done;
+	}
+	if (!revents && !ring->closing && uring_prep(ring, req) >= 0)
+		return;	/* spurious wakeup, poll again */
+	req->result = revents;
+ done:
+	req->state = REQ_DONE;
+}
+
+static void uring_reap(snd_pcm_uring_t *ring)
+{
+	unsigned int head, tail;
+	struct io_uring_cqe *cqe;
+
+	head = *ring->cq_head;
+	tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+	while (head != tail) {
+		cqe = &ring->cqes[head & *ring->cq_mask];
+		if (cqe->user_data < ring->entries &&
+		    ring->reqs[cqe->user_data].state == REQ_INFLIGHT)
+			uring_complete(ring, &ring->reqs[cqe->user_data], cqe->res);
+		head++;
+	}
+	__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/*
+ * The kernel may still use the poll descriptors of the waits in flight,
+ * so they are cancelled and their completions reaped before the close.
+ */
+static void uring_cancel(snd_pcm_uring_t *ring)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int i;
+	int ret;
+
+	ring->closing = 1;
+	if (uring_enter(ring) < 0)
+		return;
+	for (i = 0; i < ring->entries; i++) {
+		if (ring->reqs[i].state != REQ_INFLIGHT)
+			continue;
+		sqe = uring_sqe(ring);
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->addr = i;
+		sqe->user_data = URING_CANCEL_DATA;
+		uring_sqe_commit(ring);
+	}
+	if (uring_enter(ring) < 0)
+		return;
+	uring_reap(ring);
+	while (uring_count(ring, REQ_INFLIGHT) > 0) {
+		ret = syscall(__NR_io_uring_enter, ring->fd, 0, 1,
+			      IORING_ENTER_GETEVENTS, NULL, 0);
+		if (ret < 0 && errno != EINTR)
+			break;
+		uring_reap(ring);
+	}
+}
+
+#else /* URING_NATIVE */
+
+static int uring_setup(snd_pcm_uring_t *ring ATTRIBUTE_UNUSED)
+{
+	return -ENOSYS;
+}
+
+static int uring_enter(snd_pcm_uring_t *ring ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static int uring_native(snd_pcm_uring_t *ring ATTRIBUTE_UNUSED,
+			struct uring_req *req ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static int uring_prep(snd_pcm_uring_t *ring ATTRIBUTE_UNUSED,
+		      struct uring_req *req ATTRIBUTE_UNUSED)
+{
+	return -ENOSYS;
+}
+
+static void uring_reap(snd_pcm_uring_t *ring ATTRIBUTE_UNUSED)
+{
+}
+
+#endif /* URING_NATIVE */
+
+static struct uring_req *uring_req_new(snd_pcm_uring_t *ring, snd_pcm_t *pcm,
+				       snd_pcm_uring_op_t op, void *private_data)
+{
+	struct uring_req *req;
+	unsigned int i;
+
+	if (ring->used >= ring->entries)
+		return NULL;
+	for (i = 0, req = ring->reqs; i < ring->entries; i++, req++)
+		if (req->state == REQ_FREE)
+			break;
+	memset(req, 0, sizeof(*req));
+	req->op = op;
+	req->pcm = pcm;
+	req->private_data = private_data;
+	ring->used++;
+	return req;
+}
+
+static void uring_req_free(snd_pcm_uring_t *ring, struct uring_req *req)
+{
+	free(req->pfds);
+	req->pfds = NULL;
+	req->state = REQ_FREE;
+	ring->used--;
+}
+
+static int uring_queue(snd_pcm_uring_t *ring, struct uring_req *req)
+{
+	int err;
+
+	if (uring_native(ring, req)) {
+		err = uring_prep(ring, req);
+		if (err < 0) {
+			uring_req_free(ring, req);
+			return err;
+		}
+		return 0;
+	}
+	req->state = req->op == SND_PCM_URING_POLL ? REQ_WAITING : REQ_QUEUED;
+	return 0;
+}
+
+static int uring_xfer(snd_pcm_uring_t *ring, snd_pcm_t *pcm,
+		      snd_pcm_uring_op_t op, void *buffer,
+		      snd_pcm_uframes_t size, void *private_data)
+{
+	struct uring_req *req;
+
+	assert(ring && pcm && (buffer || size == 0));
+	req = uring_req_new(ring, pcm, op, private_data);
+	if (!req)
+		return -EAGAIN;
+	req->buffer = buffer;
+	req->size = size;
+	return uring_queue(ring, req);
+}
+
+/* the emulated transfers are done in the queue order */
+static void uring_run_queued(snd_pcm_uring_t *ring)
+{
+	struct uring_req *req;
+	unsigned int i;
+
+	for (i = 0, req = ring->reqs; i < ring->entries; i++, req++) {
+		if (req->state != REQ_QUEUED)
+			continue;
+		if (req->op == SND_PCM_URING_WRITEI)
+			req->result = snd_pcm_writei(req->pcm, req->buffer, req->size);
+		else
+			req->result = snd_pcm_readi(req->pcm, req->buffer, req->size);
+		req->state = REQ_DONE;
+	}
+}
+
+static int uring_remaining(const struct timespec *end)
+{
+	struct timespec now;
+	long long ms;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ms = (end->tv_sec - now.tv_sec) * 1000LL +
+	     (end->tv_nsec - now.tv_nsec) / 1000000;
+	if (ms <= 0)
+		return 0;
+	return ms > INT_MAX ? INT_MAX : ms;
+}
+
+/*
+ * Poll the io_uring descriptor together with the descriptors of the
+ * emulated waits, the waits which became ready are completed.
+ */
+static int uring_wait(snd_pcm_uring_t *ring, int timeout)
+{
+	struct pollfd *pfds, *pfd;
+	struct uring_req *req;
+	unsigned short revents;
+	unsigned int i, nfds = 0;
+	int inflight, err;
+
+	inflight = ring->fd >= 0 && uring_count(ring, REQ_INFLIGHT) > 0;
+	if (inflight)
+		nfds++;
+	for (i = 0, req = ring->reqs; i < ring->entries; i++, req++)
+		if (req->state == REQ_WAITING)
+			nfds += req->nfds;
+	if (!nfds)
+		return 0;
+	pfds = alloca(sizeof(*pfds) * nfds);
+	pfd = pfds;
+	if (inflight) {
+		pfd->fd = ring->fd;
+		pfd->events = POLLIN;
+		pfd++;
+	}
+	for (i = 0, req = ring->reqs; i < ring->entries; i++, req++) {
+		if (req->state != REQ_WAITING)
+			continue;
+		memcpy(pfd, req->pfds, sizeof(*pfd) * req->nfds);
+		pfd += req->nfds;
+	}
+	err = poll(pfds, nfds, timeout);
+	if (err < 0)
+		return errno == EINTR ? 0 : -errno;
+	if (err == 0)
+		return 0;
+	pfd = pfds + inflight;
+	for (i = 0, req = ring->reqs; i < ring->entries; i++, req++) {
+		if (req->state != REQ_WAITING)
+			continue;
+		err = snd_pcm_poll_descriptors_revents(req->pcm, pfd, req->nfds,
+						       &revents);
+		pfd += req->nfds;
+		if (err < 0) {
+			req->result = err;
+			req->state = REQ_DONE;
+		} else if (revents) {
+			req->result = revents;
+			req->state = REQ_DONE;
+		}
+	}
+	return 1;
+}
+
+#endif /* DOC_HIDDEN */
+
+/**
+ * \brief Create a ring for batched PCM transfers
+ * \param ringp Returned ring
+ * \param entries Maximum count of outstanding requests
+ * \param mode Mode flags (#SND_PCM_URING_EMULATE)
+ * \return 0 on success otherwise a negative error code
+ *
+ * The ring uses io_uring when the kernel supports it, otherwise (or
+ * with #SND_PCM_URING_EMULATE) all requests are emulated, see
+ * #snd_pcm_uring_native().
+ */
+int snd_pcm_uring_open(snd_pcm_uring_t **ringp, unsigned int entries, int mode)
+{
+	snd_pcm_uring_t *ring;
+	int err;
+
+	assert(ringp);
+	if (entries == 0 || entries > URING_MAX_ENTRIES ||
+	    (mode & ~SND_PCM_URING_EMULATE))
+		return -EINVAL;
+	ring = calloc(1, sizeof(*ring));
+	if (!ring)
+		return -ENOMEM;
+	ring->reqs = calloc(entries, sizeof(*ring->reqs));
+	if (!ring->reqs) {
+		free(ring);
+		return -ENOMEM;
+	}
+	ring->entries = entries;
+	ring->fd = -1;
+	if (!(mode & SND_PCM_URING_EMULATE)) {
+		err = uring_setup(ring);
+		if (err < 0)
+			SNDMSG("io_uring is not available (%i), emulating", err);
+	}
+	*ringp = ring;
+	return 0;
+}
+
+/**
+ * \brief Close a ring for batched PCM transfers
+ * \param ring Ring
+ * \return 0 on success otherwise a negative error code
+ *
+ * The requests which are not completed yet are cancelled.
+ */
+int snd_pcm_uring_close(snd_pcm_uring_t *ring)
+{
+	unsigned int i;
+
+	assert(ring);
+#ifdef URING_NATIVE
+	if (ring->fd >= 0) {
+		uring_cancel(ring);
+		close(ring->fd);
+		uring_unmap(ring);
+	}
+#endif
+	for (i = 0; i < ring->entries; i++)
+		free(ring->reqs[i].pfds);
+	free(ring->reqs);
+	free(ring);
+	return 0;
+}
+
+/**
+ * \brief Tell whether a ring passes the requests to the kernel
+ * \param ring Ring
+ * \return 1 if io_uring is used, 0 if all requests are emulated
+ */
+int snd_pcm_uring_native(snd_pcm_uring_t *ring)
+{
+	assert(ring);
+	return ring->fd >= 0;
+}
+
+/**
+ * \brief Queue an interleaved write
+ * \param ring Ring
+ * \param pcm PCM handle
+ * \param buffer Frames containing buffer, valid until the completion
+ * \param size Frames to be written
+ * \param private_data Pointer returned with the completion
+ * \return 0 on success otherwise a negative error code
+ * \retval -EAGAIN the ring is full, the completions must be fetched first
+ *
+ * The transfer is started by #snd_pcm_uring_submit(), its completion
+ * returns the count of written frames like #snd_pcm_writei().
+ */
+int snd_pcm_uring_writei(snd_pcm_uring_t *ring, snd_pcm_t *pcm,
+			 const void *buffer, snd_pcm_uframes_t size,
+			 void *private_data)
+{
+	return uring_xfer(ring, pcm, SND_PCM_URING_WRITEI, (void *)buffer,
+			  size, private_data);
+}
+
+/**
+ * \brief Queue an interleaved read
+ * \param ring Ring
+ * \param pcm PCM handle
+ * \param buffer Frames containing buffer, valid until the completion
+ * \param size Frames to be read
+ * \param private_data Pointer returned with the completion
+ * \return 0 on success otherwise a negative error code
+ * \retval -EAGAIN the ring is full, the completions must be fetched first
+ *
+ * The transfer is started by #snd_pcm_uring_submit(), its completion
+ * returns the count of read frames like #snd_pcm_readi().
+ */
+int snd_pcm_uring_readi(snd_pcm_uring_t *ring, snd_pcm_t *pcm,
+			void *buffer, snd_pcm_uframes_t size,
+			void *private_data)
+{
+	return uring_xfer(ring, pcm, SND_PCM_URING_READI, buffer, size,
+			  private_data);
+}
+
+/**
+ * \brief Queue a wait for a PCM
+ * \param ring Ring
+ * \param pcm PCM handle
+ * \param private_data Pointer returned with the completion
+ * \return 0 on success otherwise a negative error code
+ * \retval -EAGAIN the ring is full, the completions must be fetched first
+ *
+ * The wait completes when #snd_pcm_poll_descriptors_revents() reports
+ * an event for the PCM; the result is that event mask.
+ */
+int snd_pcm_uring_poll(snd_pcm_uring_t *ring, snd_pcm_t *pcm,
+		       void *private_data)
+{
+	struct uring_req *req;
+	int count, err;
+
+	assert(ring && pcm);
+	count = snd_pcm_poll_descriptors_count(pcm);
+	if (count <= 0)
+		return count < 0 ? count : -EIO;
+	req = uring_req_new(ring, pcm, SND_PCM_URING_POLL, private_data);
+	if (!req)
+		return -EAGAIN;
+	req->pfds = calloc(count, sizeof(*req->pfds));
+	if (!req->pfds) {
+		uring_req_free(ring, req);
+		return -ENOMEM;
+	}
+	err = snd_pcm_poll_descriptors(pcm, req->pfds, count);
+	if (err < 0) {
+		uring_req_free(ring, req);
+		return err;
+	}
+	req->nfds = err;
+	return uring_queue(ring, req);
+}
+
+/**
+ * \brief Submit the queued requests and fetch the completions
+ * \param ring Ring
+ * \param events Returned completions
+ * \param space Size of the events array
+ * \param timeout Maximum time in milliseconds to wait for a completion,
+ *        a negative value means infinity
+ * \return count of returned completions otherwise a negative error code
+ *
+ * The completions which do not fit into the events array are returned
+ * by the next calls. Zero is returned when the timeout expires or when
+ * no request is outstanding.
+ */
+int snd_pcm_uring_submit(snd_pcm_uring_t *ring, snd_pcm_uring_event_t *events,
+			 unsigned int space, int timeout)
+{
+	struct uring_req *req;
+	struct timespec end;
+	unsigned int i, pass, count = 0;
+	int err, wait;
+
+	assert(ring && (events || space == 0));
+	if (timeout > 0) {
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		end.tv_sec += timeout / 1000;
+		end.tv_nsec += (timeout % 1000) * 1000000L;
+		if (end.tv_nsec >= 1000000000L) {
+			end.tv_sec++;
+			end.tv_nsec -= 1000000000L;
+		}
+	}
+	uring_run_queued(ring);
+	for (pass = 0;; pass++) {
+		err = uring_enter(ring);
+		if (err < 0)
+			return err;
+		if (ring->fd >= 0)
+			uring_reap(ring);
+		/* the io_uring polls may be armed again */
+		err = uring_enter(ring);
+		if (err < 0)
+			return err;
+		if (uring_count(ring, REQ_DONE) > 0 ||
+		    (!uring_count(ring, REQ_WAITING) &&
+		     !uring_count(ring, REQ_INFLIGHT)))
+			break;
+		/* the first pass only checks the emulated waits */
+		if (pass == 0)
+			wait = 0;
+		else if (timeout < 0)
+			wait = -1;
+		else if (timeout == 0 || !(wait = uring_remaining(&end)))
+			break;
+		err = uring_wait(ring, wait);
+		if (err < 0)
+			return err;
+	}
+	for (i = 0, req = ring->reqs; i < ring->entries && count < space; i++, req++) {
+		if (req->state != REQ_DONE)
+			continue;
+		events[count].pcm = req->pcm;
+		events[count].op = req->op;
+		events[count].result = req->result;
+		events[count].private_data = req->private_data;
+		count++;
+		uring_req_free(ring, req);
+	}
+	return count;
+}
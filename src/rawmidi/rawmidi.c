@@ -139,6 +139,8 @@ This example shows open and read/write rawmidi operations.
 #include <stdarg.h>
 #include <unistd.h>
 #include <string.h>
+#include <poll.h>
+#include <time.h>
 #include "rawmidi_local.h"
 
 /**
@@ -154,6 +156,7 @@ static int snd_rawmidi_params_default(snd_rawmidi_t *rawmidi, snd_rawmidi_params
 	params->buffer_size = page_size();
 	params->avail_min = 1;
 	params->no_active_sensing = 1;
+	params->mode = 0;
 	return 0;
 }
 
@@ -344,6 +347,7 @@ int snd_rawmidi_close(snd_rawmidi_t *rawmidi)
 	int err;
   	assert(rawmidi);
 	err = rawmidi->ops->close(rawmidi);
+	free(rawmidi->parser);
 	free(rawmidi->name);
 	if (rawmidi->open_func)
 		snd_dlobj_cache_put(rawmidi->open_func);
@@ -805,6 +809,82 @@ int snd_rawmidi_params_get_no_active_sensing(const snd_rawmidi_params_t *params)
 	return params->no_active_sensing;
 }
 
+/**
+ * \brief set the read mode of the rawmidi input stream
+ * \param rawmidi RawMidi handle
+ * \param params pointer to snd_rawmidi_params_t structure
+ * \param val read mode
+ * \return 0 on success otherwise a negative error code
+ *
+ * In #SND_RAWMIDI_READ_TSTAMP mode the input bytes are read with
+ * snd_rawmidi_tread() and carry the time they were received.
+ */
+#ifndef DOXYGEN
+int snd_rawmidi_params_set_read_mode(snd_rawmidi_t *rawmidi ATTRIBUTE_UNUSED, snd_rawmidi_params_t *params, snd_rawmidi_read_mode_t val)
+#else
+int snd_rawmidi_params_set_read_mode(snd_rawmidi_t *rawmidi, snd_rawmidi_params_t *params, snd_rawmidi_read_mode_t val)
+#endif
+{
+	assert(rawmidi && params);
+	switch (val) {
+	case SND_RAWMIDI_READ_STANDARD:
+		params->mode &= ~SNDRV_RAWMIDI_MODE_FRAMING_MASK;
+		break;
+	case SND_RAWMIDI_READ_TSTAMP:
+		params->mode = (params->mode & ~SNDRV_RAWMIDI_MODE_FRAMING_MASK) |
+			       SNDRV_RAWMIDI_MODE_FRAMING_TSTAMP;
+		break;
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/**
+ * \brief get the read mode of the rawmidi input stream
+ * \param params pointer to snd_rawmidi_params_t structure
+ * \return the read mode
+ */
+snd_rawmidi_read_mode_t snd_rawmidi_params_get_read_mode(const snd_rawmidi_params_t *params)
+{
+	assert(params);
+	if ((params->mode & SNDRV_RAWMIDI_MODE_FRAMING_MASK) == SNDRV_RAWMIDI_MODE_FRAMING_TSTAMP)
+		return SND_RAWMIDI_READ_TSTAMP;
+	return SND_RAWMIDI_READ_STANDARD;
+}
+
+/**
+ * \brief set the clock used for the input timestamps
+ * \param rawmidi RawMidi handle
+ * \param params pointer to snd_rawmidi_params_t structure
+ * \param val clock type
+ * \return 0 on success otherwise a negative error code
+ */
+#ifndef DOXYGEN
+int snd_rawmidi_params_set_clock_type(snd_rawmidi_t *rawmidi ATTRIBUTE_UNUSED, snd_rawmidi_params_t *params, snd_rawmidi_clock_t val)
+#else
+int snd_rawmidi_params_set_clock_type(snd_rawmidi_t *rawmidi, snd_rawmidi_params_t *params, snd_rawmidi_clock_t val)
+#endif
+{
+	assert(rawmidi && params);
+	if (val & ~SNDRV_RAWMIDI_MODE_CLOCK_MASK ||
+	    val > SND_RAWMIDI_CLOCK_MONOTONIC_RAW)
+		return -EINVAL;
+	params->mode = (params->mode & ~SNDRV_RAWMIDI_MODE_CLOCK_MASK) | val;
+	return 0;
+}
+
+/**
+ * \brief get the clock used for the input timestamps
+ * \param params pointer to snd_rawmidi_params_t structure
+ * \return the clock type
+ */
+snd_rawmidi_clock_t snd_rawmidi_params_get_clock_type(const snd_rawmidi_params_t *params)
+{
+	assert(params);
+	return params->mode & SNDRV_RAWMIDI_MODE_CLOCK_MASK;
+}
+
 /**
  * \brief set parameters about rawmidi stream
  * \param rawmidi RawMidi handle
@@ -822,6 +902,7 @@ int snd_rawmidi_params(snd_rawmidi_t *rawmidi, snd_rawmidi_params_t * params)
 	rawmidi->buffer_size = params->buffer_size;
 	rawmidi->avail_min = params->avail_min;
 	rawmidi->no_active_sensing = params->no_active_sensing;
+	rawmidi->params_mode = params->mode;
 	return 0;
 }
 
@@ -838,6 +919,7 @@ int snd_rawmidi_params_current(snd_rawmidi_t *rawmidi, snd_rawmidi_params_t *par
 	params->buffer_size = rawmidi->buffer_size;
 	params->avail_min = rawmidi->avail_min;
 	params->no_active_sensing = rawmidi->no_active_sensing;
+	params->mode = rawmidi->params_mode;
 	return 0;
 }
 
@@ -945,6 +1027,9 @@ int snd_rawmidi_status(snd_rawmidi_t *rawmidi, snd_rawmidi_status_t * status)
 int snd_rawmidi_drop(snd_rawmidi_t *rawmidi)
 {
 	assert(rawmidi);
+	/* forget the partially parsed input */
+	free(rawmidi->parser);
+	rawmidi->parser = NULL;
 	return rawmidi->ops->drop(rawmidi);
 }
 
@@ -981,11 +1066,265 @@ ssize_t snd_rawmidi_write(snd_rawmidi_t *rawmidi, const void *buffer, size_t siz
  * \param rawmidi RawMidi handle
  * \param buffer buffer to store the input MIDI bytes
  * \param size input buffer size in bytes
+ *
+ * The function fails with -EINVAL in #SND_RAWMIDI_READ_TSTAMP mode,
+ * use snd_rawmidi_tread() instead.
  */
 ssize_t snd_rawmidi_read(snd_rawmidi_t *rawmidi, void *buffer, size_t size)
 {
 	assert(rawmidi);
 	assert(rawmidi->stream == SND_RAWMIDI_STREAM_INPUT);
 	assert(buffer || size == 0);
+	if ((rawmidi->params_mode & SNDRV_RAWMIDI_MODE_FRAMING_MASK) == SNDRV_RAWMIDI_MODE_FRAMING_TSTAMP)
+		return -EINVAL;
 	return (rawmidi->ops->read)(rawmidi, buffer, size);
 }
+
+/* stamp the bytes which were just read with the selected clock */
+static void rawmidi_gettime(snd_rawmidi_t *rawmidi, struct timespec *tstamp)
+{
+#ifdef HAVE_CLOCK_GETTIME
+	clockid_t id = CLOCK_MONOTONIC;
+
+	switch (rawmidi->params_mode & SNDRV_RAWMIDI_MODE_CLOCK_MASK) {
+	case SNDRV_RAWMIDI_MODE_CLOCK_REALTIME:
+		id = CLOCK_REALTIME;
+		break;
+#ifdef CLOCK_MONOTONIC_RAW
+	case SNDRV_RAWMIDI_MODE_CLOCK_MONOTONIC_RAW:
+		id = CLOCK_MONOTONIC_RAW;
+		break;
+#endif
+	}
+	clock_gettime(id, tstamp);
+#else
+	struct timeval tv;
+
+	gettimeofday(&tv, 0);
+	tstamp->tv_sec = tv.tv_sec;
+	tstamp->tv_nsec = tv.tv_usec * 1000L;
+#endif
+}
+
+static ssize_t rawmidi_tread(snd_rawmidi_t *rawmidi, struct timespec *tstamp,
+			     void *buffer, size_t size)
+{
+	ssize_t result;
+
+	if (rawmidi->tstamp_kernel && rawmidi->ops->tread)
+		return rawmidi->ops->tread(rawmidi, tstamp, buffer, size);
+	result = rawmidi->ops->read(rawmidi, buffer, size);
+	if (result > 0)
+		rawmidi_gettime(rawmidi, tstamp);
+	return result;
+}
+
+/**
+ * \brief read timestamped MIDI bytes from MIDI stream
+ * \param rawmidi RawMidi handle
+ * \param tstamp returned time when the bytes were received
+ * \param buffer buffer to store the input MIDI bytes
+ * \param size input buffer size in bytes
+ * \return count of bytes read otherwise a negative error code
+ *
+ * The stream must be set to #SND_RAWMIDI_READ_TSTAMP mode.  All returned
+ * bytes share the timestamp.  When the driver supports the timestamp
+ * framing, the time is taken by the kernel when the bytes arrived,
+ * otherwise it is taken when the bytes are read.
+ */
+ssize_t snd_rawmidi_tread(snd_rawmidi_t *rawmidi, struct timespec *tstamp,
+			  void *buffer, size_t size)
+{
+	assert(rawmidi);
+	assert(rawmidi->stream == SND_RAWMIDI_STREAM_INPUT);
+	assert(tstamp);
+	assert(buffer || size == 0);
+	if ((rawmidi->params_mode & SNDRV_RAWMIDI_MODE_FRAMING_MASK) != SNDRV_RAWMIDI_MODE_FRAMING_TSTAMP)
+		return -EINVAL;
+	return rawmidi_tread(rawmidi, tstamp, buffer, size);
+}
+
+#ifndef DOC_HIDDEN
+struct _snd_rawmidi_parser {
+	unsigned char in[256];		/* received bytes not parsed yet */
+	size_t in_pos, in_len;
+	struct timespec in_tstamp;
+	unsigned char msg[3];		/* incomplete non-SysEx message */
+	size_t msg_len, msg_need;
+	struct timespec msg_tstamp;
+	unsigned char running;		/* running status */
+	unsigned int sysex: 1;		/* inside SysEx */
+};
+#endif
+
+static size_t rawmidi_status_length(unsigned char status)
+{
+	if (status < 0xf0)
+		return (status & 0xe0) == 0xc0 ? 2 : 3;
+	switch (status) {
+	case 0xf1:
+	case 0xf3:
+		return 2;
+	case 0xf2:
+		return 3;
+	case 0xf7:
+		return 0;	/* stray end of SysEx */
+	default:
+		return 1;
+	}
+}
+
+static int rawmidi_input_ready(snd_rawmidi_t *rawmidi)
+{
+	struct pollfd pfd;
+
+	if (rawmidi->mode & SND_RAWMIDI_NONBLOCK)
+		return 1;
+	if (snd_rawmidi_poll_descriptors(rawmidi, &pfd, 1) != 1)
+		return 0;
+	return poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN);
+}
+
+/**
+ * \brief read complete timestamped MIDI messages from MIDI stream
+ * \param rawmidi RawMidi handle
+ * \param msgs array receiving the messages
+ * \param count size of the msgs array
+ * \param buffer buffer receiving the message bytes
+ * \param size buffer size in bytes, at least 3
+ * \return count of messages read otherwise a negative error code
+ *
+ * Splits the input into MIDI messages which point into \p buffer.
+ * Running status is expanded, so every message starts with its status
+ * byte.  Realtime bytes are returned as separate one byte messages.
+ * A SysEx message is returned in parts when it does not fit into
+ * \p buffer or when its end was not received yet; the following parts
+ * do not start with 0xF0 and only the last part ends with 0xF7.
+ *
+ * Each message is stamped with the time when its first byte was
+ * received, see snd_rawmidi_tread().  In #SND_RAWMIDI_READ_STANDARD
+ * mode the bytes are stamped when they are read.
+ *
+ * Only the first read of the call waits for input in blocking mode, the
+ * bytes already received are then collected without further waiting.
+ * Incomplete messages are kept for the next call, so a blocking call
+ * returns 0 when it received only the start of a message.
+ */
+ssize_t snd_rawmidi_read_messages(snd_rawmidi_t *rawmidi, snd_rawmidi_message_t *msgs,
+				  size_t count, unsigned char *buffer, size_t size)
+{
+	snd_rawmidi_parser_t *p;
+	snd_rawmidi_message_t *sx = NULL;	/* open SysEx part */
+	size_t n = 0, used = 0;
+	ssize_t err = 0;
+	int reads = 0;
+	unsigned char c;
+
+	assert(rawmidi);
+	assert(rawmidi->stream == SND_RAWMIDI_STREAM_INPUT);
+	assert(msgs || count == 0);
+	assert(buffer);
+	if (size < 3)
+		return -EINVAL;
+	p = rawmidi->parser;
+	if (!p) {
+		p = calloc(1, sizeof(*p));
+		if (!p)
+			return -ENOMEM;
+		rawmidi->parser = p;
+	}
+	while (n < count) {
+		/* a message completed by the previous byte */
+		if (p->msg_need && p->msg_len == p->msg_need) {
+			if (size - used < p->msg_len)
+				break;
+			msgs[n].tstamp = p->msg_tstamp;
+			msgs[n].data = buffer + used;
+			msgs[n].length = p->msg_len;
+			memcpy(buffer + used, p->msg, p->msg_len);
+			used += p->msg_len;
+			n++;
+			p->msg_need = 0;
+			continue;
+		}
+		if (p->in_pos >= p->in_len) {
+			if (reads && !rawmidi_input_ready(rawmidi))
+				break;
+			err = rawmidi_tread(rawmidi, &p->in_tstamp, p->in, sizeof(p->in));
+			if (err <= 0)
+				break;
+			reads++;
+			p->in_pos = 0;
+			p->in_len = err;
+		}
+		c = p->in[p->in_pos];
+		if (c >= 0xf8) {
+			if (used >= size)
+				break;
+			sx = NULL;
+			msgs[n].tstamp = p->in_tstamp;
+			msgs[n].data = buffer + used;
+			msgs[n].length = 1;
+			buffer[used++] = c;
+			n++;
+			p->in_pos++;
+			continue;
+		}
+		if (p->sysex && (c < 0x80 || c == 0xf7)) {
+			if (used >= size)
+				break;
+			if (!sx) {
+				sx = &msgs[n++];
+				sx->tstamp = p->in_tstamp;
+				sx->data = buffer + used;
+				sx->length = 0;
+			}
+			buffer[used++] = c;
+			sx->length++;
+			p->in_pos++;
+			if (c == 0xf7) {
+				p->sysex = 0;
+				sx = NULL;
+			}
+			continue;
+		}
+		if (c == 0xf0) {
+			if (used >= size)
+				break;
+			p->sysex = 1;
+			p->running = 0;
+			p->msg_need = 0;
+			sx = &msgs[n++];
+			sx->tstamp = p->in_tstamp;
+			sx->data = buffer + used;
+			sx->length = 1;
+			buffer[used++] = c;
+			p->in_pos++;
+			continue;
+		}
+		p->in_pos++;
+		if (c & 0x80) {
+			/* any other status byte ends the SysEx and a pending message */
+			p->sysex = 0;
+			sx = NULL;
+			p->running = c < 0xf0 ? c : 0;
+			p->msg_need = rawmidi_status_length(c);
+			p->msg[0] = c;
+			p->msg_len = 1;
+			p->msg_tstamp = p->in_tstamp;
+			continue;
+		}
+		if (!p->msg_need) {
+			if (!p->running)
+				continue;	/* data byte without status */
+			p->msg[0] = p->running;
+			p->msg_len = 1;
+			p->msg_need = rawmidi_status_length(p->running);
+			p->msg_tstamp = p->in_tstamp;
+		}
+		p->msg[p->msg_len++] = c;
+	}
+	if (n > 0 || err >= 0)
+		return n;
+	return err;
+}
@@ -35,13 +35,22 @@ const char *_snd_module_rawmidi_hw = "";
 #endif
 
 #define SNDRV_FILE_RAWMIDI		ALSA_DEVICE_DIRECTORY "midiC%iD%i"
-#define SNDRV_RAWMIDI_VERSION_MAX	SNDRV_PROTOCOL_VERSION(2, 0, 0)
+#define SNDRV_RAWMIDI_VERSION_MAX	SNDRV_PROTOCOL_VERSION(2, 0, 2)
+
+/* number of timestamped frames fetched by one read() */
+#define HW_TREAD_FRAMES			64
 
 #ifndef DOC_HIDDEN
 typedef struct {
 	int open;
 	int fd;
 	int card, device, subdevice;
+	int version;
+	/* input frames of the timestamp framing mode */
+	struct snd_rawmidi_framing_tstamp *frames;
+	size_t frames_count;		/* valid frames in the buffer */
+	size_t frames_pos;		/* current frame */
+	size_t frames_ofs;		/* consumed data bytes of the current frame */
 } snd_rawmidi_hw_t;
 #endif
 
@@ -57,6 +66,7 @@ static int snd_rawmidi_hw_close(snd_rawmidi_t *rmidi)
 		err = -errno;
 		SYSERR("close failed\n");
 	}
+	free(hw->frames);
 	free(hw);
 	return err;
 }
@@ -95,12 +105,30 @@ static int snd_rawmidi_hw_info(snd_rawmidi_t *rmidi, snd_rawmidi_info_t * info)
 static int snd_rawmidi_hw_params(snd_rawmidi_t *rmidi, snd_rawmidi_params_t * params)
 {
 	snd_rawmidi_hw_t *hw = rmidi->private_data;
+	unsigned int mode = params->mode;
+	int framing, err = 0;
+
+	/* older kernels do not know the mode field, let the caller stamp */
+	framing = rmidi->stream == SND_RAWMIDI_STREAM_INPUT &&
+		  hw->version >= SNDRV_PROTOCOL_VERSION(2, 0, 2) &&
+		  (mode & SNDRV_RAWMIDI_MODE_FRAMING_MASK) == SNDRV_RAWMIDI_MODE_FRAMING_TSTAMP;
+	if (framing && !hw->frames) {
+		hw->frames = malloc(HW_TREAD_FRAMES * sizeof(*hw->frames));
+		if (!hw->frames)
+			return -ENOMEM;
+	}
 	params->stream = rmidi->stream;
+	if (!framing)
+		params->mode = 0;
 	if (ioctl(hw->fd, SNDRV_RAWMIDI_IOCTL_PARAMS, params) < 0) {
 		SYSERR("SNDRV_RAWMIDI_IOCTL_PARAMS failed");
-		return -errno;
+		err = -errno;
+	} else {
+		rmidi->tstamp_kernel = framing;
+		hw->frames_count = hw->frames_pos = hw->frames_ofs = 0;
 	}
-	return 0;
+	params->mode = mode;
+	return err;
 }
 
 static int snd_rawmidi_hw_status(snd_rawmidi_t *rmidi, snd_rawmidi_status_t * status)
@@ -122,6 +150,9 @@ static int snd_rawmidi_hw_drop(snd_rawmidi_t *rmidi)
 		SYSERR("SNDRV_RAWMIDI_IOCTL_DROP failed");
 		return -errno;
 	}
+	/* the fetched input frames are dropped as well */
+	if (str == SND_RAWMIDI_STREAM_INPUT)
+		hw->frames_count = hw->frames_pos = hw->frames_ofs = 0;
 	return 0;
 }
 
@@ -156,6 +187,56 @@ static ssize_t snd_rawmidi_hw_read(snd_rawmidi_t *rmidi, void *buffer, size_t si
 	return result;
 }
 
+/*
+ * Return the data bytes of the consecutive frames which share the
+ * timestamp of the first one.  A frame which does not fit is continued
+ * by the next call.
+ */
+static ssize_t snd_rawmidi_hw_tread(snd_rawmidi_t *rmidi, struct timespec *tstamp,
+				    void *buffer, size_t size)
+{
+	snd_rawmidi_hw_t *hw = rmidi->private_data;
+	struct snd_rawmidi_framing_tstamp *f;
+	unsigned char *dst = buffer;
+	size_t ret = 0, len;
+	ssize_t result;
+
+	while (ret == 0 && size > 0) {
+		if (hw->frames_pos >= hw->frames_count) {
+			result = read(hw->fd, hw->frames, HW_TREAD_FRAMES * sizeof(*f));
+			if (result < 0)
+				return -errno;
+			if (result == 0)
+				return 0;
+			hw->frames_count = result / sizeof(*f);
+			hw->frames_pos = 0;
+			hw->frames_ofs = 0;
+		}
+		for (; hw->frames_pos < hw->frames_count && ret < size; hw->frames_pos++, hw->frames_ofs = 0) {
+			f = &hw->frames[hw->frames_pos];
+			/* unknown frame types are skipped */
+			if (f->frame_type != 0 || f->length > SNDRV_RAWMIDI_FRAMING_DATA_LENGTH)
+				continue;
+			if (ret == 0) {
+				tstamp->tv_sec = f->tv_sec;
+				tstamp->tv_nsec = f->tv_nsec;
+			} else if (tstamp->tv_sec != (time_t)f->tv_sec ||
+				   tstamp->tv_nsec != (long)f->tv_nsec) {
+				break;
+			}
+			len = f->length - hw->frames_ofs;
+			if (len > size - ret)
+				len = size - ret;
+			memcpy(dst + ret, f->data + hw->frames_ofs, len);
+			ret += len;
+			hw->frames_ofs += len;
+			if (hw->frames_ofs < f->length)
+				break;
+		}
+	}
+	return ret;
+}
+
 static const snd_rawmidi_ops_t snd_rawmidi_hw_ops = {
 	.close = snd_rawmidi_hw_close,
 	.nonblock = snd_rawmidi_hw_nonblock,
@@ -166,6 +247,7 @@ static const snd_rawmidi_ops_t snd_rawmidi_hw_ops = {
 	.drain = snd_rawmidi_hw_drain,
 	.write = snd_rawmidi_hw_write,
 	.read = snd_rawmidi_hw_read,
+	.tread = snd_rawmidi_hw_tread,
 };
 
 
@@ -272,6 +354,7 @@ int snd_rawmidi_hw_open(snd_rawmidi_t **inputp, snd_rawmidi_t **outputp,
 	hw->device = device;
 	hw->subdevice = subdevice;
 	hw->fd = fd;
+	hw->version = ver;
 
 	if (inputp) {
 		rmidi = calloc(1, sizeof(snd_rawmidi_t));
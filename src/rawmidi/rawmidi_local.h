@@ -34,8 +34,11 @@ typedef struct {
 	int (*drain)(snd_rawmidi_t *rawmidi);
 	ssize_t (*write)(snd_rawmidi_t *rawmidi, const void *buffer, size_t size);
 	ssize_t (*read)(snd_rawmidi_t *rawmidi, void *buffer, size_t size);
+	ssize_t (*tread)(snd_rawmidi_t *rawmidi, struct timespec *tstamp, void *buffer, size_t size);
 } snd_rawmidi_ops_t;
 
+typedef struct _snd_rawmidi_parser snd_rawmidi_parser_t;
+
 struct _snd_rawmidi {
 	void *open_func;
 	char *name;
@@ -48,6 +51,9 @@ struct _snd_rawmidi {
 	size_t buffer_size;
 	size_t avail_min;
 	unsigned int no_active_sensing: 1;
+	unsigned int params_mode;
+	unsigned int tstamp_kernel: 1;	/* set by params when tread delivers driver timestamps */
+	snd_rawmidi_parser_t *parser;	/* snd_rawmidi_read_messages() state */
 };
 
 int snd_rawmidi_hw_open(snd_rawmidi_t **input, snd_rawmidi_t **output,
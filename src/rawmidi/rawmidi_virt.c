@@ -52,8 +52,16 @@ typedef struct {
 
 	snd_seq_event_t out_event;
 	int pending;
+	int out_sysex;		/* inside a SysEx sent from the caller's buffer */
 } snd_rawmidi_virtual_t;
 
+/* SysEx messages from this size on are sent without copying */
+#define VIRT_SYSEX_DIRECT_MIN	256
+/* SysEx event size, fits the default input buffer of the receivers */
+#define VIRT_SYSEX_CHUNK	2048
+/* max. SysEx events written at once */
+#define VIRT_SYSEX_BATCH	32
+
 int _snd_seq_open_lconf(snd_seq_t **seqp, const char *name, 
 			int streams, int mode, snd_config_t *lconf,
 			snd_config_t *parent_conf);
@@ -162,6 +170,7 @@ static int snd_rawmidi_virtual_drop(snd_rawmidi_t *rmidi)
 		snd_seq_drop_output(virt->handle);
 		snd_midi_event_reset_encode(virt->midi_event);
 		virt->pending = 0;
+		virt->out_sysex = 0;
 	} else {
 		snd_seq_drop_input(virt->handle);
 		snd_midi_event_reset_decode(virt->midi_event);
@@ -188,11 +197,102 @@ static int snd_rawmidi_virtual_drain(snd_rawmidi_t *rmidi)
 	return snd_rawmidi_virtual_drop(rmidi);
 }
 
+/* number of leading data bytes (below 0x80) */
+static size_t sysex_data_bytes(const unsigned char *buf, size_t size)
+{
+	size_t n = 0;
+
+	while (n < size && buf[n] < 0x80)
+		n++;
+	return n;
+}
+
+/*
+ * Send parts of a SysEx message as events referring to the caller's
+ * buffer.  The sequencer copies the data from there when the events are
+ * written, so none of them may stay in the output buffer.  Returns the
+ * number of events sent, or a negative error code.
+ */
+static int snd_rawmidi_virtual_send_sysex(snd_rawmidi_virtual_t *virt,
+					  snd_seq_event_t *evs, unsigned int count)
+{
+	int err, sent;
+
+	err = snd_seq_drain_output(virt->handle);
+	if (err < 0)
+		return err;
+	sent = snd_seq_event_output_array(virt->handle, evs, count);
+	if (sent < 0)
+		return sent;
+	err = snd_seq_drain_output(virt->handle);
+	if (err < 0) {
+		sent -= snd_seq_event_output_pending(virt->handle) / sizeof(snd_seq_event_t);
+		snd_seq_drop_output_buffer(virt->handle);
+		if (sent <= 0)
+			return err;
+	}
+	return sent;
+}
+
+/*
+ * Write the SysEx data at the start of the buffer without copying it.
+ * Returns the number of bytes consumed, 0 if the bytes are left to the
+ * MIDI encoder, or a negative error code.
+ */
+static ssize_t snd_rawmidi_virtual_write_sysex(snd_rawmidi_virtual_t *virt,
+					       const unsigned char *buf, size_t size)
+{
+	snd_seq_event_t evs[VIRT_SYSEX_BATCH];
+	size_t start = 0, span, pos, len;
+	unsigned int count;
+	int sent;
+
+	if (!virt->out_sysex) {
+		/* a long message starting here */
+		if (buf[0] != MIDI_CMD_COMMON_SYSEX ||
+		    1 + sysex_data_bytes(buf + 1, size - 1) < VIRT_SYSEX_DIRECT_MIN)
+			return 0;
+		start = 1;
+	} else if (buf[0] >= 0x80 && buf[0] != MIDI_CMD_COMMON_SYSEX_END) {
+		if (buf[0] >= MIDI_CMD_COMMON_CLOCK)
+			return 0;	/* real-time messages go on */
+		/* interrupted by another message */
+		virt->out_sysex = 0;
+		return 0;
+	}
+	span = start + sysex_data_bytes(buf + start, size - start);
+	if (span < size && buf[span] == MIDI_CMD_COMMON_SYSEX_END)
+		span++;
+	for (pos = 0, count = 0; pos < span && count < VIRT_SYSEX_BATCH; count++) {
+		len = span - pos;
+		if (len > VIRT_SYSEX_CHUNK)
+			len = VIRT_SYSEX_CHUNK;
+		snd_seq_ev_clear(&evs[count]);
+		evs[count].type = SND_SEQ_EVENT_SYSEX;
+		snd_seq_ev_set_varusr(&evs[count], len, (void *)(buf + pos));
+		snd_seq_ev_set_subs(&evs[count]);
+		snd_seq_ev_set_source(&evs[count], virt->port);
+		snd_seq_ev_set_direct(&evs[count]);
+		pos += len;
+	}
+	sent = snd_rawmidi_virtual_send_sysex(virt, evs, count);
+	if (sent < 0)
+		return sent;
+	if (start)
+		snd_midi_event_reset_encode(virt->midi_event);
+	len = (const unsigned char *)evs[sent - 1].data.ext.ptr +
+		evs[sent - 1].data.ext.len - buf;
+	virt->out_sysex = buf[len - 1] != MIDI_CMD_COMMON_SYSEX_END;
+	return len;
+}
+
 static ssize_t snd_rawmidi_virtual_write(snd_rawmidi_t *rmidi, const void *buffer, size_t size)
 {
 	snd_rawmidi_virtual_t *virt = rmidi->private_data;
 	ssize_t result = 0;
 	ssize_t size1;
+	size_t len;
+	const unsigned char *p;
 	int err;
 
 	if (virt->pending) {
@@ -209,7 +309,25 @@ static ssize_t snd_rawmidi_virtual_write(snd_rawmidi_t *rmidi, const void *buffe
 	}
 
 	while (size > 0) {
-		size1 = snd_midi_event_encode(virt->midi_event, buffer, size, &virt->out_event);
+		size1 = snd_rawmidi_virtual_write_sysex(virt, buffer, size);
+		if (size1 < 0)
+			return result > 0 ? result : size1;
+		if (size1 > 0) {
+			size -= size1;
+			result += size1;
+			buffer += size1;
+			continue;
+		}
+		/* let the encoder stop at a SysEx which may be sent directly */
+		len = size;
+		if (virt->out_sysex) {
+			len = 1;
+		} else {
+			p = memchr((const char *)buffer + 1, MIDI_CMD_COMMON_SYSEX, size - 1);
+			if (p)
+				len = p - (const unsigned char *)buffer;
+		}
+		size1 = snd_midi_event_encode(virt->midi_event, buffer, len, &virt->out_event);
 		if (size1 <= 0)
 			break;
 		size -= size1;
@@ -278,6 +396,17 @@ static ssize_t snd_rawmidi_virtual_read(snd_rawmidi_t *rmidi, void *buffer, size
 	return result;
 }
 
+/* event types which snd_midi_event_decode() turns into MIDI bytes */
+static const unsigned char snd_rawmidi_virtual_input_types[] = {
+	SND_SEQ_EVENT_NOTEOFF, SND_SEQ_EVENT_NOTEON, SND_SEQ_EVENT_KEYPRESS,
+	SND_SEQ_EVENT_CONTROLLER, SND_SEQ_EVENT_PGMCHANGE, SND_SEQ_EVENT_CHANPRESS,
+	SND_SEQ_EVENT_PITCHBEND, SND_SEQ_EVENT_CONTROL14, SND_SEQ_EVENT_NONREGPARAM,
+	SND_SEQ_EVENT_REGPARAM, SND_SEQ_EVENT_SYSEX, SND_SEQ_EVENT_QFRAME,
+	SND_SEQ_EVENT_SONGPOS, SND_SEQ_EVENT_SONGSEL, SND_SEQ_EVENT_TUNE_REQUEST,
+	SND_SEQ_EVENT_CLOCK, SND_SEQ_EVENT_START, SND_SEQ_EVENT_CONTINUE,
+	SND_SEQ_EVENT_STOP, SND_SEQ_EVENT_SENSING, SND_SEQ_EVENT_RESET,
+};
+
 static const snd_rawmidi_ops_t snd_rawmidi_virtual_ops = {
 	.close = snd_rawmidi_virtual_close,
 	.nonblock = snd_rawmidi_virtual_nonblock,
@@ -318,6 +447,7 @@ int snd_rawmidi_virtual_open(snd_rawmidi_t **inputp, snd_rawmidi_t **outputp,
 	snd_rawmidi_t *rmidi;
 	snd_rawmidi_virtual_t *virt = NULL;
 	struct pollfd pfd;
+	unsigned int i;
 
 	if (inputp)
 		*inputp = 0;
@@ -356,6 +486,12 @@ int snd_rawmidi_virtual_open(snd_rawmidi_t **inputp, snd_rawmidi_t **outputp,
 		rmidi->private_data = virt;
 		virt->open++;
 		*inputp = rmidi;
+		/* drop announcements and other non-MIDI events as they are read */
+		for (i = 0; i < sizeof(snd_rawmidi_virtual_input_types); i++) {
+			err = snd_seq_set_input_filter(seq_handle, snd_rawmidi_virtual_input_types[i]);
+			if (err < 0)
+				goto _err;
+		}
 	}
 	if (outputp) {
 		rmidi = calloc(1, sizeof(*rmidi));
@@ -779,6 +779,9 @@ void event_filter(snd_seq_t *seq, snd_seq_event_t *ev)
 
 #include <poll.h>
 #include "seq_local.h"
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 /****************************************************************************
  *                                                                          *
@@ -1021,6 +1024,8 @@ int _snd_seq_open_lconf(snd_seq_t **seqp, const char *name,
 }
 #endif
 
+static void mt_free(snd_seq_t *seq);
+
 /**
  * \brief Close the sequencer
  * \param seq Handle returned from #snd_seq_open()
@@ -1041,9 +1046,11 @@ int snd_seq_close(snd_seq_t *seq)
 	err = seq->ops->close(seq);
 	if (seq->dl_handle)
 		snd_dlclose(seq->dl_handle);
+	mt_free(seq);
 	free(seq->obuf);
 	free(seq->ibuf);
 	free(seq->tmpbuf);
+	free(seq->idispatch);
 	free(seq->name);
 	free(seq);
 	return err;
@@ -1239,7 +1246,11 @@ int snd_seq_set_output_buffer_size(snd_seq_t *seq, size_t size)
 		free(seq->obuf);
 		seq->obuf = newbuf;
 		seq->obufsize = size;
+		seq->allocs++;
 	}
+	seq->obufmin = size;
+	if (seq->obufmax < size)
+		seq->obufmax = 0;
 	return 0;
 }
 
@@ -1267,10 +1278,162 @@ int snd_seq_set_input_buffer_size(snd_seq_t *seq, size_t size)
 		free(seq->ibuf);
 		seq->ibuf = newbuf;
 		seq->ibufsize = size;
+		seq->allocs++;
 	}
+	seq->ibufmin = size;
+	if (seq->ibufmax < size)
+		seq->ibufmax = 0;
+	return 0;
+}
+
+/**
+ * \brief Let the output buffer follow the size of the bursts
+ * \param seq sequencer handle
+ * \param size the maximal size of output buffer in bytes, 0 for a fixed size
+ * \return 0 on success otherwise a negative error code
+ *
+ * When the output buffer becomes full before it is drained, it is
+ * doubled at the next drain, up to \a size.  When the drains stayed
+ * below a quarter of the buffer for a while, it shrinks back to twice
+ * the largest drain, but not below the current size.  The buffer is
+ * resized only while it is empty.
+ *
+ * \sa snd_seq_set_output_buffer_size(), snd_seq_get_buffer_allocs()
+ */
+int snd_seq_set_output_buffer_max(snd_seq_t *seq, size_t size)
+{
+	assert(seq && seq->obuf);
+	if (size && size < seq->obufsize)
+		return -EINVAL;
+	seq->obufmin = seq->obufsize;
+	seq->obufmax = size;
+	seq->obufpeak = 0;
+	seq->obufdrains = 0;
+	seq->obuffull = 0;
+	return 0;
+}
+
+/**
+ * \brief Let the input buffer follow the size of the bursts
+ * \param seq sequencer handle
+ * \param size the maximal size of input buffer in bytes, 0 for a fixed size
+ * \return 0 on success otherwise a negative error code
+ *
+ * When a read from the sequencer fills most of the input buffer, the
+ * buffer is doubled before the next read, up to \a size.  When the
+ * reads stayed below a quarter of the buffer for a while, it shrinks
+ * back to twice the largest read, but not below the current size.
+ * An event longer than the buffer makes it grow as well instead of
+ * failing with \c -EINVAL or \c -EAGAIN, as long as it fits in \a size.
+ * The buffer is resized only when all events were retrieved, the events
+ * obtained before stay valid until the next input call as usual.
+ *
+ * \sa snd_seq_set_input_buffer_size(), snd_seq_get_buffer_allocs()
+ */
+int snd_seq_set_input_buffer_max(snd_seq_t *seq, size_t size)
+{
+	assert(seq && seq->ibuf);
+	size /= sizeof(snd_seq_event_t);
+	if (size && size < seq->ibufsize)
+		return -EINVAL;
+	seq->ibufmin = seq->ibufsize;
+	seq->ibufmax = size;
+	seq->ibufpeak = 0;
+	seq->ibufreads = 0;
+	seq->ibuffull = 0;
+	return 0;
+}
+
+/**
+ * \brief Return the number of buffer allocations
+ * \param seq sequencer handle
+ * \return the number of allocations
+ *
+ * Counts the allocations and reallocations of the input, output and
+ * temporary event buffers since the handle was opened, not including
+ * the input and output buffers allocated at open.  Once the sizes
+ * settled, a steady event flow keeps this value constant.
+ */
+unsigned int snd_seq_get_buffer_allocs(snd_seq_t *seq)
+{
+	assert(seq);
+	return seq->allocs;
+}
+
+/* resize an empty buffer, the size is rounded to whole events */
+static int seq_resize_buffer(snd_seq_t *seq, void **buf, size_t size)
+{
+	void *newbuf;
+
+	newbuf = malloc(size);
+	if (newbuf == NULL)
+		return -ENOMEM;
+	free(*buf);
+	*buf = newbuf;
+	seq->allocs++;
 	return 0;
 }
 
+/* called after a complete drain of burst bytes */
+static void obuf_adapt(snd_seq_t *seq, size_t burst)
+{
+	size_t size = seq->obufsize;
+
+	if (burst > seq->obufpeak)
+		seq->obufpeak = burst;
+	if (seq->obuffull) {
+		seq->obuffull = 0;
+		if (size < seq->obufmax) {
+			size *= 2;
+			if (size > seq->obufmax)
+				size = seq->obufmax;
+		}
+	} else if (++seq->obufdrains >= SND_SEQ_BUF_WINDOW) {
+		if (seq->obufpeak * 4 <= size && size > seq->obufmin) {
+			size = seq->obufpeak * 2;
+			if (size < seq->obufmin)
+				size = seq->obufmin;
+		}
+		seq->obufpeak = 0;
+		seq->obufdrains = 0;
+	}
+	if (size != seq->obufsize &&
+	    seq_resize_buffer(seq, (void **)&seq->obuf, size) >= 0) {
+		seq->obufsize = size;
+		seq->obufpeak = 0;
+		seq->obufdrains = 0;
+	}
+}
+
+/* called before a read into the empty input buffer */
+static void ibuf_adapt(snd_seq_t *seq)
+{
+	size_t size = seq->ibufsize;
+
+	if (seq->ibuffull) {
+		seq->ibuffull = 0;
+		if (size < seq->ibufmax) {
+			size *= 2;
+			if (size > seq->ibufmax)
+				size = seq->ibufmax;
+		}
+	} else if (seq->ibufreads >= SND_SEQ_BUF_WINDOW) {
+		if (seq->ibufpeak * 4 <= size && size > seq->ibufmin) {
+			size = seq->ibufpeak * 2;
+			if (size < seq->ibufmin)
+				size = seq->ibufmin;
+		}
+		seq->ibufpeak = 0;
+		seq->ibufreads = 0;
+	}
+	if (size != seq->ibufsize &&
+	    seq_resize_buffer(seq, (void **)&seq->ibuf, size * sizeof(snd_seq_event_t)) >= 0) {
+		seq->ibufsize = size;
+		seq->ibufpeak = 0;
+		seq->ibufreads = 0;
+	}
+}
+
 
 /**
  * \brief Get size of #snd_seq_system_info_t
@@ -3879,6 +4042,250 @@ ssize_t snd_seq_event_length(snd_seq_event_t *ev)
  * output to sequencer
  */
 
+static char *obuf_reserve(snd_seq_t *seq, size_t len);
+static void obuf_reset(snd_seq_t *seq);
+static int snd_seq_drain_obuf(snd_seq_t *seq);
+
+#define SEQ_MT_CELLS	512	/* ring size in events */
+#define SEQ_MT_SPILL	64	/* longest staged event in cells */
+
+#ifdef HAVE_LIBPTHREAD
+/*
+ * Multi-producer output: each producer thread stages its events in a
+ * private ring, and the thread which drains the output merges the rings
+ * into the output buffer.  A ring has one writer (its thread) and one
+ * reader (the drainer holding drain_lock), so the head and tail indices
+ * are published with plain acquire/release atomics.  An event is always
+ * stored contiguously: the part of an event crossing the end of the ring
+ * goes to the spill cells and is mirrored to the start.
+ */
+typedef struct snd_seq_mt_ring {
+	struct snd_seq_mt_ring *next;
+	int owned;		/* claimed by a producer thread */
+	size_t head;		/* consumed cells, advanced by the drainer */
+	size_t tail;		/* produced cells, advanced by the owner */
+	snd_seq_event_t cells[SEQ_MT_CELLS + SEQ_MT_SPILL];
+} snd_seq_mt_ring_t;
+
+struct _snd_seq_mt {
+	pthread_key_t key;
+	pthread_mutex_t drain_lock;
+	snd_seq_mt_ring_t *rings;	/* only prepended while enabled */
+};
+
+static void mt_ring_release(void *ptr)
+{
+	snd_seq_mt_ring_t *ring = ptr;
+
+	/* the staged events stay and are merged by the next drain */
+	__atomic_store_n(&ring->owned, 0, __ATOMIC_RELEASE);
+}
+
+static snd_seq_mt_ring_t *mt_ring(snd_seq_mt_t *mt)
+{
+	snd_seq_mt_ring_t *ring;
+	int owned;
+
+	ring = pthread_getspecific(mt->key);
+	if (ring)
+		return ring;
+	/* take over a ring of an exited thread */
+	for (ring = __atomic_load_n(&mt->rings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+		owned = 0;
+		if (__atomic_compare_exchange_n(&ring->owned, &owned, 1, 0,
+						__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			goto __found;
+	}
+	ring = calloc(1, sizeof(*ring));
+	if (!ring)
+		return NULL;
+	ring->owned = 1;
+	ring->next = __atomic_load_n(&mt->rings, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&mt->rings, &ring->next, ring, 1,
+					    __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		;
+      __found:
+	if (pthread_setspecific(mt->key, ring)) {
+		mt_ring_release(ring);
+		return NULL;
+	}
+	return ring;
+}
+
+/* stage an event in the ring of the calling thread */
+static int mt_stage(snd_seq_t *seq, snd_seq_event_t *ev, size_t len)
+{
+	snd_seq_mt_ring_t *ring;
+	size_t cells, head, tail, pos;
+
+	ring = mt_ring(seq->mt);
+	if (!ring)
+		return -ENOMEM;
+	cells = (len + sizeof(snd_seq_event_t) - 1) / sizeof(snd_seq_event_t);
+	tail = ring->tail;
+	head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	if (SEQ_MT_CELLS - (tail - head) < cells)
+		return -EAGAIN;
+	pos = tail % SEQ_MT_CELLS;
+	ring->cells[pos] = *ev;
+	if (snd_seq_ev_is_variable(ev))
+		memcpy(&ring->cells[pos + 1], ev->data.ext.ptr, ev->data.ext.len);
+	if (pos + cells > SEQ_MT_CELLS)
+		memcpy(ring->cells, &ring->cells[SEQ_MT_CELLS],
+		       (pos + cells - SEQ_MT_CELLS) * sizeof(snd_seq_event_t));
+	__atomic_store_n(&ring->tail, tail + cells, __ATOMIC_RELEASE);
+	return (tail + cells - head) * sizeof(snd_seq_event_t);
+}
+
+/* move the staged events to the output buffer; called with drain_lock */
+static int mt_merge(snd_seq_t *seq)
+{
+	snd_seq_mt_ring_t *ring;
+	snd_seq_event_t *ev;
+	size_t head, tail, len;
+	char *buf;
+	int err;
+
+	for (ring = __atomic_load_n(&seq->mt->rings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+		head = ring->head;
+		tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+		while (head != tail) {
+			ev = &ring->cells[head % SEQ_MT_CELLS];
+			len = snd_seq_event_length(ev);
+			buf = obuf_reserve(seq, len);
+			if (!buf) {
+				__atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+				err = snd_seq_drain_obuf(seq);
+				if (err < 0)
+					return err;
+				continue;
+			}
+			memcpy(buf, ev, len);
+			head += (len + sizeof(snd_seq_event_t) - 1) / sizeof(snd_seq_event_t);
+		}
+		__atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+	}
+	return 0;
+}
+
+static size_t mt_pending(snd_seq_t *seq)
+{
+	snd_seq_mt_ring_t *ring;
+	size_t cells = 0;
+
+	for (ring = __atomic_load_n(&seq->mt->rings, __ATOMIC_ACQUIRE); ring; ring = ring->next)
+		cells += __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) -
+			 __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	return cells * sizeof(snd_seq_event_t);
+}
+
+static void mt_drop(snd_seq_t *seq)
+{
+	snd_seq_mt_ring_t *ring;
+
+	for (ring = __atomic_load_n(&seq->mt->rings, __ATOMIC_ACQUIRE); ring; ring = ring->next)
+		__atomic_store_n(&ring->head, __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE),
+				 __ATOMIC_RELEASE);
+}
+
+static void mt_lock(snd_seq_t *seq)
+{
+	pthread_mutex_lock(&seq->mt->drain_lock);
+}
+
+static void mt_unlock(snd_seq_t *seq)
+{
+	pthread_mutex_unlock(&seq->mt->drain_lock);
+}
+
+static void mt_free(snd_seq_t *seq)
+{
+	snd_seq_mt_ring_t *ring, *next;
+
+	if (!seq->mt)
+		return;
+	pthread_key_delete(seq->mt->key);
+	pthread_mutex_destroy(&seq->mt->drain_lock);
+	for (ring = seq->mt->rings; ring; ring = next) {
+		next = ring->next;
+		free(ring);
+	}
+	free(seq->mt);
+	seq->mt = NULL;
+}
+#else
+static inline int mt_stage(snd_seq_t *seq ATTRIBUTE_UNUSED, snd_seq_event_t *ev ATTRIBUTE_UNUSED,
+			   size_t len ATTRIBUTE_UNUSED) { return -ENXIO; }
+static inline int mt_merge(snd_seq_t *seq ATTRIBUTE_UNUSED) { return 0; }
+static inline size_t mt_pending(snd_seq_t *seq ATTRIBUTE_UNUSED) { return 0; }
+static inline void mt_drop(snd_seq_t *seq ATTRIBUTE_UNUSED) { }
+static inline void mt_lock(snd_seq_t *seq ATTRIBUTE_UNUSED) { }
+static inline void mt_unlock(snd_seq_t *seq ATTRIBUTE_UNUSED) { }
+static void mt_free(snd_seq_t *seq ATTRIBUTE_UNUSED) { }
+#endif
+
+/**
+ * \brief enable or disable the multi-producer output mode
+ * \param seq sequencer handle
+ * \param enable non-zero to enable, zero to disable
+ * \return 0 on success otherwise a negative error code
+ *
+ * In the multi-producer mode several threads may call
+ * #snd_seq_event_output(), #snd_seq_event_output_buffer(),
+ * #snd_seq_event_output_array(), #snd_seq_event_output_direct() and
+ * #snd_seq_drain_output() on the same handle without a lock of their
+ * own.  Each thread stages its events in a private buffer without
+ * locking; the staged events are moved to the output buffer when the
+ * output is drained, which is serialized internally.  The events of
+ * one thread keep their order, there is no order between the threads.
+ *
+ * The other output functions, e.g. #snd_seq_extract_output() or
+ * #snd_seq_set_output_buffer_size(), are not thread-safe and see only
+ * the events already merged.  Switching the mode must not race with the
+ * output functions.  When the mode is disabled, the staged events are
+ * merged into the output buffer first; if they do not fit, the error is
+ * returned and the mode stays enabled.
+ *
+ * Returns \c -ENXIO when the library was built without thread support.
+ */
+int snd_seq_set_output_mt(snd_seq_t *seq, int enable)
+{
+#ifdef HAVE_LIBPTHREAD
+	snd_seq_mt_t *mt;
+	int err;
+
+	assert(seq);
+	if (!enable) {
+		if (!seq->mt)
+			return 0;
+		mt_lock(seq);
+		err = mt_merge(seq);
+		mt_unlock(seq);
+		if (err < 0)
+			return err;
+		mt_free(seq);
+		return 0;
+	}
+	if (seq->mt)
+		return 0;
+	mt = calloc(1, sizeof(*mt));
+	if (!mt)
+		return -ENOMEM;
+	err = pthread_key_create(&mt->key, mt_ring_release);
+	if (err) {
+		free(mt);
+		return -err;
+	}
+	pthread_mutex_init(&mt->drain_lock, NULL);
+	seq->mt = mt;
+	return 0;
+#else
+	assert(seq);
+	return enable ? -ENXIO : 0;
+#endif
+}
+
+
 /**
  * \brief output an event
  * \param seq sequencer handle
@@ -3911,6 +4318,72 @@ int snd_seq_event_output(snd_seq_t *seq, snd_seq_event_t *ev)
 	return result;
 }
 
+/*
+ * The output buffer is a ring of whole events.  An event never wraps
+ * around the end of the buffer, the space behind the last event is left
+ * unused instead, so each of the (at most two) contiguous regions holds
+ * only complete events and can be passed to the write op as it is.
+ */
+static char *obuf_reserve(snd_seq_t *seq, size_t len)
+{
+	size_t pos;
+
+	if (seq->obufwrap) {
+		if (seq->obufhead - seq->obuftail < len)
+			goto _full;
+	} else if (seq->obufsize - seq->obuftail < len) {
+		if (seq->obufhead < len)
+			goto _full;
+		seq->obufwrap = seq->obuftail;
+		seq->obuftail = 0;
+	}
+	pos = seq->obuftail;
+	seq->obuftail += len;
+	seq->obufused += len;
+	return seq->obuf + pos;
+
+ _full:
+	seq->obuffull = 1;
+	return NULL;
+}
+
+static void obuf_reset(snd_seq_t *seq)
+{
+	seq->obufused = 0;
+	seq->obufhead = 0;
+	seq->obuftail = 0;
+	seq->obufwrap = 0;
+}
+
+/* remove the first len bytes (whole events) from the output buffer */
+static void obuf_consume(snd_seq_t *seq, size_t len)
+{
+	seq->obufused -= len;
+	if (seq->obufused == 0) {
+		obuf_reset(seq);
+		return;
+	}
+	seq->obufhead += len;
+	if (seq->obufwrap && seq->obufhead >= seq->obufwrap) {
+		seq->obufhead -= seq->obufwrap;
+		seq->obufwrap = 0;
+	}
+}
+
+static int snd_seq_event_output_obuf(snd_seq_t *seq, snd_seq_event_t *ev)
+{
+	size_t len = snd_seq_event_length(ev);
+	char *buf;
+
+	buf = obuf_reserve(seq, len);
+	if (buf == NULL)
+		return -EAGAIN;
+	memcpy(buf, ev, sizeof(snd_seq_event_t));
+	if (snd_seq_ev_is_variable(ev))
+		memcpy(buf + sizeof(snd_seq_event_t), ev->data.ext.ptr, ev->data.ext.len);
+	return seq->obufused;
+}
+
 /**
  * \brief output an event onto the lib buffer without draining buffer
  * \param seq sequencer handle
@@ -3930,40 +4403,134 @@ int snd_seq_event_output_buffer(snd_seq_t *seq, snd_seq_event_t *ev)
 		return -EINVAL;
 	if ((size_t) len >= seq->obufsize)
 		return -EINVAL;
-	if ((seq->obufsize - seq->obufused) < (size_t) len)
-		return -EAGAIN;
-	memcpy(seq->obuf + seq->obufused, ev, sizeof(snd_seq_event_t));
-	seq->obufused += sizeof(snd_seq_event_t);
-	if (snd_seq_ev_is_variable(ev)) {
-		memcpy(seq->obuf + seq->obufused, ev->data.ext.ptr, ev->data.ext.len);
-		seq->obufused += ev->data.ext.len;
+	if (seq->mt) {
+		if ((size_t) len <= SEQ_MT_SPILL * sizeof(snd_seq_event_t))
+			return mt_stage(seq, ev, len);
+		/* too long for staging, place it after the staged events */
+		mt_lock(seq);
+		len = mt_merge(seq);
+		if (len >= 0)
+			len = snd_seq_event_output_obuf(seq, ev);
+		mt_unlock(seq);
+		return len;
 	}
-	return seq->obufused;
+	return snd_seq_event_output_obuf(seq, ev);
+}
+
+/**
+ * \brief output an array of events
+ * \param seq sequencer handle
+ * \param evs array of events to be output
+ * \param count number of events in the array
+ * \return the number of events put onto the output buffer otherwise
+ *         a negative error code
+ *
+ * Puts the events onto the output buffer like calling
+ * #snd_seq_event_output() for each of them, draining the buffer to the
+ * sequencer when it becomes full.  Runs of fixed length events are
+ * copied into the buffer at once.
+ *
+ * When an error occurs after some events were put onto the buffer, the
+ * number of these events is returned.  The remaining events are not
+ * output.
+ *
+ * \sa snd_seq_event_output(), snd_seq_event_input_array()
+ */
+int snd_seq_event_output_array(snd_seq_t *seq, snd_seq_event_t *evs, unsigned int count)
+{
+	unsigned int idx = 0, run;
+	size_t space;
+	ssize_t len;
+	char *buf;
+	int err;
+
+	assert(seq && (evs || !count));
+	if (seq->mt) {
+		for (; idx < count; idx++) {
+			err = snd_seq_event_output(seq, &evs[idx]);
+			if (err < 0)
+				goto _error;
+		}
+		return idx;
+	}
+	while (idx < count) {
+		if (snd_seq_ev_is_variable(&evs[idx])) {
+			len = snd_seq_event_length(&evs[idx]);
+			if (len < 0 || (size_t)len >= seq->obufsize) {
+				err = -EINVAL;
+				goto _error;
+			}
+			buf = obuf_reserve(seq, len);
+			if (buf == NULL)
+				goto _drain;
+			memcpy(buf, &evs[idx], sizeof(snd_seq_event_t));
+			memcpy(buf + sizeof(snd_seq_event_t), evs[idx].data.ext.ptr,
+			       evs[idx].data.ext.len);
+			idx++;
+			continue;
+		}
+		for (run = 1; idx + run < count; run++)
+			if (snd_seq_ev_is_variable(&evs[idx + run]))
+				break;
+		space = seq->obufwrap ? seq->obufhead - seq->obuftail :
+					seq->obufsize - seq->obuftail;
+		if (space / sizeof(snd_seq_event_t) < run)
+			run = space / sizeof(snd_seq_event_t);
+		if (!run)
+			run = 1;	/* may be placed after the wrap */
+		buf = obuf_reserve(seq, run * sizeof(snd_seq_event_t));
+		if (buf == NULL)
+			goto _drain;
+		memcpy(buf, &evs[idx], run * sizeof(snd_seq_event_t));
+		idx += run;
+		continue;
+	 _drain:
+		err = snd_seq_drain_output(seq);
+		if (err < 0)
+			goto _error;
+	}
+	return idx;
+
+ _error:
+	return idx ? (int)idx : err;
 }
 
 /*
  * allocate the temporary buffer
  */
+/*
+ * the temporary buffer is kept and grows in powers of two, so a stream
+ * of variable length events of similar sizes does not allocate
+ */
 static int alloc_tmpbuf(snd_seq_t *seq, size_t len)
 {
 	size_t size = ((len + sizeof(snd_seq_event_t) - 1) / sizeof(snd_seq_event_t));
-	if (seq->tmpbuf == NULL) {
-		if (size > DEFAULT_TMPBUF_SIZE)
-			seq->tmpbufsize = size;
-		else
-			seq->tmpbufsize = DEFAULT_TMPBUF_SIZE;
-		seq->tmpbuf = malloc(seq->tmpbufsize * sizeof(snd_seq_event_t));
-		if (seq->tmpbuf == NULL)
-			return -ENOMEM;
-	}  else if (len > seq->tmpbufsize) {
-		seq->tmpbuf = realloc(seq->tmpbuf, size * sizeof(snd_seq_event_t));
-		if (seq->tmpbuf == NULL)
-			return -ENOMEM;
-		seq->tmpbufsize = size;
-	}
+	size_t newsize;
+	snd_seq_event_t *newbuf;
+
+	if (seq->tmpbuf && size <= seq->tmpbufsize)
+		return 0;
+	newsize = seq->tmpbuf ? seq->tmpbufsize : DEFAULT_TMPBUF_SIZE;
+	while (newsize < size)
+		newsize *= 2;
+	newbuf = realloc(seq->tmpbuf, newsize * sizeof(snd_seq_event_t));
+	if (newbuf == NULL)
+		return -ENOMEM;
+	seq->tmpbuf = newbuf;
+	seq->tmpbufsize = newsize;
+	seq->allocs++;
 	return 0;
 }
 
+static ssize_t snd_seq_event_output_tmpbuf(snd_seq_t *seq, snd_seq_event_t *ev, size_t len)
+{
+	if (alloc_tmpbuf(seq, len) < 0)
+		return -ENOMEM;
+	*seq->tmpbuf = *ev;
+	memcpy(seq->tmpbuf + 1, ev->data.ext.ptr, ev->data.ext.len);
+	return seq->ops->write(seq, seq->tmpbuf, len);
+}
+
 /**
  * \brief output an event directly to the sequencer NOT through output buffer
  * \param seq sequencer handle
@@ -3988,11 +4555,14 @@ int snd_seq_event_output_direct(snd_seq_t *seq, snd_seq_event_t *ev)
 	else if (len == sizeof(*ev)) {
 		buf = ev;
 	} else {
-		if (alloc_tmpbuf(seq, (size_t)len) < 0)
-			return -ENOMEM;
-		*seq->tmpbuf = *ev;
-		memcpy(seq->tmpbuf + 1, ev->data.ext.ptr, ev->data.ext.len);
-		buf = seq->tmpbuf;
+		if (seq->mt) {
+			/* serialize the use of tmpbuf */
+			mt_lock(seq);
+			len = snd_seq_event_output_tmpbuf(seq, ev, len);
+			mt_unlock(seq);
+			return len;
+		}
+		return snd_seq_event_output_tmpbuf(seq, ev, len);
 	}
 	return seq->ops->write(seq, buf, (size_t) len);
 }
@@ -4007,6 +4577,8 @@ int snd_seq_event_output_direct(snd_seq_t *seq, snd_seq_event_t *ev)
 int snd_seq_event_output_pending(snd_seq_t *seq)
 {
 	assert(seq);
+	if (seq->mt)
+		return seq->obufused + mt_pending(seq);
 	return seq->obufused;
 }
 
@@ -4027,19 +4599,48 @@ int snd_seq_event_output_pending(snd_seq_t *seq)
  */
 int snd_seq_drain_output(snd_seq_t *seq)
 {
-	ssize_t result, processed = 0;
+	int err;
+
 	assert(seq);
+	if (!seq->mt)
+		return snd_seq_drain_obuf(seq);
+	mt_lock(seq);
+	err = mt_merge(seq);
+	if (err >= 0)
+		err = snd_seq_drain_obuf(seq);
+	mt_unlock(seq);
+	return err;
+}
+
+static int snd_seq_drain_obuf(snd_seq_t *seq)
+{
+	ssize_t result, processed = 0;
+	size_t burst = seq->obufused;
+
 	while (seq->obufused > 0) {
-		result = seq->ops->write(seq, seq->obuf, seq->obufused);
+		struct iovec vec[2];
+		vec[0].iov_base = seq->obuf + seq->obufhead;
+		if (seq->obufwrap) {
+			vec[0].iov_len = seq->obufwrap - seq->obufhead;
+			vec[1].iov_base = seq->obuf;
+			vec[1].iov_len = seq->obuftail;
+		} else {
+			vec[0].iov_len = seq->obuftail - seq->obufhead;
+		}
+		if (seq->obufwrap && seq->ops->writev)
+			result = seq->ops->writev(seq, vec, 2);
+		else
+			result = seq->ops->write(seq, vec[0].iov_base, vec[0].iov_len);
 		if (result < 0) {
 			if (result == -EAGAIN && processed)
 				return seq->obufused;
 			return result;
 		}
-		if ((size_t)result < seq->obufused)
-			memmove(seq->obuf, seq->obuf + result, seq->obufused - result);
-		seq->obufused -= result;
+		obuf_consume(seq, result);
+		processed += result;
 	}
+	if (seq->obufmax && burst)
+		obuf_adapt(seq, burst);
 	return 0;
 }
 
@@ -4056,24 +4657,23 @@ int snd_seq_drain_output(snd_seq_t *seq)
  */
 int snd_seq_extract_output(snd_seq_t *seq, snd_seq_event_t **ev_res)
 {
-	size_t len, olen;
+	size_t len;
 	snd_seq_event_t ev;
 	assert(seq);
 	if (ev_res)
 		*ev_res = NULL;
-	if ((olen = seq->obufused) < sizeof(snd_seq_event_t))
+	if (seq->obufused < sizeof(snd_seq_event_t))
 		return -ENOENT;
-	memcpy(&ev, seq->obuf, sizeof(snd_seq_event_t));
+	memcpy(&ev, seq->obuf + seq->obufhead, sizeof(snd_seq_event_t));
 	len = snd_seq_event_length(&ev);
 	if (ev_res) {
 		/* extract the event */
 		if (alloc_tmpbuf(seq, len) < 0)
 			return -ENOMEM;
-		memcpy(seq->tmpbuf, seq->obuf, len);
+		memcpy(seq->tmpbuf, seq->obuf + seq->obufhead, len);
 		*ev_res = seq->tmpbuf;
 	}
-	seq->obufused = olen - len;
-	memmove(seq->obuf, seq->obuf + len, seq->obufused);
+	obuf_consume(seq, len);
 	return 0;
 }
 
@@ -4083,20 +4683,124 @@ int snd_seq_extract_output(snd_seq_t *seq, snd_seq_event_t **ev_res)
  * input from sequencer
  */
 
+/*
+ * drop the filtered events from the freshly read input buffer and pass
+ * the events with a handler to it, the remaining events are compacted
+ */
+static int snd_seq_event_dispatch_buffer(snd_seq_t *seq)
+{
+	snd_seq_input_dispatch_t *d = seq->idispatch;
+	snd_seq_event_t *ev;
+	size_t src = 0, dst = 0, cells;
+	int err, result = 0;
+
+	while (src < seq->ibuflen) {
+		ev = &seq->ibuf[src];
+		cells = 1;
+		if (snd_seq_ev_is_variable(ev)) {
+			cells += (ev->data.ext.len + sizeof(snd_seq_event_t) - 1) / sizeof(snd_seq_event_t);
+			if (cells > seq->ibuflen - src) {
+				/* truncated, reported by snd_seq_event_retrieve_buffer() */
+				cells = seq->ibuflen - src;
+				goto __keep;
+			}
+			ev->data.ext.ptr = ev + 1;
+		}
+		if (d->filtered && !snd_seq_get_bit(ev->type, d->filter))
+			goto __skip;
+		if (d->handler[ev->type].func) {
+			err = d->handler[ev->type].func(seq, ev, d->handler[ev->type].private_data);
+			if (err < 0 && !result)
+				result = err;
+			if (err <= 0)
+				goto __skip;
+		}
+	      __keep:
+		if (dst != src)
+			memmove(&seq->ibuf[dst], ev, cells * sizeof(snd_seq_event_t));
+		dst += cells;
+	      __skip:
+		src += cells;
+	}
+	seq->ibuflen = dst;
+	return result;
+}
+
+/*
+ * the kernel fails with -EAGAIN both on an empty pool and on a first
+ * event longer than the buffer, tell them apart by the pool fill
+ */
+static int snd_seq_event_input_waiting(snd_seq_t *seq)
+{
+	snd_seq_client_pool_t info;
+
+	if (snd_seq_get_client_pool(seq, &info) < 0)
+		return 0;
+	return info.input_free < info.input_pool;
+}
+
 /*
  * read from sequencer to input buffer
  */
 static ssize_t snd_seq_event_read_buffer(snd_seq_t *seq)
 {
 	ssize_t len;
-	len = (seq->ops->read)(seq, seq->ibuf, seq->ibufsize * sizeof(snd_seq_event_t));
+	size_t size;
+	int err;
+
+	if (seq->ibufmax)
+		ibuf_adapt(seq);
+	for (;;) {
+		len = (seq->ops->read)(seq, seq->ibuf, seq->ibufsize * sizeof(snd_seq_event_t));
+		/* the first event does not fit, grow while allowed */
+		if (seq->ibufsize >= seq->ibufmax)
+			break;
+		if (len == -EAGAIN) {
+			if (!snd_seq_event_input_waiting(seq))
+				break;
+		} else if (len != -EINVAL)
+			break;
+		size = seq->ibufsize;
+		seq->ibuffull = 1;
+		ibuf_adapt(seq);
+		if (seq->ibufsize == size)
+			break;		/* out of memory */
+	}
 	if (len < 0)
 		return len;
 	seq->ibuflen = len / sizeof(snd_seq_event_t);
 	seq->ibufptr = 0;
+	if (seq->ibufmax && seq->ibuflen) {
+		if (seq->ibuflen > seq->ibufpeak)
+			seq->ibufpeak = seq->ibuflen;
+		seq->ibufreads++;
+		/* the read stops early before an event that does not fit */
+		if (seq->ibuflen * 4 > seq->ibufsize * 3)
+			seq->ibuffull = 1;
+	}
+	if (seq->idispatch) {
+		err = snd_seq_event_dispatch_buffer(seq);
+		if (err < 0)
+			return err;
+	}
 	return seq->ibuflen;
 }
 
+/*
+ * fill the empty input buffer, read again when all events were filtered
+ */
+static int snd_seq_event_fill_buffer(snd_seq_t *seq)
+{
+	ssize_t err;
+
+	do {
+		err = snd_seq_event_read_buffer(seq);
+		if (err < 0)
+			return err;
+	} while (seq->ibuflen == 0);
+	return 0;
+}
+
 static int snd_seq_event_retrieve_buffer(snd_seq_t *seq, snd_seq_event_t **retp)
 {
 	size_t ncells;
@@ -4155,13 +4859,50 @@ int snd_seq_event_input(snd_seq_t *seq, snd_seq_event_t **ev)
 	assert(seq);
 	*ev = NULL;
 	if (seq->ibuflen <= 0) {
-		if ((err = snd_seq_event_read_buffer(seq)) < 0)
+		if ((err = snd_seq_event_fill_buffer(seq)) < 0)
 			return err;
 	}
 
 	return snd_seq_event_retrieve_buffer(seq, ev);
 }
 
+/**
+ * \brief retrieve the events available in the input buffer
+ * \param seq sequencer handle
+ * \param evs array to store the event pointers
+ * \param count size of the array
+ * \return the number of events stored otherwise a negative error code
+ *
+ * Like #snd_seq_event_input(), but stores the pointers of up to count
+ * events at once.  When the input buffer is empty, it is filled by one
+ * read from the sequencer first, so the function blocks or returns
+ * \c -EAGAIN in the same way as #snd_seq_event_input().  Only the events
+ * already in the input buffer are returned, no further read is done.
+ *
+ * The events stay valid until the next input function is called.
+ *
+ * \sa snd_seq_event_input(), snd_seq_event_output_array()
+ */
+int snd_seq_event_input_array(snd_seq_t *seq, snd_seq_event_t **evs, unsigned int count)
+{
+	unsigned int idx;
+	int err;
+
+	assert(seq && (evs || !count));
+	if (!count)
+		return 0;
+	if (seq->ibuflen <= 0) {
+		if ((err = snd_seq_event_fill_buffer(seq)) < 0)
+			return err;
+	}
+	for (idx = 0; idx < count && seq->ibuflen > 0; idx++) {
+		err = snd_seq_event_retrieve_buffer(seq, &evs[idx]);
+		if (err < 0)
+			return idx ? (int)idx : err;
+	}
+	return idx;
+}
+
 /*
  * read input data from sequencer if available
  */
@@ -4204,6 +4945,113 @@ int snd_seq_event_input_pending(snd_seq_t *seq, int fetch_sequencer)
 	return seq->ibuflen;
 }
 
+static snd_seq_input_dispatch_t *get_input_dispatch(snd_seq_t *seq)
+{
+	if (!seq->idispatch)
+		seq->idispatch = calloc(1, sizeof(*seq->idispatch));
+	return seq->idispatch;
+}
+
+static void put_input_dispatch(snd_seq_t *seq)
+{
+	if (seq->idispatch && !seq->idispatch->filtered && !seq->idispatch->handlers) {
+		free(seq->idispatch);
+		seq->idispatch = NULL;
+	}
+}
+
+/**
+ * \brief accept an event type in the user-space input filter
+ * \param seq sequencer handle
+ * \param event_type event type to be accepted
+ * \return 0 on success otherwise a negative error code
+ *
+ * Once an event type was added, the input functions return only the
+ * events of the accepted types.  Other events are dropped right after
+ * they are read from the sequencer, before they are handed out or
+ * passed to a handler.  Unlike #snd_seq_set_client_event_filter(), the
+ * filter is evaluated in user space, so it works with any sequencer
+ * type and does not change the client information.
+ *
+ * \sa snd_seq_reset_input_filter(), snd_seq_set_input_handler()
+ */
+int snd_seq_set_input_filter(snd_seq_t *seq, int event_type)
+{
+	snd_seq_input_dispatch_t *d;
+
+	assert(seq);
+	if (event_type < 0 || event_type > 255)
+		return -EINVAL;
+	d = get_input_dispatch(seq);
+	if (!d)
+		return -ENOMEM;
+	snd_seq_set_bit(event_type, d->filter);
+	d->filtered = 1;
+	return 0;
+}
+
+/**
+ * \brief accept all event types in the user-space input filter
+ * \param seq sequencer handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * \sa snd_seq_set_input_filter()
+ */
+int snd_seq_reset_input_filter(snd_seq_t *seq)
+{
+	assert(seq);
+	if (seq->idispatch) {
+		memset(seq->idispatch->filter, 0, sizeof(seq->idispatch->filter));
+		seq->idispatch->filtered = 0;
+		put_input_dispatch(seq);
+	}
+	return 0;
+}
+
+/**
+ * \brief set the input handler of an event type
+ * \param seq sequencer handle
+ * \param event_type event type
+ * \param handler handler function, NULL to remove the handler
+ * \param private_data value passed to the handler
+ * \return 0 on success otherwise a negative error code
+ *
+ * The handler is called for each accepted event of the given type while
+ * the input buffer is filled by #snd_seq_event_input(),
+ * #snd_seq_event_input_array() or #snd_seq_event_input_pending().
+ * The event is valid only during the call.  When the handler returns 0,
+ * the event is consumed; when it returns a positive value, the event is
+ * kept and returned by the input functions as usual.  A negative value
+ * is returned by the input function which filled the buffer, the other
+ * events are still dispatched.
+ *
+ * The handler must not call the input functions of the same handle.
+ *
+ * \sa snd_seq_set_input_filter()
+ */
+int snd_seq_set_input_handler(snd_seq_t *seq, int event_type,
+			      snd_seq_event_handler_t handler, void *private_data)
+{
+	snd_seq_input_dispatch_t *d;
+
+	assert(seq);
+	if (event_type < 0 || event_type > 255)
+		return -EINVAL;
+	if (!handler && !seq->idispatch)
+		return 0;
+	d = get_input_dispatch(seq);
+	if (!d)
+		return -ENOMEM;
+	if (d->handler[event_type].func)
+		d->handlers--;
+	d->handler[event_type].func = handler;
+	d->handler[event_type].private_data = private_data;
+	if (handler)
+		d->handlers++;
+	put_input_dispatch(seq);
+	return 0;
+}
+
 /*----------------------------------------------------------------*/
 
 /*
@@ -4223,7 +5071,14 @@ int snd_seq_event_input_pending(snd_seq_t *seq, int fetch_sequencer)
 int snd_seq_drop_output_buffer(snd_seq_t *seq)
 {
 	assert(seq);
-	seq->obufused = 0;
+	if (seq->mt) {
+		mt_lock(seq);
+		mt_drop(seq);
+		obuf_reset(seq);
+		mt_unlock(seq);
+		return 0;
+	}
+	obuf_reset(seq);
 	return 0;
 }
 
@@ -4525,7 +5380,7 @@ static inline int snd_seq_compare_real_time(snd_seq_real_time_t *a, snd_seq_real
 }
 
 /* Routine to match events to be removed */
-static int remove_match(snd_seq_remove_events_t *info, snd_seq_event_t *ev)
+int _snd_seq_remove_match(snd_seq_remove_events_t *info, snd_seq_event_t *ev)
 {
 	int res;
 
@@ -4579,6 +5434,28 @@ static int remove_match(snd_seq_remove_events_t *info, snd_seq_event_t *ev)
 	return 1;
 }
 
+/*
+ * Drop the matching events from a contiguous region of the output buffer,
+ * compacting the remaining ones to its start.  Returns the new region end.
+ */
+static size_t obuf_remove_region(snd_seq_t *seq, snd_seq_remove_events_t *rmp,
+				 size_t start, size_t end)
+{
+	size_t src, dst, len;
+	snd_seq_event_t *ev;
+
+	for (src = dst = start; src < end; src += len) {
+		ev = (snd_seq_event_t *)(seq->obuf + src);
+		len = snd_seq_event_length(ev);
+		if (_snd_seq_remove_match(rmp, ev))
+			continue;
+		if (dst != src)
+			memmove(seq->obuf + dst, seq->obuf + src, len);
+		dst += len;
+	}
+	return dst;
+}
+
 /**
  * \brief remove events on input/output buffers and pools
  * \param seq sequencer handle
@@ -4608,25 +5485,27 @@ int snd_seq_remove_events(snd_seq_t *seq, snd_seq_remove_events_t *rmp)
 		 if (! (rmp->remove_mode & ~(SNDRV_SEQ_REMOVE_INPUT|SNDRV_SEQ_REMOVE_OUTPUT))) {
 			 /* The simple case - remove all */
 			 snd_seq_drop_output_buffer(seq);
-		} else {
-			char *ep;
-			size_t len;
-			snd_seq_event_t *ev;
-
-			ep = seq->obuf;
-			while (ep - seq->obuf < (ssize_t)seq->obufused) {
-
-				ev = (snd_seq_event_t *)ep;
-				len = snd_seq_event_length(ev);
-
-				if (remove_match(rmp, ev)) {
-					/* Remove event */
-					seq->obufused -= len;
-					memmove(ep, ep + len, seq->obufused - (ep - seq->obuf));
-				} else {
-					ep += len;
-				}
+		} else if (seq->obufwrap) {
+			size_t end, tail;
+
+			end = obuf_remove_region(seq, rmp, seq->obufhead, seq->obufwrap);
+			tail = obuf_remove_region(seq, rmp, 0, seq->obuftail);
+			seq->obufused = end - seq->obufhead + tail;
+			seq->obuftail = tail;
+			if (end == seq->obufhead) {
+				seq->obufhead = 0;
+				seq->obufwrap = 0;
+			} else {
+				seq->obufwrap = end;
 			}
+			if (!seq->obufused)
+				obuf_reset(seq);
+		} else {
+			seq->obuftail = obuf_remove_region(seq, rmp, seq->obufhead,
+							   seq->obuftail);
+			seq->obufused = seq->obuftail - seq->obufhead;
+			if (!seq->obufused)
+				obuf_reset(seq);
 		}
 	}
 
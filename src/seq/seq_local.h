@@ -26,11 +26,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <sys/uio.h>
 #include "local.h"
 
 #define SND_SEQ_OBUF_SIZE	(16*1024)	/* default size */
 #define SND_SEQ_IBUF_SIZE	500		/* in event_size aligned */
 #define DEFAULT_TMPBUF_SIZE	20
+#define SND_SEQ_BUF_WINDOW	64		/* transfers observed before shrinking */
 
 typedef struct snd_seq_queue_client snd_seq_queue_client_t;
 
@@ -62,6 +64,7 @@ typedef struct {
 	int (*set_queue_info)(snd_seq_t *seq, snd_seq_queue_info_t *info);
 	int (*get_named_queue)(snd_seq_t *seq, snd_seq_queue_info_t *info);
 	ssize_t (*write)(snd_seq_t *seq, void *buf, size_t len);
+	ssize_t (*writev)(snd_seq_t *seq, const struct iovec *vec, int count);	/* optional */
 	ssize_t (*read)(snd_seq_t *seq, void *buf, size_t len);
 	int (*remove_events)(snd_seq_t *seq, snd_seq_remove_events_t *rmp);
 	int (*get_client_pool)(snd_seq_t *seq, snd_seq_client_pool_t *info);
@@ -70,6 +73,18 @@ typedef struct {
 	int (*query_next_port)(snd_seq_t *seq, snd_seq_port_info_t *info);
 } snd_seq_ops_t;
 
+typedef struct {
+	unsigned char filter[32];	/* accepted event types */
+	int filtered;			/* filter is active */
+	struct {
+		snd_seq_event_handler_t func;
+		void *private_data;
+	} handler[256];
+	int handlers;			/* number of installed handlers */
+} snd_seq_input_dispatch_t;
+
+typedef struct _snd_seq_mt snd_seq_mt_t;
+
 struct _snd_seq {
 	char *name;
 	snd_seq_type_t type;
@@ -81,17 +96,35 @@ struct _snd_seq {
 	void *private_data;
 	int client;		/* client number */
 	/* buffers */
-	char *obuf;		/* output buffer */
+	char *obuf;		/* output buffer (ring of whole events) */
 	size_t obufsize;		/* output buffer size */
 	size_t obufused;		/* output buffer used size */
+	size_t obufhead;	/* offset of the first pending event */
+	size_t obuftail;	/* offset for the next event */
+	size_t obufwrap;	/* end of the events before wrap, 0 = not wrapped */
 	snd_seq_event_t *ibuf;	/* input buffer */
 	size_t ibufptr;		/* current pointer of input buffer */
 	size_t ibuflen;		/* queued length */
 	size_t ibufsize;		/* input buffer size */
 	snd_seq_event_t *tmpbuf;	/* temporary event for extracted event */
 	size_t tmpbufsize;		/* size of errbuf */
+	snd_seq_input_dispatch_t *idispatch;	/* input filter and handlers */
+	snd_seq_mt_t *mt;		/* multi-producer output staging */
+	/* adaptive buffer sizes, max 0 = fixed size */
+	size_t obufmin, obufmax;	/* in bytes */
+	size_t obufpeak;		/* largest drain in the window */
+	unsigned int obufdrains;	/* drains in the window */
+	unsigned int obuffull: 1;	/* the buffer became full before drain */
+	unsigned int ibuffull: 1;	/* the last read filled the buffer */
+	size_t ibufmin, ibufmax;	/* in events */
+	size_t ibufpeak;		/* largest read in the window */
+	unsigned int ibufreads;		/* reads in the window */
+	unsigned int allocs;		/* buffer (re)allocations */
 };
 
 int snd_seq_hw_open(snd_seq_t **handle, const char *name, int streams, int mode);
+int snd_seq_loop_open(snd_seq_t **handle, const char *name, int streams, int mode);
+#define _snd_seq_remove_match snd1_seq_remove_match
+int _snd_seq_remove_match(snd_seq_remove_events_t *info, snd_seq_event_t *ev);
 
 #endif
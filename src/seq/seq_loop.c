@@ -0,0 +1,1781 @@
+/*
+ *  Sequencer Interface - in-process loopback
+ *
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * All loop clients opened by a process share one in-process sequencer
+ * core.  It implements clients, ports, subscriptions and queues like the
+ * kernel sequencer, but nothing leaves the process: the events written by
+ * a client are dispatched right away in its write call, either directly
+ * into the input FIFOs of the destination clients, or onto a queue whose
+ * events are delivered by a dispatcher thread when they are due.
+ *
+ * The input FIFO of each client is a bounded multi-producer single-consumer
+ * ring of event cells with a sequence number per cell, so writers never
+ * take a lock to deliver an event.  A variable length event occupies
+ * consecutive cells like in the kernel input stream.  The poll descriptor
+ * is a socket which is kept readable while the FIFO is not empty.
+ *
+ * Not implemented: announcements on the system announce port, time-stamping
+ * of delivered events and queue timers other than the monotonic clock.
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
+#include "seq_local.h"
+#include "list.h"
+
+#ifdef HAVE_LIBPTHREAD
+
+#include <pthread.h>
+
+#ifndef PIC
+/* entry for static linking */
+const char *_snd_module_seq_loop = "";
+#endif
+
+#ifndef DOC_HIDDEN
+
+#define LOOP_MAX_CLIENTS	192
+#define LOOP_MAX_PORTS		254
+#define LOOP_MAX_QUEUES		32
+#define LOOP_MAX_CHANNELS	256
+#define LOOP_CLIENT_BASE	128
+#define LOOP_FIFO_CELLS		2048	/* default input pool, power of two */
+#define LOOP_OUTPUT_POOL	500
+#define LOOP_SKEW_BASE		0x10000	/* the only base the kernel accepts */
+
+typedef struct {
+	unsigned long seq;		/* cell state for the lock-free ring */
+	snd_seq_event_t ev;
+} loop_cell_t;
+
+typedef struct {
+	loop_cell_t *cells;
+	unsigned long mask;
+	unsigned long head;		/* consumer position */
+	unsigned long tail;		/* producer position */
+} loop_fifo_t;
+
+typedef struct {
+	struct list_head list;
+	snd_seq_port_subscribe_t info;
+} loop_subs_t;
+
+typedef struct {
+	snd_seq_port_info_t info;
+	struct list_head subs;		/* subscriptions with this port as sender */
+} loop_port_t;
+
+typedef struct {
+	snd_seq_client_info_t info;
+	loop_port_t *ports[LOOP_MAX_PORTS];
+	int streams;
+	loop_fifo_t fifo;
+	int wake_fd[2];			/* [0] poll descriptor, [1] wakeup */
+	int need_wakeup;		/* consumer waits for a wakeup */
+	int overflow;			/* events were lost */
+	int event_lost;
+} loop_client_t;
+
+typedef struct {
+	struct list_head list;
+	unsigned long long due;		/* tick or nanoseconds */
+	snd_seq_event_t ev;
+	/* variable length data follows */
+} loop_event_t;
+
+typedef struct {
+	snd_seq_queue_info_t info;
+	unsigned char used[LOOP_MAX_CLIENTS];
+	int running;
+	unsigned int tempo;		/* us per quarter */
+	int ppq;
+	unsigned int skew_value;
+	unsigned int skew_base;
+	unsigned long long base_mono;	/* monotonic ns when running since */
+	unsigned long long base_tick;	/* tick position at base_mono */
+	unsigned long long base_time;	/* ns position at base_mono */
+	struct list_head tick_events;	/* sorted by tick */
+	struct list_head time_events;	/* sorted by time */
+	int events;
+} loop_queue_t;
+
+typedef struct {
+	pthread_rwlock_t lock;		/* clients, ports and subscriptions */
+	pthread_mutex_t qlock;		/* queues */
+	pthread_cond_t qcond;
+	pthread_t thread;
+	int thread_running;
+	int thread_stop;
+	int refs;
+	loop_client_t *clients[LOOP_MAX_CLIENTS];
+	loop_queue_t *queues[LOOP_MAX_QUEUES];
+} loop_core_t;
+
+typedef struct {
+	loop_client_t *client;
+} snd_seq_loop_t;
+
+#endif /* DOC_HIDDEN */
+
+static pthread_mutex_t loop_open_mutex = PTHREAD_MUTEX_INITIALIZER;
+static loop_core_t loop_core;
+
+static unsigned long long loop_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned int loop_ncells(const snd_seq_event_t *ev)
+{
+	if (!snd_seq_ev_is_variable(ev))
+		return 1;
+	return 1 + (ev->data.ext.len + sizeof(snd_seq_event_t) - 1) /
+		sizeof(snd_seq_event_t);
+}
+
+/*
+ * input FIFO
+ */
+
+static int loop_fifo_init(loop_fifo_t *fifo, unsigned int cells)
+{
+	unsigned long size = 1, idx;
+
+	while (size < cells)
+		size <<= 1;
+	fifo->cells = malloc(size * sizeof(*fifo->cells));
+	if (!fifo->cells)
+		return -ENOMEM;
+	for (idx = 0; idx < size; idx++)
+		fifo->cells[idx].seq = idx;
+	fifo->mask = size - 1;
+	fifo->head = 0;
+	fifo->tail = 0;
+	return 0;
+}
+
+/* called by any writer */
+static int loop_fifo_put(loop_fifo_t *fifo, const snd_seq_event_t *ev,
+			 const void *data)
+{
+	unsigned long pos, cell_seq, n, idx;
+	long dif;
+	size_t len;
+
+	n = loop_ncells(ev);
+	if (n > fifo->mask + 1)
+		return -ENOSPC;
+	pos = __atomic_load_n(&fifo->tail, __ATOMIC_RELAXED);
+	for (;;) {
+		dif = 0;
+		for (idx = 0; idx < n; idx++) {
+			cell_seq = __atomic_load_n(&fifo->cells[(pos + idx) & fifo->mask].seq,
+						   __ATOMIC_ACQUIRE);
+			dif = (long)(cell_seq - (pos + idx));
+			if (dif)
+				break;
+		}
+		if (!dif) {
+			if (__atomic_compare_exchange_n(&fifo->tail, &pos, pos + n, 1,
+							__ATOMIC_RELAXED,
+							__ATOMIC_RELAXED))
+				break;
+		} else if (dif < 0) {
+			return -ENOSPC;	/* not consumed yet */
+		} else {
+			pos = __atomic_load_n(&fifo->tail, __ATOMIC_RELAXED);
+		}
+	}
+	/* data cells first, the header publishes the whole event */
+	len = n > 1 ? ev->data.ext.len : 0;
+	for (idx = 1; idx < n; idx++) {
+		loop_cell_t *cell = &fifo->cells[(pos + idx) & fifo->mask];
+		size_t size = len < sizeof(cell->ev) ? len : sizeof(cell->ev);
+		memcpy(&cell->ev, data, size);
+		data = (const char *)data + size;
+		len -= size;
+		__atomic_store_n(&cell->seq, pos + idx + 1, __ATOMIC_RELEASE);
+	}
+	fifo->cells[pos & fifo->mask].ev = *ev;
+	__atomic_store_n(&fifo->cells[pos & fifo->mask].seq, pos + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static int loop_fifo_empty(loop_fifo_t *fifo)
+{
+	return __atomic_load_n(&fifo->cells[fifo->head & fifo->mask].seq,
+			       __ATOMIC_ACQUIRE) != fifo->head + 1;
+}
+
+/* called by the owner only; returns the copied bytes */
+static size_t loop_fifo_get(loop_fifo_t *fifo, snd_seq_event_t *buf, size_t count)
+{
+	unsigned long n, idx;
+	size_t done = 0;
+	loop_cell_t *cell;
+
+	while (!loop_fifo_empty(fifo)) {
+		cell = &fifo->cells[fifo->head & fifo->mask];
+		n = loop_ncells(&cell->ev);
+		if (done + n > count)
+			break;
+		for (idx = 0; idx < n; idx++) {
+			cell = &fifo->cells[(fifo->head + idx) & fifo->mask];
+			if (buf)
+				buf[done + idx] = cell->ev;
+			__atomic_store_n(&cell->seq, fifo->head + idx + fifo->mask + 1,
+					 __ATOMIC_RELEASE);
+		}
+		fifo->head += n;
+		done += n;
+	}
+	return done * sizeof(snd_seq_event_t);
+}
+
+static void loop_wakeup(loop_client_t *client)
+{
+	char c = 0;
+
+	if (__atomic_load_n(&client->need_wakeup, __ATOMIC_SEQ_CST) &&
+	    __atomic_exchange_n(&client->need_wakeup, 0, __ATOMIC_SEQ_CST)) {
+		if (send(client->wake_fd[1], &c, 1, MSG_DONTWAIT) < 0 && errno != EAGAIN)
+			SYSERR("send failed");
+	}
+}
+
+/*
+ * The consumer found its FIFO empty: clear the poll descriptor and ask the
+ * writers for a wakeup.  Returns 1 when an event arrived meanwhile.
+ */
+static int loop_arm_wakeup(loop_client_t *client)
+{
+	char buf[64];
+	char c = 0;
+
+	while (recv(client->wake_fd[0], buf, sizeof(buf), MSG_DONTWAIT) > 0)
+		;
+	__atomic_store_n(&client->need_wakeup, 1, __ATOMIC_SEQ_CST);
+	if (loop_fifo_empty(&client->fifo) &&
+	    !__atomic_load_n(&client->overflow, __ATOMIC_SEQ_CST))
+		return 0;
+	/* keep the descriptor readable unless a writer did it already */
+	if (__atomic_exchange_n(&client->need_wakeup, 0, __ATOMIC_SEQ_CST))
+		send(client->wake_fd[1], &c, 1, MSG_DONTWAIT);
+	return 1;
+}
+
+/*
+ * event dispatching
+ */
+
+static loop_client_t *loop_client(int client)
+{
+	if (client < 0 || client >= LOOP_MAX_CLIENTS)
+		return NULL;
+	return loop_core.clients[client];
+}
+
+static loop_port_t *loop_port(int client, int port)
+{
+	loop_client_t *c = loop_client(client);
+
+	if (!c || port < 0 || port >= LOOP_MAX_PORTS)
+		return NULL;
+	return c->ports[port];
+}
+
+static void loop_queue_control(const snd_seq_event_t *ev);
+
+static void loop_deliver_client(loop_client_t *client, snd_seq_event_t *ev,
+				const void *data)
+{
+	const snd_seq_client_info_t *info = &client->info;
+
+	if (!(client->streams & SND_SEQ_OPEN_INPUT))
+		return;
+	if ((info->filter & SNDRV_SEQ_FILTER_USE_EVENT) &&
+	    !(info->event_filter[ev->type >> 3] & (1 << (ev->type & 7))))
+		return;
+	if (loop_fifo_put(&client->fifo, ev, data) < 0) {
+		__atomic_add_fetch(&client->event_lost, 1, __ATOMIC_RELAXED);
+		__atomic_store_n(&client->overflow, 1, __ATOMIC_SEQ_CST);
+	}
+	loop_wakeup(client);
+}
+
+static void loop_deliver_port(snd_seq_event_t *ev, const void *data)
+{
+	loop_client_t *client;
+	int idx;
+
+	if (ev->dest.client == SND_SEQ_CLIENT_SYSTEM &&
+	    ev->dest.port == SND_SEQ_PORT_SYSTEM_TIMER) {
+		loop_queue_control(ev);
+		return;
+	}
+	if (ev->dest.client == SND_SEQ_ADDRESS_BROADCAST) {
+		for (idx = 0; idx < LOOP_MAX_CLIENTS; idx++) {
+			client = loop_core.clients[idx];
+			if (!client || !(client->info.filter & SNDRV_SEQ_FILTER_BROADCAST))
+				continue;
+			ev->dest.client = idx;
+			loop_deliver_client(client, ev, data);
+		}
+		ev->dest.client = SND_SEQ_ADDRESS_BROADCAST;
+		return;
+	}
+	if (ev->dest.port == SND_SEQ_ADDRESS_BROADCAST) {
+		client = loop_client(ev->dest.client);
+		if (client)
+			loop_deliver_client(client, ev, data);
+		return;
+	}
+	if (!loop_port(ev->dest.client, ev->dest.port))
+		return;
+	loop_deliver_client(loop_core.clients[ev->dest.client], ev, data);
+}
+
+/* deliver an event now; the core lock must be held for reading */
+static void loop_deliver(snd_seq_event_t *ev, const void *data)
+{
+	loop_port_t *port;
+	loop_subs_t *subs;
+	struct list_head *pos;
+
+	if (ev->dest.client != SND_SEQ_ADDRESS_SUBSCRIBERS) {
+		loop_deliver_port(ev, data);
+		return;
+	}
+	port = loop_port(ev->source.client, ev->source.port);
+	if (!port)
+		return;
+	list_for_each(pos, &port->subs) {
+		subs = list_entry(pos, loop_subs_t, list);
+		ev->dest.client = subs->info.dest.client;
+		ev->dest.port = subs->info.dest.port;
+		loop_deliver_port(ev, data);
+	}
+	ev->dest.client = SND_SEQ_ADDRESS_SUBSCRIBERS;
+}
+
+/*
+ * queues
+ */
+
+static loop_queue_t *loop_queue(int queue)
+{
+	if (queue < 0 || queue >= LOOP_MAX_QUEUES)
+		return NULL;
+	return loop_core.queues[queue];
+}
+
+/* current queue position; qlock must be held */
+/* queue time passing in a monotonic interval */
+static unsigned long long loop_skew(loop_queue_t *q, unsigned long long ns)
+{
+	if (q->skew_value == q->skew_base)
+		return ns;
+	return ns / q->skew_base * q->skew_value +
+	       ns % q->skew_base * q->skew_value / q->skew_base;
+}
+
+/* monotonic interval for a queue time interval, 0 if the skew stops the queue */
+static unsigned long long loop_unskew(loop_queue_t *q, unsigned long long ns)
+{
+	if (q->skew_value == q->skew_base)
+		return ns;
+	if (!q->skew_value)
+		return 0;
+	return ns / q->skew_value * q->skew_base +
+	       (ns % q->skew_value * q->skew_base + q->skew_value - 1) / q->skew_value;
+}
+
+static void loop_queue_position(loop_queue_t *q, unsigned long long now,
+				unsigned long long *tick, unsigned long long *time)
+{
+	unsigned long long elapsed;
+
+	if (!q->running) {
+		*tick = q->base_tick;
+		*time = q->base_time;
+		return;
+	}
+	elapsed = loop_skew(q, now - q->base_mono);
+	*time = q->base_time + elapsed;
+	*tick = q->base_tick + elapsed * q->ppq / (q->tempo * 1000ULL);
+}
+
+static void loop_queue_rebase(loop_queue_t *q, unsigned long long now)
+{
+	loop_queue_position(q, now, &q->base_tick, &q->base_time);
+	q->base_mono = now;
+}
+
+static unsigned long long loop_real_ns(const snd_seq_real_time_t *t)
+{
+	return t->tv_sec * 1000000000ULL + t->tv_nsec;
+}
+
+/* move the due events of a queue onto the given list; qlock must be held */
+static void loop_queue_collect(loop_queue_t *q, unsigned long long now,
+			       struct list_head *due)
+{
+	unsigned long long tick, time;
+	loop_event_t *e;
+
+	loop_queue_position(q, now, &tick, &time);
+	while (!list_empty(&q->tick_events)) {
+		e = list_entry(q->tick_events.next, loop_event_t, list);
+		if (e->due > tick)
+			break;
+		list_del(&e->list);
+		list_add_tail(&e->list, due);
+		q->events--;
+	}
+	while (!list_empty(&q->time_events)) {
+		e = list_entry(q->time_events.next, loop_event_t, list);
+		if (e->due > time)
+			break;
+		list_del(&e->list);
+		list_add_tail(&e->list, due);
+		q->events--;
+	}
+}
+
+/* monotonic time of the next event of a queue, 0 if none; qlock must be held */
+static unsigned long long loop_queue_deadline(loop_queue_t *q)
+{
+	unsigned long long deadline = 0, t;
+	loop_event_t *e;
+
+	if (!q->running || !q->skew_value)
+		return 0;
+	if (!list_empty(&q->tick_events)) {
+		e = list_entry(q->tick_events.next, loop_event_t, list);
+		deadline = q->base_mono +
+			loop_unskew(q, ((e->due - q->base_tick) * q->tempo * 1000ULL +
+					q->ppq - 1) / q->ppq);
+	}
+	if (!list_empty(&q->time_events)) {
+		e = list_entry(q->time_events.next, loop_event_t, list);
+		t = q->base_mono + loop_unskew(q, e->due - q->base_time);
+		if (!deadline || t < deadline)
+			deadline = t;
+	}
+	return deadline;
+}
+
+static void loop_deliver_list(struct list_head *due)
+{
+	loop_event_t *e;
+
+	while (!list_empty(due)) {
+		e = list_entry(due->next, loop_event_t, list);
+		list_del(&e->list);
+		loop_deliver(&e->ev, e + 1);
+		free(e);
+	}
+}
+
+static void loop_free_events(struct list_head *list)
+{
+	while (!list_empty(list)) {
+		loop_event_t *e = list_entry(list->next, loop_event_t, list);
+		list_del(&e->list);
+		free(e);
+	}
+}
+
+/* the core lock is held for reading */
+static void loop_queue_control(const snd_seq_event_t *ev)
+{
+	loop_queue_t *q;
+	unsigned long long now = loop_now();
+
+	pthread_mutex_lock(&loop_core.qlock);
+	q = loop_queue(ev->data.queue.queue);
+	if (!q)
+		goto unlock;
+	switch (ev->type) {
+	case SND_SEQ_EVENT_START:
+		q->base_tick = 0;
+		q->base_time = 0;
+		q->base_mono = now;
+		q->running = 1;
+		break;
+	case SND_SEQ_EVENT_CONTINUE:
+		if (!q->running) {
+			q->base_mono = now;
+			q->running = 1;
+		}
+		break;
+	case SND_SEQ_EVENT_STOP:
+		loop_queue_rebase(q, now);
+		q->running = 0;
+		break;
+	case SND_SEQ_EVENT_TEMPO:
+		if (ev->data.queue.param.value > 0) {
+			loop_queue_rebase(q, now);
+			q->tempo = ev->data.queue.param.value;
+		}
+		break;
+	case SND_SEQ_EVENT_QUEUE_SKEW:
+		if (ev->data.queue.param.skew.base == LOOP_SKEW_BASE) {
+			loop_queue_rebase(q, now);
+			q->skew_value = ev->data.queue.param.skew.value;
+		}
+		break;
+	case SND_SEQ_EVENT_SETPOS_TICK:
+		loop_queue_rebase(q, now);
+		q->base_tick = ev->data.queue.param.time.tick;
+		break;
+	case SND_SEQ_EVENT_SETPOS_TIME:
+		loop_queue_rebase(q, now);
+		q->base_time = loop_real_ns(&ev->data.queue.param.time.time);
+		break;
+	default:
+		break;
+	}
+	pthread_cond_signal(&loop_core.qcond);
+ unlock:
+	pthread_mutex_unlock(&loop_core.qlock);
+}
+
+static void *loop_dispatcher(void *arg ATTRIBUTE_UNUSED)
+{
+	struct list_head due;
+	unsigned long long now, deadline, t;
+	struct timespec ts;
+	int idx;
+
+	INIT_LIST_HEAD(&due);
+	pthread_mutex_lock(&loop_core.qlock);
+	while (!loop_core.thread_stop) {
+		now = loop_now();
+		deadline = 0;
+		for (idx = 0; idx < LOOP_MAX_QUEUES; idx++) {
+			loop_queue_t *q = loop_core.queues[idx];
+			if (!q)
+				continue;
+			loop_queue_collect(q, now, &due);
+			t = loop_queue_deadline(q);
+			if (t && (!deadline || t < deadline))
+				deadline = t;
+		}
+		if (!list_empty(&due)) {
+			pthread_mutex_unlock(&loop_core.qlock);
+			pthread_rwlock_rdlock(&loop_core.lock);
+			loop_deliver_list(&due);
+			pthread_rwlock_unlock(&loop_core.lock);
+			pthread_mutex_lock(&loop_core.qlock);
+			continue;
+		}
+		if (!deadline) {
+			pthread_cond_wait(&loop_core.qcond, &loop_core.qlock);
+			continue;
+		}
+		ts.tv_sec = deadline / 1000000000ULL;
+		ts.tv_nsec = deadline % 1000000000ULL;
+		pthread_cond_timedwait(&loop_core.qcond, &loop_core.qlock, &ts);
+	}
+	pthread_mutex_unlock(&loop_core.qlock);
+	return NULL;
+}
+
+/* put an event onto its queue; the core lock is held for reading */
+static int loop_enqueue(snd_seq_event_t *ev, const void *data, size_t len)
+{
+	unsigned long long now, tick, time;
+	struct list_head *head, *pos;
+	struct list_head due;
+	loop_queue_t *q;
+	loop_event_t *e;
+
+	e = malloc(sizeof(*e) + len);
+	if (!e)
+		return -ENOMEM;
+	e->ev = *ev;
+	memcpy(e + 1, data, len);
+	INIT_LIST_HEAD(&due);
+	now = loop_now();
+	pthread_mutex_lock(&loop_core.qlock);
+	q = loop_queue(ev->queue);
+	if (!q) {
+		pthread_mutex_unlock(&loop_core.qlock);
+		free(e);
+		return -EINVAL;
+	}
+	loop_queue_position(q, now, &tick, &time);
+	if (snd_seq_ev_is_real(ev)) {
+		e->due = loop_real_ns(&ev->time.time);
+		if (snd_seq_ev_is_reltime(ev)) {
+			e->due += time;
+			e->ev.time.time.tv_sec = e->due / 1000000000ULL;
+			e->ev.time.time.tv_nsec = e->due % 1000000000ULL;
+		}
+		head = &q->time_events;
+	} else {
+		e->due = ev->time.tick;
+		if (snd_seq_ev_is_reltime(ev)) {
+			e->due += tick;
+			e->ev.time.tick = e->due;
+		}
+		head = &q->tick_events;
+	}
+	e->ev.flags &= ~SND_SEQ_TIME_MODE_MASK;
+	e->ev.flags |= SND_SEQ_TIME_MODE_ABS;
+	/* events come mostly in order, search from the end */
+	for (pos = head->prev; pos != head; pos = pos->prev)
+		if (list_entry(pos, loop_event_t, list)->due <= e->due)
+			break;
+	list_add(&e->list, pos);
+	q->events++;
+	loop_queue_collect(q, now, &due);
+	pthread_cond_signal(&loop_core.qcond);
+	pthread_mutex_unlock(&loop_core.qlock);
+	loop_deliver_list(&due);
+	return 0;
+}
+
+/*
+ * operations
+ */
+
+static void loop_free_port(loop_port_t *port)
+{
+	while (!list_empty(&port->subs)) {
+		loop_subs_t *subs = list_entry(port->subs.next, loop_subs_t, list);
+		list_del(&subs->list);
+		free(subs);
+	}
+	free(port);
+}
+
+static loop_subs_t *loop_find_subs(const snd_seq_port_subscribe_t *sub)
+{
+	loop_port_t *port = loop_port(sub->sender.client, sub->sender.port);
+	struct list_head *pos;
+
+	if (!port)
+		return NULL;
+	list_for_each(pos, &port->subs) {
+		loop_subs_t *subs = list_entry(pos, loop_subs_t, list);
+		if (subs->info.dest.client == sub->dest.client &&
+		    subs->info.dest.port == sub->dest.port)
+			return subs;
+	}
+	return NULL;
+}
+
+/* remove a subscription; the core lock must be held for writing */
+static void loop_remove_subs(loop_subs_t *subs)
+{
+	loop_port_t *port;
+
+	port = loop_port(subs->info.sender.client, subs->info.sender.port);
+	if (port)
+		port->info.read_use--;
+	port = loop_port(subs->info.dest.client, subs->info.dest.port);
+	if (port)
+		port->info.write_use--;
+	list_del(&subs->list);
+	free(subs);
+}
+
+/* delete a port and all its subscriptions; the core lock must be held for writing */
+static void loop_delete_port(loop_client_t *client, int idx)
+{
+	loop_port_t *port = client->ports[idx];
+	struct list_head *pos, *npos;
+	int c, p;
+
+	for (c = 0; c < LOOP_MAX_CLIENTS; c++) {
+		if (!loop_core.clients[c])
+			continue;
+		for (p = 0; p < LOOP_MAX_PORTS; p++) {
+			loop_port_t *other = loop_core.clients[c]->ports[p];
+			if (!other)
+				continue;
+			list_for_each_safe(pos, npos, &other->subs) {
+				loop_subs_t *subs = list_entry(pos, loop_subs_t, list);
+				if (other == port ||
+				    (subs->info.dest.client == client->info.client &&
+				     subs->info.dest.port == idx))
+					loop_remove_subs(subs);
+			}
+		}
+	}
+	client->ports[idx] = NULL;
+	client->info.num_ports--;
+	loop_free_port(port);
+}
+
+static int snd_seq_loop_close(snd_seq_t *seq)
+{
+	snd_seq_loop_t *loop = seq->private_data;
+	loop_client_t *client = loop->client;
+	struct list_head *pos, *npos;
+	int idx, stop = 0;
+
+	pthread_mutex_lock(&loop_open_mutex);
+	pthread_rwlock_wrlock(&loop_core.lock);
+	for (idx = 0; idx < LOOP_MAX_PORTS; idx++)
+		if (client->ports[idx])
+			loop_delete_port(client, idx);
+	loop_core.clients[client->info.client] = NULL;
+	pthread_mutex_lock(&loop_core.qlock);
+	for (idx = 0; idx < LOOP_MAX_QUEUES; idx++) {
+		loop_queue_t *q = loop_core.queues[idx];
+		if (!q)
+			continue;
+		if (q->info.owner == client->info.client) {
+			loop_free_events(&q->tick_events);
+			loop_free_events(&q->time_events);
+			free(q);
+			loop_core.queues[idx] = NULL;
+			continue;
+		}
+		q->used[client->info.client] = 0;
+		list_for_each_safe(pos, npos, &q->tick_events) {
+			loop_event_t *e = list_entry(pos, loop_event_t, list);
+			if (e->ev.source.client == client->info.client) {
+				list_del(&e->list);
+				free(e);
+				q->events--;
+			}
+		}
+		list_for_each_safe(pos, npos, &q->time_events) {
+			loop_event_t *e = list_entry(pos, loop_event_t, list);
+			if (e->ev.source.client == client->info.client) {
+				list_del(&e->list);
+				free(e);
+				q->events--;
+			}
+		}
+	}
+	if (--loop_core.refs == 0) {
+		loop_core.thread_stop = 1;
+		pthread_cond_signal(&loop_core.qcond);
+		stop = loop_core.thread_running;
+	}
+	pthread_mutex_unlock(&loop_core.qlock);
+	pthread_rwlock_unlock(&loop_core.lock);
+	if (stop) {
+		pthread_join(loop_core.thread, NULL);
+		loop_core.thread_running = 0;
+	}
+	if (!loop_core.refs) {
+		/* the system client */
+		for (idx = 0; idx < LOOP_MAX_PORTS; idx++)
+			if (loop_core.clients[0]->ports[idx])
+				loop_free_port(loop_core.clients[0]->ports[idx]);
+		free(loop_core.clients[0]);
+		loop_core.clients[0] = NULL;
+		pthread_rwlock_destroy(&loop_core.lock);
+		pthread_mutex_destroy(&loop_core.qlock);
+		pthread_cond_destroy(&loop_core.qcond);
+	}
+	pthread_mutex_unlock(&loop_open_mutex);
+	close(client->wake_fd[0]);
+	close(client->wake_fd[1]);
+	free(client->fifo.cells);
+	free(client);
+	free(loop);
+	return 0;
+}
+
+static int snd_seq_loop_nonblock(snd_seq_t *seq ATTRIBUTE_UNUSED,
+				 int nonblock ATTRIBUTE_UNUSED)
+{
+	/* seq->mode is checked in read */
+	return 0;
+}
+
+static int snd_seq_loop_system_info(snd_seq_t *seq ATTRIBUTE_UNUSED,
+				    snd_seq_system_info_t *info)
+{
+	int idx;
+
+	memset(info, 0, sizeof(*info));
+	info->queues = LOOP_MAX_QUEUES;
+	info->clients = LOOP_MAX_CLIENTS;
+	info->ports = LOOP_MAX_PORTS;
+	info->channels = LOOP_MAX_CHANNELS;
+	pthread_rwlock_rdlock(&loop_core.lock);
+	for (idx = 0; idx < LOOP_MAX_CLIENTS; idx++)
+		if (loop_core.clients[idx])
+			info->cur_clients++;
+	pthread_mutex_lock(&loop_core.qlock);
+	for (idx = 0; idx < LOOP_MAX_QUEUES; idx++)
+		if (loop_core.queues[idx])
+			info->cur_queues++;
+	pthread_mutex_unlock(&loop_core.qlock);
+	pthread_rwlock_unlock(&loop_core.lock);
+	return 0;
+}
+
+static void loop_client_info(loop_client_t *client, snd_seq_client_info_t *info)
+{
+	*info = client->info;
+	info->event_lost = __atomic_load_n(&client->event_lost, __ATOMIC_RELAXED);
+}
+
+static int snd_seq_loop_get_client_info(snd_seq_t *seq ATTRIBUTE_UNUSED,
+					snd_seq_client_info_t *info)
+{
+	loop_client_t *client;
+	int err = 0;
+
+	pthread_rwlock_rdlock(&loop_core.lock);
+	client = loop_client(info->client);
+	if (client)
+		loop_client_info(client, info);
+	else
+		err = -ENOENT;
+	pthread_rwlock_unlock(&loop_core.lock);
+	return err;
+}
+
+static int snd_seq_loop_set_client_info(snd_seq_t *seq,
+					snd_seq_client_info_t *info)
+{
+	snd_seq_loop_t *loop = seq->private_data;
+	loop_client_t *client = loop->client;
+
+	if (info->client != client->info.client)
+		return -EPERM;
+	pthread_rwlock_wrlock(&loop_core.lock);
+	memcpy(client->info.name, info->name, sizeof(client->info.name));
+	client->info.name[sizeof(client->info.name) - 1] = 0;
+	client->info.filter = info->filter;
+	memcpy(client->info.multicast_filter, info->multicast_filter,
+	       sizeof(client->info.multicast_filter));
+	memcpy(client->info.event_filter, info->event_filter,
+	       sizeof(client->info.event_filter));
+	pthread_rwlock_unlock(&loop_core.lock);
+	return 0;
+}
+
+static void loop_port_info(loop_client_t *client, loop_port_t *port,
+			   snd_seq_port_info_t *info)
+{
+	*info = port->info;
+	info->addr.client = client->info.client;
+}
+
+static int snd_seq_loop_create_port(snd_seq_t *seq, snd_seq_port_info_t *info)
+{
+	snd_seq_loop_t *loop = seq->private_data;
+	loop_client_t *client = loop->client;
+	loop_port_t *port;
+	int idx, err = 0;
+
+	port = calloc(1, sizeof(*port));
+	if (!port)
+		return -ENOMEM;
+	INIT_LIST_HEAD(&port->subs);
+	pthread_rwlock_wrlock(&loop_core.lock);
+	if (info->flags & SNDRV_SEQ_PORT_FLG_GIVEN_PORT) {
+		idx = info->addr.port;
+		if (idx < 0 || idx >= LOOP_MAX_PORTS || client->ports[idx])
+			err = -EBUSY;
+	} else {
+		for (idx = 0; idx < LOOP_MAX_PORTS; idx++)
+			if (!client->ports[idx])
+				break;
+		if (idx >= LOOP_MAX_PORTS)
+			err = -ENOMEM;
+	}
+	if (err < 0) {
+		pthread_rwlock_unlock(&loop_core.lock);
+		free(port);
+		return err;
+	}
+	port->info = *info;
+	port->info.addr.client = client->info.client;
+	port->info.addr.port = idx;
+	port->info.name[sizeof(port->info.name) - 1] = 0;
+	port->info.read_use = 0;
+	port->info.write_use = 0;
+	port->info.kernel = NULL;
+	if (!port->info.midi_channels)
+		port->info.midi_channels = 16;
+	client->ports[idx] = port;
+	client->info.num_ports++;
+	*info = port->info;
+	pthread_rwlock_unlock(&loop_core.lock);
+	return 0;
+}
+
+static int snd_seq_loop_delete_port(snd_seq_t *seq, snd_seq_port_info_t *info)
+{
+	snd_seq_loop_t *loop = seq->private_data;
+	loop_client_t *client = loop->client;
+	int err = 0;
+
+	if (info->addr.client != client->info.client)
+		return -EPERM;
+	pthread_rwlock_wrlock(&loop_core.lock);
+	if (info->addr.port < LOOP_MAX_PORTS && client->ports[info->addr.port])
+		loop_delete_port(client, info->addr.port);
+	else
+		err = -ENOENT;
+	pthread_rwlock_unlock(&loop_core.lock);
+	return err;
+}
+
+static int snd_seq_loop_get_port_info(snd_seq_t *seq ATTRIBUTE_UNUSED,
+				      snd_seq_port_info_t *info)
+{
+	loop_port_t *port;
+	int err = 0;
+
+	pthread_rwlock_rdlock(&loop_core.lock);
+	port = loop_port(info->addr.client, info->addr.port);
+	if (port)
+		loop_port_info(loop_core.clients[info->addr.client], port, info);
+	else
+		err = -ENOENT;
+	pthread_rwlock_unlock(&loop_core.lock);
+	return err;
+}
+
+static int snd_seq_loop_set_port_info(snd_seq_t *seq, snd_seq_port_info_t *info)
+{
+	snd_seq_loop_t *loop = seq->private_data;
+	loop_port_t *port;
+	int err = 0;
+
+	if (info->addr.client != loop->client->info.client)
+		return -EPERM;
+	pthread_rwlock_wrlock(&loop_core.lock);
+	port = loop_port(info->addr.client, info->addr.port);
+	if (port) {
+		memcpy(port->info.name, info->name, sizeof(port->info.name));
+		port->info.name[sizeof(port->info.name) - 1] = 0;
+		port->info.capability = info->capability;
+		port->info.type = info->type;
+		port->info.midi_channels = info->midi_channels;
+		port->info.midi_voices = info->midi_voices;
+		port->info.synth_voices = info->synth_voices;
+		port->info.flags = info->flags;
+		port->info.time_queue = info->time_queue;
+	} else {
+		err = -ENOENT;
+	}
+	pthread_rwlock_unlock(&loop_core.lock);
+	return err;
+}
+
+static int snd_seq_loop_get_port_subscription(snd_seq_t *seq ATTRIBUTE_UNUSED,
+					      snd_seq_port_subscribe_t *sub)
+{
+	loop_subs_t *subs;
+	int err = 0;
+
+	pthread_rwlock_rdlock(&loop_core.lock);
+	subs = loop_find_subs(sub);
+	if (subs)
+		*sub = subs->info;
+	else
+		err = -ENOENT;
+	pthread_rwlock_unlock(&loop_core.lock);
+	return err;
+}
+
+static int snd_seq_loop_subscribe_port(snd_seq_t *seq, snd_seq_port_subscribe_t *sub)
+{
+	snd_seq_loop_t *loop = seq->private_data;
+	int self = loop->client->info.client;
+	loop_port_t *sender, *dest;
+	loop_subs_t *subs;
+	int err = 0;
+
+	subs = calloc(1, sizeof(*subs));
+	if (!subs)
+		return -ENOMEM;
+	subs->info = *sub;
+	pthread_rwlock_wrlock(&loop_core.lock);
+	sender = loop_port(sub->sender.client, sub->sender.port);
+	dest = loop_port(sub->dest.client, sub->dest.port);
+	if (!sender || !dest) {
+		err = -ENOENT;
+	} else if ((sub->sender.client != self &&
+		    (sender->info.capability & (SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ)) !=
+		    (SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ)) ||
+		   (sub->dest.client != self &&
+		    (dest->info.capability & (SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE)) !=
+		    (SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE))) {
+		err = -EPERM;
+	} else if (loop_find_subs(sub)) {
+		err = -EBUSY;
+	} else {
+		list_add_tail(&subs->list, &sender->subs);
+		sender->info.read_use++;
+		dest->info.write_use++;
+		subs = NULL;
+	}
+	pthread_rwlock_unlock(&loop_core.lock);
+	free(subs);
+	return err;
+}
+
+static int snd_seq_loop_unsubscribe_port(snd_seq_t *seq ATTRIBUTE_UNUSED,
+					 snd_seq_port_subscribe_t *sub)
+{
+	loop_subs_t *subs;
+	int err = 0;
+
+	pthread_rwlock_wrlock(&loop_core.lock);
+	subs = loop_find_subs(sub);
+	if (subs)
+		loop_remove_subs(subs);
+	else
+		err = -ENOENT;
+	pthread_rwlock_unlock(&loop_core.lock);
+	return err;
+}
+
+static int snd_seq_loop_query_port_subscribers(snd_seq_t *seq ATTRIBUTE_UNUSED,
+					       snd_seq_query_subscribe_t *subs)
+{
+	struct list_head *pos;
+	loop_port_t *port;
+	int c, p, count = 0, err = -ENOENT;
+
+	pthread_rwlock_rdlock(&loop_core.lock);
+	port = loop_port(subs->root.client, subs->root.port);
+	if (!port)
+		goto unlock;
+	if (subs->type == SNDRV_SEQ_QUERY_SUBS_READ) {
+		list_for_each(pos, &port->subs) {
+			loop_subs_t *s = list_entry(pos, loop_subs_t, list);
+			if (count++ == subs->index) {
+				subs->addr = s->info.dest;
+				subs->queue = s->info.queue;
+				subs->flags = s->info.flags;
+				err = 0;
+			}
+		}
+		goto done;
+	}
+	for (c = 0; c < LOOP_MAX_CLIENTS; c++) {
+		if (!loop_core.clients[c])
+			continue;
+		for (p = 0; p < LOOP_MAX_PORTS; p++) {
+			loop_port_t *other = loop_core.clients[c]->ports[p];
+			if (!other)
+				continue;
+			list_for_each(pos, &other->subs) {
+				loop_subs_t *s = list_entry(pos, loop_subs_t, list);
+				if (s->info.dest.client != subs->root.client ||
+				    s->info.dest.port != subs->root.port)
+					continue;
+				if (count++ == subs->index) {
+					subs->addr = s->info.sender;
+					subs->queue = s->info.queue;
+					subs->flags = s->info.flags;
+					err = 0;
+				}
+			}
+		}
+	}
+ done:
+	subs->num_subs = count;
+ unlock:
+	pthread_rwlock_unlock(&loop_core.lock);
+	return err;
+}
+
+static int snd_seq_loop_get_queue_status(snd_seq_t *seq ATTRIBUTE_UNUSED,
+					 snd_seq_queue_status_t *status)
+{
+	unsigned long long tick, time;
+	loop_queue_t *q;
+	int err = 0;
+
+	pthread_mutex_lock(&loop_core.qlock);
+	q = loop_queue(status->queue);
+	if (q) {
+		loop_queue_position(q, loop_now(), &tick, &time);
+		status->events = q->events;
+		status->tick = tick;
+		status->time.tv_sec = time / 1000000000ULL;
+		status->time.tv_nsec = time % 1000000000ULL;
+		status->running = q->running;
+		status->flags = 0;
+	} else {
+		err = -EINVAL;
+	}
+	pthread_mutex_unlock(&loop_core.qlock);
+	return err;
+}
+
+static int snd_seq_loop_get_queue_tempo(snd_seq_t *seq ATTRIBUTE_UNUSED,
+					snd_seq_queue_tempo_t *tempo)
+{
+	loop_queue_t *q;
+	int err = 0;
+
+	pthread_mutex_lock(&loop_core.qlock);
+	q = loop_queue(tempo->queue);
+	if (q) {
+		tempo->tempo = q->tempo;
+		tempo->ppq = q->ppq;
+		tempo->skew_value = q->skew_value;
+		tempo->skew_base = q->skew_base;
+	} else {
+		err = -EINVAL;
+	}
+	pthread_mutex_unlock(&loop_core.qlock);
+	return err;
+}
+
+static int snd_seq_loop_set_queue_tempo(snd_seq_t *seq ATTRIBUTE_UNUSED,
+					snd_seq_queue_tempo_t *tempo)
+{
+	loop_queue_t *q;
+	int err = 0;
+
+	if (!tempo->tempo || tempo->ppq <= 0)
+		return -EINVAL;
+	/* as the kernel, a zero base leaves the skew unchanged */
+	if (tempo->skew_base && tempo->skew_base != LOOP_SKEW_BASE)
+		return -EINVAL;
+	pthread_mutex_lock(&loop_core.qlock);
+	q = loop_queue(tempo->queue);
+	if (q) {
+		loop_queue_rebase(q, loop_now());
+		q->tempo = tempo->tempo;
+		q->ppq = tempo->ppq;
+		if (tempo->skew_base)
+			q->skew_value = tempo->skew_value;
+		pthread_cond_signal(&loop_core.qcond);
+	} else {
+		err = -EINVAL;
+	}
+	pthread_mutex_unlock(&loop_core.qlock);
+	return err;
+}
+
+static int snd_seq_loop_get_queue_timer(snd_seq_t *seq ATTRIBUTE_UNUSED,
+					snd_seq_queue_timer_t *timer)
+{
+	int err = 0;
+
+	pthread_mutex_lock(&loop_core.qlock);
+	if (loop_queue(timer->queue)) {
+		memset(&timer->u, 0, sizeof(timer->u));
+		timer->type = SND_SEQ_TIMER_ALSA;
+		timer->u.alsa.id.dev_class = SND_TIMER_CLASS_GLOBAL;
+		timer->u.alsa.id.device = SND_TIMER_GLOBAL_SYSTEM;
+	} else {
+		err = -EINVAL;
+	}
+	pthread_mutex_unlock(&loop_core.qlock);
+	return err;
+}
+
+static int snd_seq_loop_set_queue_timer(snd_seq_t *seq ATTRIBUTE_UNUSED,
+					snd_seq_queue_timer_t *timer)
+{
+	int err = 0;
+
+	/* the queues always run on the monotonic clock */
+	pthread_mutex_lock(&loop_core.qlock);
+	if (!loop_queue(timer->queue))
+		err = -EINVAL;
+	else if (timer->type != SND_SEQ_TIMER_ALSA)
+		err = -EINVAL;
+	pthread_mutex_unlock(&loop_core.qlock);
+	return err;
+}
+
+static int snd_seq_loop_get_queue_client(snd_seq_t *seq ATTRIBUTE_UNUSED,
+					 snd_seq_queue_client_t *info)
+{
+	loop_queue_t *q;
+	int err = 0;
+
+	pthread_mutex_lock(&loop_core.qlock);
+	q = loop_queue(info->queue);
+	if (q && info->client >= 0 && info->client < LOOP_MAX_CLIENTS)
+		info->used = q->used[info->client];
+	else
+		err = -EINVAL;
+	pthread_mutex_unlock(&loop_core.qlock);
+	return err;
+}
+
+static int snd_seq_loop_set_queue_client(snd_seq_t *seq ATTRIBUTE_UNUSED,
+					 snd_seq_queue_client_t *info)
+{
+	loop_queue_t *q;
+	int err = 0;
+
+	pthread_mutex_lock(&loop_core.qlock);
+	q = loop_queue(info->queue);
+	if (q && info->client >= 0 && info->client < LOOP_MAX_CLIENTS)
+		q->used[info->client] = info->used ? 1 : 0;
+	else
+		err = -EINVAL;
+	pthread_mutex_unlock(&loop_core.qlock);
+	return err;
+}
+
+static int snd_seq_loop_create_queue(snd_seq_t *seq, snd_seq_queue_info_t *info)
+{
+	snd_seq_loop_t *loop = seq->private_data;
+	loop_queue_t *q;
+	int idx, err;
+
+	q = calloc(1, sizeof(*q));
+	if (!q)
+		return -ENOMEM;
+	q->info = *info;
+	q->info.owner = loop->client->info.client;
+	q->info.name[sizeof(q->info.name) - 1] = 0;
+	q->tempo = 500000;
+	q->ppq = 96;
+	q->skew_value = LOOP_SKEW_BASE;
+	q->skew_base = LOOP_SKEW_BASE;
+	q->used[q->info.owner] = 1;
+	INIT_LIST_HEAD(&q->tick_events);
+	INIT_LIST_HEAD(&q->time_events);
+	pthread_mutex_lock(&loop_core.qlock);
+	for (idx = 0; idx < LOOP_MAX_QUEUES; idx++)
+		if (!loop_core.queues[idx])
+			break;
+	if (idx >= LOOP_MAX_QUEUES) {
+		err = -ENOMEM;
+		goto error;
+	}
+	if (!loop_core.thread_running) {
+		loop_core.thread_stop = 0;
+		err = -pthread_create(&loop_core.thread, NULL, loop_dispatcher, NULL);
+		if (err < 0)
+			goto error;
+		loop_core.thread_running = 1;
+	}
+	q->info.queue = idx;
+	loop_core.queues[idx] = q;
+	*info = q->info;
+	pthread_mutex_unlock(&loop_core.qlock);
+	return 0;
+
+ error:
+	pthread_mutex_unlock(&loop_core.qlock);
+	free(q);
+	return err;
+}
+
+static int snd_seq_loop_delete_queue(snd_seq_t *seq, snd_seq_queue_info_t *info)
+{
+	snd_seq_loop_t *loop = seq->private_data;
+	loop_queue_t *q;
+	int err = 0;
+
+	pthread_mutex_lock(&loop_core.qlock);
+	q = loop_queue(info->queue);
+	if (!q) {
+		err = -EINVAL;
+	} else if (q->info.owner != loop->client->info.client) {
+		err = -EPERM;
+	} else {
+		loop_free_events(&q->tick_events);
+		loop_free_events(&q->time_events);
+		loop_core.queues[info->queue] = NULL;
+		free(q);
+	}
+	pthread_mutex_unlock(&loop_core.qlock);
+	return err;
+}
+
+static int snd_seq_loop_get_queue_info(snd_seq_t *seq ATTRIBUTE_UNUSED,
+				       snd_seq_queue_info_t *info)
+{
+	loop_queue_t *q;
+	int err = 0;
+
+	pthread_mutex_lock(&loop_core.qlock);
+	q = loop_queue(info->queue);
+	if (q)
+		*info = q->info;
+	else
+		err = -EINVAL;
+	pthread_mutex_unlock(&loop_core.qlock);
+	return err;
+}
+
+static int snd_seq_loop_set_queue_info(snd_seq_t *seq, snd_seq_queue_info_t *info)
+{
+	snd_seq_loop_t *loop = seq->private_data;
+	loop_queue_t *q;
+	int err = 0;
+
+	pthread_mutex_lock(&loop_core.qlock);
+	q = loop_queue(info->queue);
+	if (!q) {
+		err = -EINVAL;
+	} else if (q->info.owner != loop->client->info.client) {
+		err = -EPERM;
+	} else {
+		memcpy(q->info.name, info->name, sizeof(q->info.name));
+		q->info.name[sizeof(q->info.name) - 1] = 0;
+		q->info.locked = info->locked;
+		q->info.flags = info->flags;
+		if (loop_client(info->owner))
+			q->info.owner = info->owner;
+	}
+	pthread_mutex_unlock(&loop_core.qlock);
+	return err;
+}
+
+static int snd_seq_loop_get_named_queue(snd_seq_t *seq ATTRIBUTE_UNUSED,
+					snd_seq_queue_info_t *info)
+{
+	int idx, err = -EINVAL;
+
+	pthread_mutex_lock(&loop_core.qlock);
+	for (idx = 0; idx < LOOP_MAX_QUEUES; idx++) {
+		loop_queue_t *q = loop_core.queues[idx];
+		if (q && !strncmp(q->info.name, info->name, sizeof(q->info.name))) {
+			*info = q->info;
+			err = 0;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&loop_core.qlock);
+	return err;
+}
+
+static ssize_t snd_seq_loop_write(snd_seq_t *seq, void *buf, size_t len)
+{
+	snd_seq_loop_t *loop = seq->private_data;
+	snd_seq_event_t ev;
+	size_t done = 0, dlen;
+	const void *data;
+	ssize_t elen;
+	int err = 0;
+
+	pthread_rwlock_rdlock(&loop_core.lock);
+	while (len - done >= sizeof(ev)) {
+		memcpy(&ev, (char *)buf + done, sizeof(ev));
+		elen = snd_seq_event_length(&ev);
+		if (elen < 0 || (size_t)elen > len - done) {
+			err = -EINVAL;
+			break;
+		}
+		data = (char *)buf + done + sizeof(ev);
+		dlen = elen - sizeof(ev);
+		if (snd_seq_ev_is_varusr(&ev)) {
+			/* the data is copied from the user pointer as by the kernel */
+			data = ev.data.ext.ptr;
+			dlen = ev.data.ext.len;
+			ev.flags &= ~SND_SEQ_EVENT_LENGTH_MASK;
+			ev.flags |= SND_SEQ_EVENT_LENGTH_VARIABLE;
+		}
+		ev.source.client = loop->client->info.client;
+		if (snd_seq_ev_is_direct(&ev))
+			loop_deliver(&ev, data);
+		else {
+			err = loop_enqueue(&ev, data, dlen);
+			if (err < 0)
+				break;
+		}
+		done += elen;
+	}
+	pthread_rwlock_unlock(&loop_core.lock);
+	if (!done && err < 0)
+		return err;
+	return done;
+}
+
+static ssize_t snd_seq_loop_read(snd_seq_t *seq, void *buf, size_t len)
+{
+	snd_seq_loop_t *loop = seq->private_data;
+	loop_client_t *client = loop->client;
+	struct pollfd pfd;
+	size_t count;
+
+	for (;;) {
+		if (__atomic_exchange_n(&client->overflow, 0, __ATOMIC_SEQ_CST)) {
+			/* like the kernel, the FIFO is cleared on overflow */
+			loop_fifo_get(&client->fifo, NULL, client->fifo.mask + 1);
+			return -ENOSPC;
+		}
+		count = loop_fifo_get(&client->fifo, buf, len / sizeof(snd_seq_event_t));
+		if (count) {
+			/* drop a stale wakeup so poll() does not report an empty FIFO */
+			if (loop_fifo_empty(&client->fifo))
+				loop_arm_wakeup(client);
+			return count;
+		}
+		if (!loop_fifo_empty(&client->fifo))
+			return -EINVAL;	/* the buffer is too small */
+		if (loop_arm_wakeup(client))
+			continue;
+		if (seq->mode & SND_SEQ_NONBLOCK)
+			return -EAGAIN;
+		pfd.fd = client->wake_fd[0];
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+			return -errno;
+	}
+}
+
+static int snd_seq_loop_remove_events(snd_seq_t *seq, snd_seq_remove_events_t *rmp)
+{
+	snd_seq_loop_t *loop = seq->private_data;
+	struct list_head *pos, *npos;
+	struct list_head *lists[2];
+	int idx, l;
+
+	if (rmp->remove_mode & SNDRV_SEQ_REMOVE_INPUT)
+		loop_fifo_get(&loop->client->fifo, NULL, loop->client->fifo.mask + 1);
+	if (!(rmp->remove_mode & SNDRV_SEQ_REMOVE_OUTPUT))
+		return 0;
+	pthread_mutex_lock(&loop_core.qlock);
+	for (idx = 0; idx < LOOP_MAX_QUEUES; idx++) {
+		loop_queue_t *q = loop_core.queues[idx];
+		if (!q)
+			continue;
+		if ((rmp->remove_mode & SNDRV_SEQ_REMOVE_DEST) && rmp->queue != idx)
+			continue;
+		lists[0] = &q->tick_events;
+		lists[1] = &q->time_events;
+		for (l = 0; l < 2; l++) {
+			list_for_each_safe(pos, npos, lists[l]) {
+				loop_event_t *e = list_entry(pos, loop_event_t, list);
+				if (e->ev.source.client != loop->client->info.client ||
+				    !_snd_seq_remove_match(rmp, &e->ev))
+					continue;
+				list_del(&e->list);
+				free(e);
+				q->events--;
+			}
+		}
+	}
+	pthread_mutex_unlock(&loop_core.qlock);
+	return 0;
+}
+
+static int snd_seq_loop_get_client_pool(snd_seq_t *seq, snd_seq_client_pool_t *info)
+{
+	snd_seq_loop_t *loop = seq->private_data;
+	loop_fifo_t *fifo = &loop->client->fifo;
+
+	info->client = loop->client->info.client;
+	info->output_pool = LOOP_OUTPUT_POOL;
+	info->output_room = LOOP_OUTPUT_POOL / 2;
+	info->output_free = LOOP_OUTPUT_POOL;
+	info->input_pool = fifo->mask + 1;
+	info->input_free = fifo->mask + 1 -
+		(__atomic_load_n(&fifo->tail, __ATOMIC_RELAXED) - fifo->head);
+	return 0;
+}
+
+static int snd_seq_loop_set_client_pool(snd_seq_t *seq, snd_seq_client_pool_t *info)
+{
+	snd_seq_loop_t *loop = seq->private_data;
+	loop_client_t *client = loop->client;
+	loop_fifo_t fifo;
+	int err;
+
+	if (info->client != client->info.client)
+		return -EPERM;
+	if (info->input_pool <= 0 || (unsigned long)info->input_pool == client->fifo.mask + 1 ||
+	    !(client->streams & SND_SEQ_OPEN_INPUT))
+		return 0;
+	err = loop_fifo_init(&fifo, info->input_pool);
+	if (err < 0)
+		return err;
+	/* no writer can access the FIFO while the lock is held for writing */
+	pthread_rwlock_wrlock(&loop_core.lock);
+	if (!loop_fifo_empty(&client->fifo)) {
+		pthread_rwlock_unlock(&loop_core.lock);
+		free(fifo.cells);
+		return -EBUSY;
+	}
+	free(client->fifo.cells);
+	client->fifo = fifo;
+	pthread_rwlock_unlock(&loop_core.lock);
+	return 0;
+}
+
+static int snd_seq_loop_query_next_client(snd_seq_t *seq ATTRIBUTE_UNUSED,
+					  snd_seq_client_info_t *info)
+{
+	int idx, err = -ENOENT;
+
+	pthread_rwlock_rdlock(&loop_core.lock);
+	for (idx = info->client < 0 ? 0 : info->client + 1; idx < LOOP_MAX_CLIENTS; idx++) {
+		if (loop_core.clients[idx]) {
+			loop_client_info(loop_core.clients[idx], info);
+			err = 0;
+			break;
+		}
+	}
+	pthread_rwlock_unlock(&loop_core.lock);
+	return err;
+}
+
+static int snd_seq_loop_query_next_port(snd_seq_t *seq ATTRIBUTE_UNUSED,
+					snd_seq_port_info_t *info)
+{
+	loop_client_t *client;
+	int idx, err = -ENOENT;
+
+	pthread_rwlock_rdlock(&loop_core.lock);
+	client = loop_client(info->addr.client);
+	if (client) {
+		for (idx = info->addr.port + 1; idx < LOOP_MAX_PORTS; idx++) {
+			if (idx >= 0 && client->ports[idx]) {
+				loop_port_info(client, client->ports[idx], info);
+				err = 0;
+				break;
+			}
+		}
+	}
+	pthread_rwlock_unlock(&loop_core.lock);
+	return err;
+}
+
+static const snd_seq_ops_t snd_seq_loop_ops = {
+	.close = snd_seq_loop_close,
+	.nonblock = snd_seq_loop_nonblock,
+	.system_info = snd_seq_loop_system_info,
+	.get_client_info = snd_seq_loop_get_client_info,
+	.set_client_info = snd_seq_loop_set_client_info,
+	.create_port = snd_seq_loop_create_port,
+	.delete_port = snd_seq_loop_delete_port,
+	.get_port_info = snd_seq_loop_get_port_info,
+	.set_port_info = snd_seq_loop_set_port_info,
+	.get_port_subscription = snd_seq_loop_get_port_subscription,
+	.subscribe_port = snd_seq_loop_subscribe_port,
+	.unsubscribe_port = snd_seq_loop_unsubscribe_port,
+	.query_port_subscribers = snd_seq_loop_query_port_subscribers,
+	.get_queue_status = snd_seq_loop_get_queue_status,
+	.get_queue_tempo = snd_seq_loop_get_queue_tempo,
+	.set_queue_tempo = snd_seq_loop_set_queue_tempo,
+	.get_queue_timer = snd_seq_loop_get_queue_timer,
+	.set_queue_timer = snd_seq_loop_set_queue_timer,
+	.get_queue_client = snd_seq_loop_get_queue_client,
+	.set_queue_client = snd_seq_loop_set_queue_client,
+	.create_queue = snd_seq_loop_create_queue,
+	.delete_queue = snd_seq_loop_delete_queue,
+	.get_queue_info = snd_seq_loop_get_queue_info,
+	.set_queue_info = snd_seq_loop_set_queue_info,
+	.get_named_queue = snd_seq_loop_get_named_queue,
+	.write = snd_seq_loop_write,
+	.read = snd_seq_loop_read,
+	.remove_events = snd_seq_loop_remove_events,
+	.get_client_pool = snd_seq_loop_get_client_pool,
+	.set_client_pool = snd_seq_loop_set_client_pool,
+	.query_next_client = snd_seq_loop_query_next_client,
+	.query_next_port = snd_seq_loop_query_next_port,
+};
+
+/* create the core with its system client; loop_open_mutex must be held */
+static int loop_core_init(void)
+{
+	static const char *const names[2] = { "Timer", "Announce" };
+	pthread_condattr_t attr;
+	loop_client_t *system;
+	int idx;
+
+	system = calloc(1, sizeof(*system));
+	if (!system)
+		return -ENOMEM;
+	system->info.client = SND_SEQ_CLIENT_SYSTEM;
+	system->info.type = KERNEL_CLIENT;
+	strcpy(system->info.name, "System");
+	system->info.card = -1;
+	system->info.pid = -1;
+	for (idx = 0; idx < 2; idx++) {
+		loop_port_t *port = calloc(1, sizeof(*port));
+		if (!port) {
+			while (idx-- > 0)
+				free(system->ports[idx]);
+			free(system);
+			return -ENOMEM;
+		}
+		INIT_LIST_HEAD(&port->subs);
+		port->info.addr.port = idx;
+		strcpy(port->info.name, names[idx]);
+		port->info.capability = idx ? SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ :
+			SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_WRITE |
+			SND_SEQ_PORT_CAP_SUBS_READ | SND_SEQ_PORT_CAP_SUBS_WRITE;
+		system->ports[idx] = port;
+		system->info.num_ports++;
+	}
+	pthread_rwlock_init(&loop_core.lock, NULL);
+	pthread_mutex_init(&loop_core.qlock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&loop_core.qcond, &attr);
+	pthread_condattr_destroy(&attr);
+	loop_core.clients[SND_SEQ_CLIENT_SYSTEM] = system;
+	return 0;
+}
+
+int snd_seq_loop_open(snd_seq_t **handle, const char *name, int streams, int mode)
+{
+	snd_seq_loop_t *loop = NULL;
+	loop_client_t *client = NULL;
+	snd_seq_t *seq = NULL;
+	int idx, err;
+
+	*handle = NULL;
+	if (!(streams & SND_SEQ_OPEN_DUPLEX))
+		return -EINVAL;
+	loop = calloc(1, sizeof(*loop));
+	client = calloc(1, sizeof(*client));
+	seq = calloc(1, sizeof(*seq));
+	if (!loop || !client || !seq) {
+		err = -ENOMEM;
+		goto _err;
+	}
+	client->wake_fd[0] = client->wake_fd[1] = -1;
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, client->wake_fd) < 0) {
+		SYSERR("socketpair failed");
+		err = -errno;
+		goto _err;
+	}
+	client->streams = streams;
+	if (streams & SND_SEQ_OPEN_INPUT) {
+		err = loop_fifo_init(&client->fifo, LOOP_FIFO_CELLS);
+		if (err < 0)
+			goto _err;
+	}
+	client->need_wakeup = 1;
+	client->info.type = USER_CLIENT;
+	client->info.filter = SNDRV_SEQ_FILTER_BROADCAST;
+	client->info.card = -1;
+	client->info.pid = getpid();
+	if (streams & SND_SEQ_OPEN_OUTPUT) {
+		seq->obuf = (char *) malloc(seq->obufsize = SND_SEQ_OBUF_SIZE);
+		if (!seq->obuf) {
+			err = -ENOMEM;
+			goto _err;
+		}
+	}
+	if (streams & SND_SEQ_OPEN_INPUT) {
+		seq->ibuf = (snd_seq_event_t *) calloc(sizeof(snd_seq_event_t), seq->ibufsize = SND_SEQ_IBUF_SIZE);
+		if (!seq->ibuf) {
+			err = -ENOMEM;
+			goto _err;
+		}
+	}
+
+	pthread_mutex_lock(&loop_open_mutex);
+	if (!loop_core.refs) {
+		err = loop_core_init();
+		if (err < 0) {
+			pthread_mutex_unlock(&loop_open_mutex);
+			goto _err;
+		}
+	}
+	pthread_rwlock_wrlock(&loop_core.lock);
+	for (idx = LOOP_CLIENT_BASE; idx < LOOP_MAX_CLIENTS; idx++)
+		if (!loop_core.clients[idx])
+			break;
+	if (idx < LOOP_MAX_CLIENTS) {
+		client->info.client = idx;
+		snprintf(client->info.name, sizeof(client->info.name), "Client-%d", idx);
+		loop_core.clients[idx] = client;
+		loop_core.refs++;
+	}
+	pthread_rwlock_unlock(&loop_core.lock);
+	if (!loop_core.refs) {
+		/* undo loop_core_init() */
+		free(loop_core.clients[0]->ports[0]);
+		free(loop_core.clients[0]->ports[1]);
+		free(loop_core.clients[0]);
+		loop_core.clients[0] = NULL;
+		pthread_rwlock_destroy(&loop_core.lock);
+		pthread_mutex_destroy(&loop_core.qlock);
+		pthread_cond_destroy(&loop_core.qcond);
+	}
+	pthread_mutex_unlock(&loop_open_mutex);
+	if (idx >= LOOP_MAX_CLIENTS) {
+		err = -EBUSY;
+		goto _err;
+	}
+
+	loop->client = client;
+	if (name)
+		seq->name = strdup(name);
+	seq->type = SND_SEQ_TYPE_LOOP;
+	seq->streams = streams;
+	seq->mode = mode;
+	seq->poll_fd = client->wake_fd[0];
+	seq->ops = &snd_seq_loop_ops;
+	seq->private_data = loop;
+	seq->client = idx;
+	*handle = seq;
+	return 0;
+
+ _err:
+	if (seq) {
+		free(seq->obuf);
+		free(seq->ibuf);
+		free(seq);
+	}
+	if (client) {
+		if (client->wake_fd[0] >= 0) {
+			close(client->wake_fd[0]);
+			close(client->wake_fd[1]);
+		}
+		free(client->fifo.cells);
+		free(client);
+	}
+	free(loop);
+	return err;
+}
+
+int _snd_seq_loop_open(snd_seq_t **handlep, char *name,
+		       snd_config_t *root ATTRIBUTE_UNUSED, snd_config_t *conf,
+		       int streams, int mode)
+{
+	snd_config_iterator_t i, next;
+	snd_config_for_each(i, next, conf) {
+		snd_config_t *n = snd_config_iterator_entry(i);
+		const char *id;
+		if (snd_config_get_id(n, &id) < 0)
+			continue;
+		if (_snd_conf_generic_id(id))
+			continue;
+		SNDERR("Unknown field %s", id);
+		return -EINVAL;
+	}
+	return snd_seq_loop_open(handlep, name, streams, mode);
+}
+SND_DLSYM_BUILD_VERSION(_snd_seq_loop_open, SND_SEQ_DLSYM_VERSION);
+
+#endif /* HAVE_LIBPTHREAD */
@@ -29,6 +29,7 @@
  */
 
 #include <malloc.h>
+#include <stdint.h>
 #include "local.h"
 
 #ifndef DOC_HIDDEN
@@ -294,6 +295,83 @@ int snd_midi_event_resize_buffer(snd_midi_event_t *dev, size_t bufsize)
 	return 0;
 }
 
+/* number of leading data bytes (below 0x80) in buf */
+static long data_bytes(const unsigned char *buf, long count)
+{
+	long n = 0;
+	uint64_t w;
+
+	/* test eight bytes at once for a status byte */
+	while (count - n >= 8) {
+		memcpy(&w, buf + n, sizeof(w));
+		if (w & 0x8080808080808080ULL)
+			break;
+		n += 8;
+	}
+	while (n < count && buf[n] < 0x80)
+		n++;
+	return n;
+}
+
+/*
+ * Append the data bytes at the start of buf to a SysEx message, like
+ * snd_midi_event_encode_byte() does for each of them.  A full buffer
+ * completes an event.  Returns the number of bytes consumed.
+ */
+static long encode_sysex_data(snd_midi_event_t *dev, const unsigned char *buf,
+			      long count, snd_seq_event_t *ev)
+{
+	size_t room = dev->bufsize - dev->read;
+	long n;
+
+	n = data_bytes(buf, count);
+	if ((size_t)n < room) {
+		memcpy(dev->buf + dev->read, buf, n);
+		dev->read += n;
+		return n;
+	}
+	memcpy(dev->buf + dev->read, buf, room);
+	ev->flags &= ~SND_SEQ_EVENT_LENGTH_MASK;
+	ev->flags |= SND_SEQ_EVENT_LENGTH_VARIABLE;
+	ev->type = SND_SEQ_EVENT_SYSEX;
+	ev->data.ext.len = dev->bufsize;
+	ev->data.ext.ptr = dev->buf;
+	dev->read = 0; /* continue to parse */
+	return room;
+}
+
+/*
+ * Complete a channel message, possibly with running status, when all its
+ * remaining data bytes are at the start of buf.  Returns the number of
+ * bytes consumed, or 0 when the bytes must go through
+ * snd_midi_event_encode_byte().
+ */
+static long encode_channel_data(snd_midi_event_t *dev, const unsigned char *buf,
+				long count, snd_seq_event_t *ev)
+{
+	const struct status_event_list_t *st = &status_event[dev->type];
+	long need;
+	size_t pos;
+
+	if (dev->qlen > 0) {
+		need = dev->qlen;
+		pos = dev->read;
+	} else {
+		need = st->qlen;	/* running status */
+		pos = 1;
+	}
+	if (need > count || data_bytes(buf, need) != need)
+		return 0;
+	memcpy(dev->buf + pos, buf, need);
+	dev->read = pos + need;
+	dev->qlen = 0;
+	ev->type = st->event;
+	ev->flags &= ~SND_SEQ_EVENT_LENGTH_MASK;
+	ev->flags |= SND_SEQ_EVENT_LENGTH_FIXED;
+	st->encode(dev, ev);
+	return need;
+}
+
 /**
  * \brief Encodes bytes to sequencer event.
  * \param[in] dev MIDI event parser.
@@ -359,13 +437,29 @@ int snd_midi_event_resize_buffer(snd_midi_event_t *dev, size_t bufsize)
  */
 long snd_midi_event_encode(snd_midi_event_t *dev, const unsigned char *buf, long count, snd_seq_event_t *ev)
 {
-	long result = 0;
+	long result = 0, n;
 	int rc;
 
 	ev->type = SND_SEQ_EVENT_NONE;
 
-	while (count-- > 0) {
+	while (count > 0) {
+		/* runs of data bytes are handled in bulk */
+		if (dev->type == ST_SYSEX && dev->read < dev->bufsize) {
+			n = encode_sysex_data(dev, buf, count, ev);
+			if (ev->type != SND_SEQ_EVENT_NONE)
+				return result + n;
+			buf += n;
+			count -= n;
+			result += n;
+			if (!count)
+				break;
+		} else if (dev->type < ST_INVALID) {
+			n = encode_channel_data(dev, buf, count, ev);
+			if (n > 0)
+				return result + n;
+		}
 		rc = snd_midi_event_encode_byte(dev, *buf++, ev);
+		count--;
 		result++;
 		if (rc < 0)
 			return rc;
@@ -20,10 +20,18 @@
 
 #ifndef PIC
 
+#include "config.h"
+
 extern const char *_snd_module_seq_hw;
+#ifdef HAVE_LIBPTHREAD
+extern const char *_snd_module_seq_loop;
+#endif
 
 static const char **snd_seq_open_objects[] = {
-	&_snd_module_seq_hw
+	&_snd_module_seq_hw,
+#ifdef HAVE_LIBPTHREAD
+	&_snd_module_seq_loop,
+#endif
 };
 	
 void *snd_seq_open_symbols(void)
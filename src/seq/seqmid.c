@@ -370,6 +370,302 @@ int snd_seq_sync_output_queue(snd_seq_t *seq)
 	return err;
 }
 
+/* events copied and stamped at once by the scheduler */
+#define SCHEDULER_BATCH		64
+
+struct _snd_seq_scheduler {
+	snd_seq_t *seq;
+	int queue;
+	unsigned int watermark;		/* events kept in the queue */
+	snd_seq_event_t *events;
+	unsigned int count;
+	unsigned int pos;		/* next event to be sent */
+	snd_seq_tick_time_t base_tick;	/* origin of the relative events */
+	snd_seq_real_time_t base_time;
+	unsigned int batches;
+	unsigned int late;
+	snd_seq_tick_time_t max_late_tick;
+	snd_seq_real_time_t max_late_time;
+};
+
+/**
+ * \brief create a scheduler feeding events to a queue
+ * \param schedp the pointer to store the new scheduler
+ * \param seq sequencer handle
+ * \param queue the queue id
+ * \param watermark the number of events to keep scheduled on the queue
+ * \return 0 on success or negative error code
+ *
+ * The scheduler sends a long sorted event list to the queue without
+ * overfilling the output pool.  Each #snd_seq_scheduler_fill() call
+ * tops the queue up to \a watermark events once it dropped to the half
+ * of it, so the events are written in large batches.  The watermark is
+ * limited to the output pool size, and the output room of the client
+ * pool is set to the half of it: the sequencer reports \c POLLOUT when
+ * the next batch fits.
+ *
+ * A typical player loop:
+ * \code
+ * snd_seq_scheduler_set_events(sched, evs, count);
+ * snd_seq_start_queue(seq, queue, NULL);
+ * snd_seq_drain_output(seq);
+ * while (snd_seq_scheduler_pending(sched) > 0) {
+ *	snd_seq_scheduler_fill(sched);
+ *	snd_seq_poll_descriptors(seq, &pfd, 1, POLLOUT);
+ *	poll(&pfd, 1, -1);
+ * }
+ * snd_seq_sync_output_queue(seq);
+ * \endcode
+ *
+ * \sa snd_seq_scheduler_fill(), snd_seq_set_client_pool_output_room()
+ */
+int snd_seq_scheduler_new(snd_seq_scheduler_t **schedp, snd_seq_t *seq, int queue,
+			  unsigned int watermark)
+{
+	snd_seq_scheduler_t *sched;
+	snd_seq_client_pool_t info;
+	int err;
+
+	assert(schedp && seq);
+	if (!watermark)
+		return -EINVAL;
+	if ((err = snd_seq_get_client_pool(seq, &info)) < 0)
+		return err;
+	if (watermark > (unsigned int)info.output_pool)
+		watermark = info.output_pool;
+	info.output_room = watermark / 2 ? watermark / 2 : 1;
+	if ((err = snd_seq_set_client_pool(seq, &info)) < 0)
+		return err;
+	sched = calloc(1, sizeof(*sched));
+	if (!sched)
+		return -ENOMEM;
+	sched->seq = seq;
+	sched->queue = queue;
+	sched->watermark = watermark;
+	*schedp = sched;
+	return 0;
+}
+
+/**
+ * \brief free the scheduler
+ * \param sched the scheduler
+ *
+ * The events already sent stay on the queue.
+ */
+void snd_seq_scheduler_free(snd_seq_scheduler_t *sched)
+{
+	free(sched);
+}
+
+/**
+ * \brief set the event list to be sent
+ * \param sched the scheduler
+ * \param evs the events sorted by their time stamps
+ * \param count the number of events
+ * \return 0 on success or negative error code
+ *
+ * The array is not copied and must stay valid until all events are
+ * sent.  The events are scheduled on the queue of the scheduler.
+ * Relative time stamps are taken relative to the queue position at this
+ * call, not to the position when the event is sent, so the timing does
+ * not drift with the batches.  The statistics are reset.
+ */
+int snd_seq_scheduler_set_events(snd_seq_scheduler_t *sched, snd_seq_event_t *evs,
+				 unsigned int count)
+{
+	snd_seq_queue_status_t status;
+	int err;
+
+	assert(sched && (evs || !count));
+	memset(&status, 0, sizeof(status));
+	if ((err = snd_seq_get_queue_status(sched->seq, sched->queue, &status)) < 0)
+		return err;
+	sched->events = evs;
+	sched->count = count;
+	sched->pos = 0;
+	sched->base_tick = status.tick;
+	sched->base_time.tv_sec = status.time.tv_sec;
+	sched->base_time.tv_nsec = status.time.tv_nsec;
+	sched->batches = 0;
+	sched->late = 0;
+	sched->max_late_tick = 0;
+	sched->max_late_time.tv_sec = 0;
+	sched->max_late_time.tv_nsec = 0;
+	return 0;
+}
+
+/* make the event time absolute on the scheduler queue */
+static void scheduler_prepare(snd_seq_scheduler_t *sched, snd_seq_event_t *ev)
+{
+	ev->queue = sched->queue;
+	if ((ev->flags & SND_SEQ_TIME_MODE_MASK) == SND_SEQ_TIME_MODE_REL) {
+		if ((ev->flags & SND_SEQ_TIME_STAMP_MASK) == SND_SEQ_TIME_STAMP_REAL) {
+			ev->time.time.tv_sec += sched->base_time.tv_sec;
+			ev->time.time.tv_nsec += sched->base_time.tv_nsec;
+			if (ev->time.time.tv_nsec >= 1000000000) {
+				ev->time.time.tv_sec++;
+				ev->time.time.tv_nsec -= 1000000000;
+			}
+		} else {
+			ev->time.tick += sched->base_tick;
+		}
+	}
+	ev->flags &= ~SND_SEQ_TIME_MODE_MASK;
+	ev->flags |= SND_SEQ_TIME_MODE_ABS;
+}
+
+/* count a sent event behind the queue position as late */
+static void scheduler_account(snd_seq_scheduler_t *sched, const snd_seq_event_t *ev,
+			      const snd_seq_queue_status_t *status)
+{
+	snd_seq_real_time_t late;
+
+	if ((ev->flags & SND_SEQ_TIME_STAMP_MASK) == SND_SEQ_TIME_STAMP_REAL) {
+		if (ev->time.time.tv_sec > status->time.tv_sec ||
+		    (ev->time.time.tv_sec == status->time.tv_sec &&
+		     ev->time.time.tv_nsec >= status->time.tv_nsec))
+			return;
+		late.tv_sec = status->time.tv_sec - ev->time.time.tv_sec;
+		if (status->time.tv_nsec >= ev->time.time.tv_nsec) {
+			late.tv_nsec = status->time.tv_nsec - ev->time.time.tv_nsec;
+		} else {
+			late.tv_sec--;
+			late.tv_nsec = status->time.tv_nsec + 1000000000 - ev->time.time.tv_nsec;
+		}
+		if (late.tv_sec > sched->max_late_time.tv_sec ||
+		    (late.tv_sec == sched->max_late_time.tv_sec &&
+		     late.tv_nsec > sched->max_late_time.tv_nsec))
+			sched->max_late_time = late;
+	} else {
+		if (ev->time.tick >= status->tick)
+			return;
+		if (status->tick - ev->time.tick > sched->max_late_tick)
+			sched->max_late_tick = status->tick - ev->time.tick;
+	}
+	sched->late++;
+}
+
+/**
+ * \brief send the next batch of events
+ * \param sched the scheduler
+ * \return the number of events sent or negative error code
+ *
+ * Does nothing while more than the half of the watermark is scheduled
+ * on the queue.  Otherwise the queue is filled up to the watermark and
+ * the events are drained to the sequencer.  Call this function again
+ * when the sequencer reports \c POLLOUT.
+ *
+ * The events found behind the current queue position when they are
+ * sent are counted as late, see #snd_seq_scheduler_get_late().
+ */
+int snd_seq_scheduler_fill(snd_seq_scheduler_t *sched)
+{
+	snd_seq_queue_status_t status;
+	snd_seq_event_t batch[SCHEDULER_BATCH];
+	unsigned int room, n, i, sent = 0;
+	int err;
+
+	assert(sched);
+	/* the previous batch is not out yet */
+	err = snd_seq_drain_output(sched->seq);
+	if (err < 0)
+		return err == -EAGAIN ? 0 : err;
+	if (sched->pos >= sched->count)
+		return 0;
+	memset(&status, 0, sizeof(status));
+	if ((err = snd_seq_get_queue_status(sched->seq, sched->queue, &status)) < 0)
+		return err;
+	if ((unsigned int)status.events > sched->watermark / 2)
+		return 0;
+	room = sched->watermark - status.events;
+	while (room > 0 && sched->pos < sched->count) {
+		n = sched->count - sched->pos;
+		if (n > room)
+			n = room;
+		if (n > SCHEDULER_BATCH)
+			n = SCHEDULER_BATCH;
+		memcpy(batch, sched->events + sched->pos, n * sizeof(snd_seq_event_t));
+		for (i = 0; i < n; i++)
+			scheduler_prepare(sched, &batch[i]);
+		err = snd_seq_event_output_array(sched->seq, batch, n);
+		if (err < 0)
+			break;
+		/* the rest is prepared again from the originals next time */
+		for (i = 0; i < (unsigned int)err; i++)
+			scheduler_account(sched, &batch[i], &status);
+		sched->pos += err;
+		sent += err;
+		room -= err;
+		if ((unsigned int)err < n)
+			break;
+	}
+	if (sent)
+		sched->batches++;
+	if (err >= 0 || err == -EAGAIN) {
+		err = snd_seq_drain_output(sched->seq);
+		if (err == -EAGAIN)
+			err = 0;
+	}
+	if (err < 0 && !sent)
+		return err;
+	return sent;
+}
+
+/**
+ * \brief get the number of events not sent yet
+ * \param sched the scheduler
+ * \return the number of events
+ */
+unsigned int snd_seq_scheduler_pending(snd_seq_scheduler_t *sched)
+{
+	assert(sched);
+	return sched->count - sched->pos;
+}
+
+/**
+ * \brief get the number of batches sent
+ * \param sched the scheduler
+ * \return the number of #snd_seq_scheduler_fill() calls which sent events
+ */
+unsigned int snd_seq_scheduler_get_batches(snd_seq_scheduler_t *sched)
+{
+	assert(sched);
+	return sched->batches;
+}
+
+/**
+ * \brief get the number of late events
+ * \param sched the scheduler
+ * \return the number of events sent after the queue passed their time
+ */
+unsigned int snd_seq_scheduler_get_late(snd_seq_scheduler_t *sched)
+{
+	assert(sched);
+	return sched->late;
+}
+
+/**
+ * \brief get the maximal lateness of the tick scheduled events
+ * \param sched the scheduler
+ * \return the lateness in ticks
+ */
+snd_seq_tick_time_t snd_seq_scheduler_get_max_late_tick(snd_seq_scheduler_t *sched)
+{
+	assert(sched);
+	return sched->max_late_tick;
+}
+
+/**
+ * \brief get the maximal lateness of the real-time scheduled events
+ * \param sched the scheduler
+ * \return the lateness
+ */
+const snd_seq_real_time_t *snd_seq_scheduler_get_max_late_time(snd_seq_scheduler_t *sched)
+{
+	assert(sched);
+	return &sched->max_late_time;
+}
+
 /**
  * \brief parse the given string and get the sequencer address
  * \param seq sequencer handle
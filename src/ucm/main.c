@@ -317,6 +317,28 @@ static int execute_cset(snd_ctl_t *ctl, const char *cset, unsigned int type)
 	return err;
 }
 
+/* execute a plain cset, compiled on the first use for the given ctl */
+static int execute_cset_compiled(snd_ctl_t *ctl, struct sequence_element *s)
+{
+	int err;
+
+	if (s->cset_compiled && s->cset_ctl == ctl) {
+		err = snd_ctl_ascii_cset_write(ctl, s->cset_compiled);
+		if (err != -ENOENT)
+			return err < 0 ? err : 0;
+		/* the element was removed or renumbered, compile again */
+	}
+	snd_ctl_ascii_cset_free(s->cset_compiled);
+	s->cset_compiled = NULL;
+	s->cset_ctl = NULL;
+	err = snd_ctl_ascii_cset_compile(&s->cset_compiled, ctl, s->data.cset);
+	if (err < 0)
+		return err;
+	s->cset_ctl = ctl;
+	err = snd_ctl_ascii_cset_write(ctl, s->cset_compiled);
+	return err < 0 ? err : 0;
+}
+
 /**
  * \brief Execute the sequence
  * \param uc_mgr Use case manager
@@ -406,7 +428,10 @@ static int execute_sequence(snd_use_case_mgr_t *uc_mgr,
 					goto __fail;
 				}
 			}
-			err = execute_cset(ctl, s->data.cset, s->type);
+			if (s->type == SEQUENCE_ELEMENT_TYPE_CSET)
+				err = execute_cset_compiled(ctl, s);
+			else
+				err = execute_cset(ctl, s->data.cset, s->type);
 			if (err < 0) {
 				uc_error("unable to execute cset '%s'", s->data.cset);
 				goto __fail;
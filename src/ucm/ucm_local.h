@@ -75,6 +75,9 @@ struct sequence_element {
 		char *exec;
 		struct component_sequence cmpt_seq; /* component sequence */
 	} data;
+	/* cset compiled on the first execution */
+	snd_ctl_t *cset_ctl;
+	snd_ctl_ascii_cset_t *cset_compiled;
 };
 
 /*
@@ -403,6 +403,7 @@ void uc_mgr_free_sequence_element(struct sequence_element *seq)
 	case SEQUENCE_ELEMENT_TYPE_CSET_BIN_FILE:
 	case SEQUENCE_ELEMENT_TYPE_CSET_TLV:
 		free(seq->data.cset);
+		snd_ctl_ascii_cset_free(seq->cset_compiled);
 		break;
 	case SEQUENCE_ELEMENT_TYPE_EXEC:
 		free(seq->data.exec);
@@ -0,0 +1,214 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "test.h"
+#include <alsa/control_external.h>
+
+/*
+ * A control_ext instance with a stereo volume, a stereo switch and an
+ * enumerated control is the target of the compiled assignments.
+ */
+#define VOLUME_KEY	0
+#define SWITCH_KEY	1
+#define MODE_KEY	2
+
+static const char *const elem_names[] = {
+	"Master Playback Volume", "Master Playback Switch", "Mode"
+};
+static const char *const mode_names[] = { "Off", "Low", "High" };
+static long volume[2];
+static long sw[2];
+static unsigned int mode;
+static int writes;
+
+static int stub_elem_count(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED)
+{
+	return 3;
+}
+
+static int stub_elem_list(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			  unsigned int offset, snd_ctl_elem_id_t *id)
+{
+	snd_ctl_elem_id_set_interface(id, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_id_set_name(id, elem_names[offset]);
+	return 0;
+}
+
+static snd_ctl_ext_key_t stub_find_elem(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+					const snd_ctl_elem_id_t *id)
+{
+	unsigned int i;
+
+	for (i = 0; i < 3; i++)
+		if (!strcmp(snd_ctl_elem_id_get_name(id), elem_names[i]))
+			return i;
+	return SND_CTL_EXT_KEY_NOT_FOUND;
+}
+
+static int stub_get_attribute(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			      snd_ctl_ext_key_t key, int *type,
+			      unsigned int *acc, unsigned int *count)
+{
+	*acc = SND_CTL_EXT_ACCESS_READWRITE;
+	*count = 2;
+	if (key == VOLUME_KEY)
+		*type = SND_CTL_ELEM_TYPE_INTEGER;
+	else if (key == SWITCH_KEY)
+		*type = SND_CTL_ELEM_TYPE_BOOLEAN;
+	else {
+		*type = SND_CTL_ELEM_TYPE_ENUMERATED;
+		*count = 1;
+	}
+	return 0;
+}
+
+static int stub_get_integer_info(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+				 snd_ctl_ext_key_t key ATTRIBUTE_UNUSED,
+				 long *imin, long *imax, long *istep)
+{
+	*imin = 0;
+	*imax = 200;
+	*istep = 1;
+	return 0;
+}
+
+static int stub_get_enumerated_info(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+				    snd_ctl_ext_key_t key ATTRIBUTE_UNUSED,
+				    unsigned int *items)
+{
+	*items = 3;
+	return 0;
+}
+
+static int stub_get_enumerated_name(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+				    snd_ctl_ext_key_t key ATTRIBUTE_UNUSED,
+				    unsigned int item, char *name,
+				    size_t name_max_len)
+{
+	if (item >= 3)
+		return -EINVAL;
+	snprintf(name, name_max_len, "%s", mode_names[item]);
+	return 0;
+}
+
+static int stub_read_integer(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			     snd_ctl_ext_key_t key, long *value)
+{
+	long *v = key == VOLUME_KEY ? volume : sw;
+
+	value[0] = v[0];
+	value[1] = v[1];
+	return 0;
+}
+
+static int stub_write_integer(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			      snd_ctl_ext_key_t key, long *value)
+{
+	long *v = key == VOLUME_KEY ? volume : sw;
+
+	writes++;
+	v[0] = value[0];
+	v[1] = value[1];
+	return 1;
+}
+
+static int stub_read_enumerated(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+				snd_ctl_ext_key_t key ATTRIBUTE_UNUSED,
+				unsigned int *items)
+{
+	*items = mode;
+	return 0;
+}
+
+static int stub_write_enumerated(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+				 snd_ctl_ext_key_t key ATTRIBUTE_UNUSED,
+				 unsigned int *items)
+{
+	writes++;
+	mode = *items;
+	return 1;
+}
+
+static const snd_ctl_ext_callback_t stub_callback = {
+	.elem_count = stub_elem_count,
+	.elem_list = stub_elem_list,
+	.find_elem = stub_find_elem,
+	.get_attribute = stub_get_attribute,
+	.get_integer_info = stub_get_integer_info,
+	.get_enumerated_info = stub_get_enumerated_info,
+	.get_enumerated_name = stub_get_enumerated_name,
+	.read_integer = stub_read_integer,
+	.write_integer = stub_write_integer,
+	.read_enumerated = stub_read_enumerated,
+	.write_enumerated = stub_write_enumerated,
+};
+
+static int cset(snd_ctl_t *ctl, const char *str)
+{
+	snd_ctl_ascii_cset_t *cset;
+	int err;
+
+	err = ALSA_CHECK(snd_ctl_ascii_cset_compile(&cset, ctl, str));
+	if (err < 0)
+		return err;
+	err = ALSA_CHECK(snd_ctl_ascii_cset_write(ctl, cset));
+	snd_ctl_ascii_cset_free(cset);
+	return err;
+}
+
+static void test_cset(void)
+{
+	snd_ctl_ext_t ext;
+	snd_ctl_ascii_cset_t *toggle;
+	snd_ctl_t *ctl;
+
+	memset(&ext, 0, sizeof(ext));
+	ext.version = SND_CTL_EXT_VERSION;
+	strcpy(ext.id, "Stub");
+	ext.poll_fd = -1;
+	ext.callback = &stub_callback;
+	if (ALSA_CHECK(snd_ctl_ext_create(&ext, "stub", 0)) < 0)
+		return;
+	ctl = ext.handle;
+
+	cset(ctl, "name='Master Playback Volume' 50%,10");
+	TEST_CHECK(volume[0] == 100 && volume[1] == 10);
+	/* a single value is applied to all channels */
+	cset(ctl, "name='Master Playback Volume' 7");
+	TEST_CHECK(volume[0] == 7 && volume[1] == 7);
+	/* missing values keep the current state */
+	volume[1] = 33;
+	cset(ctl, "name='Master Playback Volume' 9,");
+	TEST_CHECK(volume[0] == 9 && volume[1] == 33);
+
+	cset(ctl, "iface=MIXER,name='Mode' High");
+	TEST_CHECK(mode == 2);
+	cset(ctl, "name='Mode' Low");
+	TEST_CHECK(mode == 1);
+
+	sw[0] = 1;
+	sw[1] = 0;
+	if (ALSA_CHECK(snd_ctl_ascii_cset_compile(&toggle, ctl,
+			"name='Master Playback Switch' toggle,on")) >= 0) {
+		writes = 0;
+		snd_ctl_ascii_cset_write(ctl, toggle);
+		TEST_CHECK(sw[0] == 0 && sw[1] == 1);
+		snd_ctl_ascii_cset_write(ctl, toggle);
+		TEST_CHECK(sw[0] == 1 && sw[1] == 1);
+		TEST_CHECK(writes == 2);
+		snd_ctl_ascii_cset_free(toggle);
+	}
+
+	TEST_CHECK(snd_ctl_ascii_cset_compile(&toggle, ctl,
+					      "name='No Such Control' 1") < 0);
+	TEST_CHECK(snd_ctl_ascii_cset_compile(&toggle, ctl,
+					      "name=Mode") == -EINVAL);
+
+	snd_ctl_ext_delete(&ext);
+}
+
+int main(void)
+{
+	test_cset();
+	return TEST_EXIT_CODE();
+}
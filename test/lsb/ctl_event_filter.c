@@ -0,0 +1,124 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "test.h"
+#include <alsa/control_external.h>
+
+/*
+ * A control_ext instance with a fixed queue of element events.
+ */
+struct stub_event {
+	snd_ctl_elem_iface_t iface;
+	unsigned int numid;
+	unsigned int mask;
+};
+
+static const struct stub_event events[] = {
+	{ SND_CTL_ELEM_IFACE_MIXER, 1, SND_CTL_EVENT_MASK_VALUE },
+	{ SND_CTL_ELEM_IFACE_PCM, 2, SND_CTL_EVENT_MASK_VALUE },
+	{ SND_CTL_ELEM_IFACE_PCM, 3, SND_CTL_EVENT_MASK_INFO },
+	{ SND_CTL_ELEM_IFACE_PCM, 9, SND_CTL_EVENT_MASK_VALUE },
+	{ SND_CTL_ELEM_IFACE_MIXER, 2, SND_CTL_EVENT_MASK_VALUE },
+	{ SND_CTL_ELEM_IFACE_PCM, 4, SND_CTL_EVENT_MASK_REMOVE },
+	/* outside the interfaces and numid range of the filter */
+	{ SND_CTL_ELEM_IFACE_MIXER, 12, SND_CTL_EVENT_MASK_REMOVE },
+	{ SND_CTL_ELEM_IFACE_MIXER, 12, SND_CTL_EVENT_MASK_INFO },
+};
+static unsigned int event_pos;
+
+static int stub_elem_count(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static int stub_elem_list(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			  unsigned int offset ATTRIBUTE_UNUSED,
+			  snd_ctl_elem_id_t *id ATTRIBUTE_UNUSED)
+{
+	return -EINVAL;
+}
+
+static snd_ctl_ext_key_t stub_find_elem(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+					const snd_ctl_elem_id_t *id ATTRIBUTE_UNUSED)
+{
+	return SND_CTL_EXT_KEY_NOT_FOUND;
+}
+
+static int stub_read_event(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			   snd_ctl_elem_id_t *id, unsigned int *event_mask)
+{
+	const struct stub_event *ev;
+
+	if (event_pos >= sizeof(events) / sizeof(events[0]))
+		return -EAGAIN;
+	ev = &events[event_pos++];
+	snd_ctl_elem_id_set_interface(id, ev->iface);
+	snd_ctl_elem_id_set_numid(id, ev->numid);
+	*event_mask = ev->mask;
+	return 1;
+}
+
+static const snd_ctl_ext_callback_t stub_callback = {
+	.elem_count = stub_elem_count,
+	.elem_list = stub_elem_list,
+	.find_elem = stub_find_elem,
+	.read_event = stub_read_event,
+};
+
+static void test_filter_read(void)
+{
+	snd_ctl_ext_t ext;
+	snd_ctl_event_filter_t *filter;
+	snd_ctl_event_t *event;
+
+	memset(&ext, 0, sizeof(ext));
+	ext.version = SND_CTL_EXT_VERSION;
+	strcpy(ext.id, "Stub");
+	strcpy(ext.name, "Stub Card");
+	ext.poll_fd = -1;
+	ext.callback = &stub_callback;
+	if (ALSA_CHECK(snd_ctl_ext_create(&ext, "stub", SND_CTL_NONBLOCK)) < 0)
+		return;
+
+	snd_ctl_event_filter_alloca(&filter);
+	snd_ctl_event_alloca(&event);
+	snd_ctl_event_filter_clear(filter);
+	snd_ctl_event_filter_add_interface(filter, SND_CTL_ELEM_IFACE_PCM);
+	snd_ctl_event_filter_set_numid_range(filter, 1, 8);
+	snd_ctl_event_filter_set_mask(filter, SND_CTL_EVENT_MASK_VALUE);
+	ALSA_CHECK(snd_ctl_set_event_filter(ext.handle, filter));
+
+	TEST_CHECK(snd_ctl_read(ext.handle, event) == 1);
+	TEST_CHECK(snd_ctl_event_elem_get_numid(event) == 2);
+	TEST_CHECK(snd_ctl_read(ext.handle, event) == 1);
+	TEST_CHECK(snd_ctl_event_elem_get_numid(event) == 4);
+	TEST_CHECK(snd_ctl_event_elem_get_mask(event) == SND_CTL_EVENT_MASK_REMOVE);
+	TEST_CHECK(snd_ctl_read(ext.handle, event) == 1);
+	TEST_CHECK(snd_ctl_event_elem_get_numid(event) == 12);
+	TEST_CHECK(snd_ctl_event_elem_get_mask(event) == SND_CTL_EVENT_MASK_REMOVE);
+	TEST_CHECK(snd_ctl_event_filter_match(filter, event));
+	TEST_CHECK(snd_ctl_read(ext.handle, event) == -EAGAIN);
+
+	/* all events pass again without the filter */
+	event_pos = 0;
+	ALSA_CHECK(snd_ctl_set_event_filter(ext.handle, NULL));
+	TEST_CHECK(snd_ctl_read(ext.handle, event) == 1);
+	TEST_CHECK(snd_ctl_event_elem_get_numid(event) == 1);
+	TEST_CHECK(!snd_ctl_event_filter_match(filter, event));
+	snd_ctl_event_filter_add_interface(filter, SND_CTL_ELEM_IFACE_MIXER);
+	TEST_CHECK(snd_ctl_event_filter_match(filter, event));
+	snd_ctl_event_filter_set_numid_range(filter, 2, 8);
+	TEST_CHECK(!snd_ctl_event_filter_match(filter, event));
+	snd_ctl_event_filter_set_numid_range(filter, 1, 1);
+	TEST_CHECK(snd_ctl_event_filter_match(filter, event));
+	snd_ctl_event_filter_set_mask(filter, SND_CTL_EVENT_MASK_INFO);
+	TEST_CHECK(!snd_ctl_event_filter_match(filter, event));
+
+	snd_ctl_ext_delete(&ext);
+}
+
+int main(void)
+{
+	test_filter_read();
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,229 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "test.h"
+#include <alsa/control_external.h>
+
+/*
+ * A control_ext instance stands in for a sound card: a stereo volume with
+ * a dB TLV and an enumerated control.
+ */
+#define VOLUME_KEY	0
+#define MODE_KEY	1
+
+static long volume[2] = { 10, 20 };
+static unsigned int mode = 1;
+static const char *const mode_names[] = { "Off", "Low", "High" };
+static const unsigned int volume_tlv[] = {
+	SND_CTL_TLVT_DB_SCALE, 2 * sizeof(int), (unsigned int)-5000, 50
+};
+
+static int stub_elem_count(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED)
+{
+	return 2;
+}
+
+static int stub_elem_list(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			  unsigned int offset, snd_ctl_elem_id_t *id)
+{
+	snd_ctl_elem_id_set_interface(id, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_id_set_name(id, offset == VOLUME_KEY ?
+				 "Master Playback Volume" : "Mode");
+	return 0;
+}
+
+static snd_ctl_ext_key_t stub_find_elem(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+					const snd_ctl_elem_id_t *id)
+{
+	const char *name = snd_ctl_elem_id_get_name(id);
+
+	if (!strcmp(name, "Master Playback Volume"))
+		return VOLUME_KEY;
+	if (!strcmp(name, "Mode"))
+		return MODE_KEY;
+	return SND_CTL_EXT_KEY_NOT_FOUND;
+}
+
+static int stub_get_attribute(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			      snd_ctl_ext_key_t key, int *type,
+			      unsigned int *acc, unsigned int *count)
+{
+	if (key == VOLUME_KEY) {
+		*type = SND_CTL_ELEM_TYPE_INTEGER;
+		*acc = SND_CTL_EXT_ACCESS_READWRITE | SND_CTL_EXT_ACCESS_TLV_READ;
+		*count = 2;
+	} else {
+		*type = SND_CTL_ELEM_TYPE_ENUMERATED;
+		*acc = SND_CTL_EXT_ACCESS_READWRITE;
+		*count = 1;
+	}
+	return 0;
+}
+
+static int stub_get_integer_info(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+				 snd_ctl_ext_key_t key ATTRIBUTE_UNUSED,
+				 long *imin, long *imax, long *istep)
+{
+	*imin = 0;
+	*imax = 100;
+	*istep = 1;
+	return 0;
+}
+
+static int stub_get_enumerated_info(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+				    snd_ctl_ext_key_t key ATTRIBUTE_UNUSED,
+				    unsigned int *items)
+{
+	*items = 3;
+	return 0;
+}
+
+static int stub_get_enumerated_name(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+				    snd_ctl_ext_key_t key ATTRIBUTE_UNUSED,
+				    unsigned int item, char *name,
+				    size_t name_max_len)
+{
+	if (item >= 3)
+		return -EINVAL;
+	snprintf(name, name_max_len, "%s", mode_names[item]);
+	return 0;
+}
+
+static int stub_read_integer(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			     snd_ctl_ext_key_t key ATTRIBUTE_UNUSED,
+			     long *value)
+{
+	value[0] = volume[0];
+	value[1] = volume[1];
+	return 0;
+}
+
+static int stub_read_enumerated(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+				snd_ctl_ext_key_t key ATTRIBUTE_UNUSED,
+				unsigned int *items)
+{
+	*items = mode;
+	return 0;
+}
+
+static const snd_ctl_ext_callback_t stub_callback = {
+	.elem_count = stub_elem_count,
+	.elem_list = stub_elem_list,
+	.find_elem = stub_find_elem,
+	.get_attribute = stub_get_attribute,
+	.get_integer_info = stub_get_integer_info,
+	.get_enumerated_info = stub_get_enumerated_info,
+	.get_enumerated_name = stub_get_enumerated_name,
+	.read_integer = stub_read_integer,
+	.read_enumerated = stub_read_enumerated,
+};
+
+static int open_mirror(snd_ctl_t **ctl, const char *file)
+{
+	snd_config_t *top;
+	char buf[256];
+	int err;
+
+	snprintf(buf, sizeof(buf),
+		 "ctl.mirrortest { type mirror file \"%s\" }", file);
+	err = load_config(&top, buf);
+	if (err < 0)
+		return err;
+	err = ALSA_CHECK(snd_ctl_open_lconf(ctl, "mirrortest", 0, top));
+	snd_config_delete(top);
+	return err;
+}
+
+static void test_mirror(void)
+{
+	snd_ctl_ext_t ext;
+	snd_ctl_mirror_t *mirror;
+	snd_ctl_t *ctl;
+	snd_ctl_elem_list_t *list;
+	snd_ctl_elem_id_t *id;
+	snd_ctl_elem_info_t *info;
+	snd_ctl_elem_value_t *value;
+	snd_ctl_event_t *event;
+	unsigned int tlv[16];
+	char file[] = "/tmp/alsa-ctl-mirror-XXXXXX";
+	int fd;
+
+	fd = mkstemp(file);
+	if (fd < 0)
+		return;
+	close(fd);
+
+	memset(&ext, 0, sizeof(ext));
+	ext.version = SND_CTL_EXT_VERSION;
+	strcpy(ext.id, "Stub");
+	strcpy(ext.name, "Stub Card");
+	ext.poll_fd = -1;
+	ext.callback = &stub_callback;
+	ext.tlv.p = volume_tlv;
+	if (ALSA_CHECK(snd_ctl_ext_create(&ext, "stub", 0)) < 0)
+		goto out;
+	if (ALSA_CHECK(snd_ctl_mirror_publish(&mirror, ext.handle, file)) < 0)
+		goto out_ext;
+	if (open_mirror(&ctl, file) < 0)
+		goto out_mirror;
+	TEST_CHECK(snd_ctl_type(ctl) == SND_CTL_TYPE_MIRROR);
+
+	snd_ctl_elem_list_alloca(&list);
+	ALSA_CHECK(snd_ctl_elem_list(ctl, list));
+	TEST_CHECK(snd_ctl_elem_list_get_count(list) == 2);
+
+	snd_ctl_elem_info_alloca(&info);
+	snd_ctl_elem_info_set_interface(info, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_info_set_name(info, "Mode");
+	snd_ctl_elem_info_set_item(info, 2);
+	ALSA_CHECK(snd_ctl_elem_info(ctl, info));
+	TEST_CHECK(snd_ctl_elem_info_get_items(info) == 3);
+	TEST_CHECK(!strcmp(snd_ctl_elem_info_get_item_name(info), "High"));
+
+	snd_ctl_elem_value_alloca(&value);
+	snd_ctl_elem_value_set_interface(value, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_value_set_name(value, "Master Playback Volume");
+	ALSA_CHECK(snd_ctl_elem_read(ctl, value));
+	TEST_CHECK(snd_ctl_elem_value_get_integer(value, 0) == 10);
+	TEST_CHECK(snd_ctl_elem_value_get_integer(value, 1) == 20);
+	TEST_CHECK(snd_ctl_elem_write(ctl, value) == -EPERM);
+
+	snd_ctl_elem_info_clear(info);
+	snd_ctl_elem_info_set_interface(info, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_info_set_name(info, "Master Playback Volume");
+	ALSA_CHECK(snd_ctl_elem_info(ctl, info));
+	TEST_CHECK(snd_ctl_elem_info_get_max(info) == 100);
+	snd_ctl_elem_id_alloca(&id);
+	snd_ctl_elem_info_get_id(info, id);
+	ALSA_CHECK(snd_ctl_elem_tlv_read(ctl, id, tlv, sizeof(tlv)));
+	TEST_CHECK(!memcmp(tlv, volume_tlv, sizeof(volume_tlv)));
+
+	snd_ctl_event_alloca(&event);
+	ALSA_CHECK(snd_ctl_subscribe_events(ctl, 1));
+	TEST_CHECK(snd_ctl_read(ctl, event) == -EAGAIN);
+
+	volume[1] = 55;
+	TEST_CHECK(snd_ctl_mirror_update(mirror) == 1);
+	TEST_CHECK(snd_ctl_read(ctl, event) == 1);
+	TEST_CHECK(snd_ctl_event_elem_get_mask(event) == SND_CTL_EVENT_MASK_VALUE);
+	TEST_CHECK(!strcmp(snd_ctl_event_elem_get_name(event),
+			   "Master Playback Volume"));
+	TEST_CHECK(snd_ctl_read(ctl, event) == -EAGAIN);
+	ALSA_CHECK(snd_ctl_elem_read(ctl, value));
+	TEST_CHECK(snd_ctl_elem_value_get_integer(value, 1) == 55);
+
+	snd_ctl_close(ctl);
+ out_mirror:
+	snd_ctl_mirror_free(mirror);
+ out_ext:
+	snd_ctl_ext_delete(&ext);
+ out:
+	unlink(file);
+}
+
+int main(void)
+{
+	test_mirror();
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,251 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "test.h"
+#include <alsa/control_external.h>
+
+/*
+ * A control_ext instance with a volume with dB range, an enumerated
+ * and a boolean element.  The element info callbacks are counted.
+ */
+#define ELEMS	3
+#define ITEMS	3
+
+static const char *const elem_names[ELEMS] = {
+	"Master Playback Volume",
+	"Mode",
+	"Master Playback Switch",
+};
+static const char *item_names[ITEMS] = { "Off", "Low", "High" };
+static const unsigned int db_scale[] = { SND_CTL_TLVT_DB_SCALE, 8, -6000, 100 };
+static unsigned int info_calls;
+static int pending_info = -1;		/* numid of a queued INFO event */
+
+static int stub_elem_count(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED)
+{
+	return ELEMS;
+}
+
+static int stub_elem_list(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			  unsigned int offset, snd_ctl_elem_id_t *id)
+{
+	snd_ctl_elem_id_set_interface(id, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_id_set_name(id, elem_names[offset]);
+	return 0;
+}
+
+static snd_ctl_ext_key_t stub_find_elem(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+					const snd_ctl_elem_id_t *id)
+{
+	unsigned int i;
+
+	for (i = 0; i < ELEMS; i++)
+		if (!strcmp(snd_ctl_elem_id_get_name(id), elem_names[i]))
+			return i;
+	return SND_CTL_EXT_KEY_NOT_FOUND;
+}
+
+static int stub_get_attribute(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			      snd_ctl_ext_key_t key, int *type,
+			      unsigned int *acc, unsigned int *count)
+{
+	info_calls++;
+	*count = 1;
+	*acc = SND_CTL_EXT_ACCESS_READWRITE;
+	switch (key) {
+	case 0:
+		*type = SND_CTL_ELEM_TYPE_INTEGER;
+		*acc |= SND_CTL_EXT_ACCESS_TLV_READ;
+		*count = 2;
+		break;
+	case 1:
+		*type = SND_CTL_ELEM_TYPE_ENUMERATED;
+		break;
+	default:
+		*type = SND_CTL_ELEM_TYPE_BOOLEAN;
+		break;
+	}
+	return 0;
+}
+
+static int stub_get_integer_info(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+				 snd_ctl_ext_key_t key ATTRIBUTE_UNUSED,
+				 long *imin, long *imax, long *istep)
+{
+	*imin = 0;
+	*imax = 60;
+	*istep = 1;
+	return 0;
+}
+
+static int stub_get_enumerated_info(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+				    snd_ctl_ext_key_t key ATTRIBUTE_UNUSED,
+				    unsigned int *items)
+{
+	*items = ITEMS;
+	return 0;
+}
+
+static int stub_get_enumerated_name(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+				    snd_ctl_ext_key_t key ATTRIBUTE_UNUSED,
+				    unsigned int item, char *name, size_t name_max_len)
+{
+	if (item >= ITEMS)
+		return -EINVAL;
+	snprintf(name, name_max_len, "%s", item_names[item]);
+	return 0;
+}
+
+static int stub_read_event(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			   snd_ctl_elem_id_t *id, unsigned int *event_mask)
+{
+	if (pending_info < 0)
+		return -EAGAIN;
+	snd_ctl_elem_id_set_interface(id, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_id_set_name(id, elem_names[pending_info - 1]);
+	snd_ctl_elem_id_set_numid(id, pending_info);
+	*event_mask = SND_CTL_EVENT_MASK_INFO;
+	pending_info = -1;
+	return 1;
+}
+
+static const snd_ctl_ext_callback_t stub_callback = {
+	.elem_count = stub_elem_count,
+	.elem_list = stub_elem_list,
+	.find_elem = stub_find_elem,
+	.get_attribute = stub_get_attribute,
+	.get_integer_info = stub_get_integer_info,
+	.get_enumerated_info = stub_get_enumerated_info,
+	.get_enumerated_name = stub_get_enumerated_name,
+	.read_event = stub_read_event,
+};
+
+/* everything snd_hctl_elem_info() and snd_hctl_elem_tlv_read() return */
+struct elem_data {
+	snd_ctl_elem_type_t type;
+	unsigned int count;
+	unsigned int access;
+	long min, max;
+	char items[ITEMS][64];
+	int tlv_err;
+	unsigned int tlv[8];
+};
+
+static void query(snd_hctl_t *hctl, struct elem_data *data)
+{
+	snd_hctl_elem_t *elem;
+	snd_ctl_elem_info_t *info;
+	unsigned int i, item;
+
+	snd_ctl_elem_info_alloca(&info);
+	memset(data, 0, ELEMS * sizeof(*data));
+	for (elem = snd_hctl_first_elem(hctl); elem; elem = snd_hctl_elem_next(elem)) {
+		for (i = 0; i < ELEMS; i++)
+			if (!strcmp(snd_hctl_elem_get_name(elem), elem_names[i]))
+				break;
+		if (i == ELEMS)
+			continue;
+		ALSA_CHECK(snd_hctl_elem_info(elem, info));
+		data[i].type = snd_ctl_elem_info_get_type(info);
+		data[i].count = snd_ctl_elem_info_get_count(info);
+		data[i].access = snd_ctl_elem_info_is_readable(info) |
+				 snd_ctl_elem_info_is_writable(info) << 1 |
+				 snd_ctl_elem_info_is_tlv_readable(info) << 2;
+		if (data[i].type == SND_CTL_ELEM_TYPE_INTEGER) {
+			data[i].min = snd_ctl_elem_info_get_min(info);
+			data[i].max = snd_ctl_elem_info_get_max(info);
+		}
+		if (data[i].type == SND_CTL_ELEM_TYPE_ENUMERATED) {
+			for (item = 0; item < ITEMS; item++) {
+				snd_ctl_elem_info_set_item(info, item);
+				ALSA_CHECK(snd_hctl_elem_info(elem, info));
+				strcpy(data[i].items[item],
+				       snd_ctl_elem_info_get_item_name(info));
+			}
+		}
+		if (data[i].access & 4)
+			data[i].tlv_err = snd_hctl_elem_tlv_read(elem, data[i].tlv,
+								 sizeof(data[i].tlv));
+		else
+			data[i].tlv_err = -ENXIO;
+	}
+}
+
+static int open_hctl(snd_ctl_ext_t *ext, snd_hctl_t **hctl, int prefetch)
+{
+	memset(ext, 0, sizeof(*ext));
+	ext->version = SND_CTL_EXT_VERSION;
+	strcpy(ext->id, "Stub");
+	strcpy(ext->name, "Stub Card");
+	ext->poll_fd = -1;
+	ext->callback = &stub_callback;
+	ext->tlv.p = db_scale;
+	if (ALSA_CHECK(snd_ctl_ext_create(ext, "stub", SND_CTL_NONBLOCK)) < 0)
+		return -1;
+	if (ALSA_CHECK(snd_hctl_open_ctl(hctl, ext->handle)) < 0) {
+		snd_ctl_ext_delete(ext);
+		return -1;
+	}
+	ALSA_CHECK(snd_hctl_set_prefetch(*hctl, prefetch));
+	if (ALSA_CHECK(snd_hctl_load(*hctl)) < 0) {
+		snd_hctl_close(*hctl);
+		return -1;
+	}
+	return 0;
+}
+
+/* prefetched and queried data must be the same */
+static void test_prefetch(void)
+{
+	struct elem_data plain[ELEMS], cached[ELEMS];
+	snd_ctl_event_filter_t *filter;
+	snd_ctl_ext_t ext;
+	snd_hctl_t *hctl;
+	unsigned int calls;
+
+	if (open_hctl(&ext, &hctl, 0) < 0)
+		return;
+	calls = info_calls;
+	query(hctl, plain);
+	TEST_CHECK(info_calls > calls);
+	snd_hctl_close(hctl);
+
+	if (open_hctl(&ext, &hctl, 1) < 0)
+		return;
+	calls = info_calls;
+	query(hctl, cached);
+	/* all served from the prefetched data */
+	TEST_CHECK(info_calls == calls);
+	TEST_CHECK(!memcmp(plain, cached, sizeof(plain)));
+	TEST_CHECK(cached[0].tlv_err == 0);
+	TEST_CHECK(cached[0].tlv[0] == SND_CTL_TLVT_DB_SCALE);
+	TEST_CHECK(cached[2].tlv_err < 0);
+	TEST_CHECK(!strcmp(cached[1].items[2], "High"));
+
+	/* an INFO event drops the prefetched data of the element */
+	item_names[2] = "Max";
+	pending_info = 2;
+	TEST_CHECK(snd_hctl_handle_events(hctl) == 1);
+	calls = info_calls;
+	query(hctl, cached);
+	TEST_CHECK(info_calls > calls);
+	TEST_CHECK(!strcmp(cached[1].items[2], "Max"));
+	item_names[2] = "High";
+
+	/* INFO events filtered out, the prefetched data is not trusted */
+	snd_ctl_event_filter_alloca(&filter);
+	snd_ctl_event_filter_clear(filter);
+	snd_ctl_event_filter_set_mask(filter, SND_CTL_EVENT_MASK_VALUE);
+	ALSA_CHECK(snd_ctl_set_event_filter(snd_hctl_ctl(hctl), filter));
+	calls = info_calls;
+	query(hctl, cached);
+	TEST_CHECK(info_calls > calls);
+	TEST_CHECK(!memcmp(plain, cached, sizeof(plain)));
+	snd_hctl_close(hctl);
+}
+
+int main(void)
+{
+	test_prefetch();
+	return TEST_EXIT_CODE();
+}
@@ -359,6 +359,135 @@ static void test_encode_byte(void)
 	snd_midi_event_free(midi_event);
 }
 
+/*
+ * Differential test: snd_midi_event_encode() must produce the same events at
+ * the same stream positions as snd_midi_event_encode_byte() fed byte by byte.
+ */
+struct encoded {
+	long offset;
+	snd_seq_event_t ev;
+	unsigned char sysex[256];
+};
+
+static unsigned int fuzz_seed = 12345;
+
+static unsigned int fuzz_rand(void)
+{
+	fuzz_seed = fuzz_seed * 1103515245 + 12345;
+	return fuzz_seed >> 16;
+}
+
+static long fuzz_stream(unsigned char *buf, long size)
+{
+	long n = 0, run;
+	unsigned int r;
+
+	while (n < size) {
+		r = fuzz_rand() % 100;
+		if (r < 40) {
+			run = 1 + fuzz_rand() % 40;
+			while (run-- > 0 && n < size)
+				buf[n++] = fuzz_rand() & 0x7f;
+		} else if (r < 55) {
+			buf[n++] = 0x80 + fuzz_rand() % 0x70;
+		} else if (r < 65) {
+			buf[n++] = 0xf0;
+		} else if (r < 75) {
+			buf[n++] = 0xf7;
+		} else if (r < 80) {
+			buf[n++] = 0xf8 + fuzz_rand() % 8;
+		} else if (r < 85) {
+			buf[n++] = 0xf1 + fuzz_rand() % 6;
+		} else {
+			buf[n++] = fuzz_rand() & 0xff;
+		}
+	}
+	return n;
+}
+
+static void record_event(struct encoded *e, long offset, const snd_seq_event_t *ev)
+{
+	e->offset = offset;
+	e->ev = *ev;
+	if (ev->type == SND_SEQ_EVENT_SYSEX) {
+		memcpy(e->sysex, ev->data.ext.ptr, ev->data.ext.len);
+		e->ev.data.ext.ptr = NULL;
+	}
+}
+
+static void test_encode_fuzz(void)
+{
+	static const size_t bufsizes[] = { 3, 4, 5, 16, 256 };
+	enum { STREAM = 4096, ROUNDS = 50 };
+	unsigned char *stream;
+	struct encoded *ref, *out;
+	snd_midi_event_t *byte_dev, *dev;
+	snd_seq_event_t ev;
+	long len, pos, chunk, r, nref, nout, i;
+	unsigned int b, round;
+
+	stream = malloc(STREAM);
+	ref = calloc(STREAM, sizeof(*ref));
+	out = calloc(STREAM, sizeof(*out));
+	if (!stream || !ref || !out)
+		goto out_free;
+	for (b = 0; b < sizeof(bufsizes) / sizeof(bufsizes[0]); b++) {
+		if (ALSA_CHECK(snd_midi_event_new(bufsizes[b], &byte_dev)) < 0)
+			break;
+		if (ALSA_CHECK(snd_midi_event_new(bufsizes[b], &dev)) < 0) {
+			snd_midi_event_free(byte_dev);
+			break;
+		}
+		for (round = 0; round < ROUNDS; round++) {
+			len = fuzz_stream(stream, STREAM);
+
+			nref = 0;
+			for (pos = 0; pos < len; pos++) {
+				snd_seq_ev_clear(&ev);
+				if (snd_midi_event_encode_byte(byte_dev, stream[pos], &ev) > 0)
+					record_event(&ref[nref++], pos + 1, &ev);
+			}
+
+			nout = 0;
+			for (pos = 0; pos < len; ) {
+				chunk = 1 + fuzz_rand() % 64;
+				if (chunk > len - pos)
+					chunk = len - pos;
+				while (chunk > 0) {
+					snd_seq_ev_clear(&ev);
+					r = snd_midi_event_encode(dev, stream + pos, chunk, &ev);
+					if (r <= 0)
+						break;
+					pos += r;
+					chunk -= r;
+					if (ev.type != SND_SEQ_EVENT_NONE)
+						record_event(&out[nout++], pos, &ev);
+				}
+				if (r <= 0)
+					break;
+			}
+
+			TEST_CHECK(pos == len);
+			TEST_CHECK(nout == nref);
+			for (i = 0; i < nout && i < nref; i++) {
+				if (out[i].offset != ref[i].offset ||
+				    memcmp(&out[i].ev, &ref[i].ev, sizeof(ev)) ||
+				    (ref[i].ev.type == SND_SEQ_EVENT_SYSEX &&
+				     memcmp(out[i].sysex, ref[i].sysex, ref[i].ev.data.ext.len))) {
+					TEST_CHECK(!"encoded events differ");
+					break;
+				}
+			}
+		}
+		snd_midi_event_free(dev);
+		snd_midi_event_free(byte_dev);
+	}
+ out_free:
+	free(out);
+	free(ref);
+	free(stream);
+}
+
 int main(void)
 {
 	test_decode();
@@ -366,6 +495,7 @@ int main(void)
 	test_encode();
 	test_reset_encode();
 	test_encode_byte();
+	test_encode_fuzz();
 	test_init();
 	return TEST_EXIT_CODE();
 }
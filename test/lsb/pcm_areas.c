@@ -0,0 +1,107 @@
+/*
+ * PCM area copy tests
+ *
+ * Compares snd_pcm_areas_copy() between interleaved and non-interleaved
+ * buffers with a copy of every single channel by snd_pcm_area_copy().
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+
+#define FRAMES	300
+#define OFFSET	7
+
+static void setup(snd_pcm_channel_area_t *areas, char *buf, unsigned int chns,
+		  int width, int interleaved)
+{
+	unsigned int c;
+
+	for (c = 0; c < chns; c++) {
+		areas[c].addr = buf;
+		if (interleaved) {
+			areas[c].first = c * width;
+			areas[c].step = chns * width;
+		} else {
+			areas[c].first = c * FRAMES * width;
+			areas[c].step = width;
+		}
+	}
+}
+
+static void test_copy(snd_pcm_format_t format, unsigned int chns, int interleave)
+{
+	int width = snd_pcm_format_physical_width(format);
+	size_t bytes = chns * FRAMES * width / 8;
+	snd_pcm_channel_area_t src[9], dst[9];
+	char *sbuf, *dbuf, *rbuf;
+	unsigned int c;
+	size_t i;
+
+	sbuf = malloc(bytes);
+	dbuf = malloc(bytes);
+	rbuf = malloc(bytes);
+	if (!sbuf || !dbuf || !rbuf)
+		goto out;
+	for (i = 0; i < bytes; i++)
+		sbuf[i] = i * 7 + i / 13;
+	memset(dbuf, 0x55, bytes);
+	memset(rbuf, 0x55, bytes);
+	setup(src, sbuf, chns, width, !interleave);
+	setup(dst, rbuf, chns, width, interleave);
+	for (c = 0; c < chns; c++)
+		snd_pcm_area_copy(&dst[c], OFFSET, &src[c], 3,
+				  FRAMES - OFFSET, format);
+	setup(dst, dbuf, chns, width, interleave);
+	ALSA_CHECK(snd_pcm_areas_copy(dst, OFFSET, src, 3, chns,
+				      FRAMES - OFFSET, format));
+	TEST_CHECK(memcmp(dbuf, rbuf, bytes) == 0);
+	if (memcmp(dbuf, rbuf, bytes))
+		fprintf(stderr, "format %s, %u channels, %s\n",
+			snd_pcm_format_name(format), chns,
+			interleave ? "interleave" : "deinterleave");
+out:
+	free(sbuf);
+	free(dbuf);
+	free(rbuf);
+}
+
+/* a missing source channel is silenced, a missing destination skipped */
+static void test_missing(void)
+{
+	short sbuf[4 * FRAMES], dbuf[4 * FRAMES];
+	snd_pcm_channel_area_t src[4], dst[4];
+	int i;
+
+	for (i = 0; i < 4 * FRAMES; i++)
+		sbuf[i] = i + 1;
+	memset(dbuf, 0x55, sizeof(dbuf));
+	setup(src, (char *)sbuf, 4, 16, 0);
+	setup(dst, (char *)dbuf, 4, 16, 1);
+	src[1].addr = NULL;
+	ALSA_CHECK(snd_pcm_areas_copy(dst, 0, src, 0, 4, FRAMES,
+				      SND_PCM_FORMAT_S16_LE));
+	for (i = 0; i < FRAMES; i++) {
+		TEST_CHECK(dbuf[4 * i] == sbuf[i]);
+		TEST_CHECK(dbuf[4 * i + 1] == 0);
+		TEST_CHECK(dbuf[4 * i + 3] == sbuf[3 * FRAMES + i]);
+	}
+}
+
+int main(void)
+{
+	static const snd_pcm_format_t formats[] = {
+		SND_PCM_FORMAT_S8, SND_PCM_FORMAT_S16_LE,
+		SND_PCM_FORMAT_S24_3LE, SND_PCM_FORMAT_S32_LE,
+		SND_PCM_FORMAT_FLOAT64_LE,
+	};
+	unsigned int f, chns;
+
+	for (f = 0; f < sizeof(formats) / sizeof(formats[0]); f++)
+		for (chns = 1; chns <= 9; chns++) {
+			test_copy(formats[f], chns, 1);
+			test_copy(formats[f], chns, 0);
+		}
+	test_missing();
+	return TEST_EXIT_CODE();
+}
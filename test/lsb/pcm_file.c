@@ -0,0 +1,526 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "test.h"
+
+#define FILENAME	"pcm_file_test.wav"
+#define INFILE		"pcm_file_in.wav"
+#define CHANNELS	2
+#define RATE		48000
+#define PERIOD		1024
+#define PERIODS		40
+#define HEADER		44
+
+static int open_file(snd_pcm_t **pcm, snd_pcm_stream_t stream, const char *name,
+		     const char *format, const char *opts)
+{
+	char conf[256];
+	snd_config_t *top;
+	int err;
+
+	snprintf(conf, sizeof(conf),
+		 "pcm.filetest { type file slave.pcm { type null } file \"%s\" format %s %s }",
+		 name, format, opts);
+	err = load_config(&top, conf);
+	if (err < 0)
+		return err;
+	err = ALSA_CHECK(snd_pcm_open_lconf(pcm, "filetest", stream, 0, top));
+	snd_config_delete(top);
+	return err;
+}
+
+static unsigned int le32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+/* play a counting pattern and check the WAV file written */
+static void test_write(const char *opts)
+{
+	snd_pcm_t *pcm;
+	short buf[PERIOD * CHANNELS];
+	unsigned char *data;
+	size_t len = HEADER + PERIOD * PERIODS * CHANNELS * 2;
+	FILE *f;
+	int i, j;
+
+	unlink(FILENAME);
+	if (open_file(&pcm, SND_PCM_STREAM_PLAYBACK, FILENAME, "wav", opts) < 0)
+		return;
+	if (ALSA_CHECK(snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16_LE,
+					  SND_PCM_ACCESS_RW_INTERLEAVED,
+					  CHANNELS, RATE, 0, 100000)) < 0) {
+		snd_pcm_close(pcm);
+		return;
+	}
+	for (i = 0; i < PERIODS; i++) {
+		for (j = 0; j < PERIOD * CHANNELS; j++)
+			buf[j] = i * PERIOD * CHANNELS + j;
+		TEST_CHECK(snd_pcm_writei(pcm, buf, PERIOD) == PERIOD);
+	}
+	ALSA_CHECK(snd_pcm_close(pcm));
+
+	data = malloc(len + 1);
+	f = fopen(FILENAME, "rb");
+	TEST_CHECK(f != NULL);
+	if (f && data) {
+		TEST_CHECK(fread(data, 1, len + 1, f) == len);
+		TEST_CHECK(!memcmp(data, "RIFF", 4) && !memcmp(data + 8, "WAVE", 4));
+		TEST_CHECK(le32(data + 4) == len - 8);
+		TEST_CHECK(le32(data + 40) == len - HEADER);
+		for (j = 0; j < PERIOD * PERIODS * CHANNELS; j++) {
+			short v = data[HEADER + 2 * j] | (data[HEADER + 2 * j + 1] << 8);
+			if (v != (short)j) {
+				TEST_CHECK(v == (short)j);
+				break;
+			}
+		}
+	}
+	if (f)
+		fclose(f);
+	free(data);
+	unlink(FILENAME);
+}
+
+static void put_le32(unsigned char *p, unsigned int v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+/* capture from a WAV input file with an extra chunk before the data */
+static void test_infile(void)
+{
+	enum { FRAMES = 3000, LIST = 10 };
+	unsigned char hdr[HEADER + 8 + LIST];
+	short data[FRAMES * CHANNELS], buf[PERIOD * CHANNELS];
+	snd_pcm_t *pcm;
+	FILE *f;
+	int i, j, sample;
+
+	memset(hdr, 0, sizeof(hdr));
+	memcpy(hdr, "RIFF", 4);
+	put_le32(hdr + 4, sizeof(hdr) - 8 + sizeof(data));
+	memcpy(hdr + 8, "WAVEfmt ", 8);
+	put_le32(hdr + 16, 16);
+	hdr[20] = 1;
+	hdr[22] = CHANNELS;
+	put_le32(hdr + 24, RATE);
+	put_le32(hdr + 28, RATE * CHANNELS * 2);
+	hdr[32] = CHANNELS * 2;
+	hdr[34] = 16;
+	memcpy(hdr + 36, "LIST", 4);
+	put_le32(hdr + 40, LIST);
+	memcpy(hdr + 44 + LIST, "data", 4);
+	put_le32(hdr + 48 + LIST, sizeof(data));
+	for (j = 0; j < FRAMES * CHANNELS; j++)
+		data[j] = j + 1;
+	f = fopen(INFILE, "wb");
+	TEST_CHECK(f != NULL);
+	if (!f)
+		return;
+	fwrite(hdr, 1, sizeof(hdr), f);
+	fwrite(data, 1, sizeof(data), f);
+	fclose(f);
+
+	if (open_file(&pcm, SND_PCM_STREAM_CAPTURE, FILENAME, "wav",
+		      "infile \"" INFILE "\"") < 0)
+		goto out;
+	if (ALSA_CHECK(snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16_LE,
+					  SND_PCM_ACCESS_RW_INTERLEAVED,
+					  CHANNELS, RATE, 0, 100000)) < 0)
+		goto out_close;
+	ALSA_CHECK(snd_pcm_start(pcm));
+	/* past the end of the file the captured data is kept */
+	for (i = 0, sample = 0; i < 4; i++) {
+		for (j = 0; j < PERIOD * CHANNELS; j++)
+			buf[j] = -1;
+		TEST_CHECK(snd_pcm_readi(pcm, buf, PERIOD) == PERIOD);
+		for (j = 0; j < PERIOD * CHANNELS; j++, sample++) {
+			short v = sample < FRAMES * CHANNELS ? sample + 1 : -1;
+			if (buf[j] != v) {
+				TEST_CHECK(buf[j] == v);
+				break;
+			}
+		}
+	}
+
+ out_close:
+	ALSA_CHECK(snd_pcm_close(pcm));
+ out:
+	unlink(INFILE);
+	unlink(FILENAME);
+}
+
+/* write frames counting from first + 1 to a raw input file */
+static void write_raw(const char *mode, int first, int frames)
+{
+	short data[PERIOD * CHANNELS];
+	FILE *f;
+	int i, j;
+
+	f = fopen(INFILE, mode);
+	TEST_CHECK(f != NULL);
+	if (!f)
+		return;
+	for (i = 0; i < frames; i += PERIOD) {
+		for (j = 0; j < PERIOD * CHANNELS; j++)
+			data[j] = first * CHANNELS + i * CHANNELS + j + 1;
+		fwrite(data, 2 * CHANNELS, frames - i < PERIOD ? frames - i : PERIOD, f);
+	}
+	fclose(f);
+}
+
+/* read a period and check the samples from first + 1, -1 past limit */
+static void read_raw(snd_pcm_t *pcm, int first, int limit)
+{
+	short buf[PERIOD * CHANNELS];
+	int j;
+
+	for (j = 0; j < PERIOD * CHANNELS; j++)
+		buf[j] = -1;
+	TEST_CHECK(snd_pcm_readi(pcm, buf, PERIOD) == PERIOD);
+	for (j = 0; j < PERIOD * CHANNELS; j++) {
+		short v = first + j / CHANNELS < limit ? first * CHANNELS + j + 1 : -1;
+		if (buf[j] != v) {
+			TEST_CHECK(buf[j] == v);
+			break;
+		}
+	}
+}
+
+/* an input file which grows or is truncated while it is read */
+static void test_infile_changes(void)
+{
+	snd_pcm_t *pcm;
+	int truncated;
+
+	for (truncated = 0; truncated < 2; truncated++) {
+		write_raw("wb", 0, 2 * PERIOD);
+		if (open_file(&pcm, SND_PCM_STREAM_CAPTURE, FILENAME, "raw",
+			      "infile \"" INFILE "\"") < 0)
+			break;
+		if (ALSA_CHECK(snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16_LE,
+						  SND_PCM_ACCESS_RW_INTERLEAVED,
+						  CHANNELS, RATE, 0, 100000)) < 0) {
+			snd_pcm_close(pcm);
+			break;
+		}
+		ALSA_CHECK(snd_pcm_start(pcm));
+		read_raw(pcm, 0, 2 * PERIOD);
+		if (truncated) {
+			/* the mapped page past the new end is gone */
+			TEST_CHECK(truncate(INFILE, PERIOD * CHANNELS * 2) == 0);
+			read_raw(pcm, PERIOD, PERIOD);
+		} else {
+			write_raw("ab", 2 * PERIOD, 2 * PERIOD);
+			read_raw(pcm, PERIOD, 4 * PERIOD);
+			read_raw(pcm, 2 * PERIOD, 4 * PERIOD);
+			read_raw(pcm, 3 * PERIOD, 4 * PERIOD);
+		}
+		read_raw(pcm, 4 * PERIOD, 0);
+		ALSA_CHECK(snd_pcm_close(pcm));
+	}
+	unlink(INFILE);
+	unlink(FILENAME);
+}
+
+static unsigned int crc(const unsigned char *p, size_t len, unsigned int width, unsigned int poly)
+{
+	unsigned int top = 1U << (width - 1), c = 0;
+	int i;
+
+	while (len--) {
+		c ^= *p++ << (width - 8);
+		for (i = 0; i < 8; i++)
+			c = c & top ? (c << 1) ^ poly : c << 1;
+	}
+	return c & ((1U << width) - 1);
+}
+
+typedef struct {
+	const unsigned char *p;
+	size_t len, pos;
+	unsigned int bit;
+} bits_t;
+
+static unsigned int get_bits(bits_t *b, int n)
+{
+	unsigned int v = 0;
+
+	while (n-- > 0) {
+		if (b->pos >= b->len)
+			return 0;
+		v = (v << 1) | ((b->p[b->pos] >> (7 - b->bit)) & 1);
+		if (++b->bit == 8) {
+			b->bit = 0;
+			b->pos++;
+		}
+	}
+	return v;
+}
+
+static int get_signed(bits_t *b, int n)
+{
+	unsigned int v = get_bits(b, n);
+
+	return v & (1U << (n - 1)) ? (int)(v - (1U << n)) : (int)v;
+}
+
+/* a test pattern with silent, noisy and smooth blocks */
+static short flac_sample(int frame, int ch)
+{
+	unsigned int h = frame * 2654435761U + ch * 40503U;
+
+	switch ((frame / 4096) % 4) {
+	case 1:
+		return 0;
+	case 2:
+		return h >> 16;
+	default:
+		return (frame * (ch + 1) * 37) % 4000 - 2000 + ((h >> 28) & 3);
+	}
+}
+
+/*
+ * Decode the subset of FLAC written by the plugin and compare it with
+ * the pattern from the given frame, return the number of frames.  The
+ * header of a streamed file has no frame sizes and no length.
+ */
+static int check_flac(const char *name, int first, int streamed)
+{
+	unsigned char *data;
+	int *x, frames = 0, bps, channels, ok = 1;
+	unsigned int min_frame, max_frame;
+	uint64_t total;
+	bits_t b;
+	FILE *f;
+	long len;
+
+	f = fopen(name, "rb");
+	TEST_CHECK(f != NULL);
+	if (!f)
+		return -1;
+	fseek(f, 0, SEEK_END);
+	len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	data = malloc(len);
+	x = malloc(65536 * sizeof(*x));
+	if (!data || !x || fread(data, 1, len, f) != (size_t)len) {
+		fclose(f);
+		free(data);
+		free(x);
+		return -1;
+	}
+	fclose(f);
+	b.p = data;
+	b.len = len;
+	b.pos = 0;
+	b.bit = 0;
+	TEST_CHECK(len > 42 && !memcmp(data, "fLaC", 4) && data[4] == 0x80);
+	b.pos = 12;
+	min_frame = get_bits(&b, 24);
+	max_frame = get_bits(&b, 24);
+	if (streamed)
+		TEST_CHECK(min_frame == 0 && max_frame == 0);
+	else
+		TEST_CHECK(min_frame > 0 && min_frame <= max_frame);
+	TEST_CHECK(get_bits(&b, 20) == RATE);
+	channels = get_bits(&b, 3) + 1;
+	bps = get_bits(&b, 5) + 1;
+	TEST_CHECK(channels == CHANNELS && bps == 16);
+	total = (uint64_t)get_bits(&b, 4) << 32 | get_bits(&b, 32);
+	b.pos = 42;
+	while (ok && b.pos < b.len) {
+		size_t start = b.pos;
+		int n, ch, i, order, k;
+
+		ok = get_bits(&b, 14) == 0x3ffe && get_bits(&b, 2) == 0 &&
+		     get_bits(&b, 4) == 7 && get_bits(&b, 4) == 0 &&
+		     get_bits(&b, 4) == (unsigned int)channels - 1 &&
+		     get_bits(&b, 4) == 0;
+		i = get_bits(&b, 8);
+		for (k = 0x80; i & k; k >>= 1)
+			get_bits(&b, k == 0x80 ? 0 : 8);
+		n = get_bits(&b, 16) + 1;
+		ok = ok && crc(data + start, b.pos - start, 8, 0x07) == get_bits(&b, 8);
+		for (ch = 0; ok && ch < channels; ch++) {
+			int type;
+
+			get_bits(&b, 1);
+			type = get_bits(&b, 6);
+			get_bits(&b, 1);
+			if (type == 0) {
+				x[0] = get_signed(&b, bps);
+				for (i = 1; i < n; i++)
+					x[i] = x[0];
+			} else if (type == 1) {
+				for (i = 0; i < n; i++)
+					x[i] = get_signed(&b, bps);
+			} else if (type >= 8 && type <= 12) {
+				order = type - 8;
+				for (i = 0; i < order; i++)
+					x[i] = get_signed(&b, bps);
+				ok = get_bits(&b, 6) == 0;
+				k = get_bits(&b, 4);
+				for (i = order; i < n; i++) {
+					unsigned int q = 0, u;
+					int r, p = 0;
+
+					while (b.pos < b.len && !get_bits(&b, 1))
+						q++;
+					u = (q << k) | get_bits(&b, k);
+					r = (u >> 1) ^ -(int)(u & 1);
+					switch (order) {
+					case 1: p = x[i - 1]; break;
+					case 2: p = 2 * x[i - 1] - x[i - 2]; break;
+					case 3: p = 3 * x[i - 1] - 3 * x[i - 2] + x[i - 3]; break;
+					case 4: p = 4 * x[i - 1] - 6 * x[i - 2] + 4 * x[i - 3] - x[i - 4]; break;
+					}
+					x[i] = r + p;
+				}
+			} else {
+				ok = 0;
+			}
+			for (i = 0; ok && i < n; i++)
+				ok = x[i] == flac_sample(first + frames + i, ch);
+		}
+		if (b.bit)
+			get_bits(&b, 8 - b.bit);
+		ok = ok && crc(data + start, b.pos - start, 16, 0x8005) == get_bits(&b, 16);
+		frames += n;
+	}
+	TEST_CHECK(ok);
+	TEST_CHECK(total == (streamed ? 0 : (uint64_t)frames));
+	free(data);
+	free(x);
+	return frames;
+}
+
+static void play_pattern(snd_pcm_t *pcm, int frames)
+{
+	short buf[PERIOD * CHANNELS];
+	int i, n, ch;
+
+	for (i = 0; i < frames; i += n) {
+		n = frames - i < PERIOD ? frames - i : PERIOD;
+		for (ch = 0; ch < CHANNELS * n; ch++)
+			buf[ch] = flac_sample(i + ch / CHANNELS, ch % CHANNELS);
+		TEST_CHECK(snd_pcm_writei(pcm, buf, n) == n);
+	}
+}
+
+static int set_params(snd_pcm_t *pcm)
+{
+	return ALSA_CHECK(snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16_LE,
+					     SND_PCM_ACCESS_RW_INTERLEAVED,
+					     CHANNELS, RATE, 0, 100000));
+}
+
+/* lossless compression of blocks coded in different ways */
+static void test_flac(void)
+{
+	enum { FRAMES = 9 * 4096 + 1000 };
+	snd_pcm_t *pcm;
+	struct stat st;
+
+	unlink("pcm_file_test.flac");
+	if (open_file(&pcm, SND_PCM_STREAM_PLAYBACK, "pcm_file_test.flac", "flac", "") < 0)
+		return;
+	if (set_params(pcm) >= 0)
+		play_pattern(pcm, FRAMES);
+	ALSA_CHECK(snd_pcm_close(pcm));
+	TEST_CHECK(check_flac("pcm_file_test.flac", 0, 0) == FRAMES);
+	TEST_CHECK(stat("pcm_file_test.flac", &st) == 0 &&
+		   st.st_size < FRAMES * CHANNELS * 2 * 3 / 4);
+	unlink("pcm_file_test.flac");
+
+	/* a pipe is not seekable, the header is left as unknown */
+	if (open_file(&pcm, SND_PCM_STREAM_PLAYBACK, "|cat > pcm_file_test.flac", "flac", "") < 0)
+		return;
+	if (set_params(pcm) >= 0)
+		play_pattern(pcm, FRAMES);
+	ALSA_CHECK(snd_pcm_close(pcm));
+	TEST_CHECK(check_flac("pcm_file_test.flac", 0, 1) == FRAMES);
+	unlink("pcm_file_test.flac");
+}
+
+/* rolling segments, renamed when complete */
+static void test_segments(void)
+{
+	enum { SEGMENT = 1000, FRAMES = 10 * SEGMENT + 300 };
+	char name[64];
+	short buf[SEGMENT * CHANNELS];
+	snd_pcm_t *pcm;
+	FILE *f;
+	int i, j, seg, frames;
+
+	if (open_file(&pcm, SND_PCM_STREAM_PLAYBACK, "pcm_file_seg-%n.raw", "raw",
+		      "segment_size 4000") < 0)
+		return;
+	if (set_params(pcm) >= 0)
+		play_pattern(pcm, FRAMES);
+	ALSA_CHECK(snd_pcm_close(pcm));
+	for (seg = 0; seg <= FRAMES / SEGMENT; seg++) {
+		snprintf(name, sizeof(name), "pcm_file_seg-%04d.raw.part", seg);
+		TEST_CHECK(access(name, F_OK) < 0);
+		snprintf(name, sizeof(name), "pcm_file_seg-%04d.raw", seg);
+		f = fopen(name, "rb");
+		TEST_CHECK(f != NULL);
+		if (!f)
+			continue;
+		frames = fread(buf, CHANNELS * 2, SEGMENT + 1, f);
+		fclose(f);
+		unlink(name);
+		TEST_CHECK(frames == (seg < FRAMES / SEGMENT ? SEGMENT : FRAMES % SEGMENT));
+		for (i = 0; i < frames; i++)
+			for (j = 0; j < CHANNELS; j++)
+				if (buf[i * CHANNELS + j] != flac_sample(seg * SEGMENT + i, j)) {
+					TEST_CHECK(buf[i * CHANNELS + j] == flac_sample(seg * SEGMENT + i, j));
+					i = frames;
+					break;
+				}
+	}
+	TEST_CHECK(access("pcm_file_seg-0011.raw", F_OK) < 0);
+
+	/* every FLAC segment is a complete stream */
+	if (open_file(&pcm, SND_PCM_STREAM_PLAYBACK, "pcm_file_seg.flac", "flac",
+		      "segment_time 0.1") < 0)
+		return;
+	if (set_params(pcm) >= 0)
+		play_pattern(pcm, 3 * 4800);
+	ALSA_CHECK(snd_pcm_close(pcm));
+	for (seg = 0; seg < 3; seg++) {
+		snprintf(name, sizeof(name), "pcm_file_seg.%04d.flac", seg);
+		TEST_CHECK(check_flac(name, seg * 4800, 0) == 4800);
+		unlink(name);
+	}
+	TEST_CHECK(access("pcm_file_seg.0003.flac", F_OK) < 0);
+
+	/* without segments the key is dropped */
+	if (open_file(&pcm, SND_PCM_STREAM_PLAYBACK, "pcm_file_seg%n.raw", "raw", "") < 0)
+		return;
+	if (set_params(pcm) >= 0)
+		play_pattern(pcm, SEGMENT);
+	ALSA_CHECK(snd_pcm_close(pcm));
+	TEST_CHECK(access("pcm_file_seg.raw", F_OK) == 0);
+	TEST_CHECK(access("pcm_file_seg%n.raw", F_OK) < 0);
+	unlink("pcm_file_seg.raw");
+}
+
+int main(void)
+{
+	test_write("");
+	test_write("async 2");
+	test_write("async 2 fadvise true direct true");
+	test_infile();
+	test_infile_changes();
+	test_flac();
+	test_segments();
+	return TEST_EXIT_CODE();
+}
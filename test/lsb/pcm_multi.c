@@ -0,0 +1,97 @@
+/*
+ * PCM multi plugin tests
+ *
+ * Drives four null slaves aggregated to one device, serially and with
+ * worker threads, and checks that both give the same results.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "test.h"
+
+#define SLAVES		4
+#define CHANNELS	(SLAVES * 2)
+#define RATE		48000
+#define FRAMES		1000
+
+static int open_multi(snd_pcm_t **pcm, int threads)
+{
+	char conf[1024];
+	size_t len;
+	snd_config_t *top;
+	int i, err;
+
+	len = snprintf(conf, sizeof(conf),
+		       "pcm.multitest { type plug slave.pcm { type multi threads %d ",
+		       threads);
+	for (i = 0; i < SLAVES; i++)
+		len += snprintf(conf + len, sizeof(conf) - len,
+				"slaves.%d { pcm { type null } channels 2 } ", i);
+	for (i = 0; i < CHANNELS; i++)
+		len += snprintf(conf + len, sizeof(conf) - len,
+				"bindings.%d { slave %d channel %d } ",
+				i, i / 2, i % 2);
+	snprintf(conf + len, sizeof(conf) - len, "} }");
+
+	err = load_config(&top, conf);
+	if (err < 0)
+		return err;
+	err = ALSA_CHECK(snd_pcm_open_lconf(pcm, "multitest",
+					    SND_PCM_STREAM_PLAYBACK, 0, top));
+	snd_config_delete(top);
+	if (err < 0)
+		return err;
+	err = ALSA_CHECK(snd_pcm_set_params(*pcm, SND_PCM_FORMAT_S16_LE,
+					    SND_PCM_ACCESS_RW_INTERLEAVED,
+					    CHANNELS, RATE, 0, 500000));
+	if (err < 0)
+		snd_pcm_close(*pcm);
+	return err;
+}
+
+/* runs the same sequence, the results are stored in res */
+static void run(int threads, snd_pcm_sframes_t *res)
+{
+	static short buf[FRAMES * CHANNELS];
+	snd_pcm_t *pcm;
+	int i;
+
+	if (open_multi(&pcm, threads) < 0)
+		return;
+	memset(buf, 0, sizeof(buf));
+	i = 0;
+	res[i++] = snd_pcm_avail_update(pcm);
+	res[i++] = snd_pcm_writei(pcm, buf, FRAMES);
+	res[i++] = snd_pcm_writei(pcm, buf, FRAMES);
+	res[i++] = snd_pcm_avail(pcm);
+	res[i++] = snd_pcm_rewind(pcm, FRAMES / 2);
+	res[i++] = snd_pcm_avail(pcm);
+	res[i++] = snd_pcm_forward(pcm, FRAMES / 4);
+	res[i++] = snd_pcm_avail(pcm);
+	res[i++] = snd_pcm_writei(pcm, buf, FRAMES);
+	res[i++] = snd_pcm_avail(pcm);
+	ALSA_CHECK(snd_pcm_close(pcm));
+}
+
+int main(void)
+{
+	snd_pcm_sframes_t serial[10], threaded[10], clamped[10];
+	int i;
+
+	memset(serial, 0, sizeof(serial));
+	memset(threaded, 0, sizeof(threaded));
+	memset(clamped, 0, sizeof(clamped));
+	run(0, serial);
+	run(3, threaded);
+	/* more threads than slaves */
+	run(16, clamped);
+	TEST_CHECK(serial[1] == FRAMES);
+	TEST_CHECK(serial[4] > 0);
+	for (i = 0; i < 10; i++) {
+		TEST_CHECK(serial[i] >= 0);
+		TEST_CHECK(threaded[i] == serial[i]);
+		TEST_CHECK(clamped[i] == serial[i]);
+	}
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,111 @@
+/*
+ * PCM share plugin wakeup tests
+ *
+ * The share plugin exports a single notification descriptor which must
+ * be ready exactly when avail_min frames can be transferred.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include "test.h"
+
+#define CHANNELS	2
+#define RATE		48000
+#define BUFFER		3840	/* 80ms */
+#define PERIOD		960	/* 20ms */
+
+/* the share plugin opens its slave by name, so use a global configuration */
+static const char config[] =
+	"pcm.sharenull { type null }\n"
+	"pcm.sharetest { type share slave { pcm sharenull channels 2 rate 48000 "
+	"format S16_LE period_time 20000 buffer_time 80000 } bindings [ 0 1 ] }\n";
+
+static int ready(snd_pcm_t *pcm, unsigned short *revents)
+{
+	struct pollfd pfd;
+	int err;
+
+	*revents = 0;
+	if (ALSA_CHECK(snd_pcm_poll_descriptors(pcm, &pfd, 1)) != 1)
+		return -1;
+	err = poll(&pfd, 1, 0);
+	if (err > 0)
+		ALSA_CHECK(snd_pcm_poll_descriptors_revents(pcm, &pfd, 1, revents));
+	return err;
+}
+
+static void test_prepared(void)
+{
+	snd_pcm_t *pcm;
+	short buf[BUFFER * CHANNELS];
+	unsigned short revents;
+
+	if (ALSA_CHECK(snd_pcm_open(&pcm, "sharetest", SND_PCM_STREAM_PLAYBACK, 0)) < 0)
+		return;
+	if (ALSA_CHECK(snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16_LE,
+					  SND_PCM_ACCESS_RW_INTERLEAVED,
+					  CHANNELS, RATE, 0, 80000)) < 0)
+		goto out;
+	TEST_CHECK(snd_pcm_poll_descriptors_count(pcm) == 1);
+
+	/* an empty playback buffer is ready before the start */
+	TEST_CHECK(snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED);
+	TEST_CHECK(ready(pcm, &revents) == 1);
+	TEST_CHECK(revents == POLLOUT);
+	TEST_CHECK(snd_pcm_wait(pcm, 0) == 1);
+
+	/* below avail_min, nothing to do (and still below the start threshold) */
+	memset(buf, 0, sizeof(buf));
+	TEST_CHECK(snd_pcm_writei(pcm, buf, BUFFER - PERIOD / 2) == BUFFER - PERIOD / 2);
+	TEST_CHECK(snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED);
+	TEST_CHECK(ready(pcm, &revents) == 0);
+
+	/* ready again after the buffer is dropped */
+	ALSA_CHECK(snd_pcm_drop(pcm));
+	ALSA_CHECK(snd_pcm_prepare(pcm));
+	TEST_CHECK(ready(pcm, &revents) == 1);
+	TEST_CHECK(revents == POLLOUT);
+out:
+	snd_pcm_close(pcm);
+}
+
+/* the last close stops the slave thread, also while it polls */
+static void test_close_running(void)
+{
+	snd_pcm_t *pcm;
+	short buf[BUFFER * CHANNELS];
+
+	if (ALSA_CHECK(snd_pcm_open(&pcm, "sharetest", SND_PCM_STREAM_PLAYBACK, 0)) < 0)
+		return;
+	memset(buf, 0, sizeof(buf));
+	alarm(10);
+	if (ALSA_CHECK(snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16_LE,
+					  SND_PCM_ACCESS_RW_INTERLEAVED,
+					  CHANNELS, RATE, 0, 80000)) >= 0)
+		TEST_CHECK(snd_pcm_writei(pcm, buf, BUFFER) == BUFFER);
+	ALSA_CHECK(snd_pcm_close(pcm));
+	alarm(0);
+}
+
+int main(void)
+{
+	char file[] = "/tmp/alsa-pcm-share-XXXXXX";
+	int fd;
+
+	fd = mkstemp(file);
+	if (fd < 0)
+		return EXIT_FAILURE;
+	if (write(fd, config, sizeof(config) - 1) != sizeof(config) - 1) {
+		close(fd);
+		unlink(file);
+		return EXIT_FAILURE;
+	}
+	close(fd);
+	setenv("ALSA_CONFIG_PATH", file, 1);
+	test_prepared();
+	test_close_running();
+	unlink(file);
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,123 @@
+/*
+ * PCM single thread mode tests
+ *
+ * A PCM declared as used by one thread skips its locks, but a slave
+ * shared with other clients must keep them.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include "test.h"
+
+#define CHANNELS	2
+#define RATE		48000
+#define PERIOD		960
+#define PERIODS		50
+
+static const char config[] =
+	"pcm.stnull { type null single_thread true }\n"
+	"pcm.stplug { type plug slave.pcm { type null } single_thread on }\n"
+	"pcm.stbad { type null single_thread maybe }\n"
+	"pcm.stslave { type null }\n"
+	"pcm.stshare0 { type share slave { pcm stslave channels 4 rate 48000 "
+	"format S16_LE period_time 20000 buffer_time 80000 } bindings [ 0 1 ] }\n"
+	"pcm.stshare1 { type share slave { pcm stslave channels 4 rate 48000 "
+	"format S16_LE period_time 20000 buffer_time 80000 } bindings [ 2 3 ] }\n";
+
+static int set_params(snd_pcm_t *pcm)
+{
+	return ALSA_CHECK(snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16_LE,
+					     SND_PCM_ACCESS_RW_INTERLEAVED,
+					     CHANNELS, RATE, 0, 80000));
+}
+
+/* the configuration key is accepted by the plugins and checked */
+static void test_config(void)
+{
+	static const char *const names[] = { "stnull", "stplug" };
+	short buf[PERIOD * CHANNELS];
+	snd_pcm_t *pcm;
+	unsigned int i;
+
+	memset(buf, 0, sizeof(buf));
+	for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		if (ALSA_CHECK(snd_pcm_open(&pcm, names[i], SND_PCM_STREAM_PLAYBACK, 0)) < 0)
+			continue;
+		if (set_params(pcm) >= 0) {
+			TEST_CHECK(snd_pcm_writei(pcm, buf, PERIOD) == PERIOD);
+			TEST_CHECK(snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED);
+		}
+		ALSA_CHECK(snd_pcm_close(pcm));
+	}
+	TEST_CHECK(snd_pcm_open(&pcm, "stbad", SND_PCM_STREAM_PLAYBACK, 0) == -EINVAL);
+}
+
+/*
+ * Single thread clients of one share slave, each in its own thread.  The
+ * null slave takes the data at once, so the clients underrun.
+ */
+static void *share_client(void *arg)
+{
+	const char *name = arg;
+	short buf[PERIOD * CHANNELS];
+	snd_pcm_sframes_t n;
+	snd_pcm_t *pcm;
+	int i;
+
+	memset(buf, 0, sizeof(buf));
+	if (ALSA_CHECK(snd_pcm_open(&pcm, name, SND_PCM_STREAM_PLAYBACK,
+				    SND_PCM_SINGLE_THREAD)) < 0)
+		return NULL;
+	if (set_params(pcm) >= 0) {
+		for (i = 0; i < PERIODS; i++) {
+			n = snd_pcm_writei(pcm, buf, PERIOD);
+			if (n == -EPIPE)
+				n = ALSA_CHECK(snd_pcm_prepare(pcm));
+			TEST_CHECK(n == PERIOD || n == 0);
+		}
+		ALSA_CHECK(snd_pcm_drop(pcm));
+	}
+	ALSA_CHECK(snd_pcm_close(pcm));
+	return NULL;
+}
+
+static void test_share(void)
+{
+	static char *const names[] = { "stshare0", "stshare1" };
+	pthread_t threads[2];
+	int i, started = 0;
+
+	for (i = 0; i < 2; i++) {
+		if (pthread_create(&threads[i], NULL, share_client, names[i])) {
+			TEST_CHECK(0);
+			break;
+		}
+		started++;
+	}
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+}
+
+int main(void)
+{
+	char file[] = "/tmp/alsa-pcm-single-thread-XXXXXX";
+	int fd;
+
+	fd = mkstemp(file);
+	if (fd < 0)
+		return EXIT_FAILURE;
+	if (write(fd, config, sizeof(config) - 1) != sizeof(config) - 1) {
+		close(fd);
+		unlink(file);
+		return EXIT_FAILURE;
+	}
+	close(fd);
+	setenv("ALSA_CONFIG_PATH", file, 1);
+	test_config();
+	test_share();
+	unlink(file);
+	return TEST_EXIT_CODE();
+}
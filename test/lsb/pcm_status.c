@@ -0,0 +1,146 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "test.h"
+
+#define PCMS		4
+#define CHANNELS	2
+#define RATE		48000
+
+static int open_conf(snd_pcm_t **pcm, const char *def, int required)
+{
+	char conf[256];
+	snd_config_t *top;
+	int err;
+
+	snprintf(conf, sizeof(conf), "pcm.statustest %s", def);
+	err = load_config(&top, conf);
+	if (err < 0)
+		return err;
+	err = snd_pcm_open_lconf(pcm, "statustest", SND_PCM_STREAM_PLAYBACK, 0, top);
+	if (required)
+		ALSA_CHECK(err);
+	snd_config_delete(top);
+	return err;
+}
+
+/* the batch must agree with the single PCM calls */
+static void test_batch(unsigned int flags)
+{
+	static const char *const defs[PCMS] = {
+		"{ type null }",
+		"{ type plug slave.pcm { type null } }",
+		"{ type null }",
+		"{ type null }",
+	};
+	snd_pcm_t *pcms[PCMS];
+	snd_pcm_batch_status_t status[PCMS];
+	short buf[512 * CHANNELS];
+	snd_pcm_sframes_t avail, delay;
+	snd_pcm_uframes_t buffer_size, period_size;
+	int i, opened = 0;
+
+	memset(buf, 0, sizeof(buf));
+	for (i = 0; i < PCMS; i++) {
+		if (open_conf(&pcms[i], defs[i], 1) < 0)
+			goto out;
+		opened++;
+		/* the last one is left without parameters */
+		if (i == PCMS - 1)
+			break;
+		if (ALSA_CHECK(snd_pcm_set_params(pcms[i], SND_PCM_FORMAT_S16_LE,
+						  SND_PCM_ACCESS_RW_INTERLEAVED,
+						  CHANNELS, RATE, 0, 500000)) < 0)
+			goto out;
+		/* less than the start threshold, so the PCMs stay prepared */
+		TEST_CHECK(snd_pcm_writei(pcms[i], buf, 100 * (i + 1)) == 100 * (i + 1));
+	}
+
+	TEST_CHECK(snd_pcm_status_batch(pcms, status, PCMS, flags) == 1);
+	for (i = 0; i < PCMS - 1; i++) {
+		TEST_CHECK(status[i].err == 0);
+		TEST_CHECK(status[i].state == SND_PCM_STATE_PREPARED);
+		TEST_CHECK(status[i].appl_ptr == (snd_pcm_uframes_t)(100 * (i + 1)));
+		ALSA_CHECK(snd_pcm_get_params(pcms[i], &buffer_size, &period_size));
+		TEST_CHECK(status[i].hw_ptr + buffer_size - status[i].appl_ptr ==
+			   (snd_pcm_uframes_t)status[i].avail);
+		ALSA_CHECK(snd_pcm_avail_delay(pcms[i], &avail, &delay));
+		TEST_CHECK(status[i].avail == avail);
+		TEST_CHECK(status[i].delay == delay);
+	}
+	TEST_CHECK(status[PCMS - 1].err == -EIO);
+	TEST_CHECK(snd_pcm_status_batch(pcms, status, 0, flags) == 0);
+out:
+	for (i = 0; i < opened; i++)
+		snd_pcm_close(pcms[i]);
+}
+
+/* the mmapped status of a hw PCM, skipped without a sound card */
+static void test_hw(void)
+{
+	snd_pcm_t *pcm;
+	snd_pcm_batch_status_t batch;
+	snd_pcm_status_t *status;
+	short buf[100 * CHANNELS];
+
+	if (open_conf(&pcm, "{ type hw card 0 device 0 nonblock true }", 0) < 0)
+		return;
+	memset(buf, 0, sizeof(buf));
+	if (ALSA_CHECK(snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16_LE,
+					  SND_PCM_ACCESS_RW_INTERLEAVED,
+					  CHANNELS, RATE, 1, 500000)) < 0)
+		goto out;
+	/* prepared, so the records do not move */
+	TEST_CHECK(snd_pcm_writei(pcm, buf, 100) == 100);
+	snd_pcm_status_alloca(&status);
+	ALSA_CHECK(snd_pcm_status(pcm, status));
+	TEST_CHECK(snd_pcm_status_batch(&pcm, &batch, 1, 0) == 1);
+	TEST_CHECK(batch.err == 0);
+	TEST_CHECK(batch.state == snd_pcm_status_get_state(status));
+	TEST_CHECK(batch.hw_ptr == 0 && batch.appl_ptr == 100);
+	TEST_CHECK(batch.avail == (snd_pcm_sframes_t)snd_pcm_status_get_avail(status));
+	TEST_CHECK(batch.delay == snd_pcm_status_get_delay(status));
+ out:
+	snd_pcm_close(pcm);
+}
+
+/*
+ * Deferred appl_ptr updates of a hw PCM without the mmapped control
+ * record must reach the kernel before it reports the status.
+ */
+static void test_hw_sync_ptr(void)
+{
+	snd_pcm_t *pcm;
+	snd_pcm_status_t *status;
+	short buf[100 * CHANNELS];
+	snd_pcm_sframes_t delay;
+	int i;
+
+	if (open_conf(&pcm, "{ type hw card 0 device 0 nonblock true "
+		      "sync_ptr_ioctl true sync_ptr_window 100000 }", 0) < 0)
+		return;
+	memset(buf, 0, sizeof(buf));
+	if (ALSA_CHECK(snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16_LE,
+					  SND_PCM_ACCESS_RW_INTERLEAVED,
+					  CHANNELS, RATE, 0, 500000)) < 0)
+		goto out;
+	for (i = 0; i < 3; i++)
+		TEST_CHECK(snd_pcm_writei(pcm, buf, 100) == 100);
+	snd_pcm_status_alloca(&status);
+	ALSA_CHECK(snd_pcm_status(pcm, status));
+	TEST_CHECK(snd_pcm_status_get_delay(status) == 300);
+	TEST_CHECK(snd_pcm_writei(pcm, buf, 100) == 100);
+	ALSA_CHECK(snd_pcm_delay(pcm, &delay));
+	TEST_CHECK(delay == 400);
+ out:
+	snd_pcm_close(pcm);
+}
+
+int main(void)
+{
+	test_batch(0);
+	test_batch(SND_PCM_STATUS_BATCH_HWSYNC);
+	test_hw();
+	test_hw_sync_ptr();
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,167 @@
+/*
+ * PCM batched transfer tests
+ *
+ * Queues transfers and waits of several null PCMs in a ring, both with
+ * io_uring (when the kernel supports it) and emulated. A wait which never
+ * completes (on a full share PCM) is left to the close.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include "test.h"
+
+#define PCMS		3
+#define CHANNELS	2
+#define RATE		48000
+#define FRAMES		1000
+
+/* the share plugin opens its slave by name, so use a global configuration */
+static const char config[] =
+	"pcm.uringtest { type null }\n"
+	"pcm.uringshare {\n"
+	"	type share\n"
+	"	slave { pcm uringtest channels 2 rate 48000 format S16_LE }\n"
+	"	bindings [ 0 1 ]\n"
+	"}\n";
+
+static int open_pcm(snd_pcm_t **pcm, const char *name, snd_pcm_stream_t stream)
+{
+	int err;
+
+	err = ALSA_CHECK(snd_pcm_open(pcm, name, stream, 0));
+	if (err < 0)
+		return err;
+	err = ALSA_CHECK(snd_pcm_set_params(*pcm, SND_PCM_FORMAT_S16_LE,
+					    SND_PCM_ACCESS_RW_INTERLEAVED,
+					    CHANNELS, RATE, 0, 500000));
+	if (err < 0)
+		snd_pcm_close(*pcm);
+	return err;
+}
+
+/* a prepared share PCM with a full buffer is not ready until its start */
+static int fill_share(snd_pcm_t **pcm)
+{
+	static short buf[FRAMES * CHANNELS];
+	snd_pcm_sw_params_t *sw;
+	snd_pcm_uframes_t boundary;
+	snd_pcm_sframes_t avail;
+	int err;
+
+	err = open_pcm(pcm, "uringshare", SND_PCM_STREAM_PLAYBACK);
+	if (err < 0) {
+		*pcm = NULL;
+		return err;
+	}
+	snd_pcm_sw_params_alloca(&sw);
+	ALSA_CHECK(snd_pcm_sw_params_current(*pcm, sw));
+	ALSA_CHECK(snd_pcm_sw_params_get_boundary(sw, &boundary));
+	ALSA_CHECK(snd_pcm_sw_params_set_start_threshold(*pcm, sw, boundary));
+	ALSA_CHECK(snd_pcm_sw_params(*pcm, sw));
+	memset(buf, 0, sizeof(buf));
+	while ((avail = snd_pcm_avail(*pcm)) > 0)
+		ALSA_CHECK(snd_pcm_writei(*pcm, buf, avail < FRAMES ? avail : FRAMES));
+	TEST_CHECK(avail == 0);
+	return avail == 0 ? 0 : -EIO;
+}
+
+static void test_ring(int mode)
+{
+	static short buf[PCMS][FRAMES * CHANNELS];
+	snd_pcm_uring_t *ring;
+	snd_pcm_uring_event_t ev[PCMS + 1];
+	snd_pcm_t *pcms[PCMS], *share = NULL;
+	unsigned int seen = 0;
+	int i, n, loops, opened = 0;
+
+	if (ALSA_CHECK(snd_pcm_uring_open(&ring, PCMS + 1, mode)) < 0)
+		return;
+	if (mode & SND_PCM_URING_EMULATE)
+		TEST_CHECK(snd_pcm_uring_native(ring) == 0);
+	for (i = 0; i < PCMS; i++) {
+		if (open_pcm(&pcms[i], "uringtest",
+			      i == PCMS - 1 ? SND_PCM_STREAM_CAPTURE :
+			      SND_PCM_STREAM_PLAYBACK) < 0)
+			goto out;
+		opened++;
+	}
+
+	/* nothing outstanding, no wait */
+	TEST_CHECK(snd_pcm_uring_submit(ring, ev, PCMS + 1, -1) == 0);
+
+	memset(buf, 0, sizeof(buf));
+	ALSA_CHECK(snd_pcm_uring_writei(ring, pcms[0], buf[0], FRAMES, &buf[0]));
+	ALSA_CHECK(snd_pcm_uring_writei(ring, pcms[1], buf[1], FRAMES, &buf[1]));
+	ALSA_CHECK(snd_pcm_uring_readi(ring, pcms[2], buf[2], FRAMES, &buf[2]));
+	ALSA_CHECK(snd_pcm_uring_poll(ring, pcms[0], pcms[0]));
+	/* the ring is full */
+	TEST_CHECK(snd_pcm_uring_poll(ring, pcms[1], NULL) == -EAGAIN);
+
+	for (loops = 0; seen != 0x0f && loops < 10; loops++) {
+		n = snd_pcm_uring_submit(ring, ev, 2, 1000);
+		TEST_CHECK(n > 0 && n <= 2);
+		if (n <= 0)
+			break;
+		for (i = 0; i < n; i++) {
+			switch (ev[i].op) {
+			case SND_PCM_URING_WRITEI:
+			case SND_PCM_URING_READI:
+				TEST_CHECK(ev[i].result == FRAMES);
+				TEST_CHECK(ev[i].private_data ==
+					   (ev[i].pcm == pcms[0] ? (void *)&buf[0] :
+					    ev[i].pcm == pcms[1] ? (void *)&buf[1] :
+					    (void *)&buf[2]));
+				seen |= ev[i].pcm == pcms[0] ? 1 :
+					ev[i].pcm == pcms[1] ? 2 : 4;
+				break;
+			case SND_PCM_URING_POLL:
+				TEST_CHECK(ev[i].pcm == pcms[0]);
+				TEST_CHECK(ev[i].private_data == pcms[0]);
+				TEST_CHECK(ev[i].result == POLLOUT);
+				seen |= 8;
+				break;
+			}
+		}
+	}
+	TEST_CHECK(seen == 0x0f);
+	TEST_CHECK(snd_pcm_uring_submit(ring, ev, PCMS + 1, 0) == 0);
+
+	/* a wait left outstanding is cancelled by the close */
+	if (fill_share(&share) >= 0) {
+		ALSA_CHECK(snd_pcm_uring_poll(ring, share, NULL));
+		TEST_CHECK(snd_pcm_uring_submit(ring, ev, PCMS + 1, 10) == 0);
+	}
+out:
+	ALSA_CHECK(snd_pcm_uring_close(ring));
+	for (i = 0; i < opened; i++)
+		snd_pcm_close(pcms[i]);
+	if (share)
+		snd_pcm_close(share);
+}
+
+int main(void)
+{
+	char file[] = "/tmp/alsa-pcm-uring-XXXXXX";
+	snd_pcm_uring_t *ring;
+	int fd;
+
+	fd = mkstemp(file);
+	if (fd < 0)
+		return EXIT_FAILURE;
+	if (write(fd, config, sizeof(config) - 1) != sizeof(config) - 1) {
+		close(fd);
+		unlink(file);
+		return EXIT_FAILURE;
+	}
+	close(fd);
+	setenv("ALSA_CONFIG_PATH", file, 1);
+	test_ring(0);
+	test_ring(SND_PCM_URING_EMULATE);
+	TEST_CHECK(snd_pcm_uring_open(&ring, 0, 0) == -EINVAL);
+	TEST_CHECK(snd_pcm_uring_open(&ring, 4, 0x100) == -EINVAL);
+	unlink(file);
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,238 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include "test.h"
+
+/*
+ * A duplex virtual RawMIDI port on the loopback sequencer, subscribed to
+ * itself, returns the bytes written to it.
+ */
+static int open_virtual(snd_config_t **top, snd_rawmidi_t **in, snd_rawmidi_t **out,
+			snd_seq_t **seq)
+{
+	static const char conf[] =
+		"seq.looptest { type loop }\n"
+		"rawmidi.virttest { type virtual slave looptest }\n";
+	int err;
+
+	err = load_config(top, conf);
+	if (err < 0)
+		return err;
+	err = ALSA_CHECK(snd_rawmidi_open_lconf(in, out, "virttest",
+						SND_RAWMIDI_NONBLOCK, *top));
+	if (err >= 0) {
+		err = ALSA_CHECK(snd_seq_open_lconf(seq, "looptest", SND_SEQ_OPEN_DUPLEX,
+						    0, *top));
+		if (err < 0) {
+			snd_rawmidi_close(*in);
+			snd_rawmidi_close(*out);
+		}
+	}
+	if (err < 0)
+		snd_config_delete(*top);
+	return err;
+}
+
+static int subscribe_self(snd_seq_t *seq)
+{
+	snd_seq_port_subscribe_t *sub;
+	snd_seq_addr_t addr;
+
+	/* the virtual port was created by the first loop client */
+	addr.client = 128;
+	addr.port = 0;
+	snd_seq_port_subscribe_alloca(&sub);
+	snd_seq_port_subscribe_set_sender(sub, &addr);
+	snd_seq_port_subscribe_set_dest(sub, &addr);
+	return ALSA_CHECK(snd_seq_subscribe_port(seq, sub));
+}
+
+static int send_raw(snd_seq_t *seq, const void *data, size_t len)
+{
+	snd_seq_event_t ev;
+
+	snd_seq_ev_clear(&ev);
+	snd_seq_ev_set_direct(&ev);
+	snd_seq_ev_set_dest(&ev, 128, 0);
+	snd_seq_ev_set_sysex(&ev, len, (void *)data);
+	return ALSA_CHECK(snd_seq_event_output_direct(seq, &ev));
+}
+
+static size_t read_all(snd_rawmidi_t *in, unsigned char *buf, size_t size)
+{
+	size_t done = 0;
+	ssize_t err;
+
+	while (done < size) {
+		err = snd_rawmidi_read(in, buf + done, size - done);
+		if (err <= 0)
+			break;
+		done += err;
+	}
+	return done;
+}
+
+static void test_sysex(void)
+{
+	enum { SYSEX = 20000 };
+	snd_config_t *top;
+	snd_rawmidi_t *in, *out;
+	snd_seq_t *seq;
+	unsigned char *data, *back;
+	size_t len, i;
+
+	if (open_virtual(&top, &in, &out, &seq) < 0)
+		return;
+	data = malloc(2 * SYSEX);
+	back = malloc(2 * SYSEX);
+	if (!data || !back)
+		goto out;
+
+	if (subscribe_self(seq) < 0)
+		goto out;
+
+	/* note on, a long SysEx with a clock inside, note off */
+	len = 0;
+	data[len++] = 0x90;
+	data[len++] = 0x3c;
+	data[len++] = 0x40;
+	data[len++] = 0xf0;
+	for (i = 0; i < SYSEX; i++) {
+		if (i == SYSEX / 3)
+			data[len++] = 0xf8;
+		data[len++] = i & 0x7f;
+	}
+	data[len++] = 0xf7;
+	data[len++] = 0x80;
+	data[len++] = 0x3c;
+	data[len++] = 0x00;
+
+	/* split the SysEx across two writes */
+	TEST_CHECK(snd_rawmidi_write(out, data, len / 2) == (ssize_t)(len / 2));
+	TEST_CHECK(snd_rawmidi_write(out, data + len / 2, len - len / 2) ==
+		   (ssize_t)(len - len / 2));
+	TEST_CHECK(read_all(in, back, len) == len);
+	TEST_CHECK(!memcmp(data, back, len));
+
+	/* a short SysEx still goes through the encoder */
+	TEST_CHECK(snd_rawmidi_write(out, "\xf0\x01\x02\xf7", 4) == 4);
+	TEST_CHECK(read_all(in, back, 4) == 4);
+	TEST_CHECK(!memcmp(back, "\xf0\x01\x02\xf7", 4));
+	TEST_CHECK(snd_rawmidi_read(in, back, 1) == -EAGAIN);
+
+ out:
+	free(data);
+	free(back);
+	snd_seq_close(seq);
+	snd_rawmidi_close(in);
+	snd_rawmidi_close(out);
+	snd_config_delete(top);
+}
+
+static int check_msg(const snd_rawmidi_message_t *msg, const char *data, size_t len,
+		     const struct timespec *from, const struct timespec *to)
+{
+	if (msg->length != len || memcmp(msg->data, data, len))
+		return 0;
+	if (msg->tstamp.tv_sec < from->tv_sec ||
+	    (msg->tstamp.tv_sec == from->tv_sec && msg->tstamp.tv_nsec < from->tv_nsec))
+		return 0;
+	if (msg->tstamp.tv_sec > to->tv_sec ||
+	    (msg->tstamp.tv_sec == to->tv_sec && msg->tstamp.tv_nsec > to->tv_nsec))
+		return 0;
+	return 1;
+}
+
+static void test_messages(void)
+{
+	static const char stream[] =
+		"\x90\x3c\x40\x3e\x40\xf8"
+		"\xf0\x01\x02\x03\x04\xf7"
+		"\xc0\x05\xfe";
+	snd_config_t *top;
+	snd_rawmidi_t *in, *out;
+	snd_rawmidi_params_t *params;
+	snd_rawmidi_message_t msgs[8];
+	snd_seq_t *seq;
+	struct timespec from, to, ts;
+	unsigned char buf[64];
+
+	if (open_virtual(&top, &in, &out, &seq) < 0)
+		return;
+	if (subscribe_self(seq) < 0)
+		goto out;
+
+	snd_rawmidi_params_alloca(&params);
+	ALSA_CHECK(snd_rawmidi_params_current(in, params));
+	ALSA_CHECK(snd_rawmidi_params_set_read_mode(in, params, SND_RAWMIDI_READ_TSTAMP));
+	ALSA_CHECK(snd_rawmidi_params_set_clock_type(in, params, SND_RAWMIDI_CLOCK_MONOTONIC));
+	ALSA_CHECK(snd_rawmidi_params(in, params));
+	ALSA_CHECK(snd_rawmidi_params_current(in, params));
+	TEST_CHECK(snd_rawmidi_params_get_read_mode(params) == SND_RAWMIDI_READ_TSTAMP);
+	TEST_CHECK(snd_rawmidi_params_get_clock_type(params) == SND_RAWMIDI_CLOCK_MONOTONIC);
+	TEST_CHECK(snd_rawmidi_read(in, buf, 1) == -EINVAL);
+
+	/* plain timestamped bytes */
+	clock_gettime(CLOCK_MONOTONIC, &from);
+	TEST_CHECK(snd_rawmidi_write(out, "\x80\x3c\x00", 3) == 3);
+	TEST_CHECK(snd_rawmidi_tread(in, &ts, buf, sizeof(buf)) == 3);
+	clock_gettime(CLOCK_MONOTONIC, &to);
+	msgs[0].tstamp = ts;
+	msgs[0].data = buf;
+	msgs[0].length = 3;
+	TEST_CHECK(check_msg(&msgs[0], "\x80\x3c\x00", 3, &from, &to));
+
+	/* messages, running status expanded, SysEx split by the buffer size */
+	clock_gettime(CLOCK_MONOTONIC, &from);
+	TEST_CHECK(snd_rawmidi_write(out, stream, sizeof(stream) - 1) == sizeof(stream) - 1);
+	TEST_CHECK(snd_rawmidi_read_messages(in, msgs, 3, buf, sizeof(buf)) == 3);
+	clock_gettime(CLOCK_MONOTONIC, &to);
+	TEST_CHECK(check_msg(&msgs[0], "\x90\x3c\x40", 3, &from, &to));
+	TEST_CHECK(check_msg(&msgs[1], "\x90\x3e\x40", 3, &from, &to));
+	TEST_CHECK(check_msg(&msgs[2], "\xf8", 1, &from, &to));
+	TEST_CHECK(snd_rawmidi_read_messages(in, msgs, 8, buf, 4) == 1);
+	TEST_CHECK(check_msg(&msgs[0], "\xf0\x01\x02\x03", 4, &from, &to));
+	TEST_CHECK(snd_rawmidi_read_messages(in, msgs, 8, buf, sizeof(buf)) == 3);
+	TEST_CHECK(check_msg(&msgs[0], "\x04\xf7", 2, &from, &to));
+	TEST_CHECK(check_msg(&msgs[1], "\xc0\x05", 2, &from, &to));
+	TEST_CHECK(check_msg(&msgs[2], "\xfe", 1, &from, &to));
+	TEST_CHECK(snd_rawmidi_read_messages(in, msgs, 8, buf, sizeof(buf)) == -EAGAIN);
+
+	/* a message split across writes is returned once complete */
+	TEST_CHECK(snd_rawmidi_write(out, "\xb0\x07", 2) == 2);
+	TEST_CHECK(snd_rawmidi_read_messages(in, msgs, 8, buf, sizeof(buf)) == -EAGAIN);
+	TEST_CHECK(snd_rawmidi_write(out, "\x7f", 1) == 1);
+	TEST_CHECK(snd_rawmidi_read_messages(in, msgs, 8, buf, sizeof(buf)) == 1);
+	clock_gettime(CLOCK_MONOTONIC, &to);
+	TEST_CHECK(check_msg(&msgs[0], "\xb0\x07\x7f", 3, &from, &to));
+
+	/*
+	 * a blocking read does not wait again for the rest of a message;
+	 * the encoder only sends complete messages, so the parts are sent
+	 * as raw SysEx events
+	 */
+	if (ALSA_CHECK(snd_rawmidi_nonblock(in, 0)) < 0)
+		goto out;
+	alarm(10);
+	TEST_CHECK(send_raw(seq, "\xb0\x07", 2) >= 0);
+	TEST_CHECK(snd_rawmidi_read_messages(in, msgs, 8, buf, sizeof(buf)) == 0);
+	TEST_CHECK(send_raw(seq, "\x7f", 1) >= 0);
+	TEST_CHECK(snd_rawmidi_read_messages(in, msgs, 8, buf, sizeof(buf)) == 1);
+	TEST_CHECK(msgs[0].length == 3 && !memcmp(msgs[0].data, "\xb0\x07\x7f", 3));
+	alarm(0);
+
+ out:
+	snd_seq_close(seq);
+	snd_rawmidi_close(in);
+	snd_rawmidi_close(out);
+	snd_config_delete(top);
+}
+
+int main(void)
+{
+	test_sysex();
+	test_messages();
+	return TEST_EXIT_CODE();
+}
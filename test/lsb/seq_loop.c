@@ -0,0 +1,546 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "test.h"
+
+static int open_loop(snd_seq_t **seq, int mode)
+{
+	static const char conf[] = "seq.looptest { type loop }";
+	snd_config_t *top;
+	int err;
+
+	err = load_config(&top, conf);
+	if (err < 0)
+		return err;
+	err = ALSA_CHECK(snd_seq_open_lconf(seq, "looptest",
+					    SND_SEQ_OPEN_DUPLEX, mode, top));
+	snd_config_delete(top);
+	return err;
+}
+
+static void send_note(snd_seq_t *seq, int port, int note)
+{
+	snd_seq_event_t ev;
+
+	snd_seq_ev_clear(&ev);
+	snd_seq_ev_set_source(&ev, port);
+	snd_seq_ev_set_subs(&ev);
+	snd_seq_ev_set_direct(&ev);
+	snd_seq_ev_set_noteon(&ev, 0, note, 100);
+	ALSA_CHECK(snd_seq_event_output(seq, &ev));
+}
+
+static void test_loop(void)
+{
+	snd_seq_t *out, *in;
+	snd_seq_event_t ev, *rev, evs[8], *revs[8];
+	snd_seq_query_subscribe_t *query;
+	snd_seq_queue_status_t *status;
+	snd_seq_remove_events_t *rm;
+	unsigned char sysex[300];
+	int oport, iport, queue, i;
+
+	if (open_loop(&out, SND_SEQ_NONBLOCK) < 0)
+		return;
+	if (open_loop(&in, SND_SEQ_NONBLOCK) < 0)
+		goto out_close;
+	TEST_CHECK(snd_seq_type(out) == SND_SEQ_TYPE_LOOP);
+	TEST_CHECK(snd_seq_client_id(out) >= 128);
+	TEST_CHECK(snd_seq_client_id(in) != snd_seq_client_id(out));
+
+	oport = ALSA_CHECK(snd_seq_create_simple_port(out, "out",
+			SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ,
+			SND_SEQ_PORT_TYPE_APPLICATION));
+	iport = ALSA_CHECK(snd_seq_create_simple_port(in, "in",
+			SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE,
+			SND_SEQ_PORT_TYPE_APPLICATION));
+	if (oport < 0 || iport < 0)
+		goto out_close_in;
+	TEST_CHECK(snd_seq_connect_from(out, oport, snd_seq_client_id(in), iport) == -EPERM);
+	ALSA_CHECK(snd_seq_connect_to(out, oport, snd_seq_client_id(in), iport));
+	TEST_CHECK(snd_seq_connect_to(out, oport, snd_seq_client_id(in), iport) == -EBUSY);
+
+	snd_seq_query_subscribe_alloca(&query);
+	snd_seq_query_subscribe_set_client(query, snd_seq_client_id(in));
+	snd_seq_query_subscribe_set_port(query, iport);
+	snd_seq_query_subscribe_set_type(query, SND_SEQ_QUERY_SUBS_WRITE);
+	snd_seq_query_subscribe_set_index(query, 0);
+	ALSA_CHECK(snd_seq_query_port_subscribers(in, query));
+	TEST_CHECK(snd_seq_query_subscribe_get_num_subs(query) == 1);
+	TEST_CHECK(snd_seq_query_subscribe_get_addr(query)->client == snd_seq_client_id(out));
+
+	/* nothing pending yet */
+	TEST_CHECK(snd_seq_event_input(in, &rev) == -EAGAIN);
+
+	/* subscribers delivery */
+	send_note(out, oport, 60);
+	send_note(out, oport, 61);
+	ALSA_CHECK(snd_seq_drain_output(out));
+	TEST_CHECK(snd_seq_event_input(in, &rev) >= 0);
+	TEST_CHECK(rev->type == SND_SEQ_EVENT_NOTEON && rev->data.note.note == 60);
+	TEST_CHECK(rev->source.client == snd_seq_client_id(out));
+	TEST_CHECK(rev->dest.client == snd_seq_client_id(in) && rev->dest.port == iport);
+	TEST_CHECK(snd_seq_event_input(in, &rev) >= 0);
+	TEST_CHECK(rev->data.note.note == 61);
+	TEST_CHECK(snd_seq_event_input(in, &rev) == -EAGAIN);
+
+	/* variable length event */
+	for (i = 0; i < (int)sizeof(sysex); i++)
+		sysex[i] = i & 0x7f;
+	sysex[0] = 0xf0;
+	sysex[sizeof(sysex) - 1] = 0xf7;
+	snd_seq_ev_clear(&ev);
+	snd_seq_ev_set_source(&ev, oport);
+	snd_seq_ev_set_dest(&ev, snd_seq_client_id(in), iport);
+	snd_seq_ev_set_direct(&ev);
+	snd_seq_ev_set_sysex(&ev, sizeof(sysex), sysex);
+	ALSA_CHECK(snd_seq_event_output_direct(out, &ev));
+	TEST_CHECK(snd_seq_event_input(in, &rev) >= 0);
+	TEST_CHECK(rev->type == SND_SEQ_EVENT_SYSEX);
+	TEST_CHECK(rev->data.ext.len == sizeof(sysex));
+	TEST_CHECK(!memcmp(rev->data.ext.ptr, sysex, sizeof(sysex)));
+
+	/* batched output and input */
+	for (i = 0; i < 8; i++) {
+		snd_seq_ev_clear(&evs[i]);
+		snd_seq_ev_set_source(&evs[i], oport);
+		snd_seq_ev_set_subs(&evs[i]);
+		snd_seq_ev_set_direct(&evs[i]);
+		snd_seq_ev_set_controller(&evs[i], 0, 7, i);
+	}
+	TEST_CHECK(snd_seq_event_output_array(out, evs, 8) == 8);
+	ALSA_CHECK(snd_seq_drain_output(out));
+	TEST_CHECK(snd_seq_event_input_array(in, revs, 8) == 8);
+	for (i = 0; i < 8; i++)
+		TEST_CHECK(revs[i]->data.control.value == i);
+
+	/* scheduled events are held until the queue reaches them */
+	queue = ALSA_CHECK(snd_seq_alloc_queue(out));
+	if (queue >= 0) {
+		snd_seq_ev_clear(&ev);
+		snd_seq_ev_set_source(&ev, oport);
+		snd_seq_ev_set_subs(&ev);
+		snd_seq_ev_schedule_tick(&ev, queue, 0, 1);
+		snd_seq_ev_set_noteoff(&ev, 0, 62, 0);
+		ALSA_CHECK(snd_seq_event_output_direct(out, &ev));
+		snd_seq_ev_schedule_tick(&ev, queue, 0, 1000000);
+		ALSA_CHECK(snd_seq_event_output_direct(out, &ev));
+		TEST_CHECK(snd_seq_event_input(in, &rev) == -EAGAIN);
+
+		snd_seq_queue_status_alloca(&status);
+		ALSA_CHECK(snd_seq_get_queue_status(out, queue, status));
+		TEST_CHECK(snd_seq_queue_status_get_events(status) == 2);
+
+		ALSA_CHECK(snd_seq_start_queue(out, queue, NULL));
+		ALSA_CHECK(snd_seq_drain_output(out));
+		for (i = 0; i < 1000; i++) {
+			if (snd_seq_event_input_pending(in, 1) > 0)
+				break;
+			usleep(1000);
+		}
+		TEST_CHECK(snd_seq_event_input(in, &rev) >= 0 &&
+			   rev->type == SND_SEQ_EVENT_NOTEOFF && rev->data.note.note == 62);
+		TEST_CHECK(snd_seq_event_input(in, &rev) == -EAGAIN);
+
+		/* the far event can still be removed */
+		snd_seq_remove_events_alloca(&rm);
+		snd_seq_remove_events_set_condition(rm, SND_SEQ_REMOVE_OUTPUT);
+		ALSA_CHECK(snd_seq_remove_events(out, rm));
+		ALSA_CHECK(snd_seq_get_queue_status(out, queue, status));
+		TEST_CHECK(snd_seq_queue_status_get_events(status) == 0);
+		ALSA_CHECK(snd_seq_free_queue(out, queue));
+	}
+
+	ALSA_CHECK(snd_seq_disconnect_to(out, oport, snd_seq_client_id(in), iport));
+	send_note(out, oport, 63);
+	ALSA_CHECK(snd_seq_drain_output(out));
+	TEST_CHECK(snd_seq_event_input(in, &rev) == -EAGAIN);
+
+ out_close_in:
+	snd_seq_close(in);
+ out_close:
+	snd_seq_close(out);
+}
+
+static int count_control(snd_seq_t *seq ATTRIBUTE_UNUSED, snd_seq_event_t *ev, void *private_data)
+{
+	int *count = private_data;
+
+	(*count)++;
+	/* consume the low values, pass the others on */
+	return ev->data.control.value >= 4;
+}
+
+static void test_input_filter(void)
+{
+	snd_seq_t *out, *in;
+	snd_seq_event_t ev, *rev;
+	int oport, iport, i, count = 0;
+
+	if (open_loop(&out, SND_SEQ_NONBLOCK) < 0)
+		return;
+	if (open_loop(&in, SND_SEQ_NONBLOCK) < 0)
+		goto out_close;
+	oport = ALSA_CHECK(snd_seq_create_simple_port(out, "out",
+			SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ,
+			SND_SEQ_PORT_TYPE_APPLICATION));
+	iport = ALSA_CHECK(snd_seq_create_simple_port(in, "in",
+			SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE,
+			SND_SEQ_PORT_TYPE_APPLICATION));
+	if (oport < 0 || iport < 0)
+		goto out_close_in;
+	ALSA_CHECK(snd_seq_connect_to(out, oport, snd_seq_client_id(in), iport));
+
+	TEST_CHECK(snd_seq_set_input_filter(in, 256) == -EINVAL);
+	ALSA_CHECK(snd_seq_set_input_filter(in, SND_SEQ_EVENT_NOTEON));
+	ALSA_CHECK(snd_seq_set_input_filter(in, SND_SEQ_EVENT_CONTROLLER));
+	ALSA_CHECK(snd_seq_set_input_handler(in, SND_SEQ_EVENT_CONTROLLER, count_control, &count));
+
+	snd_seq_ev_clear(&ev);
+	snd_seq_ev_set_source(&ev, oport);
+	snd_seq_ev_set_subs(&ev);
+	snd_seq_ev_set_direct(&ev);
+	snd_seq_ev_set_noteoff(&ev, 0, 59, 0);
+	ALSA_CHECK(snd_seq_event_output(out, &ev));
+	send_note(out, oport, 60);
+	for (i = 0; i < 8; i++) {
+		snd_seq_ev_set_controller(&ev, 0, 7, i);
+		ALSA_CHECK(snd_seq_event_output(out, &ev));
+	}
+	snd_seq_ev_set_pgmchange(&ev, 0, 1);
+	ALSA_CHECK(snd_seq_event_output(out, &ev));
+	send_note(out, oport, 61);
+	ALSA_CHECK(snd_seq_drain_output(out));
+
+	TEST_CHECK(snd_seq_event_input(in, &rev) >= 0 &&
+		   rev->type == SND_SEQ_EVENT_NOTEON && rev->data.note.note == 60);
+	TEST_CHECK(count == 8);
+	for (i = 4; i < 8; i++)
+		TEST_CHECK(snd_seq_event_input(in, &rev) >= 0 &&
+			   rev->type == SND_SEQ_EVENT_CONTROLLER && rev->data.control.value == i);
+	TEST_CHECK(snd_seq_event_input(in, &rev) >= 0 && rev->data.note.note == 61);
+	TEST_CHECK(snd_seq_event_input(in, &rev) == -EAGAIN);
+
+	/* only filtered events pending: nothing to return */
+	snd_seq_ev_set_pgmchange(&ev, 0, 2);
+	ALSA_CHECK(snd_seq_event_output_direct(out, &ev));
+	TEST_CHECK(snd_seq_event_input(in, &rev) == -EAGAIN);
+
+	ALSA_CHECK(snd_seq_reset_input_filter(in));
+	ALSA_CHECK(snd_seq_set_input_handler(in, SND_SEQ_EVENT_CONTROLLER, NULL, NULL));
+	snd_seq_ev_set_controller(&ev, 0, 7, 0);
+	ALSA_CHECK(snd_seq_event_output_direct(out, &ev));
+	TEST_CHECK(snd_seq_event_input(in, &rev) >= 0 &&
+		   rev->type == SND_SEQ_EVENT_CONTROLLER && rev->data.control.value == 0);
+	TEST_CHECK(count == 8);
+
+ out_close_in:
+	snd_seq_close(in);
+ out_close:
+	snd_seq_close(out);
+}
+
+static void test_scheduler(void)
+{
+	enum { EVENTS = 200 };
+	snd_seq_t *out, *in;
+	snd_seq_scheduler_t *sched = NULL;
+	snd_seq_queue_tempo_t *tempo;
+	snd_seq_queue_status_t *status;
+	snd_seq_event_t *evs, *rev;
+	int oport, iport, queue, i, received = 0, loops;
+
+	evs = calloc(EVENTS, sizeof(*evs));
+	if (!evs)
+		return;
+	if (open_loop(&out, SND_SEQ_NONBLOCK) < 0)
+		goto out_free;
+	if (open_loop(&in, SND_SEQ_NONBLOCK) < 0)
+		goto out_close;
+	oport = ALSA_CHECK(snd_seq_create_simple_port(out, "out",
+			SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ,
+			SND_SEQ_PORT_TYPE_APPLICATION));
+	iport = ALSA_CHECK(snd_seq_create_simple_port(in, "in",
+			SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE,
+			SND_SEQ_PORT_TYPE_APPLICATION));
+	queue = ALSA_CHECK(snd_seq_alloc_queue(out));
+	if (oport < 0 || iport < 0 || queue < 0)
+		goto out_close_in;
+	ALSA_CHECK(snd_seq_connect_to(out, oport, snd_seq_client_id(in), iport));
+
+	/* 0.1ms per tick */
+	snd_seq_queue_tempo_alloca(&tempo);
+	snd_seq_queue_tempo_set_tempo(tempo, 100000);
+	snd_seq_queue_tempo_set_ppq(tempo, 1000);
+	ALSA_CHECK(snd_seq_set_queue_tempo(out, queue, tempo));
+
+	for (i = 0; i < EVENTS; i++) {
+		snd_seq_ev_clear(&evs[i]);
+		snd_seq_ev_set_source(&evs[i], oport);
+		snd_seq_ev_set_subs(&evs[i]);
+		snd_seq_ev_schedule_tick(&evs[i], queue, 0, 10 + i * 10);
+		snd_seq_ev_set_controller(&evs[i], 0, 7, i & 0x7f);
+	}
+	if (ALSA_CHECK(snd_seq_scheduler_new(&sched, out, queue, 64)) < 0)
+		goto out_close_in;
+	ALSA_CHECK(snd_seq_scheduler_set_events(sched, evs, EVENTS));
+
+	/* the queue is filled up to the watermark, not further */
+	TEST_CHECK(snd_seq_scheduler_fill(sched) == 64);
+	TEST_CHECK(snd_seq_scheduler_fill(sched) == 0);
+	snd_seq_queue_status_alloca(&status);
+	ALSA_CHECK(snd_seq_get_queue_status(out, queue, status));
+	TEST_CHECK(snd_seq_queue_status_get_events(status) == 64);
+	TEST_CHECK(snd_seq_scheduler_pending(sched) == EVENTS - 64);
+
+	ALSA_CHECK(snd_seq_start_queue(out, queue, NULL));
+	ALSA_CHECK(snd_seq_drain_output(out));
+	for (loops = 0; received < EVENTS && loops < 10000; loops++) {
+		TEST_CHECK(snd_seq_scheduler_fill(sched) >= 0);
+		while (snd_seq_event_input(in, &rev) >= 0) {
+			if (rev->type != SND_SEQ_EVENT_CONTROLLER)
+				continue;
+			TEST_CHECK(rev->data.control.value == (received & 0x7f));
+			received++;
+		}
+		usleep(200);
+	}
+	TEST_CHECK(received == EVENTS);
+	TEST_CHECK(snd_seq_scheduler_pending(sched) == 0);
+	TEST_CHECK(snd_seq_scheduler_get_batches(sched) > 1);
+	TEST_CHECK(snd_seq_scheduler_get_late(sched) == 0);
+
+	/* events behind the queue position are counted as late */
+	ALSA_CHECK(snd_seq_scheduler_set_events(sched, evs, 4));
+	TEST_CHECK(snd_seq_scheduler_fill(sched) == 4);
+	TEST_CHECK(snd_seq_scheduler_get_late(sched) == 4);
+	TEST_CHECK(snd_seq_scheduler_get_max_late_tick(sched) > 0);
+
+	snd_seq_scheduler_free(sched);
+ out_close_in:
+	snd_seq_close(in);
+ out_close:
+	snd_seq_close(out);
+ out_free:
+	free(evs);
+}
+
+#define MT_PRODUCERS	4
+#define MT_EVENTS	500
+
+struct mt_producer {
+	snd_seq_t *seq;
+	int port;
+	int id;
+	int err;
+};
+
+static void *mt_produce(void *arg)
+{
+	struct mt_producer *p = arg;
+	snd_seq_event_t ev;
+	int i, err;
+
+	for (i = 0; i < MT_EVENTS; i++) {
+		snd_seq_ev_clear(&ev);
+		snd_seq_ev_set_source(&ev, p->port);
+		snd_seq_ev_set_subs(&ev);
+		snd_seq_ev_set_direct(&ev);
+		snd_seq_ev_set_controller(&ev, 0, p->id, i & 0x7f);
+		err = snd_seq_event_output(p->seq, &ev);
+		if (err < 0 && !p->err)
+			p->err = err;
+	}
+	return NULL;
+}
+
+static void test_output_mt(void)
+{
+	struct mt_producer producers[MT_PRODUCERS];
+	pthread_t threads[MT_PRODUCERS];
+	int next[MT_PRODUCERS] = { 0 };
+	snd_seq_t *out, *in;
+	snd_seq_event_t *rev;
+	int oport, iport, i, received = 0, ordered = 1;
+
+	if (open_loop(&out, 0) < 0)
+		return;
+	if (open_loop(&in, SND_SEQ_NONBLOCK) < 0)
+		goto out_close;
+	oport = ALSA_CHECK(snd_seq_create_simple_port(out, "out",
+			SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ,
+			SND_SEQ_PORT_TYPE_APPLICATION));
+	iport = ALSA_CHECK(snd_seq_create_simple_port(in, "in",
+			SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE,
+			SND_SEQ_PORT_TYPE_APPLICATION));
+	if (oport < 0 || iport < 0)
+		goto out_close_in;
+	ALSA_CHECK(snd_seq_connect_to(out, oport, snd_seq_client_id(in), iport));
+	if (ALSA_CHECK(snd_seq_set_output_mt(out, 1)) < 0)
+		goto out_close_in;
+
+	for (i = 0; i < MT_PRODUCERS; i++) {
+		producers[i].seq = out;
+		producers[i].port = oport;
+		producers[i].id = i;
+		producers[i].err = 0;
+		pthread_create(&threads[i], NULL, mt_produce, &producers[i]);
+	}
+	for (i = 0; i < MT_PRODUCERS; i++) {
+		pthread_join(threads[i], NULL);
+		TEST_CHECK(producers[i].err == 0);
+	}
+	ALSA_CHECK(snd_seq_drain_output(out));
+	TEST_CHECK(snd_seq_event_output_pending(out) == 0);
+
+	/* all events arrive, each producer's in its order */
+	while (snd_seq_event_input(in, &rev) >= 0) {
+		if (rev->type != SND_SEQ_EVENT_CONTROLLER ||
+		    rev->data.control.param >= MT_PRODUCERS)
+			continue;
+		if (rev->data.control.value != (next[rev->data.control.param]++ & 0x7f))
+			ordered = 0;
+		received++;
+	}
+	TEST_CHECK(received == MT_PRODUCERS * MT_EVENTS);
+	TEST_CHECK(ordered);
+	ALSA_CHECK(snd_seq_set_output_mt(out, 0));
+
+ out_close_in:
+	snd_seq_close(in);
+ out_close:
+	snd_seq_close(out);
+}
+
+static void test_buffers(void)
+{
+	snd_seq_t *out, *in;
+	snd_seq_event_t ev, *rev;
+	unsigned char sysex[300];
+	unsigned int allocs;
+	int oport, iport, i, j, got;
+
+	if (open_loop(&out, SND_SEQ_NONBLOCK) < 0)
+		return;
+	if (open_loop(&in, SND_SEQ_NONBLOCK) < 0)
+		goto out_close;
+	oport = ALSA_CHECK(snd_seq_create_simple_port(out, "out",
+			SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ,
+			SND_SEQ_PORT_TYPE_APPLICATION));
+	iport = ALSA_CHECK(snd_seq_create_simple_port(in, "in",
+			SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE,
+			SND_SEQ_PORT_TYPE_APPLICATION));
+	if (oport < 0 || iport < 0)
+		goto out_close_in;
+	ALSA_CHECK(snd_seq_connect_to(out, oport, snd_seq_client_id(in), iport));
+
+	ALSA_CHECK(snd_seq_set_output_buffer_size(out, 16 * sizeof(ev)));
+	ALSA_CHECK(snd_seq_set_input_buffer_size(in, 8 * sizeof(ev)));
+	TEST_CHECK(snd_seq_set_output_buffer_max(out, 8 * sizeof(ev)) == -EINVAL);
+	ALSA_CHECK(snd_seq_set_output_buffer_max(out, 256 * sizeof(ev)));
+	ALSA_CHECK(snd_seq_set_input_buffer_max(in, 64 * sizeof(ev)));
+
+	/* bursts of 100 events grow both buffers, then nothing is allocated */
+	allocs = 0;
+	for (i = 0; i < 8; i++) {
+		if (i == 2)
+			allocs = snd_seq_get_buffer_allocs(out) + snd_seq_get_buffer_allocs(in);
+		for (j = 0; j < 100; j++)
+			send_note(out, oport, j);
+		ALSA_CHECK(snd_seq_drain_output(out));
+		for (got = 0; snd_seq_event_input(in, &rev) >= 0; got++)
+			;
+		TEST_CHECK(got == 100);
+	}
+	TEST_CHECK(snd_seq_get_buffer_allocs(out) + snd_seq_get_buffer_allocs(in) == allocs);
+	TEST_CHECK(snd_seq_get_output_buffer_size(out) >= 100 * sizeof(ev));
+	TEST_CHECK(snd_seq_get_output_buffer_size(out) <= 256 * sizeof(ev));
+	TEST_CHECK(snd_seq_get_input_buffer_size(in) > 8 * sizeof(ev));
+	TEST_CHECK(snd_seq_get_input_buffer_size(in) <= 64 * sizeof(ev));
+
+	/* single events shrink them back to the initial size */
+	for (i = 0; i < 2 * 64; i++) {
+		send_note(out, oport, i & 0x7f);
+		ALSA_CHECK(snd_seq_drain_output(out));
+		TEST_CHECK(snd_seq_event_input(in, &rev) >= 0);
+	}
+	TEST_CHECK(snd_seq_get_output_buffer_size(out) == 16 * sizeof(ev));
+	TEST_CHECK(snd_seq_get_input_buffer_size(in) == 8 * sizeof(ev));
+
+	/* direct SysEx output reuses the staging buffer */
+	memset(sysex, 0x11, sizeof(sysex));
+	sysex[0] = 0xf0;
+	sysex[sizeof(sysex) - 1] = 0xf7;
+	snd_seq_ev_clear(&ev);
+	snd_seq_ev_set_source(&ev, oport);
+	snd_seq_ev_set_subs(&ev);
+	snd_seq_ev_set_direct(&ev);
+	snd_seq_ev_set_sysex(&ev, sizeof(sysex), sysex);
+	for (i = 0; i < 10; i++) {
+		if (i == 1)
+			allocs = snd_seq_get_buffer_allocs(out);
+		ALSA_CHECK(snd_seq_event_output_direct(out, &ev));
+		TEST_CHECK(snd_seq_event_input(in, &rev) >= 0 &&
+			   rev->type == SND_SEQ_EVENT_SYSEX &&
+			   rev->data.ext.len == sizeof(sysex));
+	}
+	TEST_CHECK(snd_seq_get_buffer_allocs(out) == allocs);
+
+ out_close_in:
+	snd_seq_close(in);
+ out_close:
+	snd_seq_close(out);
+}
+
+/* a skewed queue runs faster or slower than the nominal tempo */
+static void test_skew(void)
+{
+	snd_seq_t *seq;
+	snd_seq_queue_tempo_t *tempo;
+	snd_seq_queue_status_t *status;
+	const snd_seq_real_time_t *rt;
+	unsigned long long ns;
+	int queue;
+
+	if (open_loop(&seq, 0) < 0)
+		return;
+	queue = ALSA_CHECK(snd_seq_alloc_queue(seq));
+	if (queue < 0)
+		goto out;
+	snd_seq_queue_tempo_alloca(&tempo);
+	ALSA_CHECK(snd_seq_get_queue_tempo(seq, queue, tempo));
+	TEST_CHECK(snd_seq_queue_tempo_get_skew_base(tempo) == 0x10000);
+	TEST_CHECK(snd_seq_queue_tempo_get_skew(tempo) == 0x10000);
+	/* the kernel only accepts the base 0x10000 */
+	snd_seq_queue_tempo_set_skew_base(tempo, 1000);
+	TEST_CHECK(snd_seq_set_queue_tempo(seq, queue, tempo) == -EINVAL);
+	snd_seq_queue_tempo_set_skew_base(tempo, 0x10000);
+	snd_seq_queue_tempo_set_skew(tempo, 0x40000);
+	ALSA_CHECK(snd_seq_set_queue_tempo(seq, queue, tempo));
+
+	ALSA_CHECK(snd_seq_start_queue(seq, queue, NULL));
+	ALSA_CHECK(snd_seq_drain_output(seq));
+	usleep(50000);
+	snd_seq_queue_status_alloca(&status);
+	ALSA_CHECK(snd_seq_get_queue_status(seq, queue, status));
+	rt = snd_seq_queue_status_get_real_time(status);
+	ns = rt->tv_sec * 1000000000ULL + rt->tv_nsec;
+	/* four times 50 ms, with some slack for a loaded machine */
+	TEST_CHECK(ns >= 180000000ULL);
+	ALSA_CHECK(snd_seq_free_queue(seq, queue));
+ out:
+	snd_seq_close(seq);
+}
+
+int main(void)
+{
+	test_loop();
+	test_input_filter();
+	test_scheduler();
+	test_output_mt();
+	test_buffers();
+	test_skew();
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,157 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "test.h"
+
+/*
+ * The output buffer is a ring of whole events.  These tests bring it to
+ * the wrapped state, where the oldest events are at the end of the
+ * buffer and the newest ones at its start, using the loopback backend.
+ */
+
+#define EVENTS	10	/* the buffer size in events */
+
+static int open_loop(snd_seq_t **seq)
+{
+	static const char conf[] = "seq.obuftest { type loop }";
+	snd_config_t *top;
+	int err;
+
+	err = load_config(&top, conf);
+	if (err < 0)
+		return err;
+	err = ALSA_CHECK(snd_seq_open_lconf(seq, "obuftest", SND_SEQ_OPEN_OUTPUT,
+					    SND_SEQ_NONBLOCK, top));
+	snd_config_delete(top);
+	if (err < 0)
+		return err;
+	err = ALSA_CHECK(snd_seq_set_output_buffer_size(*seq,
+				EVENTS * sizeof(snd_seq_event_t)));
+	if (err < 0)
+		snd_seq_close(*seq);
+	return err;
+}
+
+/* a direct note, or one scheduled on a queue which does not exist */
+static void output_note(snd_seq_t *seq, int note, int bad_queue)
+{
+	snd_seq_event_t ev;
+
+	snd_seq_ev_clear(&ev);
+	snd_seq_ev_set_subs(&ev);
+	if (bad_queue)
+		snd_seq_ev_schedule_tick(&ev, 200, 0, 0);
+	else
+		snd_seq_ev_set_direct(&ev);
+	snd_seq_ev_set_noteon(&ev, 0, note, 100);
+	snd_seq_ev_set_tag(&ev, note & 1);
+	TEST_CHECK(snd_seq_event_output_buffer(seq, &ev) > 0);
+}
+
+static int extract_note(snd_seq_t *seq)
+{
+	snd_seq_event_t *ev;
+
+	if (snd_seq_extract_output(seq, &ev) < 0 || !ev)
+		return -1;
+	return ev->data.note.note;
+}
+
+/*
+ * Leave notes first..first+6 in the buffer: five at the end of the
+ * buffer and two wrapped to its start.  With bad >= 0, that note is
+ * scheduled on a missing queue.
+ */
+static void fill_wrapped(snd_seq_t *seq, int first, int bad)
+{
+	int note;
+
+	for (note = first - 5; note < first + 3; note++)
+		output_note(seq, note, note == bad);
+	for (note = first - 5; note < first; note++)
+		TEST_CHECK(extract_note(seq) == note);
+	for (note = first + 3; note < first + 7; note++)
+		output_note(seq, note, note == bad);
+	TEST_CHECK(snd_seq_event_output_pending(seq) ==
+		   (int)(7 * sizeof(snd_seq_event_t)));
+}
+
+static void test_extract(snd_seq_t *seq)
+{
+	int note;
+
+	fill_wrapped(seq, 10, -1);
+	for (note = 10; note < 17; note++)
+		TEST_CHECK(extract_note(seq) == note);
+	TEST_CHECK(snd_seq_extract_output(seq, NULL) == -ENOENT);
+	TEST_CHECK(snd_seq_event_output_pending(seq) == 0);
+}
+
+static void test_remove(snd_seq_t *seq)
+{
+	snd_seq_remove_events_t *rm;
+	int note;
+
+	snd_seq_remove_events_alloca(&rm);
+	snd_seq_remove_events_set_condition(rm, SND_SEQ_REMOVE_OUTPUT |
+					    SND_SEQ_REMOVE_TAG_MATCH);
+	snd_seq_remove_events_set_tag(rm, 1);
+
+	/* odd notes on both sides of the wrap */
+	fill_wrapped(seq, 20, -1);
+	ALSA_CHECK(snd_seq_remove_events(seq, rm));
+	for (note = 20; note < 27; note += 2)
+		TEST_CHECK(extract_note(seq) == note);
+	TEST_CHECK(extract_note(seq) < 0);
+
+	/* all events on both sides of the wrap go */
+	fill_wrapped(seq, 30, -1);
+	snd_seq_remove_events_set_condition(rm, SND_SEQ_REMOVE_OUTPUT |
+					    SND_SEQ_REMOVE_DEST_CHANNEL);
+	snd_seq_remove_events_set_channel(rm, 0);
+	ALSA_CHECK(snd_seq_remove_events(seq, rm));
+	TEST_CHECK(snd_seq_event_output_pending(seq) == 0);
+	TEST_CHECK(extract_note(seq) < 0);
+	fill_wrapped(seq, 40, -1);
+	while (extract_note(seq) >= 0)
+		;
+}
+
+static void test_drain(snd_seq_t *seq)
+{
+	/* everything is written, in two steps across the wrap */
+	fill_wrapped(seq, 50, -1);
+	TEST_CHECK(snd_seq_drain_output(seq) == 0);
+	TEST_CHECK(snd_seq_event_output_pending(seq) == 0);
+
+	/*
+	 * the write stops at the note for the missing queue: the notes
+	 * before it are consumed, it and the following ones stay
+	 */
+	fill_wrapped(seq, 60, 66);
+	TEST_CHECK(snd_seq_drain_output(seq) == -EINVAL);
+	TEST_CHECK(snd_seq_event_output_pending(seq) ==
+		   (int)sizeof(snd_seq_event_t));
+	TEST_CHECK(extract_note(seq) == 66);
+
+	fill_wrapped(seq, 70, 75);
+	TEST_CHECK(snd_seq_drain_output(seq) == -EINVAL);
+	TEST_CHECK(snd_seq_event_output_pending(seq) ==
+		   (int)(2 * sizeof(snd_seq_event_t)));
+	TEST_CHECK(extract_note(seq) == 75);
+	TEST_CHECK(snd_seq_drain_output(seq) == 0);
+	TEST_CHECK(snd_seq_event_output_pending(seq) == 0);
+}
+
+int main(void)
+{
+	snd_seq_t *seq;
+
+	if (open_loop(&seq) < 0)
+		return TEST_EXIT_CODE();
+	test_extract(seq);
+	test_remove(seq);
+	test_drain(seq);
+	snd_seq_close(seq);
+	return TEST_EXIT_CODE();
+}
@@ -26,4 +26,23 @@ static int any_test_failed;
 
 #define TEST_EXIT_CODE() any_test_failed
 
+/* parse a configuration string, the tree is freed with snd_config_delete() */
+static inline int load_config(snd_config_t **top, const char *conf)
+{
+	snd_input_t *in;
+	int err;
+
+	err = ALSA_CHECK(snd_config_top(top));
+	if (err < 0)
+		return err;
+	err = ALSA_CHECK(snd_input_buffer_open(&in, conf, -1));
+	if (err >= 0) {
+		err = ALSA_CHECK(snd_config_load(*top, in));
+		snd_input_close(in);
+	}
+	if (err < 0)
+		snd_config_delete(*top);
+	return err;
+}
+
 #endif
@@ -0,0 +1,142 @@
+#include <stdlib.h>
+#include <errno.h>
+#include <sound/tlv.h>
+#include "test.h"
+
+/*
+ * Checks that the table based conversions give exactly the same results as
+ * the plain TLV functions, over the whole raw range and a dB sweep.
+ */
+static void check_table(unsigned int *tlv, long rangemin, long rangemax)
+{
+	snd_tlv_dB_table_t *table;
+	long v, db, dbmin, dbmax, r1, r2;
+	int xdir, e1, e2;
+
+	if (ALSA_CHECK(snd_tlv_dB_table_new(&table, tlv, rangemin, rangemax)) < 0)
+		return;
+
+	for (v = rangemin - 2; v <= rangemax + 2; v++) {
+		r1 = r2 = 0;
+		e1 = snd_tlv_convert_to_dB(tlv, rangemin, rangemax, v, &r1);
+		e2 = snd_tlv_dB_table_to_dB(table, v, &r2);
+		TEST_CHECK(e1 == e2);
+		TEST_CHECK(e1 < 0 || r1 == r2);
+	}
+
+	if (snd_tlv_get_dB_range(tlv, rangemin, rangemax, &dbmin, &dbmax) < 0)
+		goto out;
+	if (dbmin < -20000)
+		dbmin = -20000;
+	for (db = dbmin - 150; db <= dbmax + 150; db++) {
+		for (xdir = -1; xdir <= 1; xdir++) {
+			r1 = r2 = 0;
+			e1 = snd_tlv_convert_from_dB(tlv, rangemin, rangemax,
+						     db, &r1, xdir);
+			e2 = snd_tlv_dB_table_from_dB(table, db, &r2, xdir);
+			TEST_CHECK(e1 == e2);
+			TEST_CHECK(e1 < 0 || r1 == r2);
+		}
+	}
+	e1 = snd_tlv_convert_from_dB(tlv, rangemin, rangemax,
+				     SND_CTL_TLV_DB_GAIN_MUTE, &r1, 1);
+	e2 = snd_tlv_dB_table_from_dB(table, SND_CTL_TLV_DB_GAIN_MUTE, &r2, 1);
+	TEST_CHECK(e1 == e2);
+	TEST_CHECK(e1 < 0 || r1 == r2);
+ out:
+	snd_tlv_dB_table_free(table);
+}
+
+static void test_scale(void)
+{
+	unsigned int tlv[] = {
+		SND_CTL_TLVT_DB_SCALE, 2 * sizeof(int),
+		(unsigned int)-4650, 150
+	};
+	unsigned int tlv_mute[] = {
+		SND_CTL_TLVT_DB_SCALE, 2 * sizeof(int),
+		(unsigned int)-6000, 0x10000 | 75
+	};
+
+	check_table(tlv, 0, 31);
+	check_table(tlv_mute, 0, 80);
+	check_table(tlv_mute, -10, 10);
+}
+
+static void test_minmax(void)
+{
+	unsigned int tlv[] = {
+		SND_CTL_TLVT_DB_MINMAX, 2 * sizeof(int),
+		(unsigned int)-5100, 0
+	};
+	unsigned int tlv_mute[] = {
+		SND_CTL_TLVT_DB_MINMAX_MUTE, 2 * sizeof(int),
+		(unsigned int)-9000, 600
+	};
+
+	check_table(tlv, 0, 255);
+	check_table(tlv_mute, 0, 17);
+}
+
+static void test_linear(void)
+{
+	unsigned int tlv[] = {
+		SND_CTL_TLVT_DB_LINEAR, 2 * sizeof(int),
+		(unsigned int)-4000, 0
+	};
+	unsigned int tlv_mute[] = {
+		SND_CTL_TLVT_DB_LINEAR, 2 * sizeof(int),
+		(unsigned int)SND_CTL_TLV_DB_GAIN_MUTE, 1200
+	};
+
+	check_table(tlv, 0, 100);
+	check_table(tlv_mute, 0, 1000);
+}
+
+static void test_range(void)
+{
+	unsigned int tlv[] = {
+		SND_CTL_TLVT_DB_RANGE, 12 * sizeof(int),
+		0, 3,
+		SND_CTL_TLVT_DB_SCALE, 2 * sizeof(int),
+		(unsigned int)-9000, 0x10000 | 1000,
+		4, 40,
+		SND_CTL_TLVT_DB_MINMAX, 2 * sizeof(int),
+		(unsigned int)-6000, 0,
+	};
+	unsigned int tlv_gap[] = {
+		SND_CTL_TLVT_DB_RANGE, 12 * sizeof(int),
+		0, 9,
+		SND_CTL_TLVT_DB_SCALE, 2 * sizeof(int),
+		(unsigned int)-5000, 200,
+		12, 20,
+		SND_CTL_TLVT_DB_LINEAR, 2 * sizeof(int),
+		(unsigned int)-2000, 500,
+	};
+
+	check_table(tlv, 0, 40);
+	/* the range is clipped in the middle of the second item */
+	check_table(tlv, 0, 20);
+	check_table(tlv_gap, 0, 20);
+}
+
+static void test_big_range(void)
+{
+	unsigned int tlv[] = {
+		SND_CTL_TLVT_DB_MINMAX, 2 * sizeof(int),
+		(unsigned int)-12000, 1200
+	};
+
+	/* too big for the value array, falls back to the TLV path */
+	check_table(tlv, 0, 200000);
+}
+
+int main(void)
+{
+	test_scale();
+	test_minmax();
+	test_linear();
+	test_range();
+	test_big_range();
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,210 @@
+/*
+ * Benchmark for the PCM area copy and silence helpers
+ *
+ * Measures snd_pcm_areas_copy() for transposes between interleaved and
+ * non-interleaved buffers, comparing it with copying every channel by
+ * snd_pcm_area_copy() (the generic strided loop), and large contiguous
+ * copies and silence fills against plain memcpy() and memset().
+ * The results of every fast path are checked against the reference.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <alsa/asoundlib.h>
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void usage(void)
+{
+	printf("Usage: pcm-areas-bench [OPTION]...\n"
+	       "-h,--help      help\n"
+	       "-f,--frames    frames per copy (default 4096)\n"
+	       "-l,--loops     copies per measurement (default 2000)\n"
+	       "-b,--big       bytes of the contiguous copies (default 4M)\n");
+}
+
+static void setup(snd_pcm_channel_area_t *areas, char *buf, unsigned int chns,
+		  int width, int interleaved, snd_pcm_uframes_t frames)
+{
+	unsigned int c;
+
+	for (c = 0; c < chns; c++) {
+		areas[c].addr = buf;
+		if (interleaved) {
+			areas[c].first = c * width;
+			areas[c].step = chns * width;
+		} else {
+			areas[c].first = c * frames * width;
+			areas[c].step = width;
+		}
+	}
+}
+
+static int bench_transpose(unsigned int chns, snd_pcm_format_t format,
+			   int interleave, snd_pcm_uframes_t frames, int loops)
+{
+	int width = snd_pcm_format_physical_width(format);
+	size_t bytes = chns * frames * width / 8;
+	snd_pcm_channel_area_t src[8], dst[8];
+	char *sbuf, *dbuf, *rbuf;
+	long long t0, t1, t2;
+	unsigned int c;
+	size_t i;
+	int l, err = 0;
+
+	sbuf = malloc(bytes);
+	dbuf = malloc(bytes);
+	rbuf = malloc(bytes);
+	if (!sbuf || !dbuf || !rbuf) {
+		free(sbuf);
+		free(dbuf);
+		free(rbuf);
+		return -1;
+	}
+	for (i = 0; i < bytes; i++)
+		sbuf[i] = rand();
+	setup(src, sbuf, chns, width, !interleave, frames);
+	t0 = now_ns();
+	setup(dst, rbuf, chns, width, interleave, frames);
+	for (l = 0; l < loops; l++)
+		for (c = 0; c < chns; c++)
+			snd_pcm_area_copy(&dst[c], 0, &src[c], 0, frames, format);
+	t1 = now_ns();
+	setup(dst, dbuf, chns, width, interleave, frames);
+	for (l = 0; l < loops; l++)
+		snd_pcm_areas_copy(dst, 0, src, 0, chns, frames, format);
+	t2 = now_ns();
+	if (memcmp(dbuf, rbuf, bytes)) {
+		printf("MISMATCH ");
+		err = -1;
+	}
+	printf("%-13s %u ch %2d bit: %7.3f -> %7.3f ns/frame (x%.1f)\n",
+	       interleave ? "interleave" : "deinterleave", chns, width,
+	       (double)(t1 - t0) / loops / frames,
+	       (double)(t2 - t1) / loops / frames,
+	       (double)(t1 - t0) / (t2 - t1));
+	free(sbuf);
+	free(dbuf);
+	free(rbuf);
+	return err;
+}
+
+static int bench_big(size_t bytes, int loops)
+{
+	snd_pcm_uframes_t frames = bytes / 4;
+	snd_pcm_channel_area_t src[2], dst[2];
+	char *sbuf, *dbuf;
+	long long t0, t1, t2;
+	size_t i;
+	int l, err = 0;
+
+	sbuf = malloc(bytes + 64);
+	dbuf = malloc(bytes + 64);
+	if (!sbuf || !dbuf) {
+		free(sbuf);
+		free(dbuf);
+		return -1;
+	}
+	for (i = 0; i < bytes + 64; i++)
+		sbuf[i] = rand();
+	/* an offset off the vector alignment exercises the head and tail */
+	setup(src, sbuf + 8, 2, 16, 1, frames);
+	setup(dst, dbuf + 8, 2, 16, 1, frames);
+	t0 = now_ns();
+	for (l = 0; l < loops; l++)
+		memcpy(dbuf + 8, sbuf + 8, bytes);
+	t1 = now_ns();
+	for (l = 0; l < loops; l++)
+		snd_pcm_areas_copy(dst, 0, src, 0, 2, frames, SND_PCM_FORMAT_S16_LE);
+	t2 = now_ns();
+	if (memcmp(dbuf + 8, sbuf + 8, bytes)) {
+		printf("MISMATCH ");
+		err = -1;
+	}
+	printf("copy %zu bytes:    memcpy %7.3f GB/s, areas_copy %7.3f GB/s\n",
+	       bytes, (double)bytes * loops / (t1 - t0),
+	       (double)bytes * loops / (t2 - t1));
+	t0 = now_ns();
+	for (l = 0; l < loops; l++)
+		memset(dbuf + 8, 0, bytes);
+	t1 = now_ns();
+	memset(dbuf, 0x55, bytes + 64);
+	for (l = 0; l < loops; l++)
+		snd_pcm_areas_silence(dst, 0, 2, frames, SND_PCM_FORMAT_S16_LE);
+	t2 = now_ns();
+	for (i = 0; i < bytes; i++)
+		if (dbuf[i + 8]) {
+			printf("MISMATCH ");
+			err = -1;
+			break;
+		}
+	if (dbuf[7] != 0x55 || dbuf[bytes + 8] != 0x55) {
+		printf("OVERRUN ");
+		err = -1;
+	}
+	printf("silence %zu bytes: memset %7.3f GB/s, areas_silence %7.3f GB/s\n",
+	       bytes, (double)bytes * loops / (t1 - t0),
+	       (double)bytes * loops / (t2 - t1));
+	free(sbuf);
+	free(dbuf);
+	return err;
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_option[] = {
+		{"help", 0, NULL, 'h'},
+		{"frames", 1, NULL, 'f'},
+		{"loops", 1, NULL, 'l'},
+		{"big", 1, NULL, 'b'},
+		{NULL, 0, NULL, 0},
+	};
+	static const snd_pcm_format_t formats[] = {
+		SND_PCM_FORMAT_S16_LE, SND_PCM_FORMAT_S32_LE,
+	};
+	snd_pcm_uframes_t frames = 4096;
+	size_t big = 4 * 1024 * 1024;
+	int loops = 2000, err = 0;
+	unsigned int chns, f;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "hf:l:b:", long_option, NULL)) >= 0) {
+		switch (c) {
+		case 'h':
+			usage();
+			return 0;
+		case 'f':
+			frames = atol(optarg);
+			break;
+		case 'l':
+			loops = atoi(optarg);
+			break;
+		case 'b':
+			big = atol(optarg);
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	if (frames < 1 || loops < 1 || big < 64) {
+		usage();
+		return 1;
+	}
+	for (f = 0; f < sizeof(formats) / sizeof(formats[0]); f++)
+		for (chns = 2; chns <= 8; chns += 2) {
+			err |= bench_transpose(chns, formats[f], 1, frames, loops);
+			err |= bench_transpose(chns, formats[f], 0, frames, loops);
+		}
+	err |= bench_big(big, loops / 100 + 1);
+	return err ? 1 : 0;
+}
@@ -0,0 +1,142 @@
+/*
+ * Benchmark for the per-call overhead of the PCM locks
+ *
+ * Opens a PCM once normally and once with SND_PCM_SINGLE_THREAD and
+ * measures the time per call of snd_pcm_avail_update(), snd_pcm_avail()
+ * and snd_pcm_state().  Without a device name, a null PCM (optionally
+ * below a plug and a linear plugin, to show a plugin chain) defined in
+ * a local configuration is used, so no sound card is needed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <alsa/asoundlib.h>
+
+static const char *chain_conf =
+	"pcm.locktest { type plug slave.pcm { type linear"
+	" slave { pcm { type null } format S32_LE } } }";
+static const char *null_conf = "pcm.locktest { type null }";
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void usage(void)
+{
+	printf("Usage: pcm-lock-bench [OPTION]...\n"
+	       "-h,--help      help\n"
+	       "-D,--device    PCM device (default: local null PCM)\n"
+	       "-c,--chain     use a plug/linear chain above the local null PCM\n"
+	       "-l,--loops     calls per measurement (default 1000000)\n");
+}
+
+static int open_pcm(snd_pcm_t **pcm, const char *device, int chain, int mode)
+{
+	snd_config_t *top;
+	snd_input_t *in;
+	int err;
+
+	if (device)
+		return snd_pcm_open(pcm, device, SND_PCM_STREAM_PLAYBACK, mode);
+	err = snd_config_top(&top);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&in, chain ? chain_conf : null_conf, -1);
+	if (err >= 0) {
+		err = snd_config_load(top, in);
+		snd_input_close(in);
+	}
+	if (err >= 0)
+		err = snd_pcm_open_lconf(pcm, "locktest", SND_PCM_STREAM_PLAYBACK,
+					 mode, top);
+	snd_config_delete(top);
+	return err;
+}
+
+static int bench(const char *device, int chain, int mode, long loops)
+{
+	snd_pcm_t *pcm;
+	long long t0, t1, t2, t3;
+	long i;
+	int err;
+
+	err = open_pcm(&pcm, device, chain, mode);
+	if (err < 0) {
+		printf("open failed: %s\n", snd_strerror(err));
+		return err;
+	}
+	err = snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16_LE,
+				 SND_PCM_ACCESS_RW_INTERLEAVED,
+				 2, 48000, 1, 500000);
+	if (err < 0) {
+		printf("setup failed: %s\n", snd_strerror(err));
+		snd_pcm_close(pcm);
+		return err;
+	}
+	t0 = now_ns();
+	for (i = 0; i < loops; i++)
+		snd_pcm_avail_update(pcm);
+	t1 = now_ns();
+	for (i = 0; i < loops; i++)
+		snd_pcm_avail(pcm);
+	t2 = now_ns();
+	for (i = 0; i < loops; i++)
+		snd_pcm_state(pcm);
+	t3 = now_ns();
+	printf("%-14s avail_update %6.1f ns, avail %6.1f ns, state %6.1f ns\n",
+	       mode & SND_PCM_SINGLE_THREAD ? "single thread:" : "locked:",
+	       (double)(t1 - t0) / loops, (double)(t2 - t1) / loops,
+	       (double)(t3 - t2) / loops);
+	snd_pcm_close(pcm);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_option[] = {
+		{"help", 0, NULL, 'h'},
+		{"device", 1, NULL, 'D'},
+		{"chain", 0, NULL, 'c'},
+		{"loops", 1, NULL, 'l'},
+		{NULL, 0, NULL, 0},
+	};
+	const char *device = NULL;
+	long loops = 1000000;
+	int chain = 0;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "hD:cl:", long_option, NULL)) >= 0) {
+		switch (c) {
+		case 'h':
+			usage();
+			return 0;
+		case 'D':
+			device = optarg;
+			break;
+		case 'c':
+			chain = 1;
+			break;
+		case 'l':
+			loops = atol(optarg);
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	if (loops < 1) {
+		usage();
+		return 1;
+	}
+	if (bench(device, chain, 0, loops) < 0 ||
+	    bench(device, chain, SND_PCM_SINGLE_THREAD, loops) < 0)
+		return 1;
+	return 0;
+}
@@ -0,0 +1,526 @@
+/*
+ * Benchmark suite for sequencer clients on the loopback backend
+ *
+ * Opens two clients on an in-process sequencer ("loop" by default), so
+ * no sound card or /dev/snd/seq is needed, and measures:
+ *  - throughput of short events, arrays of events and SysEx events
+ *    written by a sender thread and read by the main thread,
+ *  - latency percentiles of direct events from write to read,
+ *  - lateness of events scheduled on a queue,
+ *  - scaling of several producer threads sharing one output handle,
+ *    serialized by a mutex or using the multi-producer output mode,
+ *  - snd_midi_event encoding and decoding rates.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <alsa/asoundlib.h>
+
+struct bench {
+	snd_seq_t *out;
+	snd_seq_t *in;
+	int oport;
+	int iport;
+	unsigned long events;
+	unsigned long array;
+	size_t sysex;
+	long long *stamps;	/* latency samples in ns */
+	unsigned long window;	/* max. events in flight */
+	unsigned long received;	/* updated by the receiver */
+};
+
+static void usage(void)
+{
+	printf("Usage: seq-loop-bench [options]\n"
+	       "  -D, --device=NAME       sequencer device (loop)\n"
+	       "  -n, --events=N          number of events per case (200000)\n"
+	       "  -a, --array=N           events per array (64)\n"
+	       "  -s, --sysex=BYTES       SysEx size (256)\n"
+	       "  -l, --latency=N         latency samples (20000)\n");
+}
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int wait_fd(snd_seq_t *seq, short events)
+{
+	struct pollfd pfd;
+
+	snd_seq_poll_descriptors(seq, &pfd, 1, events);
+	return poll(&pfd, 1, 1000);
+}
+
+static int flush_output(snd_seq_t *seq)
+{
+	int err;
+
+	while ((err = snd_seq_drain_output(seq)) == -EAGAIN)
+		wait_fd(seq, POLLOUT);
+	return err < 0 ? err : 0;
+}
+
+static int output_event(snd_seq_t *seq, snd_seq_event_t *ev)
+{
+	int err;
+
+	while ((err = snd_seq_event_output_buffer(seq, ev)) == -EAGAIN) {
+		err = flush_output(seq);
+		if (err < 0)
+			return err;
+	}
+	return err < 0 ? err : 0;
+}
+
+/* keep the receiver FIFO from overflowing */
+static int throttle(struct bench *b, unsigned long sent)
+{
+	int err;
+
+	if (sent - __atomic_load_n(&b->received, __ATOMIC_ACQUIRE) < b->window)
+		return 0;
+	err = flush_output(b->out);
+	if (err < 0)
+		return err;
+	while (sent - __atomic_load_n(&b->received, __ATOMIC_ACQUIRE) >= b->window)
+		sched_yield();
+	return 0;
+}
+
+static void init_event(struct bench *b, snd_seq_event_t *ev, unsigned long idx)
+{
+	snd_seq_ev_clear(ev);
+	snd_seq_ev_set_source(ev, b->oport);
+	snd_seq_ev_set_subs(ev);
+	snd_seq_ev_set_direct(ev);
+	snd_seq_ev_set_noteon(ev, 0, idx & 0x7f, 64);
+}
+
+static void *send_short(void *arg)
+{
+	struct bench *b = arg;
+	snd_seq_event_t ev;
+	unsigned long i;
+
+	for (i = 0; i < b->events; i++) {
+		init_event(b, &ev, i);
+		if (throttle(b, i) < 0 || output_event(b->out, &ev) < 0)
+			break;
+	}
+	flush_output(b->out);
+	return NULL;
+}
+
+static void *send_array(void *arg)
+{
+	struct bench *b = arg;
+	snd_seq_event_t *evs;
+	unsigned long i, j, done;
+	int err = 0;
+
+	evs = calloc(b->array, sizeof(*evs));
+	if (!evs)
+		return NULL;
+	for (i = 0; i < b->events && err >= 0; i += j) {
+		for (j = 0; j < b->array && i + j < b->events; j++)
+			init_event(b, &evs[j], i + j);
+		err = throttle(b, i + j);
+		if (err < 0)
+			break;
+		for (done = 0; done < j; ) {
+			err = snd_seq_event_output_array(b->out, evs + done, j - done);
+			if (err == -EAGAIN)
+				err = flush_output(b->out);
+			else if (err > 0)
+				done += err;
+			if (err < 0)
+				break;
+		}
+	}
+	flush_output(b->out);
+	free(evs);
+	return NULL;
+}
+
+static void *send_sysex(void *arg)
+{
+	struct bench *b = arg;
+	snd_seq_event_t ev;
+	unsigned char *data;
+	unsigned long i;
+
+	data = malloc(b->sysex);
+	if (!data)
+		return NULL;
+	memset(data, 0x10, b->sysex);
+	data[0] = 0xf0;
+	data[b->sysex - 1] = 0xf7;
+	for (i = 0; i < b->events; i++) {
+		init_event(b, &ev, i);
+		snd_seq_ev_set_sysex(&ev, b->sysex, data);
+		if (throttle(b, i) < 0 || output_event(b->out, &ev) < 0)
+			break;
+	}
+	flush_output(b->out);
+	free(data);
+	return NULL;
+}
+
+/* receive the given number of events, returns the number of lost events */
+static unsigned long receive(struct bench *b, unsigned long events)
+{
+	snd_seq_client_info_t *info;
+	snd_seq_event_t *ev;
+	unsigned long got = 0, lost = 0, base;
+	int err;
+
+	snd_seq_client_info_alloca(&info);
+	snd_seq_get_client_info(b->in, info);
+	base = snd_seq_client_info_get_event_lost(info);
+	while (got + lost < events) {
+		err = snd_seq_event_input(b->in, &ev);
+		if (err == -EAGAIN) {
+			if (!wait_fd(b->in, POLLIN))
+				break;		/* the sender gave up */
+			continue;
+		}
+		if (err == -ENOSPC) {
+			snd_seq_get_client_info(b->in, info);
+			lost = snd_seq_client_info_get_event_lost(info) - base;
+			continue;
+		}
+		if (err < 0)
+			break;
+		__atomic_store_n(&b->received, ++got, __ATOMIC_RELEASE);
+	}
+	return lost;
+}
+
+static void run_throughput(struct bench *b, const char *name,
+			   void *(*sender)(void *), size_t size)
+{
+	snd_seq_client_pool_t *pool;
+	pthread_t thread;
+	long long start, end;
+	unsigned long lost, cells;
+
+	/* allow half of the input pool in flight */
+	snd_seq_client_pool_alloca(&pool);
+	snd_seq_get_client_pool(b->in, pool);
+	cells = (size + sizeof(snd_seq_event_t) - 1) / sizeof(snd_seq_event_t);
+	b->window = snd_seq_client_pool_get_input_pool(pool) / cells / 2;
+	if (!b->window)
+		b->window = 1;
+	b->received = 0;
+	start = now_ns();
+	if (pthread_create(&thread, NULL, sender, b))
+		return;
+	lost = receive(b, b->events);
+	pthread_join(thread, NULL);
+	end = now_ns();
+	printf("%-12s %8lu events in %7.3f ms: %10.0f events/s, %lu lost\n",
+	       name, b->events, (end - start) / 1e6,
+	       b->events * 1e9 / (end - start), lost);
+}
+
+static int cmp_ll(const void *a, const void *b)
+{
+	long long x = *(const long long *)a, y = *(const long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void print_percentiles(const char *name, long long *samples,
+			      unsigned long count)
+{
+	static const double pcts[] = { 50, 90, 99, 99.9 };
+	unsigned int i;
+
+	if (!count)
+		return;
+	qsort(samples, count, sizeof(*samples), cmp_ll);
+	printf("%-12s", name);
+	for (i = 0; i < sizeof(pcts) / sizeof(pcts[0]); i++)
+		printf(" p%g %6.2f us", pcts[i],
+		       samples[(unsigned long)(count * pcts[i] / 100)] / 1e3);
+	printf(" max %6.2f us\n", samples[count - 1] / 1e3);
+}
+
+/* ping one timestamped event at a time through the sequencer */
+static void run_latency(struct bench *b, unsigned long count)
+{
+	snd_seq_event_t ev, *rev;
+	long long sent;
+	unsigned long i;
+	int err;
+
+	for (i = 0; i < count; i++) {
+		snd_seq_ev_clear(&ev);
+		snd_seq_ev_set_source(&ev, b->oport);
+		snd_seq_ev_set_subs(&ev);
+		snd_seq_ev_set_direct(&ev);
+		ev.type = SND_SEQ_EVENT_USR0;
+		sent = now_ns();
+		memcpy(ev.data.raw8.d, &sent, sizeof(sent));
+		if (snd_seq_event_output_direct(b->out, &ev) < 0)
+			break;
+		while ((err = snd_seq_event_input(b->in, &rev)) == -EAGAIN)
+			wait_fd(b->in, POLLIN);
+		if (err < 0)
+			break;
+		memcpy(&sent, rev->data.raw8.d, sizeof(sent));
+		b->stamps[i] = now_ns() - sent;
+	}
+	print_percentiles("latency", b->stamps, i);
+}
+
+/* schedule events on a running queue and measure how late they arrive */
+static void run_queue(struct bench *b, unsigned long count)
+{
+	snd_seq_event_t ev, *rev;
+	snd_seq_real_time_t t;
+	long long start, due;
+	unsigned long i;
+	int queue, err;
+
+	queue = snd_seq_alloc_queue(b->out);
+	if (queue < 0)
+		return;
+	snd_seq_start_queue(b->out, queue, NULL);
+	flush_output(b->out);
+	start = now_ns();
+	for (i = 0; i < count; i++) {
+		snd_seq_ev_clear(&ev);
+		snd_seq_ev_set_source(&ev, b->oport);
+		snd_seq_ev_set_subs(&ev);
+		due = 1000000 + i * 100000;	/* one every 100 us after 1 ms */
+		t.tv_sec = due / 1000000000;
+		t.tv_nsec = due % 1000000000;
+		snd_seq_ev_schedule_real(&ev, queue, 0, &t);
+		ev.type = SND_SEQ_EVENT_USR1;
+		if (output_event(b->out, &ev) < 0)
+			break;
+	}
+	flush_output(b->out);
+	for (i = 0; i < count; i++) {
+		while ((err = snd_seq_event_input(b->in, &rev)) == -EAGAIN)
+			wait_fd(b->in, POLLIN);
+		if (err < 0)
+			break;
+		due = rev->time.time.tv_sec * 1000000000LL + rev->time.time.tv_nsec;
+		b->stamps[i] = now_ns() - start - due;
+	}
+	print_percentiles("queue late", b->stamps, i);
+	snd_seq_free_queue(b->out, queue);
+}
+
+struct producer {
+	snd_seq_t *seq;
+	int port;
+	unsigned long events;
+	pthread_mutex_t *lock;	/* NULL in the multi-producer mode */
+};
+
+static void *produce(void *arg)
+{
+	struct producer *p = arg;
+	snd_seq_event_t ev;
+	unsigned long i;
+
+	for (i = 0; i < p->events; i++) {
+		snd_seq_ev_clear(&ev);
+		snd_seq_ev_set_source(&ev, p->port);
+		snd_seq_ev_set_subs(&ev);
+		snd_seq_ev_set_direct(&ev);
+		snd_seq_ev_set_noteon(&ev, 0, i & 0x7f, 64);
+		if (p->lock)
+			pthread_mutex_lock(p->lock);
+		while (snd_seq_event_output(p->seq, &ev) == -EAGAIN)
+			wait_fd(p->seq, POLLOUT);
+		if (p->lock)
+			pthread_mutex_unlock(p->lock);
+	}
+	return NULL;
+}
+
+/* producers write to a port without subscribers, only the output path is measured */
+static void run_producers(struct bench *b, int mt)
+{
+	static const unsigned int counts[] = { 1, 2, 4, 8 };
+	struct producer p[8];
+	pthread_t threads[8];
+	pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+	long long start, end;
+	unsigned int i, n, c;
+	int port;
+
+	port = snd_seq_create_simple_port(b->out, "sink", SND_SEQ_PORT_CAP_READ,
+					  SND_SEQ_PORT_TYPE_APPLICATION);
+	if (port < 0)
+		return;
+	if (mt && snd_seq_set_output_mt(b->out, 1) < 0)
+		goto out;
+	for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+		n = counts[c];
+		start = now_ns();
+		for (i = 0; i < n; i++) {
+			p[i].seq = b->out;
+			p[i].port = port;
+			p[i].events = b->events / n;
+			p[i].lock = mt ? NULL : &lock;
+			pthread_create(&threads[i], NULL, produce, &p[i]);
+		}
+		for (i = 0; i < n; i++)
+			pthread_join(threads[i], NULL);
+		flush_output(b->out);
+		end = now_ns();
+		printf("%-8s %u thr %8lu events in %7.3f ms: %10.0f events/s\n",
+		       mt ? "mt" : "mutex", n, b->events / n * n, (end - start) / 1e6,
+		       b->events / n * n * 1e9 / (end - start));
+	}
+	if (mt)
+		snd_seq_set_output_mt(b->out, 0);
+ out:
+	snd_seq_delete_simple_port(b->out, port);
+}
+
+static void run_midi_event(unsigned long count)
+{
+	static const unsigned char msgs[] = {
+		0x90, 0x3c, 0x40, 0x80, 0x3c, 0x00, 0xb0, 0x07, 0x64,
+		0xe0, 0x00, 0x40, 0xc0, 0x05, 0xd0, 0x20,
+	};
+	unsigned char buf[16];
+	snd_midi_event_t *dev;
+	snd_seq_event_t ev;
+	long long start, end;
+	unsigned long i, n = 0;
+	long len;
+
+	if (snd_midi_event_new(256, &dev) < 0)
+		return;
+	start = now_ns();
+	for (i = 0; i < count; i++) {
+		snd_midi_event_reset_encode(dev);
+		for (len = 0; len < (long)sizeof(msgs); ) {
+			long r = snd_midi_event_encode(dev, msgs + len, sizeof(msgs) - len, &ev);
+			if (r <= 0)
+				break;
+			len += r;
+			if (ev.type != SND_SEQ_EVENT_NONE)
+				n++;
+		}
+	}
+	end = now_ns();
+	printf("%-12s %8lu events in %7.3f ms: %10.0f events/s\n", "encode",
+	       n, (end - start) / 1e6, n * 1e9 / (end - start));
+
+	snd_seq_ev_clear(&ev);
+	snd_seq_ev_set_noteon(&ev, 0, 60, 64);
+	start = now_ns();
+	for (i = 0; i < count * 6; i++)
+		snd_midi_event_decode(dev, buf, sizeof(buf), &ev);
+	end = now_ns();
+	printf("%-12s %8lu events in %7.3f ms: %10.0f events/s\n", "decode",
+	       count * 6, (end - start) / 1e6, count * 6e9 / (end - start));
+	snd_midi_event_free(dev);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{"device", 1, NULL, 'D'},
+		{"events", 1, NULL, 'n'},
+		{"array", 1, NULL, 'a'},
+		{"sysex", 1, NULL, 's'},
+		{"latency", 1, NULL, 'l'},
+		{"help", 0, NULL, 'h'},
+		{NULL, 0, NULL, 0},
+	};
+	const char *device = "loop";
+	unsigned long latency = 20000;
+	struct bench b;
+	int c, err;
+
+	memset(&b, 0, sizeof(b));
+	b.events = 200000;
+	b.array = 64;
+	b.sysex = 256;
+	while ((c = getopt_long(argc, argv, "D:n:a:s:l:h", long_options, NULL)) >= 0) {
+		switch (c) {
+		case 'D':
+			device = optarg;
+			break;
+		case 'n':
+			b.events = strtoul(optarg, NULL, 0);
+			break;
+		case 'a':
+			b.array = strtoul(optarg, NULL, 0);
+			if (!b.array)
+				b.array = 1;
+			break;
+		case 's':
+			b.sysex = strtoul(optarg, NULL, 0);
+			if (b.sysex < 2)
+				b.sysex = 2;
+			break;
+		case 'l':
+			latency = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	err = snd_seq_open(&b.out, device, SND_SEQ_OPEN_OUTPUT, SND_SEQ_NONBLOCK);
+	if (err >= 0)
+		err = snd_seq_open(&b.in, device, SND_SEQ_OPEN_INPUT, SND_SEQ_NONBLOCK);
+	if (err < 0) {
+		fprintf(stderr, "cannot open sequencer: %s\n", snd_strerror(err));
+		return 1;
+	}
+	b.oport = snd_seq_create_simple_port(b.out, "out",
+					     SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ,
+					     SND_SEQ_PORT_TYPE_APPLICATION);
+	b.iport = snd_seq_create_simple_port(b.in, "in",
+					     SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE,
+					     SND_SEQ_PORT_TYPE_APPLICATION);
+	if (b.oport < 0 || b.iport < 0) {
+		fprintf(stderr, "cannot create ports\n");
+		return 1;
+	}
+	err = snd_seq_connect_to(b.out, b.oport, snd_seq_client_id(b.in), b.iport);
+	if (err < 0) {
+		fprintf(stderr, "cannot connect: %s\n", snd_strerror(err));
+		return 1;
+	}
+	b.stamps = calloc(latency + 1, sizeof(*b.stamps));
+	if (!b.stamps)
+		return 1;
+
+	run_throughput(&b, "short", send_short, sizeof(snd_seq_event_t));
+	run_throughput(&b, "array", send_array, sizeof(snd_seq_event_t));
+	run_throughput(&b, "sysex", send_sysex, sizeof(snd_seq_event_t) + b.sysex);
+	run_latency(&b, latency);
+	run_queue(&b, latency < 10000 ? latency : 10000);
+	run_producers(&b, 0);
+	run_producers(&b, 1);
+	run_midi_event(b.events);
+
+	free(b.stamps);
+	snd_seq_close(b.in);
+	snd_seq_close(b.out);
+	return 0;
+}
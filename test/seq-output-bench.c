@@ -0,0 +1,188 @@
+/*
+ * Throughput benchmark for the sequencer output buffer
+ *
+ * Sends a mix of short and SysEx events through snd_seq_event_output()
+ * or snd_seq_event_output_array() as fast as possible and reports the
+ * event rate.  Without a destination
+ * the events go to the (normally absent) subscribers of a local port.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <time.h>
+#include <alsa/asoundlib.h>
+
+static void usage(void)
+{
+	printf("Usage: seq-output-bench [options]\n"
+	       "  -D, --device=NAME       sequencer device (default)\n"
+	       "  -p, --port=CLIENT:PORT  destination port (subscribers)\n"
+	       "  -n, --events=N          number of events (1000000)\n"
+	       "  -s, --sysex=BYTES       SysEx size, 0 = none (32)\n"
+	       "  -e, --every=N           send a SysEx every N events (16)\n"
+	       "  -b, --buffer=BYTES      output buffer size (library default)\n"
+	       "  -a, --array=N           output arrays of N events (1 = single events)\n");
+}
+
+static int wait_output(snd_seq_t *seq)
+{
+	struct pollfd pfd;
+	int err;
+
+	for (;;) {
+		err = snd_seq_drain_output(seq);
+		if (err != -EAGAIN)
+			return err < 0 ? err : 0;
+		snd_seq_poll_descriptors(seq, &pfd, 1, POLLOUT);
+		poll(&pfd, 1, 1000);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{"device", 1, NULL, 'D'},
+		{"port", 1, NULL, 'p'},
+		{"events", 1, NULL, 'n'},
+		{"sysex", 1, NULL, 's'},
+		{"every", 1, NULL, 'e'},
+		{"buffer", 1, NULL, 'b'},
+		{"array", 1, NULL, 'a'},
+		{"help", 0, NULL, 'h'},
+		{NULL, 0, NULL, 0},
+	};
+	const char *device = "default", *dest = NULL;
+	unsigned long events = 1000000, every = 16, array = 1, i, j;
+	size_t sysex_size = 32, buffer_size = 0;
+	unsigned char *sysex;
+	struct timespec start, end;
+	snd_seq_t *seq;
+	snd_seq_event_t *evs;
+	snd_seq_addr_t addr;
+	double secs;
+	int c, port, err;
+
+	while ((c = getopt_long(argc, argv, "D:p:n:s:e:b:a:h", long_options, NULL)) >= 0) {
+		switch (c) {
+		case 'D':
+			device = optarg;
+			break;
+		case 'p':
+			dest = optarg;
+			break;
+		case 'n':
+			events = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			sysex_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'e':
+			every = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			buffer_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'a':
+			array = strtoul(optarg, NULL, 0);
+			if (!array)
+				array = 1;
+			break;
+		default:
+			usage();
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	err = snd_seq_open(&seq, device, SND_SEQ_OPEN_OUTPUT, SND_SEQ_NONBLOCK);
+	if (err < 0) {
+		fprintf(stderr, "cannot open sequencer: %s\n", snd_strerror(err));
+		return 1;
+	}
+	snd_seq_set_client_name(seq, "seq-output-bench");
+	port = snd_seq_create_simple_port(seq, "bench",
+					  SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ,
+					  SND_SEQ_PORT_TYPE_APPLICATION);
+	if (port < 0) {
+		fprintf(stderr, "cannot create port: %s\n", snd_strerror(port));
+		return 1;
+	}
+	if (dest) {
+		err = snd_seq_parse_address(seq, &addr, dest);
+		if (err >= 0)
+			err = snd_seq_connect_to(seq, port, addr.client, addr.port);
+		if (err < 0) {
+			fprintf(stderr, "cannot connect to %s: %s\n", dest, snd_strerror(err));
+			return 1;
+		}
+	}
+	if (buffer_size) {
+		err = snd_seq_set_output_buffer_size(seq, buffer_size);
+		if (err < 0) {
+			fprintf(stderr, "cannot set buffer size: %s\n", snd_strerror(err));
+			return 1;
+		}
+	}
+	sysex = malloc(sysex_size + 2);
+	evs = calloc(array, sizeof(*evs));
+	if (!sysex || !evs)
+		return 1;
+	memset(sysex, 0x10, sysex_size + 2);
+	sysex[0] = 0xf0;
+	sysex[sysex_size + 1] = 0xf7;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < events; i += j) {
+		for (j = 0; j < array && i + j < events; j++) {
+			snd_seq_event_t *ev = &evs[j];
+			snd_seq_ev_clear(ev);
+			snd_seq_ev_set_source(ev, port);
+			snd_seq_ev_set_subs(ev);
+			snd_seq_ev_set_direct(ev);
+			if (sysex_size && every && (i + j) % every == every - 1)
+				snd_seq_ev_set_sysex(ev, sysex_size + 2, sysex);
+			else
+				snd_seq_ev_set_noteon(ev, 0, (i + j) & 0x7f, 64);
+		}
+		if (array > 1) {
+			unsigned long done = 0;
+			while (done < j) {
+				err = snd_seq_event_output_array(seq, evs + done, j - done);
+				if (err == -EAGAIN)
+					err = wait_output(seq);
+				else if (err > 0)
+					done += err;
+				if (err < 0)
+					break;
+			}
+		} else {
+			while ((err = snd_seq_event_output_buffer(seq, evs)) == -EAGAIN) {
+				err = snd_seq_drain_output(seq);
+				if (err == -EAGAIN)
+					err = wait_output(seq);
+				if (err < 0)
+					break;
+			}
+		}
+		if (err < 0) {
+			fprintf(stderr, "output error: %s\n", snd_strerror(err));
+			return 1;
+		}
+	}
+	err = wait_output(seq);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if (err < 0) {
+		fprintf(stderr, "drain error: %s\n", snd_strerror(err));
+		return 1;
+	}
+
+	secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("%lu events in %.3f s: %.0f events/s\n", events, secs, events / secs);
+	free(evs);
+	free(sysex);
+	snd_seq_close(seq);
+	return 0;
+}